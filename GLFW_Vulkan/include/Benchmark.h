@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "Vulkan_Graphics.h"
+#include "GLFW_Wrapper.h"
+
+struct Benchmark_Config
+{
+	uint32_t		warmupFrames;
+	uint32_t		measuredFrames;
+	float			hitchFactor;
+	const char		*pathFile;
+	const char		*outputFile;
+
+	Benchmark_Config()
+	{
+		warmupFrames = 120;
+		measuredFrames = 1000;
+		hitchFactor = 2.0f;
+		pathFile = NULL;
+		outputFile = "benchmark.json";
+	}
+};
+
+struct Benchmark_Stats
+{
+	uint32_t		count;
+	double			avg;
+	double			p50;
+	double			p95;
+	double			p99;
+	double			max;
+	uint32_t		hitches;
+};
+
+/**
+ * @brief replays a frame indexed camera path for warmup + measured frames and writes frame time percentiles as json
+ */
+class Benchmark_Runner
+{
+private:
+	Vulkan_Graphics				*graphics;
+	GLFW_Wrapper				*glfwWrapper;
+	Benchmark_Config			config;
+	Camera_Path					path;
+
+	std::vector<double>			cpuFrameTimes;
+	std::vector<double>			gpuFrameTimes;
+
+	static Benchmark_Stats ComputeStats(std::vector<double> samples, float hitchFactor);
+
+	bool WriteResults(double wallMs);
+
+public:
+	Benchmark_Runner(Vulkan_Graphics *vGraphics, GLFW_Wrapper *gWrapper, Benchmark_Config benchConfig);
+
+	/**
+	 * @brief runs the benchmark, glfw events are pumped when a window wrapper was given
+	 * @return 0 on success
+	 */
+	int Run();
+
+	static uint64_t GetProcessMemory(uint64_t *peak);
+};
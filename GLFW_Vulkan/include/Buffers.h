@@ -37,6 +37,17 @@ struct UniformBufferObject {
 	glm::mat4 model;
 	glm::mat4 view;
 	glm::mat4 proj;
+
+	//read by the paletted fragment shader only, a palette effect is a change to paletteIndex or fixedColormap
+	int32_t paletteIndex;
+	int32_t fixedColormap;
+	float sectorLight;
+	float lightDiminishing;
+};
+
+//pushed per draw by the bindless fragment shader, picks the draw's texture out of the texture table
+struct MaterialPushConstants {
+	uint32_t textureIndex;
 };
 
 static VkVertexInputBindingDescription GetBindingDescription()
@@ -92,33 +103,65 @@ private:
 	std::vector<VkBuffer>					uniformBuffers;
 	std::vector<VkDeviceMemory>				uniformBuffersMemory;
 
+	//model matrices read by the vertex shader at binding 3 and the indexed indirect draw, one of each per image,
+	//both stay mapped so the frame's instance count and matrices are written straight in
+	std::vector<VkBuffer>					instanceBuffers;
+	std::vector<VkDeviceMemory>				instanceBuffersMemory;
+	std::vector<glm::mat4*>					instanceData;
+	std::vector<VkBuffer>					indirectBuffers;
+	std::vector<VkDeviceMemory>				indirectBuffersMemory;
+	std::vector<VkDrawIndexedIndirectCommand*>	indirectCommands;
+	uint32_t								maxInstances;
+	uint32_t								maxDraws;
+
 	std::vector<VkImage>					swapImages;
 
 	VkImageView								textureImageView;
 	VkSampler								textureSampler;
 
+	//palette and colormap lookup at binding 2, only written for the paletted shaders
+	VkImageView								paletteImageView;
+	VkSampler								paletteSampler;
+
 	VkImage									depthImage;
 	VkDeviceMemory							depthImageMemory;
 	VkImageView								depthImageView;
 
+	//set when the depth format can be sampled, so the occlusion pass can read last frame's depth
+	bool									depthSampled;
+
 public:
 	Buffer_Wrapper();
 	~Buffer_Wrapper();
 	
 	void BufferInit(VkDevice logDevice, VkPhysicalDevice physDevice, VkQueue gQueue, std::vector<VkImage> swapChainImages, Command *cmd);
 
-	void CreateDescriptorSetLayout();
+	/**
+	 * @brief layout reflected from the pipeline's shaders, owned by the pipeline registry
+	 */
+	void SetDescriptorSetLayout(VkDescriptorSetLayout layout){ descriptorSetLayout = layout; }
 
 	void CreateDescriptorPool();
 
 	void CreateDescriptorSets();
 
+	/**
+	 * @brief rewrites the combined image sampler of every set after SetTextureInfo, none of the sets may be in use
+	 */
+	void UpdateTextureDescriptors();
+
 	void CreateVertexBuffers(Command *cmd, const std::vector<Vertex> vertices);
 
 	void CreateIndexBuffers(Command *cmd, const std::vector<uint32_t> indices);
 
 	void CreateUniformBuffers();
 
+	/**
+	 * @brief instance matrices and indirect draw commands per image, call before CreateDescriptorSets
+	 * @param drawCapacity draws in each indirect buffer, the first draws indexCount indices and the rest start empty
+	 */
+	void CreateInstanceBuffers(uint32_t instanceCapacity, uint32_t indexCount, uint32_t drawCapacity = 1);
+
 	void CreateDepthResources(VkExtent2D extents, Command *graphicsCommand);
 
 	static void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkDevice logicalDevice, VkQueue graphicsQueue, VkPhysicalDevice physicalDevice);
@@ -127,14 +170,24 @@ public:
 
 	void SetTextureInfo(VkImageView texImgView, VkSampler texSampler);
 
+	void SetPaletteInfo(VkImageView lookupView, VkSampler lookupSampler);
+
 	VkBuffer GetVertexBuffer(){ return vertexBuffer; }
 	VkDeviceMemory GetVertexBufferMemory() { return vertexBufferMemory; }
 	VkBuffer GetIndexBuffer(){ return indexBuffer; }
 	std::vector<VkBuffer> GetUniformBuffers() { return uniformBuffers; }
 	std::vector<VkDeviceMemory> GetUniformBuffersMemory() { return uniformBuffersMemory; }
 	std::vector<VkDescriptorSet> GetDescriptorSets() { return descriptorSets; }
+	std::vector<VkBuffer> GetIndirectBuffers(){ return indirectBuffers; }
+	glm::mat4* GetInstanceData(uint32_t imageIndex){ return instanceData[imageIndex]; }
+	VkDrawIndexedIndirectCommand* GetIndirectCommand(uint32_t imageIndex){ return indirectCommands[imageIndex]; }
+	uint32_t GetMaxInstances(){ return maxInstances; }
+	uint32_t GetMaxDraws(){ return maxDraws; }
 	VkDescriptorSetLayout GetDescriptorSetLayout(){ return descriptorSetLayout; }
 	VkImageView GetDepthImageView(){ return depthImageView; }
+	VkImage GetDepthImage(){ return depthImage; }
+	bool IsDepthSampled(){ return depthSampled; }
+	std::vector<VkBuffer> GetInstanceBuffers(){ return instanceBuffers; }
 
 	VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 	
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Camera_Keyframe
+{
+	uint32_t		frame;
+	glm::vec3		eye;
+	glm::vec3		target;
+	float			modelAngle;
+};
+
+/**
+ * @brief scripted camera/object animation keyed by frame index so that runs are reproducible
+ */
+class Camera_Path
+{
+private:
+	std::vector<Camera_Keyframe>	keys;
+
+public:
+	Camera_Path();
+
+	void AddKey(uint32_t frame, glm::vec3 eye, glm::vec3 target, float modelAngle);
+
+	/**
+	 * @brief loads keys from a text file, one "frame eyeX eyeY eyeZ targetX targetY targetZ angleDegrees" per line
+	 * @return false if the file could not be read or held no keys
+	 */
+	bool Load(const char *filename);
+
+	/**
+	 * @brief builds the default path, the old 90 degrees per second spin sampled at 60 frames per second
+	 */
+	void BuildDefault(uint32_t frameCount);
+
+	/**
+	 * @brief interpolates the path at a frame, wrapping past the last key
+	 */
+	void Evaluate(uint32_t frame, glm::vec3 &eye, glm::vec3 &target, float &modelAngle);
+
+	bool IsEmpty(){ return keys.empty(); }
+};
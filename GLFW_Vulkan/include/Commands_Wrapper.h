@@ -3,6 +3,8 @@
 #include "Pipeline_Wrapper.h"
 #include "Queue_Wrapper.h"
 
+class Occlusion_Culler;
+
 struct Command
 {
 	uint8_t									_inuse;
@@ -39,7 +41,13 @@ public:
 
 	Command* CreateCommandPool(uint32_t graphicsFamily, VkCommandPoolCreateFlags flags);
 
-	void CreateCommandBuffers(Command *cmd, uint32_t swpchnFbs, std::vector<VkFramebuffer> fBuffers, Pipeline* pipe, VkExtent2D extents, VkBuffer vertexBuffer, VkBuffer indexBuffer, std::vector<VkDescriptorSet> descriptorSets, std::vector<uint32_t> indices);
+	/**
+	 * @param indirectBuffers drawCount indexed indirect draws per framebuffer, holding the frame's instance counts
+	 * @param drawsPerCall draws one vkCmdDrawIndexedIndirect may take, 1 without the multiDrawIndirect feature
+	 * @param textureTableSets when given, bound as set 1 beside descriptorSets in one call and the draw samples textureIndex out of it
+	 * @param occlusion when given, culls against the depth drawn and draws what it finds visible in a second pass
+	 */
+	void CreateCommandBuffers(Command *cmd, uint32_t swpchnFbs, std::vector<VkFramebuffer> fBuffers, Pipeline* pipe, VkExtent2D extents, VkBuffer vertexBuffer, VkBuffer indexBuffer, std::vector<VkDescriptorSet> descriptorSets, const std::vector<VkBuffer> &indirectBuffers, uint32_t drawCount, uint32_t drawsPerCall, VkQueryPool timestampPool = VK_NULL_HANDLE, const std::vector<VkDescriptorSet> &textureTableSets = std::vector<VkDescriptorSet>(), uint32_t textureIndex = 0, Occlusion_Culler *occlusion = NULL);
 
 	void ResetCommandPool(Command *com);
 
@@ -52,6 +60,13 @@ public:
 
 	void ConfigureRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkPipeline graphicsPipeline, VkExtent2D extent);
 
+	/**
+	 * @brief sets every dynamic state the pipelines expect, viewport and scissor to extent and the rest to their defaults,
+	 * call after binding a pipeline
+	 * @note a line width other than 1 needs wideLines and a non-zero bias clamp depthBiasClamp
+	 */
+	void SetDynamicState(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
 	void ConfigureRenderPassEnd(VkCommandBuffer cmdBuffer);
 
 	VkCommandBuffer CmdRenderBegin(uint32_t index, Pipeline *thePipe, VkFramebuffer fBuffer, VkPipeline pipeline, VkExtent2D extent, Command *graphicsPool);
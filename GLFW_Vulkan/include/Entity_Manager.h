@@ -0,0 +1,209 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+#include "Job_System.h"
+
+enum EntityComponent
+{
+	EC_TRANSFORM,
+	EC_VELOCITY,
+	EC_MESH,
+	EC_COUNT
+};
+
+#define ENTITY_MASK(component) (1u << (component))
+
+struct Transform_Component
+{
+	static const EntityComponent TYPE = EC_TRANSFORM;
+
+	glm::vec3				position;
+
+	//degrees about z
+	float					yaw;
+	float					scale;
+};
+
+struct Velocity_Component
+{
+	static const EntityComponent TYPE = EC_VELOCITY;
+
+	//units and degrees per second
+	glm::vec3				linear;
+	float					angular;
+};
+
+struct Mesh_Component
+{
+	static const EntityComponent TYPE = EC_MESH;
+
+	uint32_t				mesh;
+	uint32_t				texture;
+};
+
+/**
+ * @brief index into the entity records plus the generation the record had when it was handed out,
+ * an id outlives its entity safely since a reused record has moved on to a later generation
+ */
+struct Entity_Id
+{
+	uint32_t				index;
+
+	//0 is never handed out, a zeroed id is null
+	uint32_t				generation;
+
+	bool operator==(const Entity_Id &other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity_Id &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief every entity with exactly one set of components, one tightly packed array per component
+ */
+struct Entity_Archetype
+{
+	uint32_t				mask;
+	uint32_t				count;
+	uint32_t				capacity;
+
+	//empty for components outside mask
+	std::vector<uint8_t>	columns[EC_COUNT];
+	std::vector<Entity_Id>	entities;
+};
+
+/**
+ * @brief a run of entities out of one archetype handed to a query, component arrays line up by position
+ */
+struct Entity_Chunk
+{
+	uint32_t				count;
+
+	//position of the chunk's first entity among everything the query matches, in iteration order
+	uint32_t				first;
+	const Entity_Id			*entities;
+	void					*columns[EC_COUNT];
+
+	/**
+	 * @return NULL if the archetype has no T
+	 */
+	template <typename T>
+	T* Get(){ return (T*)columns[T::TYPE]; }
+};
+
+typedef void (*EntityQueryFunction)(Entity_Chunk &chunk, void *data);
+
+/**
+ * @brief archetype component storage, a query walks each matching archetype's arrays front to back
+ * @note creating, destroying or changing the components of entities moves rows around,
+ * it must not happen while a query is running
+ */
+class Entity_Manager
+{
+private:
+	struct Entity_Record
+	{
+		uint32_t			generation;
+		uint32_t			archetype;
+		uint32_t			row;
+	};
+
+	std::vector<Entity_Archetype*>	archetypes;
+	std::vector<Entity_Record>		records;
+	std::vector<uint32_t>			freeIndices;
+	uint32_t						aliveCount;
+
+	uint32_t FindArchetype(uint32_t mask);
+
+	/**
+	 * @return the new row, the row's components are left uninitialised
+	 */
+	uint32_t AddRow(Entity_Archetype *archetype, Entity_Id id);
+
+	/**
+	 * @brief fills the hole with the archetype's last row
+	 */
+	void RemoveRow(Entity_Archetype *archetype, uint32_t row);
+
+	void MoveEntity(Entity_Id id, uint32_t mask);
+
+	Entity_Chunk MakeChunk(Entity_Archetype *archetype, uint32_t begin, uint32_t end, uint32_t first);
+
+	template <typename Body>
+	static void RunBody(Entity_Chunk &chunk, void *data)
+	{
+		(*(const Body*)data)(chunk);
+	}
+
+public:
+	Entity_Manager();
+	~Entity_Manager();
+
+	static uint32_t ComponentSize(EntityComponent component);
+
+	/**
+	 * @brief components start zeroed
+	 */
+	Entity_Id Create(uint32_t mask);
+
+	void Destroy(Entity_Id id);
+
+	bool IsAlive(Entity_Id id);
+
+	/**
+	 * @return NULL if the entity is gone or lacks the component, valid until entities are next created, destroyed or changed
+	 */
+	void* GetComponent(Entity_Id id, EntityComponent component);
+
+	template <typename T>
+	T* Get(Entity_Id id){ return (T*)GetComponent(id, T::TYPE); }
+
+	/**
+	 * @brief moves the entity to the archetype with the extra components, the new ones start zeroed
+	 */
+	void AddComponents(Entity_Id id, uint32_t mask);
+
+	void RemoveComponents(Entity_Id id, uint32_t mask);
+
+	/**
+	 * @brief calls query once per archetype holding every component in mask
+	 */
+	void ForEach(uint32_t mask, EntityQueryFunction query, void *data);
+
+	/**
+	 * @brief splits each matching archetype into chunks of at most grain entities and runs them on the job system
+	 * @param grain 0 lets the job system pick
+	 * @note returns once every chunk has run, query must only write to the chunk it is given
+	 */
+	void ParallelForEach(Job_System *jobSystem, uint32_t mask, uint32_t grain, EntityQueryFunction query, void *data);
+
+	/**
+	 * @brief ForEach and ParallelForEach with any callable taking (Entity_Chunk &chunk)
+	 */
+	template <typename Body>
+	void ForEach(uint32_t mask, const Body &body)
+	{
+		ForEach(mask, &Entity_Manager::RunBody<Body>, (void*)&body);
+	}
+
+	template <typename Body>
+	void ParallelForEach(Job_System *jobSystem, uint32_t mask, uint32_t grain, const Body &body)
+	{
+		ParallelForEach(jobSystem, mask, grain, &Entity_Manager::RunBody<Body>, (void*)&body);
+	}
+
+	/**
+	 * @brief entities holding every component in mask
+	 */
+	uint32_t Count(uint32_t mask);
+
+	uint32_t GetEntityCount(){ return aliveCount; }
+	uint32_t GetArchetypeCount(){ return (uint32_t)archetypes.size(); }
+
+	/**
+	 * @brief integrates transforms by velocities over entityCount entities, stored as archetype arrays and as an array
+	 * of whole actor structs, and logs the time per pass of each
+	 * @return false if the two layouts disagree on the result
+	 */
+	static bool Benchmark(uint32_t entityCount);
+};
\ No newline at end of file
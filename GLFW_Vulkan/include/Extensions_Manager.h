@@ -29,6 +29,11 @@ public:
 	Extensions_Manager();
 	~Extensions_Manager();
 
-	std::vector<const char*> InstanceExtensionsInit(bool validation);
+	std::vector<const char*> InstanceExtensionsInit(bool validation, bool windowed = true);
 	void DeviceExtensionsInit(VkPhysicalDevice device, std::vector<const char*> *deviceExtNames);
+
+	/**
+	 * @brief checks a device extension before the device is created, DeviceExtensionsInit enables every available one
+	 */
+	static bool IsDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName);
 };
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+#include "Job_System.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define CULL_HAS_SIMD 1
+#elif defined(__x86_64__) || defined(__i386__)
+#define CULL_HAS_SIMD 1
+#else
+#define CULL_HAS_SIMD 0
+#endif
+
+enum CullPath
+{
+	CULL_SCALAR,
+	CULL_SSE,
+	CULL_AVX2,
+	CULL_PATH_COUNT
+};
+
+/**
+ * @brief tests bounding spheres against the view frustum, stored as separate x, y, z and radius arrays so the
+ * SSE path tests 4 and the AVX2 path 8 spheres per plane at once
+ * @note every path gives the same visible list, in ascending index order
+ */
+class Frustum_Culler
+{
+private:
+	//padded to a multiple of 8 so the wide paths never load past the end
+	std::vector<float>		centerX;
+	std::vector<float>		centerY;
+	std::vector<float>		centerZ;
+	std::vector<float>		radius;
+	uint32_t				count;
+
+	//normalised, a point is inside when dot(plane.xyz, point) + plane.w >= 0
+	glm::vec4				planes[6];
+
+	CullPath				path;
+
+	std::vector<uint32_t>	visible;
+	uint32_t				visibleCount;
+
+	//visible objects per block while the blocks run as jobs, compacted afterwards
+	std::vector<uint32_t>	blockCounts;
+
+	/**
+	 * @brief writes the indices of the visible spheres in [begin, end) to out
+	 * @return how many were written
+	 */
+	static uint32_t CullScalar(const Frustum_Culler *culler, uint32_t begin, uint32_t end, uint32_t *out);
+	static uint32_t CullSSE(const Frustum_Culler *culler, uint32_t begin, uint32_t end, uint32_t *out);
+	static uint32_t CullAVX2(const Frustum_Culler *culler, uint32_t begin, uint32_t end, uint32_t *out);
+
+	uint32_t CullRange(uint32_t begin, uint32_t end, uint32_t *out) const;
+
+public:
+	/**
+	 * @brief starts on the widest path the CPU supports
+	 */
+	Frustum_Culler();
+
+	/**
+	 * @brief planes of the frustum viewProj maps to clip space, with Vulkan's 0 to 1 depth range
+	 */
+	static void ExtractPlanes(const glm::mat4 &viewProj, glm::vec4 planes[6]);
+
+	static bool IsSupported(CullPath path);
+	static CullPath BestPath();
+	static const char* PathName(CullPath path);
+
+	/**
+	 * @return false if the CPU lacks the path, the current one is kept
+	 */
+	bool SetPath(CullPath path);
+	CullPath GetPath(){ return path; }
+
+	void SetFrustum(const glm::mat4 &viewProj);
+
+	/**
+	 * @brief sets the number of spheres, existing ones keep their bounds
+	 */
+	void Resize(uint32_t sphereCount);
+
+	void SetSphere(uint32_t index, const glm::vec3 &center, float sphereRadius)
+	{
+		centerX[index] = center.x;
+		centerY[index] = center.y;
+		centerZ[index] = center.z;
+		radius[index] = sphereRadius;
+	}
+
+	/**
+	 * @brief fills the visible list, split into blocks run on the job system when one is given
+	 * @return the number of visible spheres
+	 */
+	uint32_t Cull(Job_System *jobSystem = NULL);
+
+	const uint32_t* GetVisible(){ return visible.data(); }
+	uint32_t GetVisibleCount(){ return visibleCount; }
+	uint32_t GetCount(){ return count; }
+
+	/**
+	 * @brief culls sphereCount random spheres on every supported path, checks each visible list against the scalar one
+	 * and logs the time per cull on one thread and on the job system
+	 * @return false if any path disagrees with the scalar path
+	 */
+	static bool Benchmark(uint32_t sphereCount);
+};
\ No newline at end of file
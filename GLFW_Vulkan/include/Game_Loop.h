@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "Job_System.h"
+#include "Entity_Manager.h"
+
+//Doom's tic rate
+#define GAME_DEFAULT_TICK_RATE 35
+
+/**
+ * @brief what the renderer needs of one entity, copied out of the entity manager at the end of each tick
+ */
+struct Game_Instance
+{
+	Entity_Id				entity;
+	glm::vec3				position;
+	float					yaw;
+	float					scale;
+	uint32_t				mesh;
+};
+
+/**
+ * @brief everything the simulation hands the renderer, one copy per tick
+ */
+struct Game_State
+{
+	uint32_t					tick;
+
+	//degrees, kept in [0, 360)
+	float						modelAngle;
+
+	//every entity with a transform and a mesh
+	std::vector<Game_Instance>	instances;
+};
+
+/**
+ * @brief runs the simulation at a fixed tick rate while frames draw at whatever rate the present mode allows,
+ * each frame draws the last two ticks blended by how far it sits between them
+ * @note the tick after the newest one simulates as a job while frames draw, a frame only waits on it once a whole tick
+ * has passed and it still hasn't finished
+ */
+class Game_Loop
+{
+private:
+	Job_System								*jobSystem;
+
+	//only touched by the tick job once the loop has started
+	Entity_Manager							*entities;
+
+	double									tickSeconds;
+	uint32_t								tickRate;
+	uint32_t								maxTicksPerFrame;
+
+	//previous and current are drawn, next is written by the tick job, the three rotate every tick
+	Game_State								states[3];
+	uint32_t								previous;
+	uint32_t								current;
+	uint32_t								next;
+	Game_State								rendered;
+
+	Job_Counter								tickCounter;
+
+	std::chrono::steady_clock::time_point	lastTime;
+	bool									started;
+	double									accumulator;
+
+	uint64_t								ticks;
+	uint64_t								ticksDropped;
+
+	static void TickJob(void *data, uint32_t begin, uint32_t end);
+
+	void Simulate(const Game_State &from, Game_State &to);
+
+	/**
+	 * @brief copies every entity with a transform and a mesh into state
+	 */
+	void ExtractInstances(Game_State &state);
+
+	/**
+	 * @brief starts simulating next from current, on the job system if there is one
+	 */
+	void StartTick();
+
+	static void Interpolate(const Game_State &from, const Game_State &to, float alpha, Game_State &result);
+
+public:
+	Game_Loop();
+	~Game_Loop();
+
+	/**
+	 * @param jobSystem NULL simulates each tick inline when it is consumed
+	 * @param entities stepped by the tick job, may be NULL
+	 * @param maxTicksPerFrame ticks one frame may catch up on, time past that is dropped so a slow frame can't
+	 * make the next one slower still
+	 */
+	void Game_LoopInit(Job_System *jobSystem, Entity_Manager *entities, uint32_t tickRate = GAME_DEFAULT_TICK_RATE, uint32_t maxTicksPerFrame = 5);
+
+	/**
+	 * @brief runs every tick the time since the last call covers and returns the state to draw this frame
+	 * @note the pointer stays valid until the next call
+	 */
+	const Game_State* Advance();
+
+	/**
+	 * @brief how far the drawn state sits between the previous and current tick, 0 to 1
+	 */
+	float GetAlpha(){ return (float)(accumulator / tickSeconds); }
+
+	uint32_t GetTickRate(){ return tickRate; }
+	uint64_t GetTicks(){ return ticks; }
+	uint64_t GetTicksDropped(){ return ticksDropped; }
+};
\ No newline at end of file
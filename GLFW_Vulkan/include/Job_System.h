@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief begin and end carry the range of a parallel for chunk, plain jobs can use them as two free arguments
+ */
+typedef void (*JobFunction)(void *data, uint32_t begin, uint32_t end);
+
+class Job_Counter;
+
+struct Job
+{
+	JobFunction				function;
+	void					*data;
+
+	//decremented once the job has run, may be NULL
+	Job_Counter				*counter;
+
+	uint32_t				begin;
+	uint32_t				end;
+};
+
+/**
+ * @brief counts unfinished jobs, waited on as a fence and used as the dependency of jobs started by RunAfter
+ * @note may be reused once it reaches zero, it must outlive every job counting on it
+ */
+class Job_Counter
+{
+private:
+	friend class Job_System;
+
+	std::atomic<uint32_t>	pending;
+
+	//jobs started when pending reaches zero
+	std::mutex				continuationMutex;
+	std::vector<Job>		continuations;
+
+public:
+	Job_Counter();
+
+	bool IsDone(){ return pending.load(std::memory_order_acquire) == 0; }
+};
+
+/**
+ * @brief Chase-Lev work stealing deque, the owning thread pushes and pops at the bottom while any thread steals from the top
+ * @note fixed capacity, Push returns false when full and the caller runs the job itself
+ */
+class Job_Deque
+{
+private:
+	//padded apart so thieves hammering top don't share a cache line with the owner's bottom
+	std::atomic<int64_t>	top;
+	uint8_t					topPadding[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t>	bottom;
+	uint8_t					bottomPadding[64 - sizeof(std::atomic<int64_t>)];
+	std::vector<Job>		jobs;
+	int64_t					mask;
+
+public:
+	/**
+	 * @param capacity rounded up to a power of two
+	 */
+	Job_Deque(uint32_t capacity = 4096);
+
+	bool Push(const Job &job);
+	bool Pop(Job &job);
+	bool Steal(Job &job);
+
+	bool IsEmpty(){ return top.load(std::memory_order_acquire) >= bottom.load(std::memory_order_acquire); }
+};
+
+/**
+ * @brief workers pinned one per core, each with a work stealing deque, plus a queue only the main thread runs for
+ * GLFW and other calls that must stay on it
+ * @note the thread calling Job_SystemInit becomes the main thread and runs jobs whenever it waits
+ */
+class Job_System
+{
+private:
+	std::vector<std::thread>		workers;
+
+	//index 0 belongs to the main thread, worker i owns deque i + 1
+	std::vector<Job_Deque*>			deques;
+
+	//jobs from threads outside the pool, such as the texture decoder's
+	std::mutex						injectMutex;
+	std::deque<Job>					injected;
+	std::atomic<uint32_t>			injectedCount;
+
+	std::mutex						mainMutex;
+	std::deque<Job>					mainJobs;
+
+	std::mutex						sleepMutex;
+	std::condition_variable			workReady;
+	std::atomic<uint32_t>			sleepers;
+	std::atomic<bool>				stopWorkers;
+
+	std::atomic<uint64_t>			jobsRun;
+	std::atomic<uint64_t>			steals;
+
+	void WorkerLoop(uint32_t index);
+
+	/**
+	 * @brief own deque first, then jobs from outside the pool, then a steal from a random victim
+	 */
+	bool FindJob(uint32_t index, Job &job);
+
+	bool HasWork();
+
+	void Execute(const Job &job);
+
+	/**
+	 * @brief retires one job from the counter and starts its continuations when it was the last
+	 */
+	void Finish(Job_Counter *counter);
+
+	void Push(const Job &job);
+
+	void WakeWorker();
+
+	/**
+	 * @brief runs one main thread job, false if there was none
+	 */
+	bool RunMainThreadJob();
+
+	static void PinThread(std::thread &thread, uint32_t core);
+
+	static void SplitRange(void *data, uint32_t begin, uint32_t end);
+
+	template <typename Body>
+	static void RunBody(void *data, uint32_t begin, uint32_t end)
+	{
+		(*(const Body*)data)(begin, end);
+	}
+
+public:
+	Job_System();
+	~Job_System();
+
+	/**
+	 * @param workerCount 0 uses one per core beside the main thread
+	 * @note jobs still queued when the system is destroyed are dropped, wait on their counters first
+	 */
+	void Job_SystemInit(uint32_t workerCount = 0);
+
+	void Run(JobFunction function, void *data, Job_Counter *counter = NULL, uint32_t begin = 0, uint32_t end = 0);
+
+	/**
+	 * @brief queues the job once dependency reaches zero, or right away if it already has
+	 */
+	void RunAfter(Job_Counter *dependency, JobFunction function, void *data, Job_Counter *counter = NULL, uint32_t begin = 0, uint32_t end = 0);
+
+	/**
+	 * @brief the job runs on the main thread, in RunMainThreadJobs or while the main thread waits
+	 */
+	void RunOnMainThread(JobFunction function, void *data, Job_Counter *counter = NULL);
+
+	/**
+	 * @brief runs other jobs until counter reaches zero, the main thread also runs main thread jobs meanwhile
+	 */
+	void Wait(Job_Counter *counter);
+
+	/**
+	 * @brief called by the main loop, runs every main thread job queued so far
+	 */
+	void RunMainThreadJobs();
+
+	/**
+	 * @brief calls body over [0, count) in chunks of at most grain, split recursively so idle workers steal half ranges
+	 * @param grain 0 picks about eight chunks per thread
+	 * @note blocks until every chunk has run, the calling thread runs chunks too
+	 */
+	void ParallelFor(uint32_t count, uint32_t grain, JobFunction body, void *data);
+
+	/**
+	 * @brief ParallelFor with any callable taking (uint32_t begin, uint32_t end)
+	 */
+	template <typename Body>
+	void ParallelFor(uint32_t count, uint32_t grain, const Body &body)
+	{
+		ParallelFor(count, grain, &Job_System::RunBody<Body>, (void*)&body);
+	}
+
+	uint32_t GetWorkerCount(){ return (uint32_t)workers.size(); }
+	uint64_t GetJobsRun(){ return jobsRun.load(std::memory_order_relaxed); }
+	uint64_t GetSteals(){ return steals.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief logs spawn and steal cost per job and parallel for scaling from 1 thread up to maxThreads
+	 * @return false if a parallel for produced a wrong result
+	 */
+	static bool Benchmark(uint32_t maxThreads);
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+/**
+ * @brief a room's floor and ceiling, light is 0-255 like the palette's sector light
+ */
+struct Level_Sector
+{
+	float			floorHeight;
+	float			ceilingHeight;
+	float			light;
+};
+
+/**
+ * @brief a wall from v1 to v2, as in Doom the front sector is on the right walking from v1 to v2
+ * @note back is -1 for a one sided wall, which nothing can be seen through
+ */
+struct Level_Line
+{
+	uint32_t		v1;
+	uint32_t		v2;
+	int32_t			front;
+	int32_t			back;
+};
+
+/**
+ * @brief the map as it is edited, before the BSP and PVS are built
+ */
+struct Level_Source
+{
+	std::vector<glm::vec2>		vertices;
+	std::vector<Level_Sector>	sectors;
+	std::vector<Level_Line>		lines;
+	glm::vec2					start;
+	float						startAngle;
+};
+
+/**
+ * @brief offline build of a Level_Map, splits the map into a BSP of convex leaves, finds the portals between them,
+ * flows visibility through the portals and stores each leaf's potentially visible set run length coded
+ */
+class Level_Compiler
+{
+public:
+	/**
+	 * @brief reads a text map, one of these per line, # starts a comment
+	 *   vertex x y
+	 *   sector floorHeight ceilingHeight light
+	 *   line v1 v2 frontSector backSector
+	 *   start x y angleDegrees
+	 */
+	static bool LoadSource(const char *filename, Level_Source &source);
+
+	/**
+	 * @brief builds the level file's contents
+	 * @return false if the map refers to vertices or sectors it lacks
+	 */
+	static bool Compile(const Level_Source &source, std::vector<uint8_t> &level);
+
+	/**
+	 * @brief compiles a text map into a level file
+	 */
+	static bool CompileFile(const char *sourceFile, const char *levelFile);
+
+	/**
+	 * @brief zero runs are stored as a 0 byte and the run length, other bytes as they are
+	 */
+	static void CompressRow(const uint8_t *row, uint32_t rowSize, std::vector<uint8_t> &compressed);
+
+	/**
+	 * @brief a grid of rooms, each opening onto its neighbours through a doorway in a thick wall
+	 */
+	static void BuildRoomGrid(uint32_t roomsPerSide, Level_Source &source);
+
+	/**
+	 * @brief compiles a roomsPerSide square grid of rooms, then logs the leaves drawn from cameras spread over the map
+	 * against the leaf count, with and without the frustum, and checks that any two points with no wall between them
+	 * have each other's leaf in their PVS
+	 * @return false if the level fails to compile or load, or the PVS misses a leaf that can be seen
+	 */
+	static bool Benchmark(uint32_t roomsPerSide);
+};
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Buffers.h"
+
+#define LEVEL_FILE_MAGIC 0x4C564C44 // "DLVL"
+#define LEVEL_FILE_VERSION 1
+
+//Doom's view height above the floor, in map units
+#define LEVEL_EYE_HEIGHT 41.0f
+
+/**
+ * @brief start of a compiled level, followed by the nodes, leaves, vertices, indices and PVS rows in that order
+ */
+struct Level_Header
+{
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		fileSize;
+	uint32_t		nodeCount;
+	uint32_t		leafCount;
+	uint32_t		vertexCount;
+	uint32_t		indexCount;
+	uint32_t		pvsSize;
+	glm::vec2		start;
+	float			startAngle;
+	uint32_t		pad;
+};
+
+//a child index with the top bit set is a leaf
+#define LEVEL_CHILD_LEAF 0x80000000u
+
+/**
+ * @brief a partition line, points with dot(normal, point) >= distance are in front
+ * @note children[0] is the front, leaves are numbered in tree order so a node's leaves are the range starting at firstLeaf
+ */
+struct Level_Node
+{
+	glm::vec2		normal;
+	float			distance;
+	uint32_t		children[2];
+	uint32_t		firstLeaf;
+	uint32_t		leafCount;
+	glm::vec3		boundsMin;
+	glm::vec3		boundsMax;
+};
+
+/**
+ * @brief one convex subsector, its floor, ceiling and walls are indexCount indices from firstIndex
+ * @note pvsOffset is where the leaf's run length coded row starts in the PVS data
+ */
+struct Level_Leaf
+{
+	glm::vec3		boundsMin;
+	glm::vec3		boundsMax;
+	uint32_t		firstIndex;
+	uint32_t		indexCount;
+	uint32_t		pvsOffset;
+	float			floorHeight;
+	float			ceilingHeight;
+};
+
+/**
+ * @brief a level compiled by Level_Compiler, walks its BSP front to back from the camera and keeps only the leaves
+ * the camera leaf's potentially visible set holds and the frustum touches
+ */
+class Level_Map
+{
+private:
+	std::vector<uint8_t>		data;
+
+	const Level_Header			*header;
+	const Level_Node			*nodes;
+	const Level_Leaf			*leaves;
+	const Vertex				*vertices;
+	const uint32_t				*indices;
+	const uint8_t				*pvs;
+
+	//the camera leaf's row, expanded, with visibleBefore[i] the number of its visible leaves below leaf i
+	uint32_t					pvsLeaf;
+	std::vector<uint8_t>		pvsRow;
+	std::vector<uint32_t>		visibleBefore;
+
+	std::vector<uint32_t>		nodeStack;
+
+	bool Validate() const;
+
+	void SetPvsLeaf(uint32_t leaf);
+
+public:
+	Level_Map();
+
+	/**
+	 * @brief reads a compiled level, false if it is missing or malformed
+	 */
+	bool Level_MapInit(const char *filename);
+
+	/**
+	 * @brief takes a compiled level already in memory
+	 */
+	bool Level_MapInit(const std::vector<uint8_t> &level);
+
+	bool IsLoaded() const { return header != NULL; }
+
+	/**
+	 * @brief the leaf holding a point on the map, every point is in exactly one
+	 */
+	uint32_t FindLeaf(const glm::vec2 &point) const;
+
+	/**
+	 * @brief fills visible with the leaves to draw from eye, nearest first
+	 * @param viewProj NULL skips the frustum test and keeps every leaf in the PVS
+	 * @return the camera leaf
+	 */
+	uint32_t CollectVisible(const glm::vec3 &eye, const glm::mat4 *viewProj, std::vector<uint32_t> &visible);
+
+	/**
+	 * @brief expands a leaf's PVS row, bit i of the leafCount bits is set when leaf i may be seen from it
+	 */
+	void DecompressPvs(uint32_t leaf, std::vector<uint8_t> &row) const;
+
+	uint32_t GetLeafCount() const { return header ? header->leafCount : 0; }
+	uint32_t GetNodeCount() const { return header ? header->nodeCount : 0; }
+	const Level_Leaf& GetLeaf(uint32_t leaf) const { return leaves[leaf]; }
+
+	uint32_t GetVertexCount() const { return header ? header->vertexCount : 0; }
+	uint32_t GetIndexCount() const { return header ? header->indexCount : 0; }
+	const Vertex* GetVertices() const { return vertices; }
+	const uint32_t* GetIndices() const { return indices; }
+	uint32_t GetPvsSize() const { return header ? header->pvsSize : 0; }
+
+	/**
+	 * @brief the player start at eye height above the floor it stands on
+	 */
+	glm::vec3 GetStartEye() const;
+	float GetStartAngle() const { return header ? header->startAngle : 0.0f; }
+
+	/**
+	 * @brief the furthest two points of the level can be apart, for the far plane
+	 */
+	float GetExtent() const;
+};
\ No newline at end of file
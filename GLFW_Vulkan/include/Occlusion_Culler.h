@@ -0,0 +1,200 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Pipeline_Wrapper.h"
+
+#define OCCLUSION_DOWNSAMPLE_SHADER "shaders/hiz_comp.spv"
+#define OCCLUSION_TEST_SHADER "shaders/occlusion_comp.spv"
+
+//an object's action, the first phase drew it and the test only refreshes its visibility
+#define OCCLUSION_DRAWN 0x80000000u
+//an object's action, the index is an instance slot copied into the compacted instances when it passes, not a draw
+#define OCCLUSION_INSTANCE 0x40000000u
+#define OCCLUSION_INDEX_MASK 0x3FFFFFFFu
+
+/**
+ * @brief world space bounds tested against the depth pyramid, laid out as the test shader reads them
+ * @note id is the object's slot in the visibility buffer, action what passing the test does
+ */
+struct Occlusion_Object
+{
+	glm::vec3		boundsMin;
+	uint32_t		id;
+	glm::vec3		boundsMax;
+	uint32_t		action;
+};
+
+/**
+ * @brief start of an object buffer, the test is dispatched indirectly from it so the recording never changes
+ */
+struct Occlusion_ObjectHeader
+{
+	VkDispatchIndirectCommand	dispatch;
+	uint32_t		objectCount;
+	uint32_t		pad[4];
+};
+
+struct Occlusion_DownsamplePush
+{
+	glm::ivec2		sourceSize;
+	glm::ivec2		destinationSize;
+};
+
+struct Occlusion_TestPush
+{
+	glm::vec2		depthSize;
+	uint32_t		mipCount;
+	uint32_t		compactBase;
+};
+
+/**
+ * @brief two phase occlusion culling against a hierarchical depth pyramid
+ * the first phase draws what was visible last time, a compute pass then downsamples that depth into the pyramid
+ * and tests every object's bounds against it, and a second render pass draws the objects the first skipped that turned out visible,
+ * so something coming out from behind a wall is drawn the frame it appears instead of the frame after
+ * @note each render image has its own object, visibility and draw buffers, written on the cpu once its last submission has completed
+ */
+class Occlusion_Culler
+{
+private:
+	VkDevice				logicalDevice;
+	VkPhysicalDevice		physicalDevice;
+
+	VkImage					depthImage;
+	VkImageView				depthImageView;
+	VkImageAspectFlags		depthAspect;
+	VkExtent2D				depthExtent;
+
+	//farthest depth of each 2x2 block of the level below, level 0 is half the depth buffer
+	VkImage					hizImage;
+	VkDeviceMemory			hizImageMemory;
+	VkImageView				hizView;
+	std::vector<VkImageView>	hizLevelViews;
+	std::vector<VkExtent2D>	hizSizes;
+	VkSampler				hizSampler;
+
+	VkRenderPass			loadRenderPass;
+
+	VkPipeline				downsamplePipeline;
+	VkPipelineLayout		downsampleLayout;
+	VkPipeline				testPipeline;
+	VkPipelineLayout		testLayout;
+
+	VkDescriptorPool		descriptorPool;
+	std::vector<VkDescriptorSet>	downsampleSets;
+	std::vector<VkDescriptorSet>	testSets;
+
+	std::vector<VkBuffer>	objectBuffers;
+	std::vector<VkDeviceMemory>	objectBuffersMemory;
+	std::vector<Occlusion_ObjectHeader*>	objectData;
+
+	std::vector<VkBuffer>	visibilityBuffers;
+	std::vector<VkDeviceMemory>	visibilityBuffersMemory;
+	std::vector<uint32_t*>	visibilityData;
+
+	//the second phase's draws, the test sets their instance counts
+	std::vector<VkBuffer>	drawBuffers;
+	std::vector<VkDeviceMemory>	drawBuffersMemory;
+	std::vector<VkDrawIndexedIndirectCommand*>	drawData;
+	std::vector<uint32_t>	drawsWritten;
+
+	uint32_t				maxObjects;
+	uint32_t				visibilitySize;
+	uint32_t				maxDraws;
+	uint32_t				compactBase;
+
+	uint64_t				framesCulled;
+	uint64_t				objectsTested;
+	uint64_t				objectsDeferred;
+	uint64_t				objectsRecovered;
+
+	void CreateHizImage(VkExtent2D extent);
+
+	void CreateBuffers(uint32_t imageCount);
+
+	void WriteDownsampleSets();
+
+	Occlusion_Object* GetObjects(uint32_t imageIndex){ return (Occlusion_Object*)(objectData[imageIndex] + 1); }
+
+	bool AddObject(uint32_t imageIndex, uint32_t id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, uint32_t action);
+
+public:
+	Occlusion_Culler();
+	~Occlusion_Culler();
+
+	/**
+	 * @param imageCount one set of buffers per render image
+	 * @param visibilityIds ids objects may use, every one starts visible
+	 * @param drawCapacity the second phase's draws, the first is always the compacted instances
+	 * @param compactedBase instance slot the deferred instances that pass are copied to onward
+	 * @return false if the compute shaders are missing or fail to build, the renderer then draws without it
+	 */
+	bool Occlusion_CullerInit(VkDevice device, VkPhysicalDevice physDevice, Pipeline_Wrapper *pipeWrapper, VkImage depth, VkImageView depthView, VkFormat depthFormat,
+		VkExtent2D extent, uint32_t imageCount, uint32_t visibilityIds, uint32_t objectCapacity, uint32_t drawCapacity, uint32_t compactedBase);
+
+	/**
+	 * @brief points each image's test at its uniform buffer, for the view and projection, and its instance buffer
+	 */
+	void BindFrameBuffers(const std::vector<VkBuffer> &uniformBuffers, const std::vector<VkBuffer> &instanceBuffers);
+
+	/**
+	 * @brief starts an image's object list, reading what its last submission's second phase drew
+	 * @param instanceDraw the model's draw, the compacted instances are drawn with it
+	 */
+	void BeginFrame(uint32_t imageIndex, const VkDrawIndexedIndirectCommand &instanceDraw);
+
+	/**
+	 * @brief whether the object passed the test the last time this image was drawn
+	 */
+	bool WasVisible(uint32_t imageIndex, uint32_t id) const { return id >= visibilitySize || visibilityData[imageIndex][id] != 0; }
+
+	/**
+	 * @brief an object the first phase draws, tested so it drops out once something covers it
+	 */
+	void AddDrawn(uint32_t imageIndex, uint32_t id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+	/**
+	 * @brief an instance the first phase skipped, its matrix at instanceSlot is drawn in the second if it passes
+	 * @return false when full, the caller draws it in the first phase instead
+	 */
+	bool AddDeferredInstance(uint32_t imageIndex, uint32_t id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, uint32_t instanceSlot);
+
+	/**
+	 * @brief a draw the first phase skipped, drawn in the second if it passes
+	 * @return false when full, the caller draws it in the first phase instead
+	 */
+	bool AddDeferredDraw(uint32_t imageIndex, uint32_t id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const VkDrawIndexedIndirectCommand &draw);
+
+	/**
+	 * @brief sizes the test's dispatch to the objects added
+	 */
+	void EndFrame(uint32_t imageIndex);
+
+	/**
+	 * @brief records the pyramid build and the test, between the first phase's render pass and the second's
+	 * @note leaves the depth buffer as the first phase left it, ready for GetRenderPass to load
+	 */
+	void RecordCulling(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+	/**
+	 * @brief the render pass the second phase draws in, loading the first's color and depth
+	 */
+	VkRenderPass GetRenderPass(){ return loadRenderPass; }
+	const std::vector<VkBuffer>& GetDrawBuffers(){ return drawBuffers; }
+	uint32_t GetMaxDraws(){ return maxDraws; }
+
+	uint32_t GetMipCount(){ return (uint32_t)hizSizes.size(); }
+	uint64_t GetFramesCulled(){ return framesCulled; }
+	uint64_t GetObjectsTested(){ return objectsTested; }
+
+	/**
+	 * @brief objects left out of the first phase, and how many of those the second phase drew
+	 */
+	uint64_t GetObjectsDeferred(){ return objectsDeferred; }
+	uint64_t GetObjectsRecovered(){ return objectsRecovered; }
+};
\ No newline at end of file
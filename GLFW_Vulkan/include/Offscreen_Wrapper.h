@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include "Pipeline_Wrapper.h"
+#include "Commands_Wrapper.h"
+
+/**
+ * @brief render target used in place of the swapchain when running without a window or surface
+ */
+class Offscreen_Wrapper
+{
+private:
+	VkDevice							logDevice;
+	VkPhysicalDevice					physDevice;
+
+	VkFormat							colorFormat;
+	VkExtent2D							extent;
+
+	std::vector<VkImage>				colorImages;
+	std::vector<VkDeviceMemory>			colorImagesMemory;
+	std::vector<VkImageView>			imageViews;
+
+	std::vector<VkFramebuffer>			frameBuffers;
+
+public:
+	Offscreen_Wrapper();
+	~Offscreen_Wrapper();
+
+	void OffscreenInit(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t width, uint32_t height, uint32_t imageCount);
+
+	VkFormat GetFormat(){ return colorFormat; }
+	VkExtent2D GetExtent(){ return extent; }
+
+	std::vector<VkImage> GetImages(){ return colorImages; }
+	std::vector<VkImageView> GetImageViews(){ return imageViews; }
+
+	void CreateFrameBuffers(Pipeline* pipe, VkImageView depthImageView);
+
+	std::vector<VkFramebuffer> GetFrameBuffers(){ return frameBuffers; }
+
+	/**
+	 * @brief copies a finished color image back to host memory and writes it as a png
+	 * @param index the image to read back, must be in TRANSFER_SRC_OPTIMAL layout
+	 */
+	bool SaveImage(uint32_t index, const char *filename, Command *cmd, VkQueue queue);
+};
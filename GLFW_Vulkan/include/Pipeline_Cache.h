@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief header written in front of the driver's cache blob, the driver header alone has no driverVersion
+ */
+struct Pipeline_CacheFileHeader
+{
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		vendorID;
+	uint32_t		deviceID;
+	uint32_t		driverVersion;
+	uint8_t			pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t		dataSize;
+	uint64_t		dataHash;
+};
+
+/**
+ * @brief VkPipelineCache persisted to disk, validated against the current device and replaced atomically on save
+ */
+class Pipeline_Cache
+{
+private:
+	VkDevice						logicalDevice;
+	VkPhysicalDeviceProperties		deviceProperties;
+	VkPipelineCache					cache;
+	std::string						cachePath;
+
+	bool							loadedFromDisk;
+	size_t							loadedBytes;
+
+	std::atomic<uint32_t>			pipelinesCreated;
+	std::atomic<uint64_t>			creationMicroseconds;
+	uint32_t						pipelinesAtLastSave;
+
+	std::chrono::steady_clock::time_point	lastSave;
+	float							saveInterval;
+	std::thread						saveThread;
+
+	bool ValidateHeader(const Pipeline_CacheFileHeader &header, const uint8_t *data, size_t size);
+
+	static uint64_t HashData(const uint8_t *data, size_t size);
+
+	static bool WriteFileAtomic(const std::string &path, const std::vector<uint8_t> &contents);
+
+	void WriteSnapshot();
+
+public:
+	Pipeline_Cache();
+	~Pipeline_Cache();
+
+	/**
+	 * @brief creates the cache, seeded from path when the file matches this device and driver
+	 * @param saveSeconds minimum interval between periodic saves, 0 disables them
+	 */
+	void Pipeline_CacheInit(VkPhysicalDevice physDevice, VkDevice device, const char *path, float saveSeconds = 30.0f);
+
+	VkPipelineCache GetCache(){ return cache; }
+
+	/**
+	 * @brief records a pipeline creation so startup cost with a warm or cold cache can be reported
+	 */
+	void RecordCreation(uint32_t pipelineCount, double milliseconds);
+
+	/**
+	 * @brief called once per frame, saves on a background thread when new pipelines exist and the interval has passed
+	 */
+	void Update();
+
+	/**
+	 * @brief blocking save, used at shutdown
+	 */
+	void Save();
+
+	bool WasLoadedFromDisk(){ return loadedFromDisk; }
+	uint32_t GetPipelinesCreated(){ return pipelinesCreated.load(); }
+	double GetCreationMilliseconds(){ return creationMicroseconds.load() / 1000.0; }
+};
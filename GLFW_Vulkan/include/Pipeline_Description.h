@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief shader feature toggles, bit n is passed to both stages as a VkBool32 specialization constant with constant_id n
+ */
+typedef enum
+{
+	SV_AlphaTest	= 1 << 0,
+	SV_Fog			= 1 << 1,
+	SV_Fullbright	= 1 << 2,
+	SV_Lighting		= 1 << 3
+}ShaderVariantBits;
+
+#define SHADER_VARIANT_FEATURES 4
+
+/**
+ * @brief full graphics pipeline state, two descriptions that compare equal produce interchangeable pipelines
+ * @note viewport and scissor are dynamic and set at record time, so the render extent is not part of the state
+ */
+struct Pipeline_Description
+{
+	std::string										vertFile;
+	std::string										fragFile;
+
+	//ShaderVariantBits, each distinct key is its own pipeline with the unused paths compiled out
+	uint32_t										variantKey;
+
+	std::vector<VkVertexInputBindingDescription>	bindings;
+	std::vector<VkVertexInputAttributeDescription>	attributes;
+	VkPrimitiveTopology								topology;
+
+	VkPolygonMode									polygonMode;
+	VkCullModeFlags									cullMode;
+	VkFrontFace										frontFace;
+
+	VkBool32										depthTest;
+	VkBool32										depthWrite;
+	VkCompareOp										depthCompare;
+
+	VkBool32										blendEnable;
+	VkBlendFactor									srcColorBlend;
+	VkBlendFactor									dstColorBlend;
+	VkBlendOp										colorBlendOp;
+	VkBlendFactor									srcAlphaBlend;
+	VkBlendFactor									dstAlphaBlend;
+	VkBlendOp										alphaBlendOp;
+
+	std::vector<VkDescriptorSetLayout>				setLayouts;
+	std::vector<VkPushConstantRange>				pushConstants;
+
+	//render pass compatibility, any pass compatible with this one can use the pipeline
+	VkRenderPass									renderPass;
+	uint32_t										subpass;
+
+	Pipeline_Description()
+	{
+		variantKey = 0;
+		topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		polygonMode = VK_POLYGON_MODE_FILL;
+		cullMode = VK_CULL_MODE_BACK_BIT;
+		frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		depthTest = VK_TRUE;
+		depthWrite = VK_TRUE;
+		depthCompare = VK_COMPARE_OP_LESS;
+		blendEnable = VK_FALSE;
+		srcColorBlend = VK_BLEND_FACTOR_SRC_ALPHA;
+		dstColorBlend = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlendOp = VK_BLEND_OP_ADD;
+		srcAlphaBlend = VK_BLEND_FACTOR_ONE;
+		dstAlphaBlend = VK_BLEND_FACTOR_ZERO;
+		alphaBlendOp = VK_BLEND_OP_ADD;
+		renderPass = VK_NULL_HANDLE;
+		subpass = 0;
+	}
+
+	uint64_t Hash() const;
+
+	bool operator==(const Pipeline_Description &other) const;
+};
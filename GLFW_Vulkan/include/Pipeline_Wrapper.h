@@ -1,62 +1,295 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "Job_System.h"
 #include "Shader_Wrapper.h"
+#include "Shader_Archive.h"
+#include "Pipeline_Cache.h"
+#include "Pipeline_Description.h"
+
+typedef uint32_t PipelineHandle;
+
+#define PIPELINE_HANDLE_INVALID 0xFFFFFFFF
+
+typedef enum
+{
+	PS_Pending,
+	PS_Ready,
+	PS_Failed
+}PipelineStatus;
 
 
 struct Pipeline
 {
-	bool                inUse;
-	VkPipeline          graphicsPipeline;
-	VkRenderPass        renderPass;
-	VkPipelineLayout    pipelineLayout;
-	size_t              vertSize;
-	char               *vertShader;
-	VkShaderModule      vertModule;
-	size_t              fragSize;
-	char               *fragShader;
-	VkShaderModule      fragModule;
-	VkDevice            device;
+	bool					inUse;
+	VkPipeline				graphicsPipeline;
+	VkRenderPass			renderPass;
+	VkPipelineLayout		pipelineLayout;
+	uint64_t				hash;
+	Pipeline_Description	description;
+	VkDevice				device;
+
+	//written by the compile job, graphicsPipeline is only valid once this reads PS_Ready
+	std::atomic<uint32_t>	status;
+
+	//a hot reload compiles here, the main thread swaps it in at a frame boundary
+	VkPipeline				rebuiltPipeline;
 
 	Pipeline()
 	{
 		this->inUse = false;
-		this->vertModule = VK_NULL_HANDLE;
-		this->fragModule = VK_NULL_HANDLE;
+		this->status = PS_Pending;
+		this->graphicsPipeline = VK_NULL_HANDLE;
+		this->rebuiltPipeline = VK_NULL_HANDLE;
+		this->renderPass = VK_NULL_HANDLE;
+		this->pipelineLayout = VK_NULL_HANDLE;
+		this->hash = 0;
+		this->device = VK_NULL_HANDLE;
 	}
 };
 
+struct Pipeline_Shader
+{
+	VkShaderModule			module;
+	Shader_Reflection		reflection;
+};
+
+struct Pipeline_CompileJob
+{
+	Pipeline				*pipe;
+	bool					rebuild;
+};
+
+/**
+ * @brief an object the gpu may still be using, destroyed once the frame it was retired on has completed
+ */
+struct Pipeline_Retired
+{
+	VkPipeline				pipeline;
+	VkShaderModule			module;
+	uint64_t				frame;
+};
+
 
 class Pipeline_Wrapper
 {
 private:
 	Shader_Wrapper			*shaderWrapper;
-	
-	uint32_t				maxPipes;
-	std::vector<Pipeline>	pipelineList;
+
+	//deque so pointers handed out by GetPipeline stay valid as the registry grows
+	std::deque<Pipeline>	pipelineList;
+
+	std::unordered_map<uint64_t, std::vector<PipelineHandle>>	pipelineLookup;
+
+	//keyed by the set layouts followed by stage, offset and size of each push constant range
+	std::map<std::vector<uint64_t>, VkPipelineLayout>	layoutCache;
+
+	//keyed by binding, type, count, stages and binding flags of each binding, identical sets share one layout
+	std::map<std::vector<uint32_t>, VkDescriptorSetLayout>	setLayoutCache;
+
+	//descriptors given to runtime sized arrays, 0 while descriptor indexing is off
+	uint32_t				indexedArraySize;
+
+	std::unordered_map<std::string, Pipeline_Shader>	shaderModules;
+
+	//shaders changed on disk since startup, loaded from the loose file instead of the archive
+	std::set<std::string>	looseShaders;
 
 	VkDevice				logicalDevice;
+	VkRenderPass			renderPass;
+
+	//renderPass again with its attachments loaded, for drawing more into a frame after compute work
+	VkRenderPass			loadRenderPass;
+
+	PipelineHandle			graphicsPipelineIndex;
+
+	Pipeline_Cache			*pipelineCache;
+
+	Shader_Archive			*shaderArchive;
+
+	uint32_t				lookupHits;
+	std::atomic<uint32_t>	pipelineBuilds;
+	std::atomic<uint32_t>	pipelineRebuilds;
+
+	std::mutex				moduleMutex;
+
+	//one job per queued compile, each takes the oldest entry of compileQueue
+	Job_System				*jobSystem;
+	Job_Counter				compilesRunning;
+	std::deque<Pipeline_CompileJob>	compileQueue;
+	std::mutex				compileMutex;
+	std::condition_variable	compileDone;
+	bool					stopCompiling;
+	uint32_t				compilesPending;
+
+	std::vector<Pipeline*>	completedRebuilds;
+	std::atomic<bool>		compiledSinceUpdate;
+	std::vector<Pipeline_Retired>	retiredObjects;
+	uint64_t				currentFrame;
+
+	void QueueCompile(Pipeline *pipe, bool rebuild);
 
-	uint32_t				graphicsPipelineIndex;
+	/**
+	 * @brief compiles the oldest queued pipeline
+	 */
+	void CompileNext();
+
+	static void CompileJob(void *data, uint32_t begin, uint32_t end);
+
+	void CompilePipeline(Pipeline *pipe, bool rebuild);
+
+	Pipeline* RegisterPipeline(const Pipeline_Description &description, PipelineHandle *handle);
+
+	PipelineHandle FindPipeline(const Pipeline_Description &description, uint64_t hash);
+
+	Pipeline_Shader& LoadShader(const std::string &filename);
+
+	VkShaderModule GetShaderModule(const std::string &filename);
+
+	VkPipelineLayout GetLayout(const std::vector<VkDescriptorSetLayout> &setLayouts, const std::vector<VkPushConstantRange> &pushConstants);
+
+	void ReflectSetLayouts(const Shader_Reflection &reflection, std::vector<VkDescriptorSetLayout> &setLayouts);
 
 public:
 	Pipeline_Wrapper();
 	~Pipeline_Wrapper();
 
-	void Pipeline_WrapperInit(uint32_t maxPipelines);
+	/**
+	 * @brief sets up the registry and the render pass every registered pipeline is compatible with
+	 * @param jobs runs the background compiles, it must outlive the wrapper
+	 */
+	void Pipeline_WrapperInit(VkDevice device, VkPhysicalDevice physDevice, VkFormat format, Job_System *jobs, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+	void SetPipelineCache(Pipeline_Cache *cache){ pipelineCache = cache; }
+
+	/**
+	 * @brief shaders are created from the archive's mapping when it holds them, loose files otherwise
+	 */
+	void SetShaderArchive(Shader_Archive *archive){ shaderArchive = archive; }
+
+	/**
+	 * @brief registers the standard mesh pipeline for the given shaders and makes it the current pipe
+	 * @note the compile runs in the background, WaitForPipeline(GetCurrentHandle()) before recording with it
+	 */
+	void PipelineLoad(const char *vertFile, const char *fragFile);
+
+	/**
+	 * @brief description filled with the standard vertex layout, the shared render pass and layouts reflected from the shaders
+	 */
+	Pipeline_Description DefaultDescription(const char *vertFile, const char *fragFile);
+
+	/**
+	 * @brief fills setLayouts and pushConstants from the shaders' SPIR-V and checks the vertex attributes cover the vertex inputs
+	 * @return false if the stages disagree about a binding
+	 */
+	bool ReflectDescription(Pipeline_Description &description);
+
+	Shader_Reflection GetShaderReflection(const std::string &filename);
+
+	/**
+	 * @brief creates a compute pipeline with layouts reflected from the shader, the caller destroys the pipeline
+	 * @param layout receives the pipeline layout, owned by the registry like the set layouts
+	 * @return VK_NULL_HANDLE if the driver fails to create it
+	 */
+	VkPipeline CreateComputePipeline(const std::string &compFile, VkPipelineLayout &layout, std::vector<VkDescriptorSetLayout> &setLayouts);
+
+	/**
+	 * @brief true if the archive or the shader directory holds filename, without loading it
+	 */
+	bool HasShader(const std::string &filename);
 
-	void PipelineLoad(VkDevice device, char* vertFile, char* fragFile, VkFormat format, VkPhysicalDevice physDevice, VkExtent2D extents, VkDescriptorSetLayout descriptorSetLayout);
+	/**
+	 * @brief lays runtime sized shader arrays out as arraySize partially bound, update after bind descriptors
+	 * @note the device must have been created with the matching VK_EXT_descriptor_indexing features, call before reflecting
+	 */
+	void EnableDescriptorIndexing(uint32_t arraySize){ indexedArraySize = arraySize; }
 
-	Pipeline* NewPipe();
+	/**
+	 * @brief one layout per distinct binding list, the registry owns and destroys them
+	 * @param bindingFlags empty, or VK_EXT_descriptor_indexing flags for each binding
+	 */
+	VkDescriptorSetLayout GetSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings, const std::vector<VkDescriptorBindingFlagsEXT> &bindingFlags = std::vector<VkDescriptorBindingFlagsEXT>());
 
-	void RenderPassSetup(VkFormat format, VkPhysicalDevice physDevice, VkDevice lDevice);
+	/**
+	 * @brief returns the pipeline matching the description, creating it only if no identical one is registered
+	 */
+	PipelineHandle AcquirePipeline(const Pipeline_Description &description);
+
+	/**
+	 * @brief resolves many descriptions at once, everything not yet registered is created in a single driver call
+	 * @param handles receives one handle per description, in order
+	 */
+	void AcquirePipelines(const std::vector<Pipeline_Description> &descriptions, std::vector<PipelineHandle> &handles);
+
+	/**
+	 * @brief like AcquirePipeline but returns at once, a new pipeline is compiled as a job on the job system
+	 * @note registry calls are made from the main thread, only the driver compile runs in the job
+	 */
+	PipelineHandle RequestPipeline(const Pipeline_Description &description);
+
+	/**
+	 * @brief the base pipeline with a different ShaderVariantBits key, compiled on demand and shared by every material using that key
+	 */
+	PipelineHandle RequestVariant(PipelineHandle base, uint32_t variantKey);
+
+	bool IsPipelineReady(PipelineHandle handle);
+
+	/**
+	 * @brief blocks until the pipeline has finished compiling, returns false if it failed
+	 */
+	bool WaitForPipeline(PipelineHandle handle);
+
+	/**
+	 * @brief the pipeline if it is ready, otherwise the fallback if that is ready, otherwise NULL and the draw should be skipped
+	 */
+	Pipeline* ResolvePipeline(PipelineHandle handle, PipelineHandle fallback = PIPELINE_HANDLE_INVALID);
+
+	uint32_t GetPendingCompiles();
+
+	/**
+	 * @brief drops the cached module for a changed SPIR-V file and recompiles every pipeline using it in the background
+	 * @note the running pipelines stay in use until the rebuilds are swapped in by UpdateReloads
+	 */
+	void ReloadShader(const std::string &filename);
+
+	/**
+	 * @brief called at a frame boundary, swaps in finished rebuilds and destroys objects retired framesInFlight frames ago
+	 * @return true if any pipeline changed and command buffers recorded with it need recording again
+	 */
+	bool UpdateReloads(uint64_t frame, uint32_t framesInFlight);
+
+	Pipeline* GetPipeline(PipelineHandle handle) { return handle < pipelineList.size() ? &pipelineList[handle] : NULL; }
+
+	void RenderPassSetup(VkFormat format, VkPhysicalDevice physDevice, VkDevice lDevice, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+	VkRenderPass GetRenderPass() { return renderPass; }
+	VkRenderPass GetLoadRenderPass() { return loadRenderPass; }
 
 	VkFormat FindDepthFormat(VkPhysicalDevice physDevice);
 
 	VkFormat FindSupportedFormat(VkFormat* candidates, uint32_t candidateCount, VkImageTiling tiling, VkFormatFeatureFlags features, VkPhysicalDevice physDevice);
 
-	Pipeline GetCurrentPipe() { return pipelineList[graphicsPipelineIndex]; }
+	PipelineHandle GetCurrentHandle() { return graphicsPipelineIndex; }
+
+	Pipeline& GetCurrentPipe() { return pipelineList[graphicsPipelineIndex]; }
 
 	VkPipelineLayout GetPipelineLayout() { return pipelineList[graphicsPipelineIndex].pipelineLayout; }
 
-	static std::vector<char> ReadShaderFile(const std::string& filename);
+	uint32_t GetPipelineCount() { return (uint32_t)pipelineList.size(); }
+
+	uint32_t GetLookupHits() { return lookupHits; }
+
+	/**
+	 * @brief driver pipeline creations, and how many of those replaced a pipeline that already existed
+	 */
+	uint32_t GetBuildCount() { return pipelineBuilds.load(); }
+	uint32_t GetRebuildCount() { return pipelineRebuilds.load(); }
 };
\ No newline at end of file
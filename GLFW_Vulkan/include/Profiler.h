@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_HAS_RDTSC 1
+#else
+#include <chrono>
+#define PROFILER_HAS_RDTSC 0
+#endif
+
+struct Profile_Event
+{
+	const char			*name;
+	uint64_t			start;
+	uint64_t			end;
+};
+
+class Profiler
+{
+public:
+	static std::atomic<bool>	capturing;
+
+	/**
+	 * @brief raw timestamp, rdtsc where available and steady_clock nanoseconds otherwise
+	 */
+	static inline uint64_t ReadTicks()
+	{
+#if PROFILER_HAS_RDTSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/**
+	 * @brief pushes a finished zone into the calling thread's ring buffer
+	 */
+	static void Record(const char *name, uint64_t start, uint64_t end);
+
+	/**
+	 * @brief starts capturing right away and stops after frameCount frame marks, written as chrome trace json to outputFile
+	 * @note called before startup work, the first frame of the capture covers it
+	 */
+	static void BeginCapture(uint32_t frameCount, const char *outputFile);
+
+	/**
+	 * @brief marks a frame boundary, must be called once per frame from the main thread
+	 * @note a finished capture is written on its own thread, not inside the frame that ended it
+	 */
+	static void FrameMark();
+
+	/**
+	 * @brief ends a capture still running and waits until every capture has been written, call before exit
+	 */
+	static void Flush();
+
+	/**
+	 * @brief cost of one zone with and without a capture running
+	 * @return false if a captured zone costs more than the 20 ns target
+	 */
+	static bool Benchmark();
+
+	static bool IsCapturing() { return capturing.load(std::memory_order_relaxed); }
+};
+
+class Profile_Zone
+{
+private:
+	const char			*name;
+	uint64_t			start;
+
+public:
+	Profile_Zone(const char *zoneName)
+	{
+		name = zoneName;
+		start = Profiler::capturing.load(std::memory_order_relaxed) ? Profiler::ReadTicks() : 0;
+	}
+
+	~Profile_Zone()
+	{
+		if (start)
+		{
+			Profiler::Record(name, start, Profiler::ReadTicks());
+		}
+	}
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_ZONE(name) Profile_Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::FrameMark()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME()
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Shader_Wrapper.h"
+
+#define SHADER_ARCHIVE_FILE "shaders/shaders.pak"
+
+/**
+ * @brief start of an archive, followed by entryCount entries sorted by nameHash
+ */
+struct Shader_ArchiveHeader
+{
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		entryCount;
+	uint32_t		fileSize;
+};
+
+/**
+ * @brief one SPIR-V blob, offsets are from the start of the archive and code is 4 byte aligned
+ * @note reflectionSize is 0 when the packer stored no reflection, the loader reflects the code instead
+ */
+struct Shader_ArchiveEntry
+{
+	uint64_t		nameHash;
+	uint32_t		nameOffset;
+	uint32_t		nameLength;
+	uint32_t		codeOffset;
+	uint32_t		codeSize;
+	uint32_t		reflectionOffset;
+	uint32_t		reflectionSize;
+};
+
+/**
+ * @brief every shader in one read only file, mapped once so module creation reads straight from the mapping
+ */
+class Shader_Archive
+{
+private:
+	const uint8_t					*data;
+	size_t							size;
+
+#ifdef _WIN32
+	void							*fileHandle;
+	void							*mappingHandle;
+#endif
+
+	const Shader_ArchiveEntry* FindEntry(const std::string &name) const;
+
+	bool Validate() const;
+
+	/**
+	 * @brief finds a shader whose loose file was written after the archive, the archive then no longer matches what was compiled
+	 */
+	bool FindStaleEntry(const char *archiveFile, std::string &staleName) const;
+
+	void Unmap();
+
+public:
+	Shader_Archive();
+	~Shader_Archive();
+
+	/**
+	 * @brief maps the archive, returns false if it is missing or malformed and loose files should be used
+	 */
+	bool Shader_ArchiveInit(const char *filename);
+
+	bool IsOpen() const { return data != NULL; }
+
+	uint32_t GetEntryCount() const;
+
+	/**
+	 * @brief the named shader's code inside the mapping, NULL if the archive does not hold it
+	 * @note the pointer stays valid until the archive is destroyed
+	 */
+	const uint32_t* GetCode(const std::string &name, size_t *codeSize) const;
+
+	/**
+	 * @brief reflection stored by the packer, false if there is none and Shader_Wrapper::Reflect has to run
+	 */
+	bool GetReflection(const std::string &name, Shader_Reflection &reflection) const;
+
+	static uint64_t HashName(const std::string &name);
+
+	/**
+	 * @brief writes an archive of the given SPIR-V files, each stored under its path as given
+	 * @param withReflection also store each shader's reflection so loading skips the parse
+	 */
+	static bool Pack(const char *archiveFile, const std::vector<std::string> &shaderFiles, bool withReflection = true);
+};
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief what the directory scan last saw of one file, a change is only reported once a scan sees it unchanged
+ */
+struct Shader_WatchedFile
+{
+	uint64_t				writeTime;
+	uint64_t				size;
+	bool					pending;
+};
+
+/**
+ * @brief watches a shader directory on a background thread and reports .spv files that were rewritten
+ * @note inotify on Linux, a periodic directory scan on Windows that waits for size and write time to settle
+ */
+class Shader_Watcher
+{
+private:
+	std::string						directory;
+	std::thread						watchThread;
+	std::atomic<bool>				running;
+
+	std::mutex						changeMutex;
+	std::set<std::string>			changedFiles;
+
+#ifdef __linux__
+	int								inotifyFd;
+	int								watchFd;
+#else
+	std::map<std::string, Shader_WatchedFile>	watchedFiles;
+
+	void ScanDirectory(bool report);
+#endif
+
+	void WatchLoop();
+
+	void AddChange(const std::string &name);
+
+public:
+	Shader_Watcher();
+	~Shader_Watcher();
+
+	bool Shader_WatcherInit(const char *shaderDirectory);
+
+	/**
+	 * @brief hands over every file changed since the last call, paths are directory/name to match the pipeline descriptions
+	 */
+	void PollChanges(std::vector<std::string> &files);
+};
\ No newline at end of file
@@ -1,9 +1,42 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <string>
 #include <vector>
 
 
+struct Shader_Binding
+{
+	uint32_t							set;
+	uint32_t							binding;
+	VkDescriptorType					type;
+	uint32_t							count;		// 0 for a runtime sized array
+	VkShaderStageFlags					stages;
+};
+
+struct Shader_VertexInput
+{
+	uint32_t							location;
+	VkFormat							format;
+};
+
+/**
+ * @brief resource interface of one shader, or of every stage of a pipeline once merged
+ */
+struct Shader_Reflection
+{
+	VkShaderStageFlags					stages;
+	std::vector<Shader_Binding>			bindings;
+	std::vector<VkPushConstantRange>	pushConstants;
+	std::vector<Shader_VertexInput>		vertexInputs;
+
+	Shader_Reflection()
+	{
+		stages = 0;
+	}
+};
+
+
 class Shader_Wrapper
 {
 private:
@@ -17,7 +50,26 @@ public:
 	Shader_Wrapper(char** fileNames);
 	~Shader_Wrapper();
 
-	char* LoadShaderData(const char* filename, size_t *rsize);
+	/**
+	 * @brief reads a loose SPIR-V file, used when there is no archive and for hot reloaded shaders
+	 * @return an empty buffer if the file could not be opened
+	 */
+	static std::vector<char> ReadShaderFile(const std::string &filename);
+
+	/**
+	 * @param code may point into a mapped Shader_Archive, the driver copies it during the call
+	 */
+	VkShaderModule CreateShaderModule(const uint32_t *code, size_t codeSize, VkDevice device);
+
+	/**
+	 * @brief reads descriptor bindings, push constants and vertex inputs from the module's decorations
+	 * @return false if the code is not valid SPIR-V
+	 */
+	static bool Reflect(const uint32_t *code, size_t wordCount, Shader_Reflection &reflection);
 
-	VkShaderModule CreateShaderModule(const std::vector<char>& shader, VkDevice device);
+	/**
+	 * @brief folds another stage into a pipeline's reflection, stage flags of shared bindings are combined
+	 * @return false if both stages declare the same set and binding with different types
+	 */
+	static bool MergeReflection(Shader_Reflection &into, const Shader_Reflection &from);
 };
\ No newline at end of file
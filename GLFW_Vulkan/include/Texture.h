@@ -2,14 +2,52 @@
 
 
 #include <vulkan/vulkan.h>
+#include <string>
 #include <vector>
 
 #include "Commands_Wrapper.h"
+#include "Texture_Decoder.h"
 
+/**
+ * @brief a sampled image and everything needed to bind or destroy it
+ */
 struct Texture
 {
-	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
+	VkImage			textureImage;
+	VkDeviceMemory	textureImageMemory;
+	VkImageView		textureImageView;
+	VkFormat		format;
+	uint32_t		width;
+	uint32_t		height;
+	uint32_t		mipLevels;
+	uint32_t		layers;
+	VkDeviceSize	bytes;
+
+	//a streamed image holds file levels baseLevel and smaller, of which residentLevel and smaller have been uploaded
+	std::string		streamPath;
+	uint32_t		fileLevels;
+	uint32_t		baseLevel;
+	uint32_t		residentLevel;
+};
+
+/**
+ * @brief decoded images whose copies and mip blits are recorded into one command buffer, submitted together
+ */
+struct Texture_UploadBatch
+{
+	VkCommandBuffer						commandBuffer;
+	VkDeviceSize						bytes;
+
+	//staging regions and oversized images' own buffers, released once the batch completes
+	std::vector<Texture_DecodeResult>	staged;
+	std::vector<VkBuffer>				buffers;
+	std::vector<VkDeviceMemory>			memories;
+
+	Texture_UploadBatch()
+	{
+		commandBuffer = VK_NULL_HANDLE;
+		bytes = 0;
+	}
 };
 
 
@@ -23,34 +61,127 @@ private:
 
 	Command						*graphicsCommand;
 
-	VkImage						textureImage;
-	VkDeviceMemory				textureImageMemory;
-	VkImageView					textureImageView;
-	VkSampler					textureSampler;
-
+	bool						anisotropyEnabled;
+
+	//images are decoded off the main thread straight into this persistently mapped buffer
+	Texture_Decoder				*decoder;
+	VkBuffer					decodeStaging;
+	VkDeviceMemory				decodeStagingMemory;
+	void						*decodeStagingMapped;
+	VkFence						uploadFence;
+
+	/**
+	 * @brief uploads every level of a KTX2 file in one copy, blocks are read from disk straight into the staging buffer
+	 * @return false if the file is missing or the device cannot sample its format, nothing is created in that case
+	 */
+	bool LoadKtx2Texture(const char *path, Texture &texture, uint32_t streamTail);
+
+	/**
+	 * @brief decodes any image stb_image reads to RGBA8 and blits its mip chain on the gpu
+	 */
+	bool LoadImageTexture(const char *path, Texture &texture);
+
+	/**
+	 * @brief creates the image for a finished decode and records copying its texels straight out of the staging memory into batch
+	 * @note the batch takes over the result's staging region, it is released by FlushUploadBatch
+	 */
+	bool CreateDecodedTexture(const Texture_DecodeResult &result, Texture &texture, Texture_UploadBatch &batch);
+
+	/**
+	 * @brief submits everything recorded into batch, waits on its fence and releases its staging
+	 */
+	void FlushUploadBatch(Texture_UploadBatch &batch);
 
 public:
 	Texture_Wrapper();
 
 	~Texture_Wrapper();
 
-	void Texture_WrapperInit(VkPhysicalDevice physDevice, VkDevice logDevice, VkQueue gQueue, Command *cmd);
-
-	void CreateTextureImage();
-
-	static void CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice logicalDevice, VkPhysicalDevice physicalDevice);
-
-	static void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue);
+	/**
+	 * @param jobs runs the texture decodes, it must outlive the wrapper
+	 */
+	void Texture_WrapperInit(VkPhysicalDevice physDevice, VkDevice logDevice, VkQueue gQueue, Command *cmd, Job_System *jobs, bool anisotropy = true);
+
+	/**
+	 * @brief creates the image and view for path, a cooked .ktx2 beside it is used instead when the device can sample it
+	 * @param streamTail when non zero a cooked chain only loads the levels this size and smaller, the rest are streamed later
+	 * @return false if neither could be loaded, texture is left untouched
+	 */
+	bool LoadTexture(const char *path, Texture &texture, uint32_t streamTail = 0);
+
+	/**
+	 * @brief format of the cooked .ktx2 LoadTexture would use for path, VK_FORMAT_UNDEFINED if there is none
+	 */
+	static VkFormat CookedFormat(const char *path);
+
+	/**
+	 * @brief LoadTexture for a whole batch, sources are read and decoded in parallel while cooked files load and images upload
+	 * @param loaded set per path, textures that failed are left untouched
+	 */
+	void LoadTextures(const std::vector<std::string> &paths, std::vector<Texture> &textures, std::vector<bool> &loaded, uint32_t streamTail = 0);
+
+	/**
+	 * @brief creates an RGBA8 2D array texture, one layer per entry of layers, and blits its mip chain on the gpu
+	 * @note the view is VK_IMAGE_VIEW_TYPE_2D_ARRAY even for a single layer so the shader side always declares a sampler2DArray
+	 */
+	void CreateArrayTexture(uint32_t width, uint32_t height, uint32_t mipLevels, const std::vector<std::vector<uint8_t>> &layers, Texture &texture);
+
+	void DestroyTexture(Texture &texture);
+
+	/**
+	 * @brief copies level, read from the texture's file, into the image and makes it the resident level
+	 * @note only residentLevel - 1 may be uploaded, it is in TRANSFER_DST_OPTIMAL until this returns,
+	 * so the caller raises the sampler's minLod to it only afterwards
+	 */
+	void UploadLevel(Texture &texture, uint32_t level, const std::vector<uint8_t> &data);
+
+	/**
+	 * @brief creates a copy of a streamed texture whose image starts at baseLevel, resident levels it shares are copied on the gpu
+	 * @note the original is left intact so it can be retired once frames using it complete
+	 */
+	void ResizeTexture(const Texture &texture, uint32_t baseLevel, Texture &resized);
+
+	/**
+	 * @brief device memory of a texture's chain from baseLevel down to 1x1
+	 */
+	static VkDeviceSize ChainBytes(const Texture &texture, uint32_t baseLevel);
+
+	/**
+	 * @brief trilinear, repeating and anisotropic when enabled, maxLod is unclamped so textures of any size can share it
+	 */
+	VkSamplerCreateInfo DefaultSamplerInfo();
+
+	VkPhysicalDevice GetPhysicalDevice(){ return physicalDevice; }
+	Texture_Decoder* GetDecoder(){ return decoder; }
+
+	/**
+	 * @brief levels in a full chain down to 1x1
+	 */
+	static uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+	static void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice logicalDevice, VkPhysicalDevice physicalDevice, uint32_t arrayLayers = 1);
+
+	static void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue, uint32_t mipLevels = 1, uint32_t layerCount = 1);
+
+	/**
+	 * @brief records TransitionImageLayout's barrier into commandBuffer instead of submitting it
+	 */
+	static void RecordLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels = 1, uint32_t layerCount = 1);
+
+	/**
+	 * @brief fills levels 1 to mipLevels - 1 by blitting down from level 0, which must be in TRANSFER_DST_OPTIMAL
+	 * @note every level ends in SHADER_READ_ONLY_OPTIMAL
+	 */
+	static void GenerateMipmaps(VkImage image, int32_t width, int32_t height, uint32_t mipLevels, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue, uint32_t layerCount = 1);
+
+	/**
+	 * @brief records GenerateMipmaps' blits into commandBuffer instead of submitting them
+	 */
+	static void RecordMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t width, int32_t height, uint32_t mipLevels, uint32_t layerCount = 1);
 
 	static void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue);
 
-	static VkImageView CreateImageView(VkImage image, VkFormat format, VkDevice logDevice, VkImageAspectFlags aspectFlags);
-
-	void CreateTextureImageView();
-
-	void CreateTextureSampler();
-
-	VkImageView GetTextureImageView(){ return textureImageView; }
+	static void CopyBufferToImage(VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy> &regions, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue);
 
-	VkSampler GetTextureSampler(){ return textureSampler;}
+	static VkImageView CreateImageView(VkImage image, VkFormat format, VkDevice logDevice, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1, VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t layerCount = 1);
 };
\ No newline at end of file
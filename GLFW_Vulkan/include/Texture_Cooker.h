@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+typedef enum
+{
+	TC_BC1,
+	TC_BC7
+}TextureCookFormat;
+
+/**
+ * @brief offline conversion of source images to block compressed KTX2 files with a precomputed mip chain
+ */
+class Texture_Cooker
+{
+public:
+	/**
+	 * @brief decodes source, box filters the mip chain and encodes every level
+	 * @return false if the source could not be decoded or the output written
+	 */
+	static bool Cook(const char *source, const char *destination, TextureCookFormat format);
+
+	/**
+	 * @brief maps every texel of source to its nearest colour in the palette file and writes a single level R8_UINT KTX2
+	 * @note texels with alpha below half become PALETTE_TRANSPARENT_INDEX
+	 */
+	static bool CookPaletted(const char *source, const char *palettePath, const char *destination);
+
+	/**
+	 * @brief halves an RGBA8 image, odd edges repeat their last row or column
+	 */
+	static void Downsample(const std::vector<uint8_t> &source, uint32_t width, uint32_t height, std::vector<uint8_t> &destination);
+
+	/**
+	 * @brief encodes an RGBA8 image into 4x4 blocks, partial edge blocks repeat their edge texels
+	 */
+	static void EncodeImage(const uint8_t *rgba, uint32_t width, uint32_t height, TextureCookFormat format, std::vector<uint8_t> &blocks);
+
+	/**
+	 * @brief opaque four colour BC1 block, alpha is ignored
+	 */
+	static void EncodeBC1Block(const uint8_t texels[16][4], uint8_t block[8]);
+
+	/**
+	 * @brief BC7 mode 6 block, a single RGBA line with 4 bit indices
+	 */
+	static void EncodeBC7Block(const uint8_t texels[16][4], uint8_t block[16]);
+};
\ No newline at end of file
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Job_System.h"
+
+/**
+ * @brief a file read by the I/O thread, waiting for a decode job
+ */
+struct Texture_DecodeJob
+{
+	uint32_t				id;
+	std::string				path;
+	std::vector<uint8_t>	bytes;
+};
+
+/**
+ * @brief an RGBA8 image decoded into the staging memory at offset, or into pixels when it could not be staged
+ */
+struct Texture_DecodeResult
+{
+	uint32_t				id;
+	std::string				path;
+	bool					succeeded;
+	uint32_t				width;
+	uint32_t				height;
+	uint64_t				offset;
+	uint64_t				size;
+
+	//set only for images larger than the whole staging memory, freed with stbi_image_free
+	uint8_t					*pixels;
+};
+
+/**
+ * @brief stb_image allocation hooks, a decode job's final RGBA8 buffer is placed in its staging region instead of the heap
+ */
+void* Texture_DecodeMalloc(size_t size);
+void* Texture_DecodeRealloc(void *pointer, size_t size);
+void Texture_DecodeFree(void *pointer);
+
+/**
+ * @brief decodes images as jobs on the job system, fed by an I/O thread that reads whole files ahead of them
+ * @note decoded texels land in sub-allocations of caller owned, persistently mapped staging memory,
+ * each stays reserved until ReleaseStaging so the upload can copy straight from it.
+ * A decode job blocks while the staging memory is full, so the thread releasing it must not wait on the job system meanwhile
+ */
+class Texture_Decoder
+{
+private:
+	std::thread							ioThread;
+	Job_System							*jobSystem;
+
+	//one per file read, the destructor waits on it before the staging memory goes away
+	Job_Counter							decodesRunning;
+
+	std::mutex							decodeMutex;
+	std::condition_variable				readReady;
+	std::condition_variable				resultReady;
+	std::condition_variable				stagingFreed;
+	bool								stopDecoding;
+
+	std::deque<Texture_DecodeJob>		reads;
+	std::deque<Texture_DecodeJob>		jobs;
+	std::deque<Texture_DecodeResult>	results;
+	uint32_t							nextId;
+	uint32_t							pending;
+
+	//file bytes read but not yet decoded, the I/O thread stops reading ahead past prefetchLimit
+	uint64_t							prefetchBytes;
+	uint64_t							prefetchLimit;
+
+	uint8_t								*stagingMemory;
+	uint64_t							stagingSize;
+
+	//free ranges of the staging memory keyed by offset, neighbours are merged as ranges are released
+	std::map<uint64_t, uint64_t>		stagingFree;
+
+	uint32_t							decodeCount;
+	uint32_t							stagedInPlace;
+	uint64_t							bytesRead;
+
+	void ReadWorker();
+
+	/**
+	 * @brief decodes the oldest file read, one job is queued per file
+	 */
+	void DecodeNext();
+
+	static void DecodeJob(void *data, uint32_t begin, uint32_t end);
+
+	/**
+	 * @brief first fit, blocks until enough staging memory is released
+	 * @return false if the decoder is stopping
+	 */
+	bool AllocateStaging(uint64_t size, uint64_t &offset);
+
+	/**
+	 * @brief expects decodeMutex to be held
+	 */
+	void FreeStaging(uint64_t offset, uint64_t size);
+
+public:
+	Texture_Decoder();
+	~Texture_Decoder();
+
+	/**
+	 * @param staging mapped memory decoded images are written to, it must outlive the decoder
+	 * @param jobs runs the decodes, it must outlive the decoder
+	 * @param prefetchSize file bytes the I/O thread may hold ahead of the decode jobs
+	 */
+	void Texture_DecoderInit(void *staging, uint64_t size, Job_System *jobs, uint64_t prefetchSize = 64 * 1024 * 1024);
+
+	/**
+	 * @return an id matched by the image's result, results are returned in the order decodes finish
+	 */
+	uint32_t Submit(const std::string &path);
+
+	/**
+	 * @brief blocks for the next finished image
+	 * @return false once every submitted image has been returned
+	 */
+	bool WaitResult(Texture_DecodeResult &result);
+
+	/**
+	 * @brief takes the next finished image without blocking
+	 * @return false if none has finished yet
+	 */
+	bool TryResult(Texture_DecodeResult &result);
+
+	/**
+	 * @brief hands the result's staging memory back once its copy has completed
+	 */
+	void ReleaseStaging(const Texture_DecodeResult &result);
+
+	uint32_t GetWorkerCount(){ return jobSystem ? jobSystem->GetWorkerCount() : 0; }
+	uint32_t GetDecodeCount();
+	uint32_t GetStagedInPlace();
+	uint64_t GetBytesRead();
+
+	/**
+	 * @brief decodes every path on a job system of one worker and then of one per core into host memory and logs the speedup
+	 * @return false if any image failed to decode
+	 */
+	static bool Benchmark(const std::vector<std::string> &paths, uint64_t stagingBytes = 128 * 1024 * 1024);
+};
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <stdio.h>
+#include <vector>
+
+/**
+ * @brief fixed part of a KTX2 file, followed by one Texture_Ktx2Level per mip level
+ */
+struct Texture_Ktx2Header
+{
+	uint8_t			identifier[12];
+	uint32_t		vkFormat;
+	uint32_t		typeSize;
+	uint32_t		pixelWidth;
+	uint32_t		pixelHeight;
+	uint32_t		pixelDepth;
+	uint32_t		layerCount;
+	uint32_t		faceCount;
+	uint32_t		levelCount;
+	uint32_t		supercompressionScheme;
+	uint32_t		dfdByteOffset;
+	uint32_t		dfdByteLength;
+	uint32_t		kvdByteOffset;
+	uint32_t		kvdByteLength;
+	uint64_t		sgdByteOffset;
+	uint64_t		sgdByteLength;
+};
+
+struct Texture_Ktx2Level
+{
+	uint64_t		byteOffset;
+	uint64_t		byteLength;
+	uint64_t		uncompressedByteLength;
+};
+
+/**
+ * @brief reads 2D KTX2 textures without supercompression, level data is read straight into the caller's memory
+ */
+class Texture_Ktx2
+{
+private:
+	FILE							*file;
+	Texture_Ktx2Header				header;
+	std::vector<Texture_Ktx2Level>	levels;
+
+public:
+	Texture_Ktx2();
+	~Texture_Ktx2();
+
+	/**
+	 * @brief opens the file and validates the header and level index, no pixel data is read
+	 */
+	bool Texture_Ktx2Init(const char *filename);
+
+	VkFormat GetFormat(){ return (VkFormat)header.vkFormat; }
+	uint32_t GetWidth(){ return header.pixelWidth; }
+	uint32_t GetHeight(){ return header.pixelHeight; }
+	uint32_t GetLevelCount(){ return (uint32_t)levels.size(); }
+
+	/**
+	 * @brief a levelCount of 0 in the file asks the loader to generate the chain from the single stored level
+	 */
+	bool WantsGeneratedMips(){ return header.levelCount == 0; }
+
+	uint64_t GetLevelSize(uint32_t level){ return levels[level].byteLength; }
+
+	/**
+	 * @brief reads one level's blocks into destination, which must hold GetLevelSize(level) bytes
+	 */
+	bool ReadLevel(uint32_t level, void *destination);
+
+	/**
+	 * @brief bytes per 4x4 block for BCn formats or per texel for the uncompressed formats accepted, 0 for anything else
+	 */
+	static uint32_t BlockBytes(VkFormat format);
+
+	static bool IsBlockCompressed(VkFormat format);
+
+	/**
+	 * @brief formats holding indices rather than colours, fetched unfiltered and never mipmapped by blits
+	 */
+	static bool IsIntegerFormat(VkFormat format);
+
+	/**
+	 * @brief bytes of one level of a width x height image, rounded up to whole blocks
+	 */
+	static uint64_t LevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+	/**
+	 * @brief writes a 2D texture, levels[0] is the full size image
+	 */
+	static bool Write(const char *filename, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>> &levelData);
+};
\ No newline at end of file
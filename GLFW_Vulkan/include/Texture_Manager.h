@@ -0,0 +1,213 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Texture.h"
+#include "Texture_Streamer.h"
+#include "Texture_Table.h"
+
+typedef uint32_t TextureHandle;
+
+#define TEXTURE_HANDLE_INVALID 0xFFFFFFFF
+
+/**
+ * @brief one slot of the texture pool, slots are reused once their texture is evicted
+ */
+struct Texture_Resource
+{
+	bool			inUse;
+	Texture			texture;
+	VkSampler		sampler;
+	std::string		path;
+	uint64_t		hash;
+	uint32_t		refCount;
+
+	//bumped each time the slot is reused so stream reads for an evicted texture are discarded
+	uint32_t		generation;
+
+	//most detailed level wanted on screen, streamed toward one level at a time
+	uint32_t		requestedLevel;
+	bool			readPending;
+
+	//last frame the texture was acquired, touched or released, it can't be destroyed until that frame has completed
+	uint64_t		lastUsedFrame;
+
+	//index shaders sample the texture by when a texture table is attached, TEXTURE_SLOT_INVALID otherwise
+	uint32_t		tableSlot;
+};
+
+/**
+ * @brief an image replaced by a resize, destroyed once the frame it was retired on has completed
+ */
+struct Texture_Retired
+{
+	Texture			texture;
+	uint64_t		frame;
+};
+
+/**
+ * @brief owns every loaded texture, keyed by path, and every sampler, keyed by its create info
+ * @note unreferenced textures stay resident as a cache and are evicted least recently used first once over budget
+ */
+class Texture_Manager
+{
+private:
+	Texture_Wrapper			*loader;
+	VkDevice				logicalDevice;
+
+	//deque so pointers handed out by GetTexture stay valid as the pool grows
+	std::deque<Texture_Resource>	textureList;
+	std::vector<TextureHandle>		freeList;
+
+	std::unordered_map<uint64_t, std::vector<TextureHandle>>	textureLookup;
+
+	//keyed by every VkSamplerCreateInfo field except sType and pNext
+	std::map<std::vector<uint32_t>, VkSampler>	samplerCache;
+
+	VkSampler				defaultSampler;
+	VkSamplerCreateInfo		defaultSamplerInfo;
+
+	Texture_Streamer		*streamer;
+	Texture_Table			*textureTable;
+	uint32_t				streamTail;
+	std::vector<Texture_StreamResult>	pendingUploads;
+	std::vector<Texture_Retired>		retiredTextures;
+	bool					texturesChanged;
+
+	VkDeviceSize			budget;
+	VkDeviceSize			residentBytes;
+	uint32_t				residentCount;
+
+	uint64_t				currentFrame;
+	uint32_t				framesInFlight;
+	bool					overBudgetLogged;
+
+	uint32_t				lookupHits;
+	uint32_t				loads;
+	uint32_t				evictions;
+	uint32_t				levelsStreamed;
+	uint32_t				mipsDropped;
+
+	TextureHandle FindTexture(const std::string &path, uint64_t hash);
+
+	/**
+	 * @brief takes ownership of a created texture and puts it in a free slot holding one reference
+	 */
+	TextureHandle AddResource(const std::string &key, uint64_t hash, const Texture &texture);
+
+	void DestroyTexture(TextureHandle handle);
+
+	/**
+	 * @brief evicts unreferenced textures the gpu is done with, oldest first, then drops the top mip of the largest
+	 * streamed textures until resident bytes fit the budget
+	 */
+	void EvictToBudget();
+
+	/**
+	 * @brief swaps a resource's image for one starting at baseLevel, the old image is retired
+	 */
+	void ResizeResource(Texture_Resource &resource, uint32_t baseLevel);
+
+	/**
+	 * @brief uploads finished reads and queues the next level of every texture wanting more detail than it has
+	 */
+	void UpdateStreaming();
+
+	/**
+	 * @brief points the resource's table slot at its current view and sampler
+	 */
+	void WriteTableSlot(const Texture_Resource &resource);
+
+	/**
+	 * @brief the default sampler with minLod clamped to the texture's resident level
+	 */
+	VkSampler ResidencySampler(const Texture &texture);
+
+	static uint64_t HashPath(const std::string &path);
+
+public:
+	Texture_Manager();
+	~Texture_Manager();
+
+	/**
+	 * @param budgetBytes device memory textures may occupy before eviction starts, 0 uses half the largest device local heap
+	 * @param streamTailSize cooked textures load only their levels of this size and below and stream the rest, 0 loads everything
+	 */
+	void Texture_ManagerInit(VkDevice device, Texture_Wrapper *textureLoader, VkDeviceSize budgetBytes = 0, uint32_t streamTailSize = 0);
+
+	/**
+	 * @brief every texture loaded from now on takes a slot in table and keeps it current as it streams
+	 * @note set before the first texture is acquired, the table is not owned by the manager
+	 */
+	void SetTextureTable(Texture_Table *table){ textureTable = table; }
+
+	/**
+	 * @brief returns a referenced handle to the texture at path, loading it only if it is not already resident
+	 * @return TEXTURE_HANDLE_INVALID if the texture could not be loaded
+	 */
+	TextureHandle AcquireTexture(const char *path);
+
+	/**
+	 * @brief AcquireTexture for a level's worth of paths at once, everything not resident is decoded in parallel
+	 * @param handles one per path, TEXTURE_HANDLE_INVALID where loading failed
+	 */
+	void AcquireTextures(const std::vector<std::string> &paths, std::vector<TextureHandle> &handles);
+
+	/**
+	 * @brief hands a texture created outside the manager, such as the palette lookup, to the pool under name
+	 * @return a referenced handle, or TEXTURE_HANDLE_INVALID if name is taken, the texture is not adopted in that case
+	 * @note nothing can reload it, so it should stay referenced for as long as it is drawn
+	 */
+	TextureHandle RegisterTexture(const char *name, const Texture &texture);
+
+	void AddReference(TextureHandle handle);
+
+	/**
+	 * @brief drops a reference, the texture stays cached until the budget needs its memory
+	 */
+	void ReleaseTexture(TextureHandle handle);
+
+	/**
+	 * @brief marks the texture as drawn this frame for the LRU order
+	 */
+	void TouchTexture(TextureHandle handle);
+
+	/**
+	 * @brief the most detailed level the texture is currently seen at, streamed textures load toward it while the budget allows
+	 */
+	void RequestLevel(TextureHandle handle, uint32_t level);
+
+	/**
+	 * @brief mip level whose texels map roughly one to one onto screenPixels pixels
+	 */
+	static uint32_t LevelForCoverage(uint32_t textureSize, float screenPixels);
+
+	Texture_Resource* GetTexture(TextureHandle handle);
+
+	/**
+	 * @brief identical create infos share one sampler, the manager owns and destroys them
+	 */
+	VkSampler GetSampler(const VkSamplerCreateInfo &samplerInfo);
+
+	/**
+	 * @brief called at a frame boundary, streams levels in, destroys retired images and evicts while over budget
+	 * @return true if any texture's view or sampler changed and descriptors using it must be written again
+	 */
+	bool Update(uint64_t frame, uint32_t framesInFlight);
+
+	VkDeviceSize GetBudget(){ return budget; }
+	VkDeviceSize GetResidentBytes(){ return residentBytes; }
+	uint32_t GetResidentCount(){ return residentCount; }
+	uint32_t GetSamplerCount(){ return (uint32_t)samplerCache.size(); }
+	uint32_t GetLookupHits(){ return lookupHits; }
+	uint32_t GetLoadCount(){ return loads; }
+	uint32_t GetEvictionCount(){ return evictions; }
+	uint32_t GetLevelsStreamed(){ return levelsStreamed; }
+	uint32_t GetMipsDropped(){ return mipsDropped; }
+	uint64_t GetStreamedBytes(){ return streamer ? streamer->GetBytesRead() : 0; }
+};
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief an RGBA8 source image waiting to be packed
+ */
+struct Texture_PackImage
+{
+	std::string				name;
+	uint32_t				width;
+	uint32_t				height;
+	std::vector<uint8_t>	pixels;
+};
+
+/**
+ * @brief where a source image ended up, a mesh's uv maps to uv * uvScale + uvOffset on layer of group
+ */
+struct Texture_PackRegion
+{
+	uint32_t				group;
+	uint32_t				layer;
+	glm::vec2				uvOffset;
+	glm::vec2				uvScale;
+};
+
+/**
+ * @brief one 2D array image, either equally sized textures one per layer or atlas pages one per layer
+ */
+struct Texture_PackGroup
+{
+	bool					atlas;
+	uint32_t				width;
+	uint32_t				height;
+	uint32_t				mipLevels;
+	std::vector<std::vector<uint8_t>>	layers;
+};
+
+/**
+ * @brief free space of an atlas page as a skyline, one segment per run of equal height
+ */
+struct Texture_SkylineSegment
+{
+	uint32_t				x;
+	uint32_t				y;
+	uint32_t				width;
+};
+
+/**
+ * @brief groups same size power of two textures into array layers and packs everything else into atlas pages,
+ * offline only, -packtextures writes the layers and remap table out for a level build to consume
+ */
+class Texture_Packer
+{
+private:
+	uint32_t				atlasSize;
+	uint32_t				padding;
+
+	std::vector<Texture_PackImage>	images;
+	std::vector<Texture_PackGroup>	groups;
+	std::unordered_map<std::string, Texture_PackRegion>	remap;
+
+	uint32_t				packedTexels;
+
+	/**
+	 * @brief bottom left skyline placement, returns false if the rectangle does not fit on the page
+	 */
+	static bool SkylineInsert(std::vector<Texture_SkylineSegment> &skyline, uint32_t pageSize, uint32_t width, uint32_t height, uint32_t &x, uint32_t &y);
+
+	/**
+	 * @brief copies image into page at x, y and repeats its edge texels across the padding around it
+	 */
+	void BlitPadded(const Texture_PackImage &image, std::vector<uint8_t> &page, uint32_t x, uint32_t y);
+
+public:
+	/**
+	 * @param atlasPageSize width and height of each atlas page
+	 * @param paddingTexels gutter around every atlas entry, mips are kept while a texel of the level still fits inside it
+	 */
+	Texture_Packer(uint32_t atlasPageSize = 1024, uint32_t paddingTexels = 4);
+
+	/**
+	 * @brief decodes path with stb_image, the path is also the name the region is found by
+	 */
+	bool AddImage(const char *path);
+
+	void AddImage(const std::string &name, uint32_t width, uint32_t height, const uint8_t *rgba);
+
+	/**
+	 * @brief builds every group and the remap table from the images added so far
+	 */
+	void Pack();
+
+	/**
+	 * @brief fraction of atlas page texels covered by images, padding excluded
+	 */
+	float GetAtlasOccupancy();
+
+	/**
+	 * @brief writes each layer of each group as <prefix>_<group>_<layer>.png and the remap table as <prefix>.txt
+	 */
+	bool WriteDebugOutput(const char *prefix);
+};
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+//index cooked for texels with alpha below half, the lookup gives it zero alpha so alpha tested pipelines discard it
+#define PALETTE_TRANSPARENT_INDEX 255
+
+//Doom's PLAYPAL order: 0 normal, 1-8 damage reds, 9-12 pickup yellows, 13 radiation suit green
+#define PALETTE_START_RED 1
+#define PALETTE_RED_COUNT 8
+#define PALETTE_START_BONUS 9
+#define PALETTE_BONUS_COUNT 4
+#define PALETTE_RADIATION 13
+
+//COLORMAP rows 0-31 darken from full bright, row 32 is the invulnerability inverse map
+#define PALETTE_LIGHT_LEVELS 32
+#define PALETTE_INVERSE_COLORMAP 32
+
+/**
+ * @brief 8-bit palettes and light level colormaps, resolved into one lookup image for paletted shading
+ * @note palettes are PLAYPAL style, 768 bytes of RGB each, colormaps are COLORMAP style, 256 palette indices each
+ */
+class Texture_Palette
+{
+private:
+	std::vector<uint8_t>	palettes;
+	std::vector<uint8_t>	colormaps;
+	uint32_t				paletteCount;
+	uint32_t				colormapCount;
+
+public:
+	Texture_Palette();
+
+	/**
+	 * @param colormapPath NULL uses a single identity colormap, enough for cooking
+	 * @return false if a file is missing or is not a whole number of palettes or colormaps
+	 */
+	bool Texture_PaletteInit(const char *palettePath, const char *colormapPath = NULL);
+
+	/**
+	 * @brief closest colour of the first palette, PALETTE_TRANSPARENT_INDEX is never returned
+	 */
+	uint8_t NearestIndex(uint8_t r, uint8_t g, uint8_t b);
+
+	/**
+	 * @brief one RGBA8 layer per palette, 256 texels wide and one row per colormap, texel (i, c) is palette[colormap[c][i]]
+	 * @note both lookups happen here, a fragment resolves its index with a single fetch
+	 */
+	void BuildLookup(std::vector<std::vector<uint8_t>> &layers);
+
+	/**
+	 * @brief RGB of index in the first palette
+	 */
+	const uint8_t* GetColor(uint8_t index){ return &palettes[index * 3]; }
+
+	uint32_t GetPaletteCount(){ return paletteCount; }
+	uint32_t GetColormapCount(){ return colormapCount; }
+
+	/**
+	 * @brief the palette the status bar code picks, damage outranks pickups, which outrank the radiation suit
+	 * @param radiationSuit true while the suit is worn and not about to run out
+	 */
+	static uint32_t EffectPalette(uint32_t damageCount, uint32_t bonusCount, bool radiationSuit);
+};
\ No newline at end of file
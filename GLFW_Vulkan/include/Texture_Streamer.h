@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Texture_StreamRequest
+{
+	uint32_t				handle;
+	uint32_t				generation;
+	std::string				path;
+	uint32_t				level;
+};
+
+struct Texture_StreamResult
+{
+	uint32_t				handle;
+	uint32_t				generation;
+	uint32_t				level;
+	bool					succeeded;
+	std::vector<uint8_t>	data;
+};
+
+/**
+ * @brief reads single KTX2 levels on a background thread, uploads are left to the main thread which owns the queue
+ */
+class Texture_Streamer
+{
+private:
+	std::thread							worker;
+	std::deque<Texture_StreamRequest>	requests;
+	std::vector<Texture_StreamResult>	results;
+	std::mutex							streamMutex;
+	std::condition_variable				requestReady;
+	bool								stopStreaming;
+
+	uint64_t							bytesRead;
+
+	void StreamWorker();
+
+public:
+	Texture_Streamer();
+	~Texture_Streamer();
+
+	void Texture_StreamerInit();
+
+	void Request(const Texture_StreamRequest &request);
+
+	/**
+	 * @brief moves every finished read into finished, in the order they completed
+	 */
+	void Collect(std::vector<Texture_StreamResult> &finished);
+
+	uint64_t GetBytesRead();
+};
\ No newline at end of file
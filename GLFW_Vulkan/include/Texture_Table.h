@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#define TEXTURE_SLOT_INVALID 0xFFFFFFFF
+
+/**
+ * @brief a freed slot, handed out again once the frame it was freed on has completed
+ */
+struct Texture_RetiredSlot
+{
+	uint32_t				slot;
+	uint64_t				frame;
+};
+
+/**
+ * @brief one large partially bound combined image sampler array that every texture registers into,
+ * shaders pick a texture by slot index so draws never switch descriptor sets
+ * @note there is one set per render image, slot writes reach a set when it is flushed before that image is submitted
+ */
+class Texture_Table
+{
+private:
+	VkDevice				logicalDevice;
+
+	//reflected from the bindless shaders, owned by the pipeline registry
+	VkDescriptorSetLayout	setLayout;
+	VkDescriptorPool		descriptorPool;
+	std::vector<VkDescriptorSet>	descriptorSets;
+
+	uint32_t				capacity;
+
+	//current contents of every slot, a null view marks a slot that was never written
+	std::vector<VkDescriptorImageInfo>	slots;
+
+	//slots written since each set was last flushed
+	std::vector<std::vector<uint32_t>>	dirtySlots;
+
+	std::vector<uint32_t>	freeSlots;
+	std::vector<Texture_RetiredSlot>	retiredSlots;
+	uint32_t				usedSlots;
+
+	uint64_t				currentFrame;
+
+	uint32_t				descriptorWrites;
+
+public:
+	Texture_Table();
+	~Texture_Table();
+
+	/**
+	 * @param layout set layout with a single update after bind, partially bound array of capacity descriptors at binding 0
+	 * @param setCount one set per render image
+	 */
+	void Texture_TableInit(VkDevice device, VkDescriptorSetLayout layout, uint32_t tableCapacity, uint32_t setCount);
+
+	/**
+	 * @return TEXTURE_SLOT_INVALID once every slot is taken
+	 */
+	uint32_t AllocateSlot();
+
+	/**
+	 * @brief points slot at a texture, also used when a texture's view or sampler is replaced
+	 */
+	void WriteSlot(uint32_t slot, VkImageView imageView, VkSampler sampler);
+
+	/**
+	 * @brief command buffers recorded this frame may still index the slot, it is reused once the frame has completed
+	 */
+	void FreeSlot(uint32_t slot);
+
+	/**
+	 * @brief writes every slot changed since the last flush into the set, the set's previous submission must have completed
+	 */
+	void Flush(uint32_t setIndex);
+
+	/**
+	 * @brief called at a frame boundary, returns freed slots the gpu is done with to the free list
+	 */
+	void Update(uint64_t frame, uint32_t framesInFlight);
+
+	const std::vector<VkDescriptorSet>& GetDescriptorSets(){ return descriptorSets; }
+	uint32_t GetCapacity(){ return capacity; }
+	uint32_t GetUsedSlots(){ return usedSlots; }
+	uint32_t GetDescriptorWrites(){ return descriptorWrites; }
+};
\ No newline at end of file
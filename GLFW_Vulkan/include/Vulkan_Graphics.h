@@ -9,11 +9,25 @@
 #include "GLFW_Wrapper.h"
 #include "Extensions_Manager.h"
 #include "Swapchain_Wrapper.h"
+#include "Offscreen_Wrapper.h"
 #include "Queue_Wrapper.h"
 #include "Commands_Wrapper.h"
 #include "Buffers.h"
 #include "Texture.h"
+#include "Texture_Manager.h"
+#include "Texture_Table.h"
+#include "Texture_Palette.h"
 #include "Model.h"
+#include "Camera_Path.h"
+#include "Game_Loop.h"
+#include "Frustum_Culler.h"
+#include "Occlusion_Culler.h"
+#include "Level_Map.h"
+#include "Shader_Watcher.h"
+#include "Shader_Archive.h"
+
+//mesh handle of the loaded model, the only mesh so far, entities with any other mesh aren't drawn
+#define MESH_MODEL 0
 
 class Vulkan_Graphics
 {
@@ -38,6 +52,10 @@ private:
 	VkDeviceQueueCreateInfo			*queueCreateInfo;
 	VkPhysicalDeviceFeatures		deviceFeatures;
 
+	//chained into device creation when the texture table can be used, textureTableSize is 0 otherwise
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT	indexingFeatures;
+	uint32_t						textureTableSize;
+
 	std::vector<VkSemaphore>		imageAvailableSemaphores;
 	std::vector<VkSemaphore>		renderFinishedSemaphores;
 	std::vector<VkFence>			inFlightFences;
@@ -51,11 +69,89 @@ private:
 
 	Model							*testModel;
 
+	bool							headless;
+	uint32_t						renderWidth;
+	uint32_t						renderHeight;
+
+	Camera_Path						*cameraPath;
+	const Game_State				*gameState;
+
+	//never reset, reloads, deferred frees and texture streaming count in-flight frames with it
+	uint32_t						frameIndex;
+
+	//frames since the camera path was set, the path is evaluated with it
+	uint32_t						cameraPathFrame;
+
+	//game instances outside the view are dropped before their matrices are written, on the job system when set
+	Frustum_Culler					*culler;
+	Job_System						*jobSystem;
+
+	//a compiled level shares the model's buffers after its vertices and indices, each leaf is one indirect draw after the model's
+	const char						*levelFile;
+	Level_Map						*level;
+	uint32_t						levelVertexOffset;
+	uint32_t						levelFirstIndex;
+	std::vector<uint32_t>			visibleLeaves;
+	std::vector<uint32_t>			levelDrawsWritten;
+	uint32_t						levelInstance;
+
+	//what the last frame found hidden is left out of the first pass and drawn in a second only if the depth pyramid shows it, NULL without the compute shaders
+	Occlusion_Culler				*occlusion;
+
+	VkQueryPool						timestampPool;
+	float							timestampPeriod;
+	double							lastGpuFrameMs;
+	uint64_t						gpuFramesResolved;
+
+	Shader_Watcher					*shaderWatcher;
+
+	PipelineHandle					materialPipeline;
+
+	TextureHandle					modelTexture;
+	float							modelRadius;
+
+	//set when the model's texture holds palette indices, effects and lighting below feed the uniform buffer
+	Texture_Palette					*palette;
+	TextureHandle					paletteLookup;
+	int32_t							paletteIndex;
+	int32_t							fixedColormap;
+	float							sectorLight;
+
+
+	void Init();
 
 	void CreateVulkanInstance();
 	void CreateLogicalDevice();
 
 	void CreateSemaphores();
+
+	void CreateTimestampQueries();
+
+	void ResolveGpuFrameTime(uint32_t imageIndex);
+
+	void RecordCommandBuffers();
+
+	void UpdateShaderReload();
+
+	/**
+	 * @brief streams textures and rewrites the descriptors of any whose view or sampler changed
+	 */
+	void UpdateTextures();
+
+	/**
+	 * @brief advances the frame and runs the per-frame reload, cache and texture updates
+	 */
+	void EndFrame();
+
+	/**
+	 * @brief rewrites the level's indirect draws with the leaves visible from eye
+	 */
+	void UpdateLevelDraws(uint32_t imageIndex, const glm::vec3 &eye, const glm::mat4 &viewProj);
+
+	/**
+	 * @brief writes an instance for the first pass, or parks it for the occlusion test's second pass if it was hidden last time
+	 */
+	void AddModelInstance(uint32_t imageIndex, uint32_t id, const glm::mat4 &model, const glm::vec3 &center, float radius, uint32_t &instanceCount, uint32_t &deferredCount);
 	
 	void SetupDebugCallback();
 
@@ -63,6 +159,11 @@ private:
 
 	void PickPhysicalDevice();
 
+	/**
+	 * @brief sizes the texture table from the device's VK_EXT_descriptor_indexing limits and picks the features to enable
+	 */
+	void CheckDescriptorIndexing();
+
 	void CreateFramebuffers();
 
 	VkDeviceCreateInfo GetDeviceInfo(bool validation);
@@ -71,25 +172,100 @@ private:
 	
 	bool IsDeviceSuitable(VkPhysicalDevice device);
 
+	void DrawOffscreenFrame();
+
+	VkFormat GetRenderFormat();
+	VkExtent2D GetRenderExtent();
+	std::vector<VkImage> GetRenderImages();
+	std::vector<VkFramebuffer> GetRenderFrameBuffers();
+
 public:
 	GLFW_Wrapper					*glfwWrapper;
 	Commands_Wrapper				*cmdWrapper;
 	Extensions_Manager				*extManager;
 	Queue_Wrapper					*queueWrapper;
 	Swapchain_Wrapper				*swapchainWrapper;
+	Offscreen_Wrapper				*offscreenWrapper;
 	Pipeline_Wrapper				*pipeWrapper;
+	Pipeline_Cache					*pipelineCache;
+	Shader_Archive					*shaderArchive;
 	Buffer_Wrapper					*bufferWrapper;
 	Texture_Wrapper					*textureWrapper;
+	Texture_Manager					*textureManager;
+	Texture_Table					*textureTable;
 	Model_Manager					*modelManager;
 	
-	Vulkan_Graphics(GLFW_Wrapper *glfwWrapper, bool enableValidation);
+	/**
+	 * @param jobSystem decodes textures and splits frustum culling, it must outlive the renderer
+	 * @param levelFile a level built by Level_Compiler to draw around the model, NULL for the model alone
+	 */
+	Vulkan_Graphics(GLFW_Wrapper *glfwWrapper, bool enableValidation, Job_System *jobSystem, const char *levelFile = NULL);
+
+	/**
+	 * @brief headless renderer, draws into offscreen color/depth targets with no window, surface or present queue
+	 */
+	Vulkan_Graphics(uint32_t width, uint32_t height, bool enableValidation, Job_System *jobSystem, const char *levelFile = NULL);
 	~Vulkan_Graphics();
 
 	Command* GetGraphicsPool(){ return graphicsCommands; }
 	VkDevice GetLogicalDevice(){ return logicalDevice; }
+	bool IsHeadless(){ return headless; }
+	Pipeline_Wrapper* GetPipelineWrapper(){ return pipeWrapper; }
+	TextureHandle GetModelTexture(){ return modelTexture; }
+	Texture_Wrapper* GetTextureWrapper(){ return textureWrapper; }
 
 	//testing
 	void DrawFrame();
 
 	void UpdateUniformBuffer(uint32_t imageIndex);
+
+	bool SaveFrame(const char *filename);
+
+	/**
+	 * @brief watches the shader directory and swaps rebuilt pipelines in at frame boundaries
+	 */
+	bool EnableShaderHotReload(const char *shaderDirectory);
+
+	/**
+	 * @brief binds the model's material to a ShaderVariantBits variant, the base pipeline draws until the variant has compiled
+	 */
+	void SetMaterialVariant(uint32_t variantKey);
+
+	bool IsPaletted(){ return palette != NULL; }
+	Texture_Palette* GetPalette(){ return palette; }
+
+	/**
+	 * @brief damage, pickup and radiation suit tints, see Texture_Palette::EffectPalette
+	 */
+	void SetPaletteEffect(uint32_t effectPalette);
+
+	/**
+	 * @brief draws everything with one colormap, PALETTE_INVERSE_COLORMAP for invulnerability, -1 restores light diminishing
+	 */
+	void SetFixedColormap(int32_t colormap);
+
+	/**
+	 * @brief light level 0-255 of the sector being drawn
+	 */
+	void SetSectorLight(float light){ sectorLight = light; }
+
+	/**
+	 * @brief drives UpdateUniformBuffer from a frame indexed path instead of wall time, NULL restores wall time
+	 */
+	void SetCameraPath(Camera_Path *path){ cameraPath = path; cameraPathFrame = 0; }
+
+	/**
+	 * @brief drives UpdateUniformBuffer from the interpolated simulation state instead of wall time, NULL restores wall time
+	 * @note a camera path still takes precedence
+	 */
+	void SetGameState(const Game_State *state){ gameState = state; }
+
+	uint32_t GetFrameIndex(){ return frameIndex; }
+
+	float GetModelRadius(){ return modelRadius; }
+	Level_Map* GetLevel(){ return level; }
+	Occlusion_Culler* GetOcclusionCuller(){ return occlusion; }
+
+	double GetLastGpuFrameTime(){ return lastGpuFrameMs; }
+	uint64_t GetGpuFramesResolved(){ return gpuFramesResolved; }
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// variant toggles, set per pipeline through VkSpecializationInfo so unused paths are compiled out
+layout(constant_id = 0) const bool ALPHA_TEST = false;
+layout(constant_id = 1) const bool FOG = false;
+layout(constant_id = 2) const bool FULLBRIGHT = false;
+layout(constant_id = 3) const bool LIGHTING = false;
+
+const float FOG_DENSITY = 0.08;
+const vec3 FOG_COLOR = vec3(0.1, 0.4, 0.5);
+
+// every loaded texture, sized by the application when the pipeline layout is built
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform Material {
+    uint textureIndex;
+} material;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 color = texture(textures[material.textureIndex], fragTexCoord);
+
+    if (ALPHA_TEST && color.a < 0.5) {
+        discard;
+    }
+
+    if (LIGHTING && !FULLBRIGHT) {
+        color.rgb *= fragColor;
+    }
+
+    if (FOG) {
+        float viewDepth = 1.0 / gl_FragCoord.w;
+        color.rgb = mix(FOG_COLOR, color.rgb, exp(-viewDepth * FOG_DENSITY));
+    }
+
+    outColor = color;
+}
\ No newline at end of file
@@ -2,4 +2,16 @@ C:\VulkanSDK\1.1.92.1\Bin32\glslangvalidator.exe -V D:\MyDocuments\GLFW_Vulkan-D
 
 C:\VulkanSDK\1.1.92.1\Bin32\glslangvalidator.exe -V D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\shader.frag
 
+C:\VulkanSDK\1.1.92.1\Bin32\glslangvalidator.exe -V D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\bindless.frag -o D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\bindless_frag.spv
+
+C:\VulkanSDK\1.1.92.1\Bin32\glslangvalidator.exe -V D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\paletted.frag -o D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\paletted_frag.spv
+
+C:\VulkanSDK\1.1.92.1\Bin32\glslangvalidator.exe -V D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\hiz.comp -o D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\hiz_comp.spv
+
+C:\VulkanSDK\1.1.92.1\Bin32\glslangvalidator.exe -V D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\occlusion.comp -o D:\MyDocuments\GLFW_Vulkan-Doomlike\GLFW_Vulkan\shaders\occlusion_comp.spv
+
+pushd %~dp0..
+GLFW_Vulkan.exe -packshaders shaders/shaders.pak shaders/vert.spv shaders/frag.spv shaders/bindless_frag.spv shaders/paletted_frag.spv shaders/hiz_comp.spv shaders/occlusion_comp.spv
+popd
+
 pause
\ No newline at end of file
@@ -0,0 +1,63 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// variant toggles, set per pipeline through VkSpecializationInfo so unused paths are compiled out
+// colormaps already carry lighting and distance fade, so FOG and LIGHTING change nothing here
+layout(constant_id = 0) const bool ALPHA_TEST = false;
+layout(constant_id = 1) const bool FOG = false;
+layout(constant_id = 2) const bool FULLBRIGHT = false;
+layout(constant_id = 3) const bool LIGHTING = false;
+
+const int LIGHT_LEVELS = 32;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    int paletteIndex;
+    int fixedColormap;
+    float sectorLight;
+    float lightDiminishing;
+} ubo;
+
+// 8-bit palette indices, point sampled
+layout(binding = 1) uniform usampler2D indexSampler;
+
+// one layer per palette, 256 wide and one row per colormap, already resolved to RGBA
+layout(binding = 2) uniform sampler2DArray paletteLookup;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+// Doom's light diminishing, darker sectors start on a darker colormap and every map darkens further with distance
+int LightColormap() {
+    if (ubo.fixedColormap >= 0) {
+        return ubo.fixedColormap;
+    }
+
+    if (FULLBRIGHT) {
+        return 0;
+    }
+
+    float viewDepth = 1.0 / gl_FragCoord.w;
+    float shade = 2.0 - (ubo.sectorLight + 12.0) / 128.0;
+    float visibility = min(ubo.lightDiminishing / viewDepth, 24.0 / 32.0);
+
+    return int(clamp(shade - visibility, 0.0, 31.0 / 32.0) * float(LIGHT_LEVELS));
+}
+
+void main() {
+    ivec2 size = textureSize(indexSampler, 0);
+    ivec2 texel = ivec2(floor(fract(fragTexCoord) * vec2(size)));
+    uint index = texelFetch(indexSampler, texel, 0).r;
+
+    vec4 color = texelFetch(paletteLookup, ivec3(int(index), LightColormap(), ubo.paletteIndex), 0);
+
+    if (ALPHA_TEST && color.a < 0.5) {
+        discard;
+    }
+
+    outColor = color;
+}
\ No newline at end of file
@@ -1,6 +1,15 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// variant toggles, set per pipeline through VkSpecializationInfo so unused paths are compiled out
+layout(constant_id = 0) const bool ALPHA_TEST = false;
+layout(constant_id = 1) const bool FOG = false;
+layout(constant_id = 2) const bool FULLBRIGHT = false;
+layout(constant_id = 3) const bool LIGHTING = false;
+
+const float FOG_DENSITY = 0.08;
+const vec3 FOG_COLOR = vec3(0.1, 0.4, 0.5);
+
 layout(binding = 1) uniform sampler2D texSampler;
 
 layout(location = 0) in vec3 fragColor;
@@ -9,5 +18,20 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    vec4 color = texture(texSampler, fragTexCoord);
+
+    if (ALPHA_TEST && color.a < 0.5) {
+        discard;
+    }
+
+    if (LIGHTING && !FULLBRIGHT) {
+        color.rgb *= fragColor;
+    }
+
+    if (FOG) {
+        float viewDepth = 1.0 / gl_FragCoord.w;
+        color.rgb = mix(FOG_COLOR, color.rgb, exp(-viewDepth * FOG_DENSITY));
+    }
+
+    outColor = color;
 }
\ No newline at end of file
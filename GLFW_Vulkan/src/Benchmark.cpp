@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "simple_logger.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+Benchmark_Runner::Benchmark_Runner(Vulkan_Graphics *vGraphics, GLFW_Wrapper *gWrapper, Benchmark_Config benchConfig)
+{
+	graphics = vGraphics;
+	glfwWrapper = gWrapper;
+	config = benchConfig;
+	cpuFrameTimes = {};
+	gpuFrameTimes = {};
+}
+
+uint64_t Benchmark_Runner::GetProcessMemory(uint64_t *peak)
+{
+	uint64_t current = 0;
+	uint64_t highWater = 0;
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		current = counters.WorkingSetSize;
+		highWater = counters.PeakWorkingSetSize;
+	}
+#else
+	FILE *file = fopen("/proc/self/status", "r");
+	char line[256];
+	unsigned long long kb;
+
+	if (file)
+	{
+		while (fgets(line, sizeof(line), file))
+		{
+			if (sscanf(line, "VmRSS: %llu kB", &kb) == 1)
+			{
+				current = kb * 1024;
+			}
+			else if (sscanf(line, "VmHWM: %llu kB", &kb) == 1)
+			{
+				highWater = kb * 1024;
+			}
+		}
+		fclose(file);
+	}
+#endif
+
+	if (peak)
+	{
+		*peak = highWater;
+	}
+
+	return current;
+}
+
+Benchmark_Stats Benchmark_Runner::ComputeStats(std::vector<double> samples, float hitchFactor)
+{
+	Benchmark_Stats stats = {};
+	double total = 0.0;
+
+	if (samples.empty())
+	{
+		return stats;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	for (double sample : samples)
+	{
+		total += sample;
+	}
+
+	stats.count = (uint32_t)samples.size();
+	stats.avg = total / samples.size();
+	stats.p50 = samples[(samples.size() - 1) * 50 / 100];
+	stats.p95 = samples[(samples.size() - 1) * 95 / 100];
+	stats.p99 = samples[(samples.size() - 1) * 99 / 100];
+	stats.max = samples.back();
+
+	for (double sample : samples)
+	{
+		if (sample > stats.p50 * hitchFactor)
+		{
+			++stats.hitches;
+		}
+	}
+
+	return stats;
+}
+
+int Benchmark_Runner::Run()
+{
+	if (!config.pathFile || !path.Load(config.pathFile))
+	{
+		path.BuildDefault(config.warmupFrames + config.measuredFrames);
+	}
+
+	graphics->SetCameraPath(&path);
+
+	slog("benchmark: %i warmup frames, %i measured frames", config.warmupFrames, config.measuredFrames);
+
+	for (uint32_t i = 0; i < config.warmupFrames; ++i)
+	{
+		if (glfwWrapper)
+		{
+			if (glfwWindowShouldClose(glfwWrapper->GetWindow()))
+			{
+				return 1;
+			}
+			glfwPollEvents();
+		}
+
+		graphics->DrawFrame();
+
+		PROFILE_FRAME();
+	}
+
+	cpuFrameTimes.reserve(config.measuredFrames);
+	gpuFrameTimes.reserve(config.measuredFrames);
+
+	uint64_t gpuResolved = graphics->GetGpuFramesResolved();
+	auto runStart = std::chrono::steady_clock::now();
+	auto frameStart = runStart;
+
+	for (uint32_t i = 0; i < config.measuredFrames; ++i)
+	{
+		if (glfwWrapper)
+		{
+			if (glfwWindowShouldClose(glfwWrapper->GetWindow()))
+			{
+				break;
+			}
+			glfwPollEvents();
+		}
+
+		graphics->DrawFrame();
+
+		PROFILE_FRAME();
+
+		auto frameEnd = std::chrono::steady_clock::now();
+		cpuFrameTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+		frameStart = frameEnd;
+
+		if (graphics->GetGpuFramesResolved() != gpuResolved)
+		{
+			gpuResolved = graphics->GetGpuFramesResolved();
+			gpuFrameTimes.push_back(graphics->GetLastGpuFrameTime());
+		}
+	}
+
+	vkDeviceWaitIdle(graphics->GetLogicalDevice());
+
+	double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+
+	graphics->SetCameraPath(NULL);
+
+	return WriteResults(wallMs) ? 0 : 1;
+}
+
+static void WriteStats(FILE *file, const char *name, const Benchmark_Stats &stats)
+{
+	fprintf(file, "\t\"%s\": {\"frames\": %u, \"avg_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"hitches\": %u}",
+		name, stats.count, stats.avg, stats.p50, stats.p95, stats.p99, stats.max, stats.hitches);
+}
+
+bool Benchmark_Runner::WriteResults(double wallMs)
+{
+	Benchmark_Stats cpu = ComputeStats(cpuFrameTimes, config.hitchFactor);
+	Benchmark_Stats gpu = ComputeStats(gpuFrameTimes, config.hitchFactor);
+	uint64_t peakMemory = 0;
+	uint64_t memory = GetProcessMemory(&peakMemory);
+	FILE *file = fopen(config.outputFile, "w");
+
+	slog("benchmark cpu ms: p50 %f p95 %f p99 %f max %f, %i hitches", cpu.p50, cpu.p95, cpu.p99, cpu.max, cpu.hitches);
+	slog("benchmark gpu ms: p50 %f p95 %f p99 %f max %f, %i hitches", gpu.p50, gpu.p95, gpu.p99, gpu.max, gpu.hitches);
+
+	if (!file)
+	{
+		slog("failed to open benchmark output %s", config.outputFile);
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"headless\": %s,\n", graphics->IsHeadless() ? "true" : "false");
+	fprintf(file, "\t\"warmup_frames\": %u,\n", config.warmupFrames);
+	fprintf(file, "\t\"measured_frames\": %u,\n", (uint32_t)cpuFrameTimes.size());
+	fprintf(file, "\t\"hitch_factor\": %.2f,\n", config.hitchFactor);
+	fprintf(file, "\t\"wall_ms\": %.3f,\n", wallMs);
+	WriteStats(file, "cpu", cpu);
+	fprintf(file, ",\n");
+	WriteStats(file, "gpu", gpu);
+	fprintf(file, ",\n");
+	fprintf(file, "\t\"pipeline_cache\": {\"warm\": %s, \"pipelines\": %u, \"creation_ms\": %.3f},\n",
+		graphics->pipelineCache->WasLoadedFromDisk() ? "true" : "false",
+		graphics->pipelineCache->GetPipelinesCreated(),
+		graphics->pipelineCache->GetCreationMilliseconds());
+	fprintf(file, "\t\"pipelines\": {\"registered\": %u, \"builds\": %u, \"rebuilds\": %u, \"lookup_hits\": %u},\n",
+		graphics->GetPipelineWrapper()->GetPipelineCount(),
+		graphics->GetPipelineWrapper()->GetBuildCount(),
+		graphics->GetPipelineWrapper()->GetRebuildCount(),
+		graphics->GetPipelineWrapper()->GetLookupHits());
+	fprintf(file, "\t\"textures\": {\"mip_levels\": %u, \"bytes\": %llu, \"resident\": %u, \"resident_bytes\": %llu, \"loads\": %u, \"lookup_hits\": %u, \"evictions\": %u, \"samplers\": %u, \"levels_streamed\": %u, \"streamed_bytes\": %llu, \"mips_dropped\": %u},\n",
+		graphics->textureManager->GetTexture(graphics->GetModelTexture())->texture.mipLevels,
+		(unsigned long long)graphics->textureManager->GetTexture(graphics->GetModelTexture())->texture.bytes,
+		graphics->textureManager->GetResidentCount(),
+		(unsigned long long)graphics->textureManager->GetResidentBytes(),
+		graphics->textureManager->GetLoadCount(),
+		graphics->textureManager->GetLookupHits(),
+		graphics->textureManager->GetEvictionCount(),
+		graphics->textureManager->GetSamplerCount(),
+		graphics->textureManager->GetLevelsStreamed(),
+		(unsigned long long)graphics->textureManager->GetStreamedBytes(),
+		graphics->textureManager->GetMipsDropped());
+	fprintf(file, "\t\"texture_decode\": {\"workers\": %u, \"decoded\": %u, \"staged_in_place\": %u, \"bytes_read\": %llu},\n",
+		graphics->GetTextureWrapper()->GetDecoder()->GetWorkerCount(),
+		graphics->GetTextureWrapper()->GetDecoder()->GetDecodeCount(),
+		graphics->GetTextureWrapper()->GetDecoder()->GetStagedInPlace(),
+		(unsigned long long)graphics->GetTextureWrapper()->GetDecoder()->GetBytesRead());
+	fprintf(file, "\t\"palette\": {\"enabled\": %s, \"palettes\": %u, \"colormaps\": %u},\n",
+		graphics->IsPaletted() ? "true" : "false",
+		graphics->IsPaletted() ? graphics->GetPalette()->GetPaletteCount() : 0,
+		graphics->IsPaletted() ? graphics->GetPalette()->GetColormapCount() : 0);
+	fprintf(file, "\t\"texture_table\": {\"enabled\": %s, \"capacity\": %u, \"slots\": %u, \"descriptor_writes\": %u},\n",
+		graphics->textureTable ? "true" : "false",
+		graphics->textureTable ? graphics->textureTable->GetCapacity() : 0,
+		graphics->textureTable ? graphics->textureTable->GetUsedSlots() : 0,
+		graphics->textureTable ? graphics->textureTable->GetDescriptorWrites() : 0);
+	Occlusion_Culler *occlusion = graphics->GetOcclusionCuller();
+	double culledFrames = occlusion ? (double)std::max<uint64_t>(occlusion->GetFramesCulled(), 1) : 1.0;
+
+	fprintf(file, "\t\"occlusion\": {\"enabled\": %s, \"pyramid_levels\": %u, \"frames\": %llu, \"tested_per_frame\": %.2f, \"deferred_per_frame\": %.2f, \"recovered_per_frame\": %.2f},\n",
+		occlusion ? "true" : "false",
+		occlusion ? occlusion->GetMipCount() : 0,
+		occlusion ? (unsigned long long)occlusion->GetFramesCulled() : 0ull,
+		occlusion ? occlusion->GetObjectsTested() / culledFrames : 0.0,
+		occlusion ? occlusion->GetObjectsDeferred() / culledFrames : 0.0,
+		occlusion ? occlusion->GetObjectsRecovered() / culledFrames : 0.0);
+	fprintf(file, "\t\"memory\": {\"resident_bytes\": %llu, \"peak_resident_bytes\": %llu}\n", (unsigned long long)memory, (unsigned long long)peakMemory);
+	fprintf(file, "}\n");
+	fclose(file);
+
+	slog("wrote benchmark results to %s", config.outputFile);
+
+	return true;
+}
@@ -1,3 +1,6 @@
+#include <string.h>
+#include <algorithm>
+
 #include "Buffers.h"
 #include "Texture.h"
 #include "simple_logger.h"
@@ -17,6 +20,13 @@ Buffer_Wrapper::Buffer_Wrapper()
 	uniformBuffers = {};
 	uniformBuffersMemory = {};
 	swapImages = {};
+	textureImageView = VK_NULL_HANDLE;
+	textureSampler = VK_NULL_HANDLE;
+	paletteImageView = VK_NULL_HANDLE;
+	paletteSampler = VK_NULL_HANDLE;
+	maxInstances = 0;
+	maxDraws = 0;
+	depthSampled = false;
 }
 
 Buffer_Wrapper::~Buffer_Wrapper()
@@ -27,14 +37,20 @@ Buffer_Wrapper::~Buffer_Wrapper()
 	vkDestroyBuffer(logicalDevice, vertexBuffer, nullptr);
 	vkFreeMemory(logicalDevice, vertexBufferMemory, nullptr);
 
-	vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
-
 	for (size_t i = 0; i < swapImages.size(); i++) 
 	{
 		vkDestroyBuffer(logicalDevice, uniformBuffers[i], nullptr);
 		vkFreeMemory(logicalDevice, uniformBuffersMemory[i], nullptr);
 	}
 
+	for (size_t i = 0; i < instanceBuffers.size(); i++)
+	{
+		vkDestroyBuffer(logicalDevice, instanceBuffers[i], nullptr);
+		vkFreeMemory(logicalDevice, instanceBuffersMemory[i], nullptr);
+		vkDestroyBuffer(logicalDevice, indirectBuffers[i], nullptr);
+		vkFreeMemory(logicalDevice, indirectBuffersMemory[i], nullptr);
+	}
+
 	vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
 }
 
@@ -52,6 +68,12 @@ void Buffer_Wrapper::SetTextureInfo(VkImageView texImgView, VkSampler texSampler
 	textureSampler = texSampler;
 }
 
+void Buffer_Wrapper::SetPaletteInfo(VkImageView lookupView, VkSampler lookupSampler)
+{
+	paletteImageView = lookupView;
+	paletteSampler = lookupSampler;
+}
+
 void Buffer_Wrapper::CreateVertexBuffers(Command *cmd, const std::vector<Vertex> vertices)
 {
 	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
@@ -147,40 +169,6 @@ void Buffer_Wrapper::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDevice
 	Commands_Wrapper::CommandEndSingleTime(graphicsCmd, commandBuffer, graphicsQueue, logicalDevice);
 }
 
-void Buffer_Wrapper::CreateDescriptorSetLayout()
-{
-	VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-
-	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uboLayoutBinding.descriptorCount = 1;
-	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
-
-	VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorCount = 1;
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.pImmutableSamplers = nullptr;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-	layoutInfo.pBindings = bindings.data();
-
-	if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
-	{
-		slog("failed to create descriptor set layout!");
-	}
-	else
-	{
-		slog("created descriptor set layout");
-	}
-}
-
 void Buffer_Wrapper::CreateUniformBuffers() 
 {
 	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
@@ -194,13 +182,53 @@ void Buffer_Wrapper::CreateUniformBuffers()
 	}
 }
 
+void Buffer_Wrapper::CreateInstanceBuffers(uint32_t instanceCapacity, uint32_t indexCount, uint32_t drawCapacity)
+{
+	maxInstances = instanceCapacity;
+	maxDraws = std::max(drawCapacity, 1u);
+
+	instanceBuffers.resize(swapImages.size());
+	instanceBuffersMemory.resize(swapImages.size());
+	instanceData.resize(swapImages.size());
+	indirectBuffers.resize(swapImages.size());
+	indirectBuffersMemory.resize(swapImages.size());
+	indirectCommands.resize(swapImages.size());
+
+	for (size_t i = 0; i < swapImages.size(); i++)
+	{
+		CreateBuffer(sizeof(glm::mat4) * maxInstances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[i], instanceBuffersMemory[i], logicalDevice, graphicsQueue, physicalDevice);
+		CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * maxDraws, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indirectBuffers[i], indirectBuffersMemory[i], logicalDevice, graphicsQueue, physicalDevice);
+
+		void *data;
+
+		vkMapMemory(logicalDevice, instanceBuffersMemory[i], 0, sizeof(glm::mat4) * maxInstances, 0, &data);
+		instanceData[i] = (glm::mat4*)data;
+
+		vkMapMemory(logicalDevice, indirectBuffersMemory[i], 0, sizeof(VkDrawIndexedIndirectCommand) * maxDraws, 0, &data);
+		indirectCommands[i] = (VkDrawIndexedIndirectCommand*)data;
+
+		memset(indirectCommands[i], 0, sizeof(VkDrawIndexedIndirectCommand) * maxDraws);
+
+		//one identity instance until the first frame writes its own
+		instanceData[i][0] = glm::mat4(1.0f);
+
+		indirectCommands[i]->indexCount = indexCount;
+		indirectCommands[i]->instanceCount = 1;
+		indirectCommands[i]->firstIndex = 0;
+		indirectCommands[i]->vertexOffset = 0;
+		indirectCommands[i]->firstInstance = 0;
+	}
+}
+
 void Buffer_Wrapper::CreateDescriptorPool()
 {	
-	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	poolSizes[0].descriptorCount = static_cast<uint32_t>(swapImages.size());
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(swapImages.size());
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(swapImages.size()) * 2;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = static_cast<uint32_t>(swapImages.size());
 
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -245,7 +273,17 @@ void Buffer_Wrapper::CreateDescriptorSets()
 		imageInfo.imageView = textureImageView;
 		imageInfo.sampler = textureSampler;
 
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+		VkDescriptorImageInfo paletteInfo = {};
+		paletteInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		paletteInfo.imageView = paletteImageView;
+		paletteInfo.sampler = paletteSampler;
+
+		VkDescriptorBufferInfo instanceInfo = {};
+		instanceInfo.buffer = instanceBuffers[i];
+		instanceInfo.offset = 0;
+		instanceInfo.range = sizeof(glm::mat4) * maxInstances;
+
+		std::array<VkWriteDescriptorSet, 4> descriptorWrites = {};
 
 		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[0].dstSet = descriptorSets[i];
@@ -257,21 +295,73 @@ void Buffer_Wrapper::CreateDescriptorSets()
 
 		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[1].dstSet = descriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].dstBinding = 3;
 		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+		descriptorWrites[1].pBufferInfo = &instanceInfo;
+
+		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[2].dstSet = descriptorSets[i];
+		descriptorWrites[2].dstBinding = 1;
+		descriptorWrites[2].dstArrayElement = 0;
+		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[2].descriptorCount = 1;
+		descriptorWrites[2].pImageInfo = &imageInfo;
+
+		descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[3].dstSet = descriptorSets[i];
+		descriptorWrites[3].dstBinding = 2;
+		descriptorWrites[3].dstArrayElement = 0;
+		descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[3].descriptorCount = 1;
+		descriptorWrites[3].pImageInfo = &paletteInfo;
+
+		//with a texture table the set holds only the buffers, textures are indexed from the table's set
+		uint32_t writeCount = textureImageView != VK_NULL_HANDLE ? 3 : 2;
+
+		if (paletteImageView != VK_NULL_HANDLE)
+		{
+			writeCount = 4;
+		}
+
+		vkUpdateDescriptorSets(logicalDevice, writeCount, descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void Buffer_Wrapper::UpdateTextureDescriptors()
+{
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = textureImageView;
+	imageInfo.sampler = textureSampler;
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites(descriptorSets.size());
 
-		vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	for (size_t i = 0; i < descriptorSets.size(); i++)
+	{
+		descriptorWrites[i] = {};
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = descriptorSets[i];
+		descriptorWrites[i].dstBinding = 1;
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].pImageInfo = &imageInfo;
 	}
+
+	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
 void Buffer_Wrapper::CreateDepthResources(VkExtent2D extents, Command *graphicsCommand)
 {
 	VkFormat depthFormat = FindDepthFormat();
+	VkFormatProperties props;
+
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, depthFormat, &props);
+	depthSampled = (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
 
-	Texture_Wrapper::CreateImage(extents.width, extents.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory, logicalDevice, physicalDevice);
+	Texture_Wrapper::CreateImage(extents.width, extents.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (depthSampled ? VK_IMAGE_USAGE_SAMPLED_BIT : 0), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory, logicalDevice, physicalDevice);
 	depthImageView = Texture_Wrapper::CreateImageView(depthImage, depthFormat, logicalDevice, VK_IMAGE_ASPECT_DEPTH_BIT);
 
 	Texture_Wrapper::TransitionImageLayout(depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, logicalDevice, graphicsCommand, graphicsQueue);
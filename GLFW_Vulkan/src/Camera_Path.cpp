@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include "Camera_Path.h"
+#include "simple_logger.h"
+
+Camera_Path::Camera_Path()
+{
+	keys = {};
+}
+
+void Camera_Path::AddKey(uint32_t frame, glm::vec3 eye, glm::vec3 target, float modelAngle)
+{
+	Camera_Keyframe key = {};
+
+	key.frame = frame;
+	key.eye = eye;
+	key.target = target;
+	key.modelAngle = modelAngle;
+
+	keys.push_back(key);
+
+	std::sort(keys.begin(), keys.end(), [](const Camera_Keyframe &a, const Camera_Keyframe &b) { return a.frame < b.frame; });
+}
+
+bool Camera_Path::Load(const char *filename)
+{
+	FILE *file = fopen(filename, "r");
+	char line[256];
+	uint32_t frame;
+	glm::vec3 eye, target;
+	float angle;
+
+	if (!file)
+	{
+		slog("failed to open camera path %s", filename);
+		return false;
+	}
+
+	keys.clear();
+
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#')
+		{
+			continue;
+		}
+
+		if (sscanf(line, "%u %f %f %f %f %f %f %f", &frame, &eye.x, &eye.y, &eye.z, &target.x, &target.y, &target.z, &angle) == 8)
+		{
+			AddKey(frame, eye, target, angle);
+		}
+	}
+
+	fclose(file);
+
+	slog("loaded %i camera path keys from %s", (int)keys.size(), filename);
+
+	return !keys.empty();
+}
+
+void Camera_Path::BuildDefault(uint32_t frameCount)
+{
+	keys.clear();
+
+	AddKey(0, glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), 0.0f);
+	AddKey(frameCount, glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), frameCount * 1.5f);
+}
+
+void Camera_Path::Evaluate(uint32_t frame, glm::vec3 &eye, glm::vec3 &target, float &modelAngle)
+{
+	if (keys.empty())
+	{
+		return;
+	}
+
+	if (keys.size() == 1 || keys.back().frame == keys.front().frame)
+	{
+		eye = keys.front().eye;
+		target = keys.front().target;
+		modelAngle = keys.front().modelAngle;
+		return;
+	}
+
+	frame = keys.front().frame + (frame % (keys.back().frame - keys.front().frame));
+
+	size_t next = 1;
+	while (next < keys.size() - 1 && keys[next].frame <= frame)
+	{
+		++next;
+	}
+
+	const Camera_Keyframe &a = keys[next - 1];
+	const Camera_Keyframe &b = keys[next];
+	float t = (b.frame == a.frame) ? 0.0f : (float)(frame - a.frame) / (float)(b.frame - a.frame);
+
+	eye = glm::mix(a.eye, b.eye, t);
+	target = glm::mix(a.target, b.target, t);
+	modelAngle = a.modelAngle + (b.modelAngle - a.modelAngle) * t;
+}
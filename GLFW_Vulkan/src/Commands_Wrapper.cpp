@@ -1,6 +1,10 @@
+#include <algorithm>
+
 #include "Commands_Wrapper.h"
 #include "Buffers.h"
+#include "Occlusion_Culler.h"
 #include "simple_logger.h"
+#include "Profiler.h"
 
 Commands_Wrapper::Commands_Wrapper()
 {
@@ -46,8 +50,16 @@ void Commands_Wrapper::CommandsWrapperInit(uint32_t count, VkDevice defaultDevic
 
 
 
-void Commands_Wrapper::CreateCommandBuffers(Command *cmd, uint32_t swpchnFbs, std::vector<VkFramebuffer> fBuffers, Pipeline* pipe, VkExtent2D extents, VkBuffer vertexBuffer, VkBuffer indexBuffer, std::vector<VkDescriptorSet> descriptorSets, std::vector<uint32_t> indices)
+void Commands_Wrapper::CreateCommandBuffers(Command *cmd, uint32_t swpchnFbs, std::vector<VkFramebuffer> fBuffers, Pipeline* pipe, VkExtent2D extents, VkBuffer vertexBuffer, VkBuffer indexBuffer, std::vector<VkDescriptorSet> descriptorSets, const std::vector<VkBuffer> &indirectBuffers, uint32_t drawCount, uint32_t drawsPerCall, VkQueryPool timestampPool, const std::vector<VkDescriptorSet> &textureTableSets, uint32_t textureIndex, Occlusion_Culler *occlusion)
 {	
+	PROFILE_ZONE("CreateCommandBuffers");
+
+	//re-recording after a pipeline swap replaces the previous set
+	if (!cmd->commandBuffers.empty())
+	{
+		vkFreeCommandBuffers(device, cmd->commandPool, (uint32_t)cmd->commandBuffers.size(), cmd->commandBuffers.data());
+	}
+
 	cmd->commandBuffers.resize(swpchnFbs);
 
 	VkCommandBufferAllocateInfo allocInfo = {};
@@ -70,6 +82,12 @@ void Commands_Wrapper::CreateCommandBuffers(Command *cmd, uint32_t swpchnFbs, st
 			throw std::runtime_error("failed to begin recording command buffer!");
 		}
 
+		if (timestampPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(cmd->commandBuffers[i], timestampPool, (uint32_t)(i * 2), 2);
+			vkCmdWriteTimestamp(cmd->commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, (uint32_t)(i * 2));
+		}
+
 		VkRenderPassBeginInfo renderPassInfo = {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 		renderPassInfo.renderPass = pipe->renderPass;
@@ -86,22 +104,71 @@ void Commands_Wrapper::CreateCommandBuffers(Command *cmd, uint32_t swpchnFbs, st
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(cmd->commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		//both occlusion phases bind and draw the same way, from their own indirect buffers
+		auto recordDraws = [&](VkBuffer indirectBuffer, uint32_t indirectDraws)
+		{
+			vkCmdBindPipeline(cmd->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->graphicsPipeline);
+
+			SetDynamicState(cmd->commandBuffers[i], extents);
 
-		vkCmdBindPipeline(cmd->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->graphicsPipeline);
+			VkBuffer vertexBuffers[] = { vertexBuffer };
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(cmd->commandBuffers[i], 0, 1, vertexBuffers, offsets);
 
-		VkBuffer vertexBuffers[] = { vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(cmd->commandBuffers[i], 0, 1, vertexBuffers, offsets);
+			vkCmdBindIndexBuffer(cmd->commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-		vkCmdBindIndexBuffer(cmd->commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			if (textureTableSets.empty())
+			{
+				vkCmdBindDescriptorSets(cmd->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+			}
+			else
+			{
+				//bound once per command buffer however many textures are drawn, each draw only pushes its index
+				VkDescriptorSet sets[] = { descriptorSets[i], textureTableSets[i] };
+				MaterialPushConstants material = { textureIndex };
 
-		vkCmdBindDescriptorSets(cmd->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+				vkCmdBindDescriptorSets(cmd->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->pipelineLayout, 0, 2, sets, 0, nullptr);
+				vkCmdPushConstants(cmd->commandBuffers[i], pipe->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(material), &material);
+			}
+
+			//the instance counts are written into the indirect buffer each frame, so the recording outlives them
+			for (uint32_t first = 0; first < indirectDraws; first += drawsPerCall)
+			{
+				vkCmdDrawIndexedIndirect(cmd->commandBuffers[i], indirectBuffer, first * sizeof(VkDrawIndexedIndirectCommand), std::min(drawsPerCall, indirectDraws - first), sizeof(VkDrawIndexedIndirectCommand));
+			}
+		};
 
-		vkCmdDrawIndexed(cmd->commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+		//a pipeline still compiling has no handle yet, the pass just clears
+		bool pipeReady = pipe->status.load() == PS_Ready;
+
+		vkCmdBeginRenderPass(cmd->commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		if (pipeReady)
+		{
+			recordDraws(indirectBuffers[i], drawCount);
+		}
 
 		vkCmdEndRenderPass(cmd->commandBuffers[i]);
 
+		//the depth of what was drawn is culled against, then whatever the first pass missed is drawn over it
+		if (occlusion && pipeReady)
+		{
+			occlusion->RecordCulling(cmd->commandBuffers[i], (uint32_t)i);
+
+			renderPassInfo.renderPass = occlusion->GetRenderPass();
+			renderPassInfo.clearValueCount = 0;
+			renderPassInfo.pClearValues = NULL;
+
+			vkCmdBeginRenderPass(cmd->commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			recordDraws(occlusion->GetDrawBuffers()[i], occlusion->GetMaxDraws());
+			vkCmdEndRenderPass(cmd->commandBuffers[i]);
+		}
+
+		if (timestampPool != VK_NULL_HANDLE)
+		{
+			vkCmdWriteTimestamp(cmd->commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, (uint32_t)(i * 2 + 1));
+		}
+
 		if (vkEndCommandBuffer(cmd->commandBuffers[i]) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to record command buffer!");
@@ -207,6 +274,32 @@ void Commands_Wrapper::ConfigureRenderPass(VkCommandBuffer commandBuffer, VkRend
 
 	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+	SetDynamicState(commandBuffer, extent);
+}
+
+void Commands_Wrapper::SetDynamicState(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
+	VkViewport viewport = {};
+	VkRect2D scissor = {};
+
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	scissor.offset = { 0, 0 };
+	scissor.extent = extent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	//the values every pipeline used to bake in, none of them need a device feature
+	vkCmdSetLineWidth(commandBuffer, 1.0f);
+	vkCmdSetDepthBias(commandBuffer, 0.0f, 0.0f, 0.0f);
+	vkCmdSetStencilReference(commandBuffer, VK_STENCIL_FACE_FRONT_AND_BACK, 0);
 }
 
 VkCommandBuffer Commands_Wrapper::CommandBeginSingleTime(Command *cmd, VkDevice device)
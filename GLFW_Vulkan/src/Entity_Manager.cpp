@@ -0,0 +1,456 @@
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "Entity_Manager.h"
+#include "simple_logger.h"
+
+const static uint32_t ARCHETYPE_INITIAL_CAPACITY = 64;
+
+const static uint32_t BENCHMARK_PASSES = 100;
+const static float BENCHMARK_STEP = 1.0f / 35.0f;
+
+//an actor as one struct, the rest of its state (AI, flags, health) rides along through every pass over transforms
+struct Benchmark_Actor
+{
+	Transform_Component		transform;
+	Velocity_Component		velocity;
+	Mesh_Component			mesh;
+	uint8_t					state[64];
+};
+
+Entity_Manager::Entity_Manager()
+{
+	aliveCount = 0;
+}
+
+Entity_Manager::~Entity_Manager()
+{
+	for (Entity_Archetype *archetype : archetypes)
+	{
+		delete archetype;
+	}
+}
+
+uint32_t Entity_Manager::ComponentSize(EntityComponent component)
+{
+	switch (component)
+	{
+	case EC_TRANSFORM:
+		return sizeof(Transform_Component);
+	case EC_VELOCITY:
+		return sizeof(Velocity_Component);
+	case EC_MESH:
+		return sizeof(Mesh_Component);
+	default:
+		return 0;
+	}
+}
+
+uint32_t Entity_Manager::FindArchetype(uint32_t mask)
+{
+	for (uint32_t i = 0; i < archetypes.size(); ++i)
+	{
+		if (archetypes[i]->mask == mask)
+		{
+			return i;
+		}
+	}
+
+	Entity_Archetype *archetype = new Entity_Archetype();
+
+	archetype->mask = mask;
+	archetype->count = 0;
+	archetype->capacity = 0;
+
+	archetypes.push_back(archetype);
+
+	return (uint32_t)archetypes.size() - 1;
+}
+
+uint32_t Entity_Manager::AddRow(Entity_Archetype *archetype, Entity_Id id)
+{
+	if (archetype->count == archetype->capacity)
+	{
+		archetype->capacity = std::max(archetype->capacity * 2, ARCHETYPE_INITIAL_CAPACITY);
+
+		for (uint32_t c = 0; c < EC_COUNT; ++c)
+		{
+			if (archetype->mask & ENTITY_MASK(c))
+			{
+				archetype->columns[c].resize((size_t)archetype->capacity * ComponentSize((EntityComponent)c));
+			}
+		}
+
+		archetype->entities.resize(archetype->capacity);
+	}
+
+	uint32_t row = archetype->count++;
+
+	archetype->entities[row] = id;
+
+	return row;
+}
+
+void Entity_Manager::RemoveRow(Entity_Archetype *archetype, uint32_t row)
+{
+	uint32_t last = archetype->count - 1;
+
+	if (row != last)
+	{
+		for (uint32_t c = 0; c < EC_COUNT; ++c)
+		{
+			if (archetype->mask & ENTITY_MASK(c))
+			{
+				uint32_t size = ComponentSize((EntityComponent)c);
+				uint8_t *column = archetype->columns[c].data();
+
+				memcpy(column + (size_t)row * size, column + (size_t)last * size, size);
+			}
+		}
+
+		archetype->entities[row] = archetype->entities[last];
+		records[archetype->entities[row].index].row = row;
+	}
+
+	archetype->count = last;
+}
+
+Entity_Id Entity_Manager::Create(uint32_t mask)
+{
+	Entity_Id id;
+
+	if (!freeIndices.empty())
+	{
+		id.index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		id.index = (uint32_t)records.size();
+		records.push_back({ 1, 0, 0 });
+	}
+
+	id.generation = records[id.index].generation;
+
+	uint32_t archetypeIndex = FindArchetype(mask);
+	Entity_Archetype *archetype = archetypes[archetypeIndex];
+	uint32_t row = AddRow(archetype, id);
+
+	for (uint32_t c = 0; c < EC_COUNT; ++c)
+	{
+		if (mask & ENTITY_MASK(c))
+		{
+			uint32_t size = ComponentSize((EntityComponent)c);
+
+			memset(archetype->columns[c].data() + (size_t)row * size, 0, size);
+		}
+	}
+
+	records[id.index].archetype = archetypeIndex;
+	records[id.index].row = row;
+
+	++aliveCount;
+
+	return id;
+}
+
+void Entity_Manager::Destroy(Entity_Id id)
+{
+	if (!IsAlive(id))
+	{
+		return;
+	}
+
+	Entity_Record &record = records[id.index];
+
+	RemoveRow(archetypes[record.archetype], record.row);
+
+	//skip 0 when the generation wraps so a zeroed id never matches
+	record.generation = record.generation + 1 ? record.generation + 1 : 1;
+
+	freeIndices.push_back(id.index);
+	--aliveCount;
+}
+
+bool Entity_Manager::IsAlive(Entity_Id id)
+{
+	return id.index < records.size() && id.generation != 0 && records[id.index].generation == id.generation;
+}
+
+void* Entity_Manager::GetComponent(Entity_Id id, EntityComponent component)
+{
+	if (!IsAlive(id))
+	{
+		return NULL;
+	}
+
+	Entity_Record &record = records[id.index];
+	Entity_Archetype *archetype = archetypes[record.archetype];
+
+	if (!(archetype->mask & ENTITY_MASK(component)))
+	{
+		return NULL;
+	}
+
+	return archetype->columns[component].data() + (size_t)record.row * ComponentSize(component);
+}
+
+void Entity_Manager::MoveEntity(Entity_Id id, uint32_t mask)
+{
+	Entity_Record &record = records[id.index];
+	Entity_Archetype *from = archetypes[record.archetype];
+
+	if (from->mask == mask)
+	{
+		return;
+	}
+
+	uint32_t archetypeIndex = FindArchetype(mask);
+	Entity_Archetype *to = archetypes[archetypeIndex];
+	uint32_t oldRow = record.row;
+	uint32_t newRow = AddRow(to, id);
+
+	for (uint32_t c = 0; c < EC_COUNT; ++c)
+	{
+		if (!(mask & ENTITY_MASK(c)))
+		{
+			continue;
+		}
+
+		uint32_t size = ComponentSize((EntityComponent)c);
+		uint8_t *destination = to->columns[c].data() + (size_t)newRow * size;
+
+		if (from->mask & ENTITY_MASK(c))
+		{
+			memcpy(destination, from->columns[c].data() + (size_t)oldRow * size, size);
+		}
+		else
+		{
+			memset(destination, 0, size);
+		}
+	}
+
+	RemoveRow(from, oldRow);
+
+	record.archetype = archetypeIndex;
+	record.row = newRow;
+}
+
+void Entity_Manager::AddComponents(Entity_Id id, uint32_t mask)
+{
+	if (IsAlive(id))
+	{
+		MoveEntity(id, archetypes[records[id.index].archetype]->mask | mask);
+	}
+}
+
+void Entity_Manager::RemoveComponents(Entity_Id id, uint32_t mask)
+{
+	if (IsAlive(id))
+	{
+		MoveEntity(id, archetypes[records[id.index].archetype]->mask & ~mask);
+	}
+}
+
+Entity_Chunk Entity_Manager::MakeChunk(Entity_Archetype *archetype, uint32_t begin, uint32_t end, uint32_t first)
+{
+	Entity_Chunk chunk;
+
+	chunk.count = end - begin;
+	chunk.first = first;
+	chunk.entities = archetype->entities.data() + begin;
+
+	for (uint32_t c = 0; c < EC_COUNT; ++c)
+	{
+		chunk.columns[c] = (archetype->mask & ENTITY_MASK(c)) ? archetype->columns[c].data() + (size_t)begin * ComponentSize((EntityComponent)c) : NULL;
+	}
+
+	return chunk;
+}
+
+void Entity_Manager::ForEach(uint32_t mask, EntityQueryFunction query, void *data)
+{
+	uint32_t first = 0;
+
+	for (Entity_Archetype *archetype : archetypes)
+	{
+		if ((archetype->mask & mask) != mask || archetype->count == 0)
+		{
+			continue;
+		}
+
+		Entity_Chunk chunk = MakeChunk(archetype, 0, archetype->count, first);
+
+		query(chunk, data);
+
+		first += archetype->count;
+	}
+}
+
+void Entity_Manager::ParallelForEach(Job_System *jobSystem, uint32_t mask, uint32_t grain, EntityQueryFunction query, void *data)
+{
+	if (!jobSystem)
+	{
+		ForEach(mask, query, data);
+		return;
+	}
+
+	uint32_t first = 0;
+
+	for (Entity_Archetype *archetype : archetypes)
+	{
+		if ((archetype->mask & mask) != mask || archetype->count == 0)
+		{
+			continue;
+		}
+
+		jobSystem->ParallelFor(archetype->count, grain, [&](uint32_t begin, uint32_t end)
+		{
+			Entity_Chunk chunk = MakeChunk(archetype, begin, end, first + begin);
+
+			query(chunk, data);
+		});
+
+		first += archetype->count;
+	}
+}
+
+uint32_t Entity_Manager::Count(uint32_t mask)
+{
+	uint32_t count = 0;
+
+	for (Entity_Archetype *archetype : archetypes)
+	{
+		if ((archetype->mask & mask) == mask)
+		{
+			count += archetype->count;
+		}
+	}
+
+	return count;
+}
+
+static void IntegrateChunk(Entity_Chunk &chunk, void *data)
+{
+	Transform_Component *transforms = chunk.Get<Transform_Component>();
+	const Velocity_Component *velocities = chunk.Get<Velocity_Component>();
+
+	for (uint32_t i = 0; i < chunk.count; ++i)
+	{
+		transforms[i].position += velocities[i].linear * BENCHMARK_STEP;
+		transforms[i].yaw += velocities[i].angular * BENCHMARK_STEP;
+	}
+}
+
+static bool SameTransforms(Entity_Manager &entities, const std::vector<Entity_Id> &ids, const std::vector<Benchmark_Actor> &actors)
+{
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		Transform_Component *transform = entities.Get<Transform_Component>(ids[i]);
+
+		if (!transform || memcmp(transform, &actors[i].transform, sizeof(Transform_Component)) != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Entity_Manager::Benchmark(uint32_t entityCount)
+{
+	Entity_Manager entities;
+	std::vector<Entity_Id> ids(entityCount);
+	std::vector<Benchmark_Actor> actors(entityCount);
+	uint32_t mask = ENTITY_MASK(EC_TRANSFORM) | ENTITY_MASK(EC_VELOCITY) | ENTITY_MASK(EC_MESH);
+	bool succeeded = true;
+
+	for (uint32_t i = 0; i < entityCount; ++i)
+	{
+		Benchmark_Actor &actor = actors[i];
+
+		actor = Benchmark_Actor();
+
+		actor.transform.position = glm::vec3((float)(i % 256), (float)(i / 256 % 256), 0.0f);
+		actor.transform.scale = 1.0f;
+		actor.velocity.linear = glm::vec3((float)(i % 7) - 3.0f, (float)(i % 5) - 2.0f, (float)(i % 3) - 1.0f);
+		actor.velocity.angular = (float)(i % 360);
+
+		ids[i] = entities.Create(mask);
+
+		*entities.Get<Transform_Component>(ids[i]) = actor.transform;
+		*entities.Get<Velocity_Component>(ids[i]) = actor.velocity;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t pass = 0; pass < BENCHMARK_PASSES; ++pass)
+	{
+		for (Benchmark_Actor &actor : actors)
+		{
+			actor.transform.position += actor.velocity.linear * BENCHMARK_STEP;
+			actor.transform.yaw += actor.velocity.angular * BENCHMARK_STEP;
+		}
+	}
+
+	double aosMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / BENCHMARK_PASSES;
+
+	start = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t pass = 0; pass < BENCHMARK_PASSES; ++pass)
+	{
+		entities.ForEach(ENTITY_MASK(EC_TRANSFORM) | ENTITY_MASK(EC_VELOCITY), &IntegrateChunk, NULL);
+	}
+
+	double soaMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / BENCHMARK_PASSES;
+
+	if (!SameTransforms(entities, ids, actors))
+	{
+		slog("archetype storage and the actor array disagree after %u passes", BENCHMARK_PASSES);
+		succeeded = false;
+	}
+
+	//bring the actors level before comparing the parallel passes
+	for (uint32_t pass = 0; pass < BENCHMARK_PASSES; ++pass)
+	{
+		for (Benchmark_Actor &actor : actors)
+		{
+			actor.transform.position += actor.velocity.linear * BENCHMARK_STEP;
+			actor.transform.yaw += actor.velocity.angular * BENCHMARK_STEP;
+		}
+	}
+
+	double parallelMs;
+	uint32_t threads;
+
+	{
+		Job_System jobSystem;
+
+		jobSystem.Job_SystemInit();
+		threads = jobSystem.GetWorkerCount() + 1;
+
+		start = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t pass = 0; pass < BENCHMARK_PASSES; ++pass)
+		{
+			entities.ParallelForEach(&jobSystem, ENTITY_MASK(EC_TRANSFORM) | ENTITY_MASK(EC_VELOCITY), 0, &IntegrateChunk, NULL);
+		}
+
+		parallelMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / BENCHMARK_PASSES;
+	}
+
+	if (!SameTransforms(entities, ids, actors))
+	{
+		slog("parallel archetype passes disagree with the actor array");
+		succeeded = false;
+	}
+
+	slog("integrating %u entities, %u byte actors against %u + %u byte component arrays", entityCount,
+		(uint32_t)sizeof(Benchmark_Actor), (uint32_t)sizeof(Transform_Component), (uint32_t)sizeof(Velocity_Component));
+	slog("actor array %.3f ms per pass, %.2f ns per entity", aosMs, aosMs * 1000000.0 / std::max(entityCount, 1u));
+	slog("archetype arrays %.3f ms per pass, %.2f ns per entity, %.2fx the actor array", soaMs, soaMs * 1000000.0 / std::max(entityCount, 1u), soaMs > 0.0 ? aosMs / soaMs : 0.0);
+	slog("archetype arrays on %u threads %.3f ms per pass, %.2fx the actor array", threads, parallelMs, parallelMs > 0.0 ? aosMs / parallelMs : 0.0);
+
+	return succeeded;
+}
\ No newline at end of file
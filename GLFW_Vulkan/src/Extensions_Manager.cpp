@@ -1,3 +1,4 @@
+#include <string.h>
 #include <vector>
 
 #include "Extensions_Manager.h"
@@ -13,11 +14,11 @@ Extensions_Manager::~Extensions_Manager()
 {
 }
 
-std::vector<const char*> Extensions_Manager::InstanceExtensionsInit(bool validation)
+std::vector<const char*> Extensions_Manager::InstanceExtensionsInit(bool validation, bool windowed)
 {
 	std::vector<const char*> glfwExtensions = {};
 	uint32_t glfwCount = 0;
-	const char** glfwNames = glfwGetRequiredInstanceExtensions(&glfwCount);
+	const char** glfwNames = windowed ? glfwGetRequiredInstanceExtensions(&glfwCount) : NULL;
 	std::vector<const char*> emptyExts = {};
 	std::vector<const char*> allInstanceExtensions = {};
 
@@ -104,4 +105,25 @@ void Extensions_Manager::DeviceExtensionsInit(VkPhysicalDevice device, std::vect
 	}
 
 	deviceExtensions.enabledExtensionCount = deviceExtensions.enabledExtensionNames.size();
+}
+
+bool Extensions_Manager::IsDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName)
+{
+	uint32_t extensionCount = 0;
+
+	vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+
+	vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, extensions.data());
+
+	for (const VkExtensionProperties &extension : extensions)
+	{
+		if (strcmp(extension.extensionName, extensionName) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
 }
\ No newline at end of file
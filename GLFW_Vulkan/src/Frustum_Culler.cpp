@@ -0,0 +1,465 @@
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Frustum_Culler.h"
+#include "simple_logger.h"
+
+#if CULL_HAS_SIMD
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#endif
+
+//the wide paths need functions compiled for their instruction set, MSVC allows the intrinsics anywhere
+#if CULL_HAS_SIMD && (defined(__GNUC__) || defined(__clang__))
+#define CULL_TARGET_SSE __attribute__((target("sse2")))
+#define CULL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CULL_TARGET_SSE
+#define CULL_TARGET_AVX2
+#endif
+
+//spheres per job, a multiple of 8 so every block starts on a full AVX2 group
+const static uint32_t CULL_BLOCK_SIZE = 4096;
+
+const static uint32_t BENCHMARK_REPEATS = 20;
+
+#if CULL_HAS_SIMD
+static void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex((int*)registers, (int)leaf, (int)subleaf);
+#else
+	registers[0] = registers[1] = registers[2] = registers[3] = 0;
+	__get_cpuid_count(leaf, subleaf, &registers[0], &registers[1], &registers[2], &registers[3]);
+#endif
+}
+
+//which register states the OS saves on a context switch, only valid once cpuid reports OSXSAVE
+static uint64_t SavedStates()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t low, high;
+
+	__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+
+	return ((uint64_t)high << 32) | low;
+#endif
+}
+#endif
+
+Frustum_Culler::Frustum_Culler()
+{
+	count = 0;
+	visibleCount = 0;
+	path = BestPath();
+
+	for (glm::vec4 &plane : planes)
+	{
+		plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+bool Frustum_Culler::IsSupported(CullPath path)
+{
+	if (path == CULL_SCALAR)
+	{
+		return true;
+	}
+
+#if CULL_HAS_SIMD
+	uint32_t features[4];
+
+	Cpuid(0, 0, features);
+
+	uint32_t maxLeaf = features[0];
+
+	Cpuid(1, 0, features);
+
+	if (path == CULL_SSE)
+	{
+		return (features[3] & (1u << 25)) != 0;
+	}
+
+	if (path == CULL_AVX2)
+	{
+		bool osxsave = (features[2] & (1u << 27)) != 0;
+		bool avx = (features[2] & (1u << 28)) != 0;
+
+		//the CPU having AVX isn't enough, the OS has to save the ymm registers too
+		if (!osxsave || !avx || maxLeaf < 7 || (SavedStates() & 6) != 6)
+		{
+			return false;
+		}
+
+		Cpuid(7, 0, features);
+
+		return (features[1] & (1u << 5)) != 0;
+	}
+#endif
+
+	return false;
+}
+
+CullPath Frustum_Culler::BestPath()
+{
+	if (IsSupported(CULL_AVX2))
+	{
+		return CULL_AVX2;
+	}
+
+	return IsSupported(CULL_SSE) ? CULL_SSE : CULL_SCALAR;
+}
+
+const char* Frustum_Culler::PathName(CullPath path)
+{
+	switch (path)
+	{
+	case CULL_SCALAR:
+		return "scalar";
+	case CULL_SSE:
+		return "sse";
+	case CULL_AVX2:
+		return "avx2";
+	default:
+		return "unknown";
+	}
+}
+
+bool Frustum_Culler::SetPath(CullPath path)
+{
+	if (!IsSupported(path))
+	{
+		return false;
+	}
+
+	this->path = path;
+
+	return true;
+}
+
+void Frustum_Culler::ExtractPlanes(const glm::mat4 &viewProj, glm::vec4 planes[6])
+{
+	//glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 rows[4];
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+
+	//depth runs 0 to 1, so the near plane is z >= 0 rather than z >= -w
+	planes[4] = rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+void Frustum_Culler::SetFrustum(const glm::mat4 &viewProj)
+{
+	ExtractPlanes(viewProj, planes);
+}
+
+void Frustum_Culler::Resize(uint32_t sphereCount)
+{
+	uint32_t padded = (sphereCount + 7) & ~7u;
+
+	count = sphereCount;
+
+	centerX.resize(padded);
+	centerY.resize(padded);
+	centerZ.resize(padded);
+	radius.resize(padded);
+	visible.resize(padded);
+}
+
+uint32_t Frustum_Culler::CullScalar(const Frustum_Culler *culler, uint32_t begin, uint32_t end, uint32_t *out)
+{
+	uint32_t written = 0;
+
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		float x = culler->centerX[i];
+		float y = culler->centerY[i];
+		float z = culler->centerZ[i];
+		float negativeRadius = -culler->radius[i];
+		bool inside = true;
+
+		//same operation order as the wide paths so all of them agree to the bit
+		for (uint32_t p = 0; p < 6 && inside; ++p)
+		{
+			const glm::vec4 &plane = culler->planes[p];
+			float distance = ((plane.x * x + plane.y * y) + plane.z * z) + plane.w;
+
+			inside = distance >= negativeRadius;
+		}
+
+		out[written] = i;
+		written += inside ? 1 : 0;
+	}
+
+	return written;
+}
+
+#if CULL_HAS_SIMD
+CULL_TARGET_SSE uint32_t Frustum_Culler::CullSSE(const Frustum_Culler *culler, uint32_t begin, uint32_t end, uint32_t *out)
+{
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	__m128 signBit = _mm_set1_ps(-0.0f);
+	uint32_t written = 0;
+
+	for (uint32_t p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(culler->planes[p].x);
+		planeY[p] = _mm_set1_ps(culler->planes[p].y);
+		planeZ[p] = _mm_set1_ps(culler->planes[p].z);
+		planeW[p] = _mm_set1_ps(culler->planes[p].w);
+	}
+
+	for (uint32_t i = begin; i < end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&culler->centerX[i]);
+		__m128 y = _mm_loadu_ps(&culler->centerY[i]);
+		__m128 z = _mm_loadu_ps(&culler->centerZ[i]);
+		__m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(&culler->radius[i]), signBit);
+		__m128 inside = _mm_cmpeq_ps(signBit, signBit);
+
+		for (uint32_t p = 0; p < 6; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_mul_ps(planeZ[p], z)), planeW[p]);
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		uint32_t mask = (uint32_t)_mm_movemask_ps(inside);
+		uint32_t lanes = std::min(end - i, 4u);
+
+		//branchless compaction, every lane is written and only visible ones advance the count
+		for (uint32_t lane = 0; lane < lanes; ++lane)
+		{
+			out[written] = i + lane;
+			written += (mask >> lane) & 1;
+		}
+	}
+
+	return written;
+}
+
+CULL_TARGET_AVX2 uint32_t Frustum_Culler::CullAVX2(const Frustum_Culler *culler, uint32_t begin, uint32_t end, uint32_t *out)
+{
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	__m256 signBit = _mm256_set1_ps(-0.0f);
+	uint32_t written = 0;
+
+	for (uint32_t p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm256_set1_ps(culler->planes[p].x);
+		planeY[p] = _mm256_set1_ps(culler->planes[p].y);
+		planeZ[p] = _mm256_set1_ps(culler->planes[p].z);
+		planeW[p] = _mm256_set1_ps(culler->planes[p].w);
+	}
+
+	for (uint32_t i = begin; i < end; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&culler->centerX[i]);
+		__m256 y = _mm256_loadu_ps(&culler->centerY[i]);
+		__m256 z = _mm256_loadu_ps(&culler->centerZ[i]);
+		__m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(&culler->radius[i]), signBit);
+		__m256 inside = _mm256_cmp_ps(signBit, signBit, _CMP_EQ_OQ);
+
+		//separate multiplies and adds rather than fma, so the result matches the other paths exactly
+		for (uint32_t p = 0; p < 6; ++p)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)), _mm256_mul_ps(planeZ[p], z)), planeW[p]);
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+
+		uint32_t mask = (uint32_t)_mm256_movemask_ps(inside);
+		uint32_t lanes = std::min(end - i, 8u);
+
+		for (uint32_t lane = 0; lane < lanes; ++lane)
+		{
+			out[written] = i + lane;
+			written += (mask >> lane) & 1;
+		}
+	}
+
+	return written;
+}
+#else
+uint32_t Frustum_Culler::CullSSE(const Frustum_Culler *culler, uint32_t begin, uint32_t end, uint32_t *out)
+{
+	return CullScalar(culler, begin, end, out);
+}
+
+uint32_t Frustum_Culler::CullAVX2(const Frustum_Culler *culler, uint32_t begin, uint32_t end, uint32_t *out)
+{
+	return CullScalar(culler, begin, end, out);
+}
+#endif
+
+uint32_t Frustum_Culler::CullRange(uint32_t begin, uint32_t end, uint32_t *out) const
+{
+	switch (path)
+	{
+	case CULL_AVX2:
+		return CullAVX2(this, begin, end, out);
+	case CULL_SSE:
+		return CullSSE(this, begin, end, out);
+	default:
+		return CullScalar(this, begin, end, out);
+	}
+}
+
+uint32_t Frustum_Culler::Cull(Job_System *jobSystem)
+{
+	if (!jobSystem || count <= CULL_BLOCK_SIZE)
+	{
+		visibleCount = CullRange(0, count, visible.data());
+		return visibleCount;
+	}
+
+	uint32_t blockCount = (count + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE;
+
+	blockCounts.resize(blockCount);
+
+	//each block writes its visible list at its own start, so the blocks never touch each other's output
+	jobSystem->ParallelFor(blockCount, 1, [this](uint32_t firstBlock, uint32_t lastBlock)
+	{
+		for (uint32_t block = firstBlock; block < lastBlock; ++block)
+		{
+			uint32_t begin = block * CULL_BLOCK_SIZE;
+			uint32_t end = std::min(begin + CULL_BLOCK_SIZE, count);
+
+			blockCounts[block] = CullRange(begin, end, visible.data() + begin);
+		}
+	});
+
+	visibleCount = 0;
+
+	for (uint32_t block = 0; block < blockCount; ++block)
+	{
+		uint32_t begin = block * CULL_BLOCK_SIZE;
+
+		if (visibleCount != begin)
+		{
+			memmove(visible.data() + visibleCount, visible.data() + begin, blockCounts[block] * sizeof(uint32_t));
+		}
+
+		visibleCount += blockCounts[block];
+	}
+
+	return visibleCount;
+}
+
+bool Frustum_Culler::Benchmark(uint32_t sphereCount)
+{
+	Frustum_Culler culler;
+	uint32_t seed = 12345;
+	bool succeeded = true;
+
+	culler.Resize(sphereCount);
+
+	for (uint32_t i = 0; i < sphereCount; ++i)
+	{
+		float values[4];
+
+		for (float &value : values)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			value = (seed >> 8) / 16777216.0f;
+		}
+
+		culler.SetSphere(i, glm::vec3(values[0] * 200.0f - 100.0f, values[1] * 200.0f - 100.0f, values[2] * 40.0f - 20.0f), 0.1f + values[3] * 2.0f);
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(1.0f, 0.3f, 2.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+
+	proj[1][1] *= -1;
+
+	culler.SetFrustum(proj * view);
+
+	std::vector<uint32_t> expected;
+	CullPath paths[CULL_PATH_COUNT] = { CULL_SCALAR, CULL_SSE, CULL_AVX2 };
+
+	for (CullPath cullPath : paths)
+	{
+		if (!culler.SetPath(cullPath))
+		{
+			slog("%s culling not supported on this CPU", PathName(cullPath));
+			continue;
+		}
+
+		double bestMs = 0.0;
+
+		for (uint32_t repeat = 0; repeat < BENCHMARK_REPEATS; ++repeat)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			culler.Cull();
+
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			bestMs = repeat ? std::min(bestMs, ms) : ms;
+		}
+
+		if (cullPath == CULL_SCALAR)
+		{
+			expected.assign(culler.GetVisible(), culler.GetVisible() + culler.GetVisibleCount());
+		}
+		else if (culler.GetVisibleCount() != expected.size() || memcmp(culler.GetVisible(), expected.data(), expected.size() * sizeof(uint32_t)) != 0)
+		{
+			slog("%s culling disagrees with scalar culling, %u visible against %u", PathName(cullPath), culler.GetVisibleCount(), (uint32_t)expected.size());
+			succeeded = false;
+		}
+
+		slog("%s culling: %.3f ms for %u spheres, %u visible", PathName(cullPath), bestMs, sphereCount, culler.GetVisibleCount());
+	}
+
+	Job_System jobSystem;
+
+	jobSystem.Job_SystemInit();
+	culler.SetPath(BestPath());
+
+	double parallelMs = 0.0;
+
+	for (uint32_t repeat = 0; repeat < BENCHMARK_REPEATS; ++repeat)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		culler.Cull(&jobSystem);
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		parallelMs = repeat ? std::min(parallelMs, ms) : ms;
+	}
+
+	if (culler.GetVisibleCount() != expected.size() || memcmp(culler.GetVisible(), expected.data(), expected.size() * sizeof(uint32_t)) != 0)
+	{
+		slog("culling on the job system disagrees with scalar culling");
+		succeeded = false;
+	}
+
+	slog("%s culling on %u threads: %.3f ms", PathName(culler.GetPath()), jobSystem.GetWorkerCount() + 1, parallelMs);
+
+	return succeeded;
+}
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include <math.h>
+#include <algorithm>
+
+#include "Game_Loop.h"
+#include "simple_logger.h"
+#include "Profiler.h"
+
+const static float MODEL_DEGREES_PER_SECOND = 90.0f;
+
+Game_Loop::Game_Loop()
+{
+	jobSystem = NULL;
+	tickRate = GAME_DEFAULT_TICK_RATE;
+	tickSeconds = 1.0 / tickRate;
+	maxTicksPerFrame = 5;
+
+	previous = 0;
+	current = 1;
+	next = 2;
+
+	started = false;
+	accumulator = 0.0;
+
+	ticks = 0;
+	ticksDropped = 0;
+
+	entities = NULL;
+
+	for (Game_State &state : states)
+	{
+		state.tick = 0;
+		state.modelAngle = 0.0f;
+	}
+
+	rendered.tick = 0;
+	rendered.modelAngle = 0.0f;
+}
+
+Game_Loop::~Game_Loop()
+{
+	//the tick job writes into this object
+	if (jobSystem)
+	{
+		jobSystem->Wait(&tickCounter);
+	}
+}
+
+void Game_Loop::Game_LoopInit(Job_System *jobSystem, Entity_Manager *entities, uint32_t tickRate, uint32_t maxTicksPerFrame)
+{
+	this->jobSystem = jobSystem;
+	this->entities = entities;
+	this->tickRate = std::max(tickRate, 1u);
+	this->maxTicksPerFrame = std::max(maxTicksPerFrame, 1u);
+
+	tickSeconds = 1.0 / this->tickRate;
+
+	//the entities as they start out are both ticks the first frames draw
+	ExtractInstances(states[current]);
+
+	states[previous] = states[current];
+	rendered = states[current];
+
+	StartTick();
+
+	slog("game loop ticking at %u Hz, catching up at most %u ticks a frame", this->tickRate, this->maxTicksPerFrame);
+}
+
+void Game_Loop::TickJob(void *data, uint32_t begin, uint32_t end)
+{
+	Game_Loop *loop = (Game_Loop*)data;
+
+	loop->Simulate(loop->states[loop->current], loop->states[loop->next]);
+}
+
+void Game_Loop::Simulate(const Game_State &from, Game_State &to)
+{
+	PROFILE_ZONE("Simulate");
+
+	to.tick = from.tick + 1;
+	to.modelAngle = fmodf(from.modelAngle + MODEL_DEGREES_PER_SECOND * (float)tickSeconds, 360.0f);
+
+	if (!entities)
+	{
+		return;
+	}
+
+	float seconds = (float)tickSeconds;
+
+	entities->ParallelForEach(jobSystem, ENTITY_MASK(EC_TRANSFORM) | ENTITY_MASK(EC_VELOCITY), 0, [seconds](Entity_Chunk &chunk)
+	{
+		Transform_Component *transforms = chunk.Get<Transform_Component>();
+		const Velocity_Component *velocities = chunk.Get<Velocity_Component>();
+
+		for (uint32_t i = 0; i < chunk.count; ++i)
+		{
+			transforms[i].position += velocities[i].linear * seconds;
+			transforms[i].yaw = fmodf(transforms[i].yaw + velocities[i].angular * seconds + 360.0f, 360.0f);
+		}
+	});
+
+	ExtractInstances(to);
+}
+
+void Game_Loop::ExtractInstances(Game_State &state)
+{
+	if (!entities)
+	{
+		state.instances.clear();
+		return;
+	}
+
+	uint32_t mask = ENTITY_MASK(EC_TRANSFORM) | ENTITY_MASK(EC_MESH);
+	Game_Instance *instances;
+
+	state.instances.resize(entities->Count(mask));
+	instances = state.instances.data();
+
+	//chunk.first places every chunk's entities in the same order each tick, so Interpolate can pair them up by position
+	entities->ParallelForEach(jobSystem, mask, 0, [instances](Entity_Chunk &chunk)
+	{
+		const Transform_Component *transforms = chunk.Get<Transform_Component>();
+		const Mesh_Component *meshes = chunk.Get<Mesh_Component>();
+
+		for (uint32_t i = 0; i < chunk.count; ++i)
+		{
+			Game_Instance &instance = instances[chunk.first + i];
+
+			instance.entity = chunk.entities[i];
+			instance.position = transforms[i].position;
+			instance.yaw = transforms[i].yaw;
+			instance.scale = transforms[i].scale;
+			instance.mesh = meshes[i].mesh;
+		}
+	});
+}
+
+void Game_Loop::StartTick()
+{
+	if (jobSystem)
+	{
+		jobSystem->Run(&Game_Loop::TickJob, this, &tickCounter);
+	}
+	else
+	{
+		Simulate(states[current], states[next]);
+	}
+}
+
+static float InterpolateAngle(float from, float to, float alpha)
+{
+	float delta = to - from;
+
+	//the short way round when the angle wraps past 360
+	if (delta < -180.0f)
+	{
+		delta += 360.0f;
+	}
+	else if (delta > 180.0f)
+	{
+		delta -= 360.0f;
+	}
+
+	return fmodf(from + delta * alpha + 360.0f, 360.0f);
+}
+
+void Game_Loop::Interpolate(const Game_State &from, const Game_State &to, float alpha, Game_State &result)
+{
+	result.tick = to.tick;
+	result.modelAngle = InterpolateAngle(from.modelAngle, to.modelAngle, alpha);
+	result.instances.resize(to.instances.size());
+
+	for (size_t i = 0; i < to.instances.size(); ++i)
+	{
+		const Game_Instance &next = to.instances[i];
+		Game_Instance &instance = result.instances[i];
+
+		instance = next;
+
+		//an entity spawned, destroyed or moved archetype this tick shifts the order, those snap to the new tick
+		if (i < from.instances.size() && from.instances[i].entity == next.entity)
+		{
+			const Game_Instance &last = from.instances[i];
+
+			instance.position = last.position + (next.position - last.position) * alpha;
+			instance.yaw = InterpolateAngle(last.yaw, next.yaw, alpha);
+			instance.scale = last.scale + (next.scale - last.scale) * alpha;
+		}
+	}
+}
+
+const Game_State* Game_Loop::Advance()
+{
+	PROFILE_ZONE("GameLoopAdvance");
+
+	auto now = std::chrono::steady_clock::now();
+	double frameSeconds = started ? std::chrono::duration<double>(now - lastTime).count() : 0.0;
+
+	lastTime = now;
+	started = true;
+
+	//spiral of death clamp, a stall such as a breakpoint or a window drag is dropped rather than simulated
+	double maxSeconds = maxTicksPerFrame * tickSeconds;
+
+	if (frameSeconds > maxSeconds)
+	{
+		uint64_t dropped = (uint64_t)((frameSeconds - maxSeconds) / tickSeconds);
+
+		if (dropped)
+		{
+			slog("frame took %.1f ms, dropped %llu ticks", frameSeconds * 1000.0, (unsigned long long)dropped);
+		}
+
+		ticksDropped += dropped;
+		frameSeconds = maxSeconds;
+	}
+
+	accumulator += frameSeconds;
+
+	while (accumulator >= tickSeconds)
+	{
+		if (jobSystem)
+		{
+			jobSystem->Wait(&tickCounter);
+		}
+
+		uint32_t oldest = previous;
+
+		previous = current;
+		current = next;
+		next = oldest;
+
+		++ticks;
+		accumulator -= tickSeconds;
+
+		StartTick();
+	}
+
+	Interpolate(states[previous], states[current], GetAlpha(), rendered);
+
+	return &rendered;
+}
\ No newline at end of file
@@ -0,0 +1,824 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include "Job_System.h"
+#include "simple_logger.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//failed searches a worker yields through before it sleeps
+const static uint32_t WORKER_SPIN_COUNT = 64;
+
+//a sleeping worker looks for work this often even without a wake up
+const static std::chrono::milliseconds WORKER_SLEEP_TIMEOUT = std::chrono::milliseconds(2);
+
+const static uint32_t PARALLEL_FOR_CHUNKS_PER_THREAD = 8;
+
+const static uint32_t BENCHMARK_SPAWN_JOBS = 1 << 20;
+const static uint32_t BENCHMARK_STEAL_ROUNDS = 256;
+const static uint32_t BENCHMARK_ELEMENTS = 1 << 22;
+const static uint32_t BENCHMARK_REPEATS = 5;
+
+static thread_local Job_System *currentSystem = NULL;
+static thread_local uint32_t currentWorker = 0;
+static thread_local uint32_t victimSeed = 0;
+
+struct ParallelRange
+{
+	Job_System				*system;
+	JobFunction				body;
+	void					*data;
+	uint32_t				grain;
+	Job_Counter				*counter;
+};
+
+static uint32_t NextVictim()
+{
+	if (!victimSeed)
+	{
+		victimSeed = (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+	}
+
+	victimSeed ^= victimSeed << 13;
+	victimSeed ^= victimSeed >> 17;
+	victimSeed ^= victimSeed << 5;
+
+	return victimSeed;
+}
+
+Job_Counter::Job_Counter()
+{
+	pending.store(0, std::memory_order_relaxed);
+}
+
+Job_Deque::Job_Deque(uint32_t capacity)
+{
+	uint32_t size = 1;
+
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	jobs.resize(size);
+	mask = size - 1;
+
+	top.store(0, std::memory_order_relaxed);
+	bottom.store(0, std::memory_order_relaxed);
+}
+
+bool Job_Deque::Push(const Job &job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+
+	if (b - t > mask)
+	{
+		return false;
+	}
+
+	jobs[b & mask] = job;
+
+	bottom.store(b + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool Job_Deque::Pop(Job &job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+
+	//the store has to be visible before top is read, or a thief and the owner could both take the last job
+	bottom.store(b, std::memory_order_seq_cst);
+
+	int64_t t = top.load(std::memory_order_seq_cst);
+
+	if (t > b)
+	{
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	job = jobs[b & mask];
+
+	if (t == b)
+	{
+		//last job, race the thieves for it through top
+		bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+
+		bottom.store(b + 1, std::memory_order_relaxed);
+
+		return won;
+	}
+
+	return true;
+}
+
+bool Job_Deque::Steal(Job &job)
+{
+	int64_t t = top.load(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_seq_cst);
+
+	if (t >= b)
+	{
+		return false;
+	}
+
+	job = jobs[t & mask];
+
+	return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+Job_System::Job_System()
+{
+	injectedCount.store(0, std::memory_order_relaxed);
+	sleepers.store(0, std::memory_order_relaxed);
+	stopWorkers.store(false, std::memory_order_relaxed);
+	jobsRun.store(0, std::memory_order_relaxed);
+	steals.store(0, std::memory_order_relaxed);
+}
+
+Job_System::~Job_System()
+{
+	stopWorkers.store(true, std::memory_order_seq_cst);
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		workReady.notify_all();
+	}
+
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+
+	for (Job_Deque *deque : deques)
+	{
+		delete deque;
+	}
+
+	if (currentSystem == this)
+	{
+		currentSystem = NULL;
+	}
+}
+
+void Job_System::Job_SystemInit(uint32_t workerCount)
+{
+	uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+	if (workerCount == 0)
+	{
+		workerCount = cores > 2 ? cores - 1 : 1;
+	}
+
+	currentSystem = this;
+	currentWorker = 0;
+
+	for (uint32_t i = 0; i <= workerCount; ++i)
+	{
+		deques.push_back(new Job_Deque());
+	}
+
+	for (uint32_t i = 1; i <= workerCount; ++i)
+	{
+		workers.push_back(std::thread(&Job_System::WorkerLoop, this, i));
+
+		//workers start at core 1, leaving core 0 to the main thread until they outnumber the cores
+		//the main thread itself stays unpinned, on linux threads it starts later would inherit its mask
+		PinThread(workers.back(), i % cores);
+	}
+
+	slog("job system started %u workers on %u cores", workerCount, cores);
+}
+
+void Job_System::PinThread(std::thread &thread, uint32_t core)
+{
+#ifdef _WIN32
+	if (core < sizeof(DWORD_PTR) * 8)
+	{
+		SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)1 << core);
+	}
+#elif defined(__linux__)
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(core, &cpus);
+
+	pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#endif
+}
+
+void Job_System::WorkerLoop(uint32_t index)
+{
+	currentSystem = this;
+	currentWorker = index;
+
+	uint32_t idle = 0;
+	Job job;
+
+	while (!stopWorkers.load(std::memory_order_acquire))
+	{
+		if (FindJob(index, job))
+		{
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < WORKER_SPIN_COUNT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+
+		//pairs with the fence in WakeWorker, either the pusher sees this sleeper or HasWork sees its job
+		sleepers.fetch_add(1, std::memory_order_seq_cst);
+
+		if (!HasWork() && !stopWorkers.load(std::memory_order_acquire))
+		{
+			workReady.wait_for(lock, WORKER_SLEEP_TIMEOUT);
+		}
+
+		sleepers.fetch_sub(1, std::memory_order_relaxed);
+		idle = 0;
+	}
+}
+
+bool Job_System::FindJob(uint32_t index, Job &job)
+{
+	if (deques[index]->Pop(job))
+	{
+		return true;
+	}
+
+	if (injectedCount.load(std::memory_order_acquire))
+	{
+		std::lock_guard<std::mutex> lock(injectMutex);
+
+		if (!injected.empty())
+		{
+			job = injected.front();
+			injected.pop_front();
+			injectedCount.fetch_sub(1, std::memory_order_relaxed);
+
+			return true;
+		}
+	}
+
+	uint32_t dequeCount = (uint32_t)deques.size();
+	uint32_t start = NextVictim() % dequeCount;
+
+	for (uint32_t i = 0; i < dequeCount; ++i)
+	{
+		uint32_t victim = (start + i) % dequeCount;
+
+		if (victim != index && deques[victim]->Steal(job))
+		{
+			steals.fetch_add(1, std::memory_order_relaxed);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Job_System::HasWork()
+{
+	if (injectedCount.load(std::memory_order_seq_cst))
+	{
+		return true;
+	}
+
+	for (Job_Deque *deque : deques)
+	{
+		if (!deque->IsEmpty())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Job_System::Execute(const Job &job)
+{
+	job.function(job.data, job.begin, job.end);
+
+	jobsRun.fetch_add(1, std::memory_order_relaxed);
+
+	if (job.counter)
+	{
+		Finish(job.counter);
+	}
+}
+
+void Job_System::Finish(Job_Counter *counter)
+{
+	uint32_t value = counter->pending.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		if (value > 1)
+		{
+			if (counter->pending.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+			{
+				return;
+			}
+
+			continue;
+		}
+
+		//the last job reaches zero under the lock so RunAfter can't queue a continuation that is never started,
+		//and Wait takes the lock before returning so the counter outlives this
+		std::vector<Job> ready;
+
+		{
+			std::lock_guard<std::mutex> lock(counter->continuationMutex);
+
+			//a job added since the load keeps the counter open
+			if (!counter->pending.compare_exchange_strong(value, 0, std::memory_order_acq_rel, std::memory_order_relaxed))
+			{
+				continue;
+			}
+
+			ready.swap(counter->continuations);
+		}
+
+		for (const Job &job : ready)
+		{
+			Push(job);
+		}
+
+		return;
+	}
+}
+
+void Job_System::Push(const Job &job)
+{
+	if (currentSystem == this)
+	{
+		if (!deques[currentWorker]->Push(job))
+		{
+			//deque full, running it here keeps the producer from racing further ahead
+			Execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(injectMutex);
+
+		injected.push_back(job);
+		injectedCount.fetch_add(1, std::memory_order_release);
+	}
+
+	WakeWorker();
+}
+
+void Job_System::WakeWorker()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (sleepers.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		workReady.notify_one();
+	}
+}
+
+void Job_System::Run(JobFunction function, void *data, Job_Counter *counter, uint32_t begin, uint32_t end)
+{
+	Job job = { function, data, counter, begin, end };
+
+	if (counter)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Push(job);
+}
+
+void Job_System::RunAfter(Job_Counter *dependency, JobFunction function, void *data, Job_Counter *counter, uint32_t begin, uint32_t end)
+{
+	Job job = { function, data, counter, begin, end };
+
+	//counted now, so waiting on counter also covers the time spent waiting on dependency
+	if (counter)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(dependency->continuationMutex);
+
+		if (dependency->pending.load(std::memory_order_acquire))
+		{
+			dependency->continuations.push_back(job);
+			return;
+		}
+	}
+
+	Push(job);
+}
+
+void Job_System::RunOnMainThread(JobFunction function, void *data, Job_Counter *counter)
+{
+	Job job = { function, data, counter, 0, 0 };
+
+	if (counter)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(mainMutex);
+
+	mainJobs.push_back(job);
+}
+
+bool Job_System::RunMainThreadJob()
+{
+	Job job;
+
+	{
+		std::lock_guard<std::mutex> lock(mainMutex);
+
+		if (mainJobs.empty())
+		{
+			return false;
+		}
+
+		job = mainJobs.front();
+		mainJobs.pop_front();
+	}
+
+	Execute(job);
+
+	return true;
+}
+
+void Job_System::RunMainThreadJobs()
+{
+	size_t queued;
+
+	{
+		std::lock_guard<std::mutex> lock(mainMutex);
+		queued = mainJobs.size();
+	}
+
+	//only the jobs queued so far, ones they queue in turn wait for the next call
+	for (size_t i = 0; i < queued && RunMainThreadJob(); ++i)
+	{
+	}
+}
+
+void Job_System::Wait(Job_Counter *counter)
+{
+	bool pooled = currentSystem == this;
+	bool mainThread = pooled && currentWorker == 0;
+	Job job;
+
+	while (!counter->IsDone())
+	{
+		if (mainThread && RunMainThreadJob())
+		{
+			continue;
+		}
+
+		if (pooled && FindJob(currentWorker, job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::this_thread::yield();
+	}
+
+	std::lock_guard<std::mutex> lock(counter->continuationMutex);
+}
+
+void Job_System::SplitRange(void *data, uint32_t begin, uint32_t end)
+{
+	ParallelRange *range = (ParallelRange*)data;
+
+	//hand the upper half off and keep splitting the lower, thieves take the oldest and so the largest ranges
+	while (end - begin > range->grain)
+	{
+		uint32_t middle = begin + (end - begin) / 2;
+
+		range->system->Run(&Job_System::SplitRange, data, range->counter, middle, end);
+
+		end = middle;
+	}
+
+	range->body(range->data, begin, end);
+}
+
+void Job_System::ParallelFor(uint32_t count, uint32_t grain, JobFunction body, void *data)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (grain == 0)
+	{
+		grain = std::max(count / ((GetWorkerCount() + 1) * PARALLEL_FOR_CHUNKS_PER_THREAD), 1u);
+	}
+
+	if (count <= grain)
+	{
+		body(data, 0, count);
+		return;
+	}
+
+	Job_Counter counter;
+	ParallelRange range = { this, body, data, grain, &counter };
+
+	//the calling thread takes the first split itself, counted like any other chunk
+	counter.pending.store(1, std::memory_order_relaxed);
+
+	SplitRange(&range, 0, count);
+	Finish(&counter);
+
+	Wait(&counter);
+}
+
+static void EmptyJob(void *data, uint32_t begin, uint32_t end)
+{
+}
+
+static uint32_t BenchmarkHash(uint32_t value)
+{
+	for (uint32_t i = 0; i < 64; ++i)
+	{
+		value ^= value << 13;
+		value ^= value >> 17;
+		value ^= value << 5;
+		value += 0x9e3779b9;
+	}
+
+	return value;
+}
+
+static void BenchmarkChunk(void *data, uint32_t begin, uint32_t end)
+{
+	uint32_t *values = (uint32_t*)data;
+
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		values[i] = BenchmarkHash(i);
+	}
+}
+
+bool Job_System::Benchmark(uint32_t maxThreads)
+{
+	uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+	bool succeeded = true;
+
+	if (maxThreads == 0)
+	{
+		maxThreads = std::max(cores, 32u);
+	}
+
+	//spawn cost, the main thread pushes every job and pops whatever the one worker hasn't stolen
+	{
+		Job_System system;
+		Job_Counter counter;
+
+		system.Job_SystemInit(1);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t i = 0; i < BENCHMARK_SPAWN_JOBS; ++i)
+		{
+			system.Run(&EmptyJob, NULL, &counter);
+
+			if ((i & 1023) == 1023)
+			{
+				system.Wait(&counter);
+			}
+		}
+
+		system.Wait(&counter);
+
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+		slog("job spawn: %.1f ns per job over %u jobs, %llu stolen", ns / BENCHMARK_SPAWN_JOBS, BENCHMARK_SPAWN_JOBS, (unsigned long long)system.GetSteals());
+
+		if (system.GetJobsRun() != BENCHMARK_SPAWN_JOBS)
+		{
+			slog("job spawn ran %llu of %u jobs", (unsigned long long)system.GetJobsRun(), BENCHMARK_SPAWN_JOBS);
+			succeeded = false;
+		}
+	}
+
+	//deque cost on its own, owner push and pop against a thief draining a full deque from another thread
+	{
+		Job_Deque deque;
+		Job job = { &EmptyJob, NULL, NULL, 0, 0 };
+		uint32_t capacity = 4096;
+		uint64_t popped = 0;
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t round = 0; round < BENCHMARK_STEAL_ROUNDS; ++round)
+		{
+			for (uint32_t i = 0; i < capacity; ++i)
+			{
+				deque.Push(job);
+			}
+
+			while (deque.Pop(job))
+			{
+				++popped;
+			}
+		}
+
+		double pushPopNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+		double stealNs = 0.0;
+		uint64_t stolen = 0;
+
+		for (uint32_t round = 0; round < BENCHMARK_STEAL_ROUNDS; ++round)
+		{
+			for (uint32_t i = 0; i < capacity; ++i)
+			{
+				deque.Push(job);
+			}
+
+			std::thread thief([&]()
+			{
+				Job stolenJob;
+				auto stealStart = std::chrono::high_resolution_clock::now();
+
+				while (deque.Steal(stolenJob))
+				{
+					++stolen;
+				}
+
+				stealNs += std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - stealStart).count();
+			});
+
+			thief.join();
+		}
+
+		slog("job deque: %.1f ns per owner push and pop, %.1f ns per steal",
+			pushPopNs / ((double)capacity * BENCHMARK_STEAL_ROUNDS), stolen ? stealNs / stolen : 0.0);
+
+		if (popped != (uint64_t)capacity * BENCHMARK_STEAL_ROUNDS || stolen != (uint64_t)capacity * BENCHMARK_STEAL_ROUNDS)
+		{
+			slog("job deque popped %llu and stole %llu of %llu pushed jobs", (unsigned long long)popped, (unsigned long long)stolen,
+				(unsigned long long)capacity * BENCHMARK_STEAL_ROUNDS);
+			succeeded = false;
+		}
+	}
+
+	//the owner pops against a thief stealing the same deque, every job has to come out exactly once
+	{
+		Job_Deque deque;
+		uint32_t capacity = 4096;
+		std::vector<uint8_t> ownerTaken(capacity);
+		std::vector<uint8_t> thiefTaken(capacity);
+		uint32_t lost = 0, duplicated = 0;
+
+		for (uint32_t round = 0; round < BENCHMARK_STEAL_ROUNDS; ++round)
+		{
+			std::atomic<bool> go(false);
+
+			memset(ownerTaken.data(), 0, capacity);
+			memset(thiefTaken.data(), 0, capacity);
+
+			for (uint32_t i = 0; i < capacity; ++i)
+			{
+				Job job = { &EmptyJob, NULL, NULL, i, i + 1 };
+
+				deque.Push(job);
+			}
+
+			std::thread thief([&]()
+			{
+				Job stolenJob;
+
+				while (!go.load(std::memory_order_acquire))
+				{
+				}
+
+				while (!deque.IsEmpty())
+				{
+					if (deque.Steal(stolenJob))
+					{
+						++thiefTaken[stolenJob.begin];
+					}
+				}
+			});
+
+			Job job;
+
+			go.store(true, std::memory_order_release);
+
+			while (deque.Pop(job))
+			{
+				++ownerTaken[job.begin];
+			}
+
+			thief.join();
+
+			for (uint32_t i = 0; i < capacity; ++i)
+			{
+				uint32_t taken = ownerTaken[i] + thiefTaken[i];
+
+				lost += taken == 0;
+				duplicated += taken > 1;
+			}
+		}
+
+		if (lost || duplicated)
+		{
+			slog("job deque race: %u jobs lost and %u taken twice over %u rounds", lost, duplicated, BENCHMARK_STEAL_ROUNDS);
+			succeeded = false;
+		}
+		else
+		{
+			slog("job deque race: %u rounds of %u jobs each taken exactly once", BENCHMARK_STEAL_ROUNDS, capacity);
+		}
+	}
+
+	//parallel for scaling, one thread is the plain loop every other count is measured against
+	std::vector<uint32_t> expected(BENCHMARK_ELEMENTS);
+	std::vector<uint32_t> values(BENCHMARK_ELEMENTS);
+	double singleMs = 0.0;
+
+	//called through a pointer like the jobs are, so the plain loop isn't specialised for its constant bounds
+	JobFunction volatile serialBody = &BenchmarkChunk;
+
+	for (uint32_t repeat = 0; repeat < BENCHMARK_REPEATS; ++repeat)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		serialBody(expected.data(), 0, BENCHMARK_ELEMENTS);
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		singleMs = repeat ? std::min(singleMs, ms) : ms;
+	}
+
+	slog("parallel for: 1 thread %.2f ms", singleMs);
+
+	std::vector<uint32_t> threadCounts;
+
+	for (uint32_t threads = 2; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+
+	if (maxThreads > 1)
+	{
+		threadCounts.push_back(maxThreads);
+	}
+
+	for (uint32_t threads : threadCounts)
+	{
+		Job_System system;
+		double bestMs = 0.0;
+
+		system.Job_SystemInit(threads - 1);
+
+		for (uint32_t repeat = 0; repeat < BENCHMARK_REPEATS; ++repeat)
+		{
+			memset(values.data(), 0, values.size() * sizeof(uint32_t));
+
+			auto start = std::chrono::high_resolution_clock::now();
+
+			system.ParallelFor(BENCHMARK_ELEMENTS, 0, &BenchmarkChunk, values.data());
+
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			bestMs = repeat ? std::min(bestMs, ms) : ms;
+
+			if (memcmp(values.data(), expected.data(), values.size() * sizeof(uint32_t)) != 0)
+			{
+				slog("parallel for with %u threads skipped or repeated elements", threads);
+				succeeded = false;
+			}
+		}
+
+		slog("parallel for: %u threads %.2f ms, %.2fx one thread, %llu jobs, %llu stolen%s",
+			threads, bestMs, bestMs > 0.0 ? singleMs / bestMs : 0.0, (unsigned long long)system.GetJobsRun(),
+			(unsigned long long)system.GetSteals(), threads > cores ? ", more threads than cores" : "");
+	}
+
+	return succeeded;
+}
\ No newline at end of file
@@ -0,0 +1,1499 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Level_Compiler.h"
+#include "Level_Map.h"
+#include "simple_logger.h"
+
+//map units, points closer than this to a line are on it
+const static double LEVEL_EPSILON = 1e-3;
+
+//map units per texture repeat, Doom's flat size
+const static float LEVEL_TEXTURE_UNITS = 64.0f;
+
+//room left around the map by the polygon every leaf is cut from
+const static double LEVEL_BOUNDS_MARGIN = 64.0;
+
+//splitters tried per node, big nodes try an even spread of their segs rather than every one
+const static uint32_t LEVEL_SPLITTER_CANDIDATES = 128;
+
+//a split seg costs this many segs of imbalance when picking a splitter
+const static int32_t LEVEL_SPLIT_COST = 8;
+
+const static float ROOM_SIZE = 256.0f;
+const static float ROOM_WALL = 32.0f;
+const static float ROOM_DOOR = 64.0f;
+
+const static uint32_t BENCHMARK_CAMERAS_PER_ROOM = 4;
+const static uint32_t BENCHMARK_SIGHT_LINES = 20000;
+
+struct Compile_Point
+{
+	double			x;
+	double			y;
+};
+
+static Compile_Point MakePoint(double x, double y)
+{
+	Compile_Point point = { x, y };
+
+	return point;
+}
+
+static Compile_Point Lerp(const Compile_Point &a, const Compile_Point &b, double t)
+{
+	return MakePoint(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
+}
+
+static double Distance(const Compile_Point &a, const Compile_Point &b)
+{
+	return sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+}
+
+/**
+ * @brief points with dot(normal, point) > distance are in front
+ */
+struct Compile_Plane
+{
+	Compile_Point	normal;
+	double			distance;
+};
+
+static double Side(const Compile_Plane &plane, const Compile_Point &point)
+{
+	return plane.normal.x * point.x + plane.normal.y * point.y - plane.distance;
+}
+
+static Compile_Plane Flip(const Compile_Plane &plane)
+{
+	Compile_Plane flipped = { MakePoint(-plane.normal.x, -plane.normal.y), -plane.distance };
+
+	return flipped;
+}
+
+/**
+ * @brief the line through a and b with its front on the right walking from a to b, false if they are the same point
+ */
+static bool PlaneThrough(const Compile_Point &a, const Compile_Point &b, Compile_Plane &plane)
+{
+	double length = Distance(a, b);
+
+	if (length < LEVEL_EPSILON)
+	{
+		return false;
+	}
+
+	plane.normal = MakePoint((b.y - a.y) / length, -(b.x - a.x) / length);
+	plane.distance = plane.normal.x * a.x + plane.normal.y * a.y;
+
+	return true;
+}
+
+/**
+ * @brief one side of a line, or the part of it left after splits
+ * @note plane indexes the shared planes, flipped when this side faces the other way
+ */
+struct Compile_Seg
+{
+	Compile_Point	points[2];
+	uint32_t		line;
+	uint32_t		plane;
+	bool			flipped;
+	int32_t			sector;
+	int32_t			backSector;
+	bool			backSide;
+};
+
+/**
+ * @brief counter clockwise, edge i runs from point i to the next and lies on planes[i], -1 for the starting bounds
+ */
+struct Compile_Polygon
+{
+	std::vector<Compile_Point>	points;
+	std::vector<int32_t>		planes;
+};
+
+struct Compile_Leaf
+{
+	Compile_Polygon				polygon;
+	std::vector<Compile_Seg>	segs;
+	int32_t						sector;
+};
+
+/**
+ * @brief an opening from one leaf into another, plane faces into the leaf it leads to
+ */
+struct Compile_Portal
+{
+	Compile_Point	points[2];
+	Compile_Plane	plane;
+	uint32_t		from;
+	uint32_t		leaf;
+};
+
+/**
+ * @brief a portal segment as it is narrowed during the flow
+ */
+struct Compile_Winding
+{
+	Compile_Point	points[2];
+};
+
+struct Compile_State
+{
+	const Level_Source				*source;
+
+	//one per distinct line on the map, collinear walls share theirs
+	std::vector<Compile_Plane>		planes;
+
+	std::vector<Level_Node>			nodes;
+	std::vector<Compile_Leaf>		leaves;
+	std::vector<Level_Leaf>			levelLeaves;
+
+	std::vector<Compile_Portal>		portals;
+	std::vector<std::vector<uint32_t>>	leafPortals;
+
+	uint32_t						rowSize;
+	std::vector<uint8_t>			mightSee;
+	std::vector<uint8_t>			visible;
+	std::vector<uint8_t>			onStack;
+	uint64_t						flowSteps;
+
+	std::vector<Vertex>				vertices;
+	std::vector<uint32_t>			indices;
+};
+
+static Compile_Plane SegPlane(const Compile_State &state, const Compile_Seg &seg)
+{
+	return seg.flipped ? Flip(state.planes[seg.plane]) : state.planes[seg.plane];
+}
+
+/**
+ * @brief the shared plane a line lies on, added if no earlier line is collinear with it
+ */
+static uint32_t FindPlane(Compile_State &state, const Compile_Plane &plane, bool &flipped)
+{
+	for (uint32_t i = 0; i < (uint32_t)state.planes.size(); ++i)
+	{
+		const Compile_Plane &other = state.planes[i];
+
+		if (fabs(other.normal.x - plane.normal.x) < 1e-6 && fabs(other.normal.y - plane.normal.y) < 1e-6 && fabs(other.distance - plane.distance) < LEVEL_EPSILON)
+		{
+			flipped = false;
+			return i;
+		}
+
+		if (fabs(other.normal.x + plane.normal.x) < 1e-6 && fabs(other.normal.y + plane.normal.y) < 1e-6 && fabs(other.distance + plane.distance) < LEVEL_EPSILON)
+		{
+			flipped = true;
+			return i;
+		}
+	}
+
+	flipped = false;
+	state.planes.push_back(plane);
+
+	return (uint32_t)state.planes.size() - 1;
+}
+
+/**
+ * @brief keeps the part of polygon in front of plane, the edge the cut leaves is tagged with planeIndex
+ */
+static void ClipPolygon(const Compile_Polygon &polygon, const Compile_Plane &plane, int32_t planeIndex, Compile_Polygon &result)
+{
+	Compile_Polygon clipped;
+	size_t count = polygon.points.size();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Compile_Point &a = polygon.points[i];
+		const Compile_Point &b = polygon.points[(i + 1) % count];
+		double sideA = Side(plane, a);
+		double sideB = Side(plane, b);
+
+		if (sideA >= -LEVEL_EPSILON)
+		{
+			clipped.points.push_back(a);
+			clipped.planes.push_back(polygon.planes[i]);
+
+			//leaving, the boundary runs along the cut until the polygon comes back in
+			if (sideB < -LEVEL_EPSILON)
+			{
+				clipped.points.push_back(Lerp(a, b, sideA / (sideA - sideB)));
+				clipped.planes.push_back(planeIndex);
+			}
+		}
+		else if (sideB >= -LEVEL_EPSILON)
+		{
+			clipped.points.push_back(Lerp(a, b, sideA / (sideA - sideB)));
+			clipped.planes.push_back(polygon.planes[i]);
+		}
+	}
+
+	//a vertex on the plane comes out twice, the zero length edge between them goes
+	result.points.clear();
+	result.planes.clear();
+
+	for (size_t i = 0; i < clipped.points.size(); ++i)
+	{
+		if (!result.points.empty() && Distance(result.points.back(), clipped.points[i]) < LEVEL_EPSILON)
+		{
+			result.planes.back() = clipped.planes[i];
+			continue;
+		}
+
+		result.points.push_back(clipped.points[i]);
+		result.planes.push_back(clipped.planes[i]);
+	}
+
+	while (result.points.size() > 1 && Distance(result.points.back(), result.points.front()) < LEVEL_EPSILON)
+	{
+		result.points.pop_back();
+		result.planes.pop_back();
+	}
+
+	if (result.points.size() < 3)
+	{
+		result.points.clear();
+		result.planes.clear();
+	}
+}
+
+
+enum SegSide
+{
+	SEG_FRONT,
+	SEG_BACK,
+	SEG_SPLIT
+};
+
+static SegSide ClassifySeg(const Compile_Seg &splitter, const Compile_Plane &plane, const Compile_Seg &seg, double sides[2])
+{
+	sides[0] = Side(plane, seg.points[0]);
+	sides[1] = Side(plane, seg.points[1]);
+
+	//collinear, the way it faces decides
+	if (seg.plane == splitter.plane)
+	{
+		return seg.flipped == splitter.flipped ? SEG_FRONT : SEG_BACK;
+	}
+
+	if (sides[0] >= -LEVEL_EPSILON && sides[1] >= -LEVEL_EPSILON)
+	{
+		return SEG_FRONT;
+	}
+
+	if (sides[0] <= LEVEL_EPSILON && sides[1] <= LEVEL_EPSILON)
+	{
+		return SEG_BACK;
+	}
+
+	return SEG_SPLIT;
+}
+
+/**
+ * @brief the seg whose line splits the fewest segs into the most even halves, -1 if none has a seg behind it
+ * and the segs already bound a convex leaf
+ */
+static int32_t ChooseSplitter(const Compile_State &state, const std::vector<Compile_Seg> &segs)
+{
+	uint32_t stride = std::max((uint32_t)segs.size() / LEVEL_SPLITTER_CANDIDATES, 1u);
+
+	while (true)
+	{
+		int32_t best = -1;
+		int32_t bestCost = 0;
+
+		for (uint32_t candidate = 0; candidate < (uint32_t)segs.size(); candidate += stride)
+		{
+			Compile_Plane plane = SegPlane(state, segs[candidate]);
+			int32_t front = 0, back = 0, splits = 0;
+
+			for (const Compile_Seg &seg : segs)
+			{
+				double sides[2];
+
+				switch (ClassifySeg(segs[candidate], plane, seg, sides))
+				{
+				case SEG_FRONT:
+					++front;
+					break;
+				case SEG_BACK:
+					++back;
+					break;
+				default:
+					++splits;
+					break;
+				}
+			}
+
+			if (back + splits == 0)
+			{
+				continue;
+			}
+
+			int32_t cost = splits * LEVEL_SPLIT_COST + abs(front - back);
+
+			if (best < 0 || cost < bestCost)
+			{
+				best = (int32_t)candidate;
+				bestCost = cost;
+			}
+		}
+
+		//the sampled segs might all face the rest while one that wasn't tried doesn't, so try them all before calling it convex
+		if (best >= 0 || stride == 1)
+		{
+			return best;
+		}
+
+		stride = 1;
+	}
+}
+
+static void ChildBounds(const Compile_State &state, uint32_t child, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+	if (child & LEVEL_CHILD_LEAF)
+	{
+		boundsMin = state.levelLeaves[child & ~LEVEL_CHILD_LEAF].boundsMin;
+		boundsMax = state.levelLeaves[child & ~LEVEL_CHILD_LEAF].boundsMax;
+		return;
+	}
+
+	boundsMin = state.nodes[child].boundsMin;
+	boundsMax = state.nodes[child].boundsMax;
+}
+
+static uint32_t BuildLeaf(Compile_State &state, const std::vector<Compile_Seg> &segs, const Compile_Polygon &region)
+{
+	Compile_Leaf leaf;
+	Level_Leaf levelLeaf = {};
+	Compile_Polygon clipped;
+
+	//the region runs on past the leaf's walls into the void behind them, each wall's line cuts that off
+	leaf.polygon = region;
+
+	for (const Compile_Seg &seg : segs)
+	{
+		ClipPolygon(leaf.polygon, SegPlane(state, seg), (int32_t)seg.plane, clipped);
+		leaf.polygon = clipped;
+	}
+
+	leaf.segs = segs;
+	leaf.sector = segs.empty() ? 0 : segs[0].sector;
+
+	const Level_Sector &sector = state.source->sectors[leaf.sector];
+	std::vector<Compile_Point> points = leaf.polygon.points;
+
+	if (points.empty())
+	{
+		for (const Compile_Seg &seg : segs)
+		{
+			points.push_back(seg.points[0]);
+			points.push_back(seg.points[1]);
+		}
+	}
+
+	levelLeaf.boundsMin = glm::vec3((float)points[0].x, (float)points[0].y, sector.floorHeight);
+	levelLeaf.boundsMax = glm::vec3((float)points[0].x, (float)points[0].y, sector.ceilingHeight);
+
+	for (const Compile_Point &point : points)
+	{
+		levelLeaf.boundsMin = glm::min(levelLeaf.boundsMin, glm::vec3((float)point.x, (float)point.y, sector.floorHeight));
+		levelLeaf.boundsMax = glm::max(levelLeaf.boundsMax, glm::vec3((float)point.x, (float)point.y, sector.ceilingHeight));
+	}
+
+	levelLeaf.floorHeight = sector.floorHeight;
+	levelLeaf.ceilingHeight = sector.ceilingHeight;
+
+	state.leaves.push_back(leaf);
+	state.levelLeaves.push_back(levelLeaf);
+
+	return (uint32_t)state.leaves.size() - 1;
+}
+
+/**
+ * @brief splits segs until every leaf is convex, leaves are numbered front first so a node's leaves are consecutive
+ * @return the node index, or the leaf index with LEVEL_CHILD_LEAF set
+ */
+static uint32_t BuildNode(Compile_State &state, std::vector<Compile_Seg> &segs, const Compile_Polygon &region)
+{
+	int32_t splitterIndex = ChooseSplitter(state, segs);
+
+	if (splitterIndex < 0)
+	{
+		return BuildLeaf(state, segs, region) | LEVEL_CHILD_LEAF;
+	}
+
+	Compile_Seg splitter = segs[splitterIndex];
+	Compile_Plane plane = SegPlane(state, splitter);
+	std::vector<Compile_Seg> front, back;
+
+	for (const Compile_Seg &seg : segs)
+	{
+		double sides[2];
+
+		switch (ClassifySeg(splitter, plane, seg, sides))
+		{
+		case SEG_FRONT:
+			front.push_back(seg);
+			break;
+		case SEG_BACK:
+			back.push_back(seg);
+			break;
+		default:
+		{
+			Compile_Point cut = Lerp(seg.points[0], seg.points[1], sides[0] / (sides[0] - sides[1]));
+			Compile_Seg first = seg;
+			Compile_Seg second = seg;
+
+			first.points[1] = cut;
+			second.points[0] = cut;
+
+			(sides[0] > 0.0 ? front : back).push_back(first);
+			(sides[0] > 0.0 ? back : front).push_back(second);
+			break;
+		}
+		}
+	}
+
+	segs.clear();
+	segs.shrink_to_fit();
+
+	Compile_Polygon frontRegion, backRegion;
+
+	ClipPolygon(region, plane, (int32_t)splitter.plane, frontRegion);
+	ClipPolygon(region, Flip(plane), (int32_t)splitter.plane, backRegion);
+
+	//the slot is taken before the children so the root is node 0 and every child comes after its parent
+	uint32_t nodeIndex = (uint32_t)state.nodes.size();
+	uint32_t firstLeaf = (uint32_t)state.leaves.size();
+
+	state.nodes.push_back(Level_Node());
+
+	uint32_t frontChild = BuildNode(state, front, frontRegion);
+	uint32_t backChild = BuildNode(state, back, backRegion);
+
+	glm::vec3 frontMin, frontMax, backMin, backMax;
+
+	ChildBounds(state, frontChild, frontMin, frontMax);
+	ChildBounds(state, backChild, backMin, backMax);
+
+	Level_Node &node = state.nodes[nodeIndex];
+
+	node.normal = glm::vec2((float)plane.normal.x, (float)plane.normal.y);
+	node.distance = (float)plane.distance;
+	node.children[0] = frontChild;
+	node.children[1] = backChild;
+	node.firstLeaf = firstLeaf;
+	node.leafCount = (uint32_t)state.leaves.size() - firstLeaf;
+	node.boundsMin = glm::min(frontMin, backMin);
+	node.boundsMax = glm::max(frontMax, backMax);
+
+	return nodeIndex;
+}
+
+static void AddPortal(Compile_State &state, const Compile_Plane &plane, const Compile_Point &a, const Compile_Point &b, uint32_t from, uint32_t leaf)
+{
+	Compile_Portal portal;
+
+	portal.points[0] = a;
+	portal.points[1] = b;
+	portal.plane = plane;
+	portal.from = from;
+	portal.leaf = leaf;
+
+	state.leafPortals[from].push_back((uint32_t)state.portals.size());
+	state.portals.push_back(portal);
+}
+
+struct Compile_Edge
+{
+	uint32_t		leaf;
+	double			start;
+	double			end;
+	bool			forward;
+};
+
+/**
+ * @brief a portal is wherever two leaves' edges overlap on the same line and no one sided wall covers the overlap
+ */
+static void BuildPortals(Compile_State &state)
+{
+	std::vector<std::vector<Compile_Edge>> planeEdges(state.planes.size());
+	std::vector<std::vector<std::pair<double, double>>> walls(state.planes.size());
+
+	state.leafPortals.assign(state.leaves.size(), std::vector<uint32_t>());
+
+	//distances along each plane run in the direction its normal turned a quarter counter clockwise points
+	for (uint32_t l = 0; l < (uint32_t)state.leaves.size(); ++l)
+	{
+		const Compile_Polygon &polygon = state.leaves[l].polygon;
+
+		for (size_t i = 0; i < polygon.points.size(); ++i)
+		{
+			if (polygon.planes[i] < 0)
+			{
+				continue;
+			}
+
+			const Compile_Plane &plane = state.planes[polygon.planes[i]];
+			const Compile_Point &a = polygon.points[i];
+			const Compile_Point &b = polygon.points[(i + 1) % polygon.points.size()];
+			double start = -plane.normal.y * a.x + plane.normal.x * a.y;
+			double end = -plane.normal.y * b.x + plane.normal.x * b.y;
+			Compile_Edge edge = { l, std::min(start, end), std::max(start, end), end > start };
+
+			planeEdges[polygon.planes[i]].push_back(edge);
+		}
+
+		for (const Compile_Seg &seg : state.leaves[l].segs)
+		{
+			if (seg.backSector >= 0)
+			{
+				continue;
+			}
+
+			const Compile_Plane &plane = state.planes[seg.plane];
+			double start = -plane.normal.y * seg.points[0].x + plane.normal.x * seg.points[0].y;
+			double end = -plane.normal.y * seg.points[1].x + plane.normal.x * seg.points[1].y;
+
+			walls[seg.plane].push_back(std::make_pair(std::min(start, end), std::max(start, end)));
+		}
+	}
+
+	for (uint32_t p = 0; p < (uint32_t)state.planes.size(); ++p)
+	{
+		const Compile_Plane &plane = state.planes[p];
+		const std::vector<Compile_Edge> &edges = planeEdges[p];
+
+		std::sort(walls[p].begin(), walls[p].end());
+
+		for (size_t i = 0; i < edges.size(); ++i)
+		{
+			//a counter clockwise leaf walking along the plane's direction has the front of the plane on its right
+			if (!edges[i].forward)
+			{
+				continue;
+			}
+
+			for (size_t j = 0; j < edges.size(); ++j)
+			{
+				if (edges[j].forward || edges[j].leaf == edges[i].leaf)
+				{
+					continue;
+				}
+
+				double low = std::max(edges[i].start, edges[j].start);
+				double high = std::min(edges[i].end, edges[j].end);
+
+				if (high - low < LEVEL_EPSILON)
+				{
+					continue;
+				}
+
+				std::vector<std::pair<double, double>> openings;
+				double cursor = low;
+
+				for (const std::pair<double, double> &wall : walls[p])
+				{
+					if (wall.second <= cursor)
+					{
+						continue;
+					}
+
+					if (wall.first >= high)
+					{
+						break;
+					}
+
+					if (wall.first > cursor + LEVEL_EPSILON)
+					{
+						openings.push_back(std::make_pair(cursor, wall.first));
+					}
+
+					cursor = std::max(cursor, wall.second);
+				}
+
+				if (high > cursor + LEVEL_EPSILON)
+				{
+					openings.push_back(std::make_pair(cursor, high));
+				}
+
+				for (const std::pair<double, double> &opening : openings)
+				{
+					Compile_Point origin = MakePoint(plane.normal.x * plane.distance, plane.normal.y * plane.distance);
+					Compile_Point a = MakePoint(origin.x - plane.normal.y * opening.first, origin.y + plane.normal.x * opening.first);
+					Compile_Point b = MakePoint(origin.x - plane.normal.y * opening.second, origin.y + plane.normal.x * opening.second);
+
+					AddPortal(state, plane, a, b, edges[i].leaf, edges[j].leaf);
+					AddPortal(state, Flip(plane), a, b, edges[j].leaf, edges[i].leaf);
+				}
+			}
+		}
+	}
+}
+
+static bool TestBit(const uint8_t *row, uint32_t bit)
+{
+	return (row[bit >> 3] & (1 << (bit & 7))) != 0;
+}
+
+static void SetBit(uint8_t *row, uint32_t bit)
+{
+	row[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+}
+
+/**
+ * @brief keeps the part of winding in front of plane, false if too little is left to see through
+ */
+static bool ClipWinding(Compile_Winding &winding, const Compile_Plane &plane)
+{
+	double sides[2] = { Side(plane, winding.points[0]), Side(plane, winding.points[1]) };
+
+	if (sides[0] < -LEVEL_EPSILON && sides[1] < -LEVEL_EPSILON)
+	{
+		return false;
+	}
+
+	if (sides[0] < -LEVEL_EPSILON)
+	{
+		winding.points[0] = Lerp(winding.points[0], winding.points[1], sides[0] / (sides[0] - sides[1]));
+	}
+	else if (sides[1] < -LEVEL_EPSILON)
+	{
+		winding.points[1] = Lerp(winding.points[0], winding.points[1], sides[0] / (sides[0] - sides[1]));
+	}
+
+	return Distance(winding.points[0], winding.points[1]) >= LEVEL_EPSILON;
+}
+
+/**
+ * @brief keeps the part of target a line through both source and pass can reach, bounded by the two lines crossing
+ * from an end of source to the opposite end of pass
+ */
+static bool ClipToAntiPenumbra(const Compile_Winding &source, const Compile_Winding &pass, Compile_Winding &target)
+{
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		for (uint32_t j = 0; j < 2; ++j)
+		{
+			Compile_Plane separator;
+
+			if (!PlaneThrough(source.points[i], pass.points[j], separator))
+			{
+				continue;
+			}
+
+			double sourceSide = Side(separator, source.points[1 - i]);
+			double passSide = Side(separator, pass.points[1 - j]);
+
+			//only a line with source and pass on opposite sides bounds what is seen through them
+			if (sourceSide < -LEVEL_EPSILON && passSide > LEVEL_EPSILON)
+			{
+				if (!ClipWinding(target, separator))
+				{
+					return false;
+				}
+			}
+			else if (sourceSide > LEVEL_EPSILON && passSide < -LEVEL_EPSILON)
+			{
+				if (!ClipWinding(target, Flip(separator)))
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief nothing passes through portal then next unless next reaches in front of portal and portal lies behind next
+ */
+static bool PortalMightSee(const Compile_Portal &portal, const Compile_Portal &next)
+{
+	bool ahead = Side(portal.plane, next.points[0]) > LEVEL_EPSILON || Side(portal.plane, next.points[1]) > LEVEL_EPSILON;
+	bool behind = Side(next.plane, portal.points[0]) < -LEVEL_EPSILON || Side(next.plane, portal.points[1]) < -LEVEL_EPSILON;
+
+	return ahead && behind;
+}
+
+/**
+ * @brief floods through every portal facing the right way, an upper bound on what the full flow can find
+ */
+static void BasePortalVis(Compile_State &state, uint32_t portalIndex)
+{
+	const Compile_Portal &portal = state.portals[portalIndex];
+	uint8_t *row = &state.mightSee[(size_t)portalIndex * state.rowSize];
+	std::vector<uint32_t> stack;
+
+	SetBit(row, portal.leaf);
+	stack.push_back(portal.leaf);
+
+	while (!stack.empty())
+	{
+		uint32_t leaf = stack.back();
+		stack.pop_back();
+
+		for (uint32_t next : state.leafPortals[leaf])
+		{
+			const Compile_Portal &nextPortal = state.portals[next];
+
+			if (TestBit(row, nextPortal.leaf) || !PortalMightSee(portal, nextPortal))
+			{
+				continue;
+			}
+
+			SetBit(row, nextPortal.leaf);
+			stack.push_back(nextPortal.leaf);
+		}
+	}
+}
+
+/**
+ * @brief follows every chain of portals out of leaf that a line from source can still pass through, source and each
+ * portal narrowing as the chain gets longer
+ * @param pass the portal into leaf, NULL for the first leaf past the source portal
+ * @param might the leaves the chain can still reach, from the base flood
+ */
+static void RecursiveFlow(Compile_State &state, uint32_t sourcePortal, const Compile_Winding &source, const Compile_Winding *pass, uint32_t leaf, const uint8_t *might)
+{
+	const Compile_Plane &sourcePlane = state.portals[sourcePortal].plane;
+	std::vector<uint8_t> nextMight(state.rowSize);
+
+	state.onStack[leaf] = 1;
+	++state.flowSteps;
+
+	for (uint32_t portalIndex : state.leafPortals[leaf])
+	{
+		const Compile_Portal &portal = state.portals[portalIndex];
+		uint32_t target = portal.leaf;
+
+		if (state.onStack[target] || !TestBit(might, target))
+		{
+			continue;
+		}
+
+		const uint8_t *portalMight = &state.mightSee[(size_t)portalIndex * state.rowSize];
+		bool more = false;
+
+		for (uint32_t i = 0; i < state.rowSize; ++i)
+		{
+			nextMight[i] = might[i] & portalMight[i];
+			more = more || (nextMight[i] & ~state.visible[i]) != 0;
+		}
+
+		//already seen and nothing new past it
+		if (!more && TestBit(state.visible.data(), target))
+		{
+			continue;
+		}
+
+		Compile_Winding winding = { { portal.points[0], portal.points[1] } };
+		Compile_Winding narrowed = source;
+
+		if (!ClipWinding(winding, sourcePlane))
+		{
+			continue;
+		}
+
+		if (pass && (!ClipToAntiPenumbra(source, *pass, winding) || !ClipToAntiPenumbra(winding, *pass, narrowed)))
+		{
+			continue;
+		}
+
+		SetBit(state.visible.data(), target);
+
+		RecursiveFlow(state, sourcePortal, narrowed, &winding, target, nextMight.data());
+	}
+
+	state.onStack[leaf] = 0;
+}
+
+/**
+ * @brief every leaf's potentially visible set, run length coded into pvs
+ * @return the visible leaves summed over every leaf
+ */
+static uint64_t BuildPvs(Compile_State &state, std::vector<uint8_t> &pvs)
+{
+	uint32_t leafCount = (uint32_t)state.leaves.size();
+	uint32_t portalCount = (uint32_t)state.portals.size();
+	std::vector<uint8_t> portalVisible((size_t)portalCount * ((leafCount + 7) / 8));
+	std::vector<uint8_t> row;
+	uint64_t visibleTotal = 0;
+
+	state.rowSize = (leafCount + 7) / 8;
+	state.mightSee.assign((size_t)portalCount * state.rowSize, 0);
+	state.onStack.assign(leafCount, 0);
+	state.flowSteps = 0;
+
+	for (uint32_t p = 0; p < portalCount; ++p)
+	{
+		BasePortalVis(state, p);
+	}
+
+	for (uint32_t p = 0; p < portalCount; ++p)
+	{
+		const Compile_Portal &portal = state.portals[p];
+		Compile_Winding source = { { portal.points[0], portal.points[1] } };
+
+		state.visible.assign(state.rowSize, 0);
+		SetBit(state.visible.data(), portal.leaf);
+
+		state.onStack[portal.from] = 1;
+		RecursiveFlow(state, p, source, NULL, portal.leaf, &state.mightSee[(size_t)p * state.rowSize]);
+		state.onStack[portal.from] = 0;
+
+		memcpy(&portalVisible[(size_t)p * state.rowSize], state.visible.data(), state.rowSize);
+	}
+
+	for (uint32_t l = 0; l < leafCount; ++l)
+	{
+		row.assign(state.rowSize, 0);
+		SetBit(row.data(), l);
+
+		for (uint32_t p : state.leafPortals[l])
+		{
+			for (uint32_t i = 0; i < state.rowSize; ++i)
+			{
+				row[i] |= portalVisible[(size_t)p * state.rowSize + i];
+			}
+		}
+
+		for (uint32_t i = 0; i < leafCount; ++i)
+		{
+			visibleTotal += TestBit(row.data(), i) ? 1 : 0;
+		}
+
+		state.levelLeaves[l].pvsOffset = (uint32_t)pvs.size();
+		Level_Compiler::CompressRow(row.data(), state.rowSize, pvs);
+	}
+
+	return visibleTotal;
+}
+
+static void AddVertex(Compile_State &state, double x, double y, float z, float shade, float u, float v)
+{
+	Vertex vertex;
+
+	vertex.pos = glm::vec3((float)x, (float)y, z);
+	vertex.color = glm::vec3(shade, shade, shade);
+	vertex.texCoord = glm::vec2(u, v);
+
+	state.vertices.push_back(vertex);
+}
+
+/**
+ * @brief a quad facing the seg's front, its texture runs on from where the line starts
+ */
+static void AddWall(Compile_State &state, const Compile_Seg &seg, float bottom, float top, float shade)
+{
+	if (top - bottom < LEVEL_EPSILON)
+	{
+		return;
+	}
+
+	const Level_Line &line = state.source->lines[seg.line];
+	const glm::vec2 &origin = state.source->vertices[seg.backSide ? line.v2 : line.v1];
+	Compile_Point start = MakePoint(origin.x, origin.y);
+	float u0 = (float)Distance(start, seg.points[0]) / LEVEL_TEXTURE_UNITS;
+	float u1 = (float)Distance(start, seg.points[1]) / LEVEL_TEXTURE_UNITS;
+	float v = (top - bottom) / LEVEL_TEXTURE_UNITS;
+	uint32_t base = (uint32_t)state.vertices.size();
+
+	AddVertex(state, seg.points[0].x, seg.points[0].y, bottom, shade, u0, v);
+	AddVertex(state, seg.points[1].x, seg.points[1].y, bottom, shade, u1, v);
+	AddVertex(state, seg.points[1].x, seg.points[1].y, top, shade, u1, 0.0f);
+	AddVertex(state, seg.points[0].x, seg.points[0].y, top, shade, u0, 0.0f);
+
+	uint32_t quad[6] = { base, base + 1, base + 2, base + 2, base + 3, base };
+
+	state.indices.insert(state.indices.end(), quad, quad + 6);
+}
+
+/**
+ * @brief the leaf's floor and ceiling, and the walls of its segs, counter clockwise seen from inside the leaf
+ */
+static void BuildGeometry(Compile_State &state, uint32_t leafIndex)
+{
+	const Compile_Leaf &leaf = state.leaves[leafIndex];
+	Level_Leaf &levelLeaf = state.levelLeaves[leafIndex];
+	const Level_Sector &sector = state.source->sectors[leaf.sector];
+	const std::vector<Compile_Point> &points = leaf.polygon.points;
+	float shade = sector.light / 255.0f;
+
+	levelLeaf.firstIndex = (uint32_t)state.indices.size();
+
+	if (points.size() >= 3)
+	{
+		uint32_t floorBase = (uint32_t)state.vertices.size();
+
+		for (const Compile_Point &point : points)
+		{
+			AddVertex(state, point.x, point.y, sector.floorHeight, shade, (float)point.x / LEVEL_TEXTURE_UNITS, (float)point.y / LEVEL_TEXTURE_UNITS);
+		}
+
+		uint32_t ceilingBase = (uint32_t)state.vertices.size();
+
+		for (const Compile_Point &point : points)
+		{
+			AddVertex(state, point.x, point.y, sector.ceilingHeight, shade, (float)point.x / LEVEL_TEXTURE_UNITS, (float)point.y / LEVEL_TEXTURE_UNITS);
+		}
+
+		//the ceiling is seen from below, so its fan winds the other way
+		for (uint32_t i = 1; i + 1 < (uint32_t)points.size(); ++i)
+		{
+			uint32_t triangles[6] = { floorBase, floorBase + i, floorBase + i + 1, ceilingBase, ceilingBase + i + 1, ceilingBase + i };
+
+			state.indices.insert(state.indices.end(), triangles, triangles + 6);
+		}
+	}
+
+	for (const Compile_Seg &seg : leaf.segs)
+	{
+		const Level_Sector &front = state.source->sectors[seg.sector];
+
+		if (seg.backSector < 0)
+		{
+			AddWall(state, seg, front.floorHeight, front.ceilingHeight, shade);
+			continue;
+		}
+
+		//steps up and down between sectors, Doom's lower and upper textures
+		const Level_Sector &back = state.source->sectors[seg.backSector];
+
+		if (back.floorHeight > front.floorHeight)
+		{
+			AddWall(state, seg, front.floorHeight, std::min(back.floorHeight, front.ceilingHeight), shade);
+		}
+
+		if (back.ceilingHeight < front.ceilingHeight)
+		{
+			AddWall(state, seg, std::max(back.ceilingHeight, front.floorHeight), front.ceilingHeight, shade);
+		}
+	}
+
+	levelLeaf.indexCount = (uint32_t)state.indices.size() - levelLeaf.firstIndex;
+}
+
+template <typename T>
+static void AppendArray(std::vector<uint8_t> &level, size_t &offset, const std::vector<T> &items)
+{
+	if (!items.empty())
+	{
+		memcpy(level.data() + offset, items.data(), items.size() * sizeof(T));
+	}
+
+	offset += items.size() * sizeof(T);
+}
+
+void Level_Compiler::CompressRow(const uint8_t *row, uint32_t rowSize, std::vector<uint8_t> &compressed)
+{
+	for (uint32_t i = 0; i < rowSize;)
+	{
+		if (row[i])
+		{
+			compressed.push_back(row[i++]);
+			continue;
+		}
+
+		uint32_t run = 0;
+
+		while (i < rowSize && !row[i] && run < 255)
+		{
+			++run;
+			++i;
+		}
+
+		compressed.push_back(0);
+		compressed.push_back((uint8_t)run);
+	}
+}
+
+bool Level_Compiler::Compile(const Level_Source &source, std::vector<uint8_t> &level)
+{
+	auto compileStart = std::chrono::steady_clock::now();
+	Compile_State state;
+	std::vector<Compile_Seg> segs;
+
+	state.source = &source;
+
+	for (uint32_t i = 0; i < (uint32_t)source.lines.size(); ++i)
+	{
+		const Level_Line &line = source.lines[i];
+
+		if (line.v1 >= source.vertices.size() || line.v2 >= source.vertices.size() ||
+			line.front < 0 || line.front >= (int32_t)source.sectors.size() || line.back < -1 || line.back >= (int32_t)source.sectors.size())
+		{
+			slog("level line %u refers to a missing vertex or sector", i);
+			return false;
+		}
+
+		Compile_Seg seg;
+		Compile_Plane plane;
+		bool flipped;
+
+		seg.points[0] = MakePoint(source.vertices[line.v1].x, source.vertices[line.v1].y);
+		seg.points[1] = MakePoint(source.vertices[line.v2].x, source.vertices[line.v2].y);
+
+		if (!PlaneThrough(seg.points[0], seg.points[1], plane))
+		{
+			slog("level line %u has no length, skipping it", i);
+			continue;
+		}
+
+		seg.line = i;
+		seg.plane = FindPlane(state, plane, flipped);
+		seg.flipped = flipped;
+		seg.sector = line.front;
+		seg.backSector = line.back;
+		seg.backSide = false;
+
+		segs.push_back(seg);
+
+		if (line.back >= 0)
+		{
+			std::swap(seg.points[0], seg.points[1]);
+			seg.flipped = !flipped;
+			seg.sector = line.back;
+			seg.backSector = line.front;
+			seg.backSide = true;
+
+			segs.push_back(seg);
+		}
+	}
+
+	if (segs.empty())
+	{
+		slog("level has no lines");
+		return false;
+	}
+
+	uint32_t segCount = (uint32_t)segs.size();
+	Compile_Polygon region;
+	Compile_Point low = segs[0].points[0];
+	Compile_Point high = segs[0].points[0];
+
+	for (const Compile_Seg &seg : segs)
+	{
+		for (const Compile_Point &point : seg.points)
+		{
+			low = MakePoint(std::min(low.x, point.x), std::min(low.y, point.y));
+			high = MakePoint(std::max(high.x, point.x), std::max(high.y, point.y));
+		}
+	}
+
+	low = MakePoint(low.x - LEVEL_BOUNDS_MARGIN, low.y - LEVEL_BOUNDS_MARGIN);
+	high = MakePoint(high.x + LEVEL_BOUNDS_MARGIN, high.y + LEVEL_BOUNDS_MARGIN);
+
+	region.points.push_back(low);
+	region.points.push_back(MakePoint(high.x, low.y));
+	region.points.push_back(high);
+	region.points.push_back(MakePoint(low.x, high.y));
+	region.planes.assign(4, -1);
+
+	BuildNode(state, segs, region);
+	BuildPortals(state);
+
+	std::vector<uint8_t> pvs;
+	uint64_t visibleTotal = BuildPvs(state, pvs);
+
+	for (uint32_t l = 0; l < (uint32_t)state.leaves.size(); ++l)
+	{
+		BuildGeometry(state, l);
+	}
+
+	Level_Header header = {};
+
+	header.magic = LEVEL_FILE_MAGIC;
+	header.version = LEVEL_FILE_VERSION;
+	header.nodeCount = (uint32_t)state.nodes.size();
+	header.leafCount = (uint32_t)state.levelLeaves.size();
+	header.vertexCount = (uint32_t)state.vertices.size();
+	header.indexCount = (uint32_t)state.indices.size();
+	header.pvsSize = (uint32_t)pvs.size();
+	header.start = source.start;
+	header.startAngle = source.startAngle;
+	header.fileSize = (uint32_t)(sizeof(Level_Header) + state.nodes.size() * sizeof(Level_Node) + state.levelLeaves.size() * sizeof(Level_Leaf) +
+		state.vertices.size() * sizeof(Vertex) + state.indices.size() * sizeof(uint32_t) + pvs.size());
+
+	size_t offset = sizeof(Level_Header);
+
+	level.assign(header.fileSize, 0);
+	memcpy(level.data(), &header, sizeof(header));
+
+	AppendArray(level, offset, state.nodes);
+	AppendArray(level, offset, state.levelLeaves);
+	AppendArray(level, offset, state.vertices);
+	AppendArray(level, offset, state.indices);
+	AppendArray(level, offset, pvs);
+
+	double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count();
+	uint32_t leafCount = header.leafCount;
+
+	slog("compiled level: %u lines into %u segs, %u nodes, %u leaves, %u portals, %u triangles in %.1f ms", (uint32_t)source.lines.size(), segCount, header.nodeCount, leafCount, (uint32_t)state.portals.size(), header.indexCount / 3, compileMs);
+	slog("pvs: %.1f leaves visible from a leaf on average, %u bytes run length coded against %u, %llu flow steps", (double)visibleTotal / leafCount, header.pvsSize, leafCount * state.rowSize, (unsigned long long)state.flowSteps);
+
+	return true;
+}
+
+bool Level_Compiler::LoadSource(const char *filename, Level_Source &source)
+{
+	FILE *file = fopen(filename, "r");
+	char line[256];
+
+	if (!file)
+	{
+		slog("failed to open level source %s", filename);
+		return false;
+	}
+
+	source.vertices.clear();
+	source.sectors.clear();
+	source.lines.clear();
+	source.start = glm::vec2(0.0f, 0.0f);
+	source.startAngle = 0.0f;
+
+	while (fgets(line, sizeof(line), file))
+	{
+		glm::vec2 vertex;
+		Level_Sector sector;
+		Level_Line wall;
+
+		if (line[0] == '#')
+		{
+			continue;
+		}
+
+		if (sscanf(line, "vertex %f %f", &vertex.x, &vertex.y) == 2)
+		{
+			source.vertices.push_back(vertex);
+		}
+		else if (sscanf(line, "sector %f %f %f", &sector.floorHeight, &sector.ceilingHeight, &sector.light) == 3)
+		{
+			source.sectors.push_back(sector);
+		}
+		else if (sscanf(line, "line %u %u %d %d", &wall.v1, &wall.v2, &wall.front, &wall.back) == 4)
+		{
+			source.lines.push_back(wall);
+		}
+		else if (sscanf(line, "start %f %f %f", &vertex.x, &vertex.y, &source.startAngle) == 3)
+		{
+			source.start = vertex;
+		}
+	}
+
+	fclose(file);
+
+	slog("loaded level source %s: %i vertices, %i sectors, %i lines", filename, (int)source.vertices.size(), (int)source.sectors.size(), (int)source.lines.size());
+
+	return !source.lines.empty();
+}
+
+bool Level_Compiler::CompileFile(const char *sourceFile, const char *levelFile)
+{
+	Level_Source source;
+	std::vector<uint8_t> level;
+
+	if (!LoadSource(sourceFile, source) || !Compile(source, level))
+	{
+		return false;
+	}
+
+	FILE *file = fopen(levelFile, "wb");
+
+	if (!file)
+	{
+		slog("failed to open %s for writing", levelFile);
+		return false;
+	}
+
+	bool written = fwrite(level.data(), level.size(), 1, file) == 1;
+
+	fclose(file);
+
+	if (!written)
+	{
+		slog("failed to write level %s", levelFile);
+		return false;
+	}
+
+	slog("wrote level %s, %u bytes", levelFile, (uint32_t)level.size());
+
+	return true;
+}
+
+/**
+ * @brief where along a room's side its doorway is centred, varied so doorways rarely line up across the grid
+ */
+static float DoorOffset(uint32_t i, uint32_t j, uint32_t axis)
+{
+	uint32_t hash = (i * 73856093u) ^ (j * 19349663u) ^ (axis * 83492791u);
+
+	return ROOM_SIZE * ((hash >> 4) % 3 + 1) / 4.0f;
+}
+
+void Level_Compiler::BuildRoomGrid(uint32_t roomsPerSide, Level_Source &source)
+{
+	std::map<std::pair<float, float>, uint32_t> vertexIndices;
+	uint32_t side = std::max(roomsPerSide, 1u);
+	float pitch = ROOM_SIZE + ROOM_WALL;
+	float halfDoor = ROOM_DOOR * 0.5f;
+
+	source.vertices.clear();
+	source.sectors.clear();
+	source.lines.clear();
+
+	auto vertex = [&](float x, float y) -> uint32_t
+	{
+		auto found = vertexIndices.find(std::make_pair(x, y));
+
+		if (found != vertexIndices.end())
+		{
+			return found->second;
+		}
+
+		source.vertices.push_back(glm::vec2(x, y));
+		vertexIndices[std::make_pair(x, y)] = (uint32_t)source.vertices.size() - 1;
+
+		return (uint32_t)source.vertices.size() - 1;
+	};
+
+	auto addLine = [&](const glm::vec2 &a, const glm::vec2 &b, int32_t front, int32_t back)
+	{
+		Level_Line line = { vertex(a.x, a.y), vertex(b.x, b.y), front, back };
+
+		source.lines.push_back(line);
+	};
+
+	//a side walked clockwise round its room, broken by a doorway onto corridor when there is one
+	auto addSide = [&](const glm::vec2 &from, const glm::vec2 &to, int32_t room, int32_t corridor, float doorCentre)
+	{
+		if (corridor < 0)
+		{
+			addLine(from, to, room, -1);
+			return;
+		}
+
+		glm::vec2 direction = (to - from) * (1.0f / ROOM_SIZE);
+		glm::vec2 doorStart = from + direction * (doorCentre - halfDoor);
+		glm::vec2 doorEnd = from + direction * (doorCentre + halfDoor);
+
+		addLine(from, doorStart, room, -1);
+		addLine(doorStart, doorEnd, room, corridor);
+		addLine(doorEnd, to, room, -1);
+	};
+
+	for (uint32_t j = 0; j < side; ++j)
+	{
+		for (uint32_t i = 0; i < side; ++i)
+		{
+			Level_Sector room;
+
+			room.floorHeight = (float)(((i * 7 + j * 3) % 4) * 8);
+			room.ceilingHeight = room.floorHeight + 128.0f + ((i + j) % 2) * 32.0f;
+			room.light = 96.0f + ((i * 5 + j * 3) % 4) * 40.0f;
+
+			source.sectors.push_back(room);
+		}
+	}
+
+	//corridors east of each room then north of each, -1 on the grid's edge
+	std::vector<int32_t> eastCorridors(side * side, -1);
+	std::vector<int32_t> northCorridors(side * side, -1);
+
+	for (uint32_t j = 0; j < side; ++j)
+	{
+		for (uint32_t i = 0; i < side; ++i)
+		{
+			const Level_Sector &room = source.sectors[j * side + i];
+
+			for (uint32_t axis = 0; axis < 2; ++axis)
+			{
+				if ((axis == 0 && i + 1 == side) || (axis == 1 && j + 1 == side))
+				{
+					continue;
+				}
+
+				const Level_Sector &neighbour = source.sectors[axis == 0 ? j * side + i + 1 : (j + 1) * side + i];
+				Level_Sector corridor;
+
+				corridor.floorHeight = std::max(room.floorHeight, neighbour.floorHeight);
+				corridor.ceilingHeight = std::min(room.ceilingHeight, neighbour.ceilingHeight) - 16.0f;
+				corridor.light = 80.0f;
+
+				(axis == 0 ? eastCorridors : northCorridors)[j * side + i] = (int32_t)source.sectors.size();
+				source.sectors.push_back(corridor);
+			}
+		}
+	}
+
+	for (uint32_t j = 0; j < side; ++j)
+	{
+		for (uint32_t i = 0; i < side; ++i)
+		{
+			int32_t room = (int32_t)(j * side + i);
+			float x0 = i * pitch, y0 = j * pitch;
+			float x1 = x0 + ROOM_SIZE, y1 = y0 + ROOM_SIZE;
+			int32_t west = i > 0 ? eastCorridors[room - 1] : -1;
+			int32_t south = j > 0 ? northCorridors[room - side] : -1;
+			int32_t east = eastCorridors[room];
+			int32_t north = northCorridors[room];
+
+			//clockwise, so the room is on every wall's right
+			addSide(glm::vec2(x0, y0), glm::vec2(x0, y1), room, west, i > 0 ? DoorOffset(i - 1, j, 0) : 0.0f);
+			addSide(glm::vec2(x0, y1), glm::vec2(x1, y1), room, north, DoorOffset(i, j, 1));
+			addSide(glm::vec2(x1, y1), glm::vec2(x1, y0), room, east, ROOM_SIZE - DoorOffset(i, j, 0));
+			addSide(glm::vec2(x1, y0), glm::vec2(x0, y0), room, south, j > 0 ? ROOM_SIZE - DoorOffset(i, j - 1, 1) : 0.0f);
+
+			if (east >= 0)
+			{
+				float doorY = y0 + DoorOffset(i, j, 0);
+
+				addLine(glm::vec2(x1, doorY + halfDoor), glm::vec2(x1 + ROOM_WALL, doorY + halfDoor), east, -1);
+				addLine(glm::vec2(x1 + ROOM_WALL, doorY - halfDoor), glm::vec2(x1, doorY - halfDoor), east, -1);
+			}
+
+			if (north >= 0)
+			{
+				float doorX = x0 + DoorOffset(i, j, 1);
+
+				addLine(glm::vec2(doorX - halfDoor, y1), glm::vec2(doorX - halfDoor, y1 + ROOM_WALL), north, -1);
+				addLine(glm::vec2(doorX + halfDoor, y1 + ROOM_WALL), glm::vec2(doorX + halfDoor, y1), north, -1);
+			}
+		}
+	}
+
+	source.start = glm::vec2(ROOM_SIZE * 0.5f, ROOM_SIZE * 0.5f);
+	source.startAngle = 45.0f;
+}
+
+/**
+ * @brief true if a one sided wall crosses the line from a to b
+ */
+static bool SightBlocked(const Level_Source &source, const glm::vec2 &a, const glm::vec2 &b)
+{
+	for (const Level_Line &line : source.lines)
+	{
+		if (line.back >= 0)
+		{
+			continue;
+		}
+
+		const glm::vec2 &p = source.vertices[line.v1];
+		const glm::vec2 &q = source.vertices[line.v2];
+		double ab = ((double)b.x - a.x) * ((double)p.y - a.y) - ((double)b.y - a.y) * ((double)p.x - a.x);
+		double abq = ((double)b.x - a.x) * ((double)q.y - a.y) - ((double)b.y - a.y) * ((double)q.x - a.x);
+		double pq = ((double)q.x - p.x) * ((double)a.y - p.y) - ((double)q.y - p.y) * ((double)a.x - p.x);
+		double pqb = ((double)q.x - p.x) * ((double)b.y - p.y) - ((double)q.y - p.y) * ((double)b.x - p.x);
+
+		if (ab * abq <= 0.0 && pq * pqb <= 0.0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Level_Compiler::Benchmark(uint32_t roomsPerSide)
+{
+	Level_Source source;
+	std::vector<uint8_t> level;
+	Level_Map map;
+	uint32_t side = std::max(roomsPerSide, 1u);
+	float pitch = ROOM_SIZE + ROOM_WALL;
+
+	BuildRoomGrid(side, source);
+
+	if (!Compile(source, level) || !map.Level_MapInit(level))
+	{
+		return false;
+	}
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_int_distribution<uint32_t> anyRoom(0, side * side - 1);
+
+	auto roomPoint = [&](uint32_t room) -> glm::vec2
+	{
+		return glm::vec2((room % side) * pitch + 8.0f + unit(random) * (ROOM_SIZE - 16.0f), (room / side) * pitch + 8.0f + unit(random) * (ROOM_SIZE - 16.0f));
+	};
+
+	std::vector<uint32_t> visible;
+	uint32_t cameraCount = side * side * BENCHMARK_CAMERAS_PER_ROOM;
+	uint64_t pvsLeaves = 0, frustumLeaves = 0;
+	double walkMs = 0.0;
+
+	for (uint32_t c = 0; c < cameraCount; ++c)
+	{
+		glm::vec2 point = roomPoint(c / BENCHMARK_CAMERAS_PER_ROOM);
+		glm::vec3 eye = glm::vec3(point.x, point.y, map.GetLeaf(map.FindLeaf(point)).floorHeight + LEVEL_EYE_HEIGHT);
+		float angle = glm::radians(unit(random) * 360.0f);
+
+		map.CollectVisible(eye, NULL, visible);
+		pvsLeaves += visible.size();
+
+		glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(cosf(angle), sinf(angle), 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 proj = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 1.0f, map.GetExtent());
+
+		proj[1][1] *= -1;
+
+		glm::mat4 viewProj = proj * view;
+		auto walkStart = std::chrono::steady_clock::now();
+
+		map.CollectVisible(eye, &viewProj, visible);
+
+		walkMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - walkStart).count();
+		frustumLeaves += visible.size();
+	}
+
+	slog("level benchmark: %u rooms, %u leaves, %u nodes", side * side, map.GetLeafCount(), map.GetNodeCount());
+	slog("from %u cameras the pvs keeps %.1f leaves on average and the frustum %.1f, of %u, %.4f ms a walk", cameraCount, (double)pvsLeaves / cameraCount, (double)frustumLeaves / cameraCount, map.GetLeafCount(), walkMs / cameraCount);
+
+	//the pvs may hold leaves that can't be seen but never miss one that can
+	std::vector<uint8_t> row;
+	uint32_t checked = 0, missed = 0;
+
+	for (uint32_t s = 0; s < BENCHMARK_SIGHT_LINES; ++s)
+	{
+		glm::vec2 a = roomPoint(anyRoom(random));
+		float angle = unit(random) * 6.2831853f;
+		float length = unit(random) * pitch * 3.0f;
+		glm::vec2 b = a + glm::vec2(cosf(angle), sinf(angle)) * length;
+
+		if (SightBlocked(source, a, b))
+		{
+			continue;
+		}
+
+		uint32_t from = map.FindLeaf(a);
+		uint32_t to = map.FindLeaf(b);
+
+		++checked;
+		map.DecompressPvs(from, row);
+
+		if (!TestBit(row.data(), to))
+		{
+			if (missed < 8)
+			{
+				slog("leaf %u at %.1f %.1f can see leaf %u at %.1f %.1f but its pvs lacks it", from, a.x, a.y, to, b.x, b.y);
+			}
+
+			++missed;
+		}
+	}
+
+	slog("%u of %u clear sight lines missing from the pvs", missed, checked);
+
+	return checked && missed == 0;
+}
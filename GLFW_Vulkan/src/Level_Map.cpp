@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <glm/geometric.hpp>
+
+#include "Level_Map.h"
+#include "Frustum_Culler.h"
+#include "simple_logger.h"
+#include "Profiler.h"
+
+/**
+ * @brief false if the box is wholly behind any of the planes
+ */
+static bool BoxInFrustum(const glm::vec4 planes[6], const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		const glm::vec4 &plane = planes[i];
+
+		//the corner furthest along the plane's normal
+		float x = plane.x >= 0.0f ? boundsMax.x : boundsMin.x;
+		float y = plane.y >= 0.0f ? boundsMax.y : boundsMin.y;
+		float z = plane.z >= 0.0f ? boundsMax.z : boundsMin.z;
+
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+Level_Map::Level_Map()
+{
+	header = NULL;
+	nodes = NULL;
+	leaves = NULL;
+	vertices = NULL;
+	indices = NULL;
+	pvs = NULL;
+	pvsLeaf = UINT32_MAX;
+}
+
+bool Level_Map::Level_MapInit(const char *filename)
+{
+	FILE *file = fopen(filename, "rb");
+	std::vector<uint8_t> level;
+
+	if (!file)
+	{
+		slog("failed to open level %s", filename);
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (size > 0)
+	{
+		level.resize((size_t)size);
+
+		if (fread(level.data(), level.size(), 1, file) != 1)
+		{
+			level.clear();
+		}
+	}
+
+	fclose(file);
+
+	if (!Level_MapInit(level))
+	{
+		slog("level %s is malformed", filename);
+		return false;
+	}
+
+	return true;
+}
+
+bool Level_Map::Level_MapInit(const std::vector<uint8_t> &level)
+{
+	data = level;
+	header = (const Level_Header*)data.data();
+	pvsLeaf = UINT32_MAX;
+
+	if (data.size() < sizeof(Level_Header))
+	{
+		header = NULL;
+		return false;
+	}
+
+	const uint8_t *cursor = data.data() + sizeof(Level_Header);
+
+	nodes = (const Level_Node*)cursor;
+	cursor += (size_t)header->nodeCount * sizeof(Level_Node);
+	leaves = (const Level_Leaf*)cursor;
+	cursor += (size_t)header->leafCount * sizeof(Level_Leaf);
+	vertices = (const Vertex*)cursor;
+	cursor += (size_t)header->vertexCount * sizeof(Vertex);
+	indices = (const uint32_t*)cursor;
+	cursor += (size_t)header->indexCount * sizeof(uint32_t);
+	pvs = cursor;
+
+	if (!Validate())
+	{
+		header = NULL;
+		data.clear();
+		return false;
+	}
+
+	slog("loaded level: %u nodes, %u leaves, %u triangles, %u bytes of pvs", header->nodeCount, header->leafCount, header->indexCount / 3, header->pvsSize);
+
+	return true;
+}
+
+bool Level_Map::Validate() const
+{
+	uint64_t expected = sizeof(Level_Header) + (uint64_t)header->nodeCount * sizeof(Level_Node) + (uint64_t)header->leafCount * sizeof(Level_Leaf) +
+		(uint64_t)header->vertexCount * sizeof(Vertex) + (uint64_t)header->indexCount * sizeof(uint32_t) + header->pvsSize;
+
+	if (header->magic != LEVEL_FILE_MAGIC || header->version != LEVEL_FILE_VERSION || header->fileSize != data.size() || expected != data.size())
+	{
+		return false;
+	}
+
+	if (header->leafCount == 0)
+	{
+		return false;
+	}
+
+	//checked once here so the walk can follow children and ranges without bounds checks
+	for (uint32_t i = 0; i < header->nodeCount; ++i)
+	{
+		const Level_Node &node = nodes[i];
+
+		for (uint32_t child : node.children)
+		{
+			if ((child & LEVEL_CHILD_LEAF) ? (child & ~LEVEL_CHILD_LEAF) >= header->leafCount : (child <= i || child >= header->nodeCount))
+			{
+				return false;
+			}
+		}
+
+		if ((uint64_t)node.firstLeaf + node.leafCount > header->leafCount)
+		{
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->leafCount; ++i)
+	{
+		if ((uint64_t)leaves[i].firstIndex + leaves[i].indexCount > header->indexCount || leaves[i].pvsOffset >= header->pvsSize)
+		{
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->indexCount; ++i)
+	{
+		if (indices[i] >= header->vertexCount)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint32_t Level_Map::FindLeaf(const glm::vec2 &point) const
+{
+	if (header->nodeCount == 0)
+	{
+		return 0;
+	}
+
+	uint32_t child = 0;
+
+	while (!(child & LEVEL_CHILD_LEAF))
+	{
+		const Level_Node &node = nodes[child];
+		bool front = node.normal.x * point.x + node.normal.y * point.y >= node.distance;
+
+		child = node.children[front ? 0 : 1];
+	}
+
+	return child & ~LEVEL_CHILD_LEAF;
+}
+
+void Level_Map::DecompressPvs(uint32_t leaf, std::vector<uint8_t> &row) const
+{
+	uint32_t rowSize = (header->leafCount + 7) / 8;
+	const uint8_t *source = pvs + leaves[leaf].pvsOffset;
+	const uint8_t *end = pvs + header->pvsSize;
+
+	row.assign(rowSize, 0);
+
+	for (uint32_t i = 0; i < rowSize && source < end;)
+	{
+		if (*source)
+		{
+			row[i++] = *source++;
+			continue;
+		}
+
+		//a zero byte is followed by how many zero bytes it stands for
+		if (source + 1 >= end)
+		{
+			break;
+		}
+
+		i += source[1];
+		source += 2;
+	}
+}
+
+void Level_Map::SetPvsLeaf(uint32_t leaf)
+{
+	if (leaf == pvsLeaf)
+	{
+		return;
+	}
+
+	pvsLeaf = leaf;
+	DecompressPvs(leaf, pvsRow);
+
+	visibleBefore.resize(header->leafCount + 1);
+	visibleBefore[0] = 0;
+
+	for (uint32_t i = 0; i < header->leafCount; ++i)
+	{
+		visibleBefore[i + 1] = visibleBefore[i] + ((pvsRow[i >> 3] >> (i & 7)) & 1);
+	}
+}
+
+uint32_t Level_Map::CollectVisible(const glm::vec3 &eye, const glm::mat4 *viewProj, std::vector<uint32_t> &visible)
+{
+	PROFILE_ZONE("LevelCollectVisible");
+
+	glm::vec4 planes[6];
+	uint32_t cameraLeaf = FindLeaf(glm::vec2(eye.x, eye.y));
+
+	visible.clear();
+	SetPvsLeaf(cameraLeaf);
+
+	if (viewProj)
+	{
+		Frustum_Culler::ExtractPlanes(*viewProj, planes);
+	}
+
+	nodeStack.clear();
+	nodeStack.push_back(header->nodeCount ? 0 : LEVEL_CHILD_LEAF);
+
+	while (!nodeStack.empty())
+	{
+		uint32_t child = nodeStack.back();
+		nodeStack.pop_back();
+
+		if (child & LEVEL_CHILD_LEAF)
+		{
+			uint32_t leaf = child & ~LEVEL_CHILD_LEAF;
+
+			if (((pvsRow[leaf >> 3] >> (leaf & 7)) & 1) && (!viewProj || BoxInFrustum(planes, leaves[leaf].boundsMin, leaves[leaf].boundsMax)))
+			{
+				visible.push_back(leaf);
+			}
+
+			continue;
+		}
+
+		const Level_Node &node = nodes[child];
+
+		//no leaf under the node is in the PVS
+		if (visibleBefore[node.firstLeaf + node.leafCount] == visibleBefore[node.firstLeaf])
+		{
+			continue;
+		}
+
+		if (viewProj && !BoxInFrustum(planes, node.boundsMin, node.boundsMax))
+		{
+			continue;
+		}
+
+		//the side the eye is on comes off the stack first, so leaves come out nearest first
+		uint32_t nearSide = node.normal.x * eye.x + node.normal.y * eye.y >= node.distance ? 0 : 1;
+
+		nodeStack.push_back(node.children[nearSide ^ 1]);
+		nodeStack.push_back(node.children[nearSide]);
+	}
+
+	return cameraLeaf;
+}
+
+glm::vec3 Level_Map::GetStartEye() const
+{
+	if (!header)
+	{
+		return glm::vec3(0.0f, 0.0f, LEVEL_EYE_HEIGHT);
+	}
+
+	const Level_Leaf &leaf = leaves[FindLeaf(header->start)];
+
+	return glm::vec3(header->start.x, header->start.y, leaf.floorHeight + LEVEL_EYE_HEIGHT);
+}
+
+float Level_Map::GetExtent() const
+{
+	if (!header)
+	{
+		return 0.0f;
+	}
+
+	glm::vec3 boundsMin = header->nodeCount ? nodes[0].boundsMin : leaves[0].boundsMin;
+	glm::vec3 boundsMax = header->nodeCount ? nodes[0].boundsMax : leaves[0].boundsMax;
+
+	return glm::length(boundsMax - boundsMin);
+}
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include "Model.h"
 #include "simple_logger.h"
+#include "Profiler.h"
 
 namespace std {
 	template<> struct hash<Vertex> {
@@ -20,6 +21,8 @@ namespace std {
 
 Model* Model_Manager::LoadModel(const char* modelName)
 {
+	PROFILE_ZONE("LoadModel");
+
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
@@ -0,0 +1,543 @@
+#include <stdexcept>
+#include <string.h>
+#include <algorithm>
+
+#include "Occlusion_Culler.h"
+#include "Buffers.h"
+#include "Texture.h"
+#include "simple_logger.h"
+#include "Profiler.h"
+
+const static uint32_t DOWNSAMPLE_GROUP_SIZE = 8;
+const static uint32_t TEST_GROUP_SIZE = 64;
+
+Occlusion_Culler::Occlusion_Culler()
+{
+	logicalDevice = VK_NULL_HANDLE;
+	physicalDevice = VK_NULL_HANDLE;
+	depthImage = VK_NULL_HANDLE;
+	depthImageView = VK_NULL_HANDLE;
+	depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	depthExtent = {};
+	hizImage = VK_NULL_HANDLE;
+	hizImageMemory = VK_NULL_HANDLE;
+	hizView = VK_NULL_HANDLE;
+	hizSampler = VK_NULL_HANDLE;
+	loadRenderPass = VK_NULL_HANDLE;
+	downsamplePipeline = VK_NULL_HANDLE;
+	downsampleLayout = VK_NULL_HANDLE;
+	testPipeline = VK_NULL_HANDLE;
+	testLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	maxObjects = 0;
+	visibilitySize = 0;
+	maxDraws = 0;
+	compactBase = 0;
+	framesCulled = 0;
+	objectsTested = 0;
+	objectsDeferred = 0;
+	objectsRecovered = 0;
+}
+
+Occlusion_Culler::~Occlusion_Culler()
+{
+	//the pipeline layouts and set layouts belong to the pipeline registry, the sets go with their pool
+	if (descriptorPool != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+	}
+
+	if (downsamplePipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(logicalDevice, downsamplePipeline, nullptr);
+	}
+
+	if (testPipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(logicalDevice, testPipeline, nullptr);
+	}
+
+	for (size_t i = 0; i < objectBuffers.size(); i++)
+	{
+		vkDestroyBuffer(logicalDevice, objectBuffers[i], nullptr);
+		vkFreeMemory(logicalDevice, objectBuffersMemory[i], nullptr);
+		vkDestroyBuffer(logicalDevice, visibilityBuffers[i], nullptr);
+		vkFreeMemory(logicalDevice, visibilityBuffersMemory[i], nullptr);
+		vkDestroyBuffer(logicalDevice, drawBuffers[i], nullptr);
+		vkFreeMemory(logicalDevice, drawBuffersMemory[i], nullptr);
+	}
+
+	if (hizSampler != VK_NULL_HANDLE)
+	{
+		vkDestroySampler(logicalDevice, hizSampler, nullptr);
+	}
+
+	for (VkImageView view : hizLevelViews)
+	{
+		vkDestroyImageView(logicalDevice, view, nullptr);
+	}
+
+	if (hizView != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(logicalDevice, hizView, nullptr);
+	}
+
+	if (hizImage != VK_NULL_HANDLE)
+	{
+		vkDestroyImage(logicalDevice, hizImage, nullptr);
+		vkFreeMemory(logicalDevice, hizImageMemory, nullptr);
+	}
+}
+
+bool Occlusion_Culler::Occlusion_CullerInit(VkDevice device, VkPhysicalDevice physDevice, Pipeline_Wrapper *pipeWrapper, VkImage depth, VkImageView depthView, VkFormat depthFormat,
+	VkExtent2D extent, uint32_t imageCount, uint32_t visibilityIds, uint32_t objectCapacity, uint32_t drawCapacity, uint32_t compactedBase)
+{
+	VkFormatProperties props;
+	std::vector<VkDescriptorSetLayout> downsampleSetLayouts;
+	std::vector<VkDescriptorSetLayout> testSetLayouts;
+
+	logicalDevice = device;
+	physicalDevice = physDevice;
+	depthImage = depth;
+	depthImageView = depthView;
+	depthAspect = Buffer_Wrapper::HasStencilComponent(depthFormat) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+	depthExtent = extent;
+	loadRenderPass = pipeWrapper->GetLoadRenderPass();
+	visibilitySize = visibilityIds;
+	maxObjects = std::max(objectCapacity, 1u);
+	maxDraws = std::max(drawCapacity, 1u);
+	compactBase = compactedBase;
+
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R32_SFLOAT, &props);
+
+	if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) || loadRenderPass == VK_NULL_HANDLE)
+	{
+		slog("occlusion culling unavailable, no storage image depth pyramid or load render pass");
+		return false;
+	}
+
+	if (!pipeWrapper->HasShader(OCCLUSION_DOWNSAMPLE_SHADER) || !pipeWrapper->HasShader(OCCLUSION_TEST_SHADER))
+	{
+		slog("occlusion culling unavailable, %s or %s is missing", OCCLUSION_DOWNSAMPLE_SHADER, OCCLUSION_TEST_SHADER);
+		return false;
+	}
+
+	downsamplePipeline = pipeWrapper->CreateComputePipeline(OCCLUSION_DOWNSAMPLE_SHADER, downsampleLayout, downsampleSetLayouts);
+	testPipeline = pipeWrapper->CreateComputePipeline(OCCLUSION_TEST_SHADER, testLayout, testSetLayouts);
+
+	if (downsamplePipeline == VK_NULL_HANDLE || testPipeline == VK_NULL_HANDLE || downsampleSetLayouts.size() != 1 || testSetLayouts.size() != 1)
+	{
+		slog("occlusion culling unavailable, its compute pipelines failed to build");
+		return false;
+	}
+
+	CreateHizImage(extent);
+	CreateBuffers(imageCount);
+
+	//every pyramid level gets a set, then every render image
+	std::vector<VkDescriptorPoolSize> poolSizes(4);
+	uint32_t levels = (uint32_t)hizSizes.size();
+	uint32_t images = imageCount;
+
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = levels + images;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = levels;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[2].descriptorCount = images;
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[3].descriptorCount = images * 4;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = levels + images;
+
+	if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create occlusion descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> downsampleLayouts(levels, downsampleSetLayouts[0]);
+	std::vector<VkDescriptorSetLayout> testLayouts(images, testSetLayouts[0]);
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+
+	downsampleSets.resize(levels);
+	allocInfo.descriptorSetCount = levels;
+	allocInfo.pSetLayouts = downsampleLayouts.data();
+
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, downsampleSets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+	}
+
+	testSets.resize(images);
+	allocInfo.descriptorSetCount = images;
+	allocInfo.pSetLayouts = testLayouts.data();
+
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, testSets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate occlusion test descriptor sets!");
+	}
+
+	WriteDownsampleSets();
+
+	slog("occlusion culling: %ux%u depth pyramid of %u levels, %u objects, %u deferred draws", hizSizes[0].width, hizSizes[0].height, levels, maxObjects, maxDraws);
+
+	return true;
+}
+
+void Occlusion_Culler::CreateHizImage(VkExtent2D extent)
+{
+	VkExtent2D size = { std::max((extent.width + 1) / 2, 1u), std::max((extent.height + 1) / 2, 1u) };
+
+	//rounding up keeps every depth texel under exactly one texel of each level
+	hizSizes.clear();
+	hizSizes.push_back(size);
+
+	while (size.width > 1 || size.height > 1)
+	{
+		size.width = std::max((size.width + 1) / 2, 1u);
+		size.height = std::max((size.height + 1) / 2, 1u);
+		hizSizes.push_back(size);
+	}
+
+	Texture_Wrapper::CreateImage(hizSizes[0].width, hizSizes[0].height, (uint32_t)hizSizes.size(), VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, hizImage, hizImageMemory, logicalDevice, physicalDevice);
+	hizView = Texture_Wrapper::CreateImageView(hizImage, VK_FORMAT_R32_SFLOAT, logicalDevice, VK_IMAGE_ASPECT_COLOR_BIT, (uint32_t)hizSizes.size());
+
+	hizLevelViews.resize(hizSizes.size());
+
+	for (uint32_t level = 0; level < (uint32_t)hizSizes.size(); ++level)
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = hizImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(logicalDevice, &viewInfo, nullptr, &hizLevelViews[level]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid level view!");
+		}
+	}
+
+	//the shaders only fetch texels, filtering never applies
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = (float)hizSizes.size();
+
+	if (vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &hizSampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create depth pyramid sampler!");
+	}
+}
+
+void Occlusion_Culler::CreateBuffers(uint32_t imageCount)
+{
+	VkDeviceSize objectBytes = sizeof(Occlusion_ObjectHeader) + sizeof(Occlusion_Object) * maxObjects;
+	VkDeviceSize visibilityBytes = sizeof(uint32_t) * std::max(visibilitySize, 1u);
+	VkDeviceSize drawBytes = sizeof(VkDrawIndexedIndirectCommand) * maxDraws;
+
+	objectBuffers.resize(imageCount);
+	objectBuffersMemory.resize(imageCount);
+	objectData.resize(imageCount);
+	visibilityBuffers.resize(imageCount);
+	visibilityBuffersMemory.resize(imageCount);
+	visibilityData.resize(imageCount);
+	drawBuffers.resize(imageCount);
+	drawBuffersMemory.resize(imageCount);
+	drawData.resize(imageCount);
+	drawsWritten.assign(imageCount, 0);
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		void *data;
+
+		Buffer_Wrapper::CreateBuffer(objectBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, objectBuffers[i], objectBuffersMemory[i], logicalDevice, VK_NULL_HANDLE, physicalDevice);
+		Buffer_Wrapper::CreateBuffer(visibilityBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, visibilityBuffers[i], visibilityBuffersMemory[i], logicalDevice, VK_NULL_HANDLE, physicalDevice);
+		Buffer_Wrapper::CreateBuffer(drawBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, drawBuffers[i], drawBuffersMemory[i], logicalDevice, VK_NULL_HANDLE, physicalDevice);
+
+		vkMapMemory(logicalDevice, objectBuffersMemory[i], 0, objectBytes, 0, &data);
+		objectData[i] = (Occlusion_ObjectHeader*)data;
+
+		vkMapMemory(logicalDevice, visibilityBuffersMemory[i], 0, visibilityBytes, 0, &data);
+		visibilityData[i] = (uint32_t*)data;
+
+		vkMapMemory(logicalDevice, drawBuffersMemory[i], 0, drawBytes, 0, &data);
+		drawData[i] = (VkDrawIndexedIndirectCommand*)data;
+
+		//an empty dispatch until the first frame adds objects, and everything visible so that frame draws it all first
+		memset(objectData[i], 0, sizeof(Occlusion_ObjectHeader));
+		objectData[i]->dispatch.y = 1;
+		objectData[i]->dispatch.z = 1;
+
+		std::fill(visibilityData[i], visibilityData[i] + visibilitySize, 1u);
+		memset(drawData[i], 0, (size_t)drawBytes);
+	}
+}
+
+void Occlusion_Culler::WriteDownsampleSets()
+{
+	std::vector<VkWriteDescriptorSet> writes;
+	std::vector<VkDescriptorImageInfo> images(hizSizes.size() * 2);
+	VkWriteDescriptorSet write = {};
+
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.descriptorCount = 1;
+
+	//level 0 reads the depth buffer, every other level the one below it
+	for (uint32_t level = 0; level < (uint32_t)hizSizes.size(); ++level)
+	{
+		VkDescriptorImageInfo &source = images[level * 2];
+		VkDescriptorImageInfo &destination = images[level * 2 + 1];
+
+		source.sampler = hizSampler;
+		source.imageView = level ? hizLevelViews[level - 1] : depthImageView;
+		source.imageLayout = level ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		destination.imageView = hizLevelViews[level];
+		destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		write.dstSet = downsampleSets[level];
+		write.dstBinding = 0;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &source;
+		writes.push_back(write);
+
+		write.dstBinding = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write.pImageInfo = &destination;
+		writes.push_back(write);
+	}
+
+	vkUpdateDescriptorSets(logicalDevice, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+
+void Occlusion_Culler::BindFrameBuffers(const std::vector<VkBuffer> &uniformBuffers, const std::vector<VkBuffer> &instanceBuffers)
+{
+	std::vector<VkWriteDescriptorSet> writes;
+	std::vector<VkDescriptorImageInfo> images(testSets.size());
+	std::vector<VkDescriptorBufferInfo> buffers(testSets.size() * 5);
+	VkWriteDescriptorSet write = {};
+
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.descriptorCount = 1;
+
+	for (uint32_t i = 0; i < (uint32_t)testSets.size(); ++i)
+	{
+		VkDescriptorImageInfo &pyramid = images[i];
+		VkBuffer setBuffers[] = { uniformBuffers[i], objectBuffers[i], visibilityBuffers[i], drawBuffers[i], instanceBuffers[i] };
+
+		pyramid.sampler = hizSampler;
+		pyramid.imageView = hizView;
+		pyramid.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		write.dstSet = testSets[i];
+		write.dstBinding = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &pyramid;
+		writes.push_back(write);
+
+		write.pImageInfo = NULL;
+
+		//binding 0 is the uniform buffer, 2 to 5 the objects, visibility, second phase draws and instances
+		for (uint32_t b = 0; b < 5; ++b)
+		{
+			VkDescriptorBufferInfo &info = buffers[i * 5 + b];
+
+			info.buffer = setBuffers[b];
+			info.offset = 0;
+			info.range = VK_WHOLE_SIZE;
+
+			write.dstBinding = b ? b + 1 : 0;
+			write.descriptorType = b ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			write.pBufferInfo = &info;
+			writes.push_back(write);
+		}
+
+		write.pBufferInfo = NULL;
+	}
+
+	vkUpdateDescriptorSets(logicalDevice, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+
+void Occlusion_Culler::BeginFrame(uint32_t imageIndex, const VkDrawIndexedIndirectCommand &instanceDraw)
+{
+	VkDrawIndexedIndirectCommand *draws = drawData[imageIndex];
+
+	//the image's last submission has completed, whatever its second phase drew was missed by its first
+	objectsRecovered += draws[0].instanceCount;
+
+	for (uint32_t i = 1; i < drawsWritten[imageIndex]; ++i)
+	{
+		objectsRecovered += draws[i].instanceCount;
+		draws[i].instanceCount = 0;
+	}
+
+	draws[0] = instanceDraw;
+	draws[0].instanceCount = 0;
+	draws[0].firstInstance = compactBase;
+
+	drawsWritten[imageIndex] = 1;
+	objectData[imageIndex]->objectCount = 0;
+}
+
+bool Occlusion_Culler::AddObject(uint32_t imageIndex, uint32_t id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, uint32_t action)
+{
+	Occlusion_ObjectHeader *header = objectData[imageIndex];
+
+	if (header->objectCount == maxObjects || id >= visibilitySize)
+	{
+		return false;
+	}
+
+	Occlusion_Object &object = GetObjects(imageIndex)[header->objectCount++];
+
+	object.boundsMin = boundsMin;
+	object.id = id;
+	object.boundsMax = boundsMax;
+	object.action = action;
+
+	return true;
+}
+
+void Occlusion_Culler::AddDrawn(uint32_t imageIndex, uint32_t id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	AddObject(imageIndex, id, boundsMin, boundsMax, OCCLUSION_DRAWN);
+}
+
+bool Occlusion_Culler::AddDeferredInstance(uint32_t imageIndex, uint32_t id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, uint32_t instanceSlot)
+{
+	if (!AddObject(imageIndex, id, boundsMin, boundsMax, OCCLUSION_INSTANCE | (instanceSlot & OCCLUSION_INDEX_MASK)))
+	{
+		return false;
+	}
+
+	++objectsDeferred;
+
+	return true;
+}
+
+bool Occlusion_Culler::AddDeferredDraw(uint32_t imageIndex, uint32_t id, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const VkDrawIndexedIndirectCommand &draw)
+{
+	uint32_t &written = drawsWritten[imageIndex];
+
+	if (written == maxDraws || !AddObject(imageIndex, id, boundsMin, boundsMax, written))
+	{
+		return false;
+	}
+
+	//drawn with no instances unless the test passes it
+	drawData[imageIndex][written] = draw;
+	drawData[imageIndex][written].instanceCount = 0;
+	++written;
+	++objectsDeferred;
+
+	return true;
+}
+
+void Occlusion_Culler::EndFrame(uint32_t imageIndex)
+{
+	Occlusion_ObjectHeader *header = objectData[imageIndex];
+
+	header->dispatch.x = (header->objectCount + TEST_GROUP_SIZE - 1) / TEST_GROUP_SIZE;
+
+	objectsTested += header->objectCount;
+	++framesCulled;
+}
+
+void Occlusion_Culler::RecordCulling(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkImageMemoryBarrier barriers[2] = {};
+	uint32_t levels = (uint32_t)hizSizes.size();
+
+	//the first phase's depth becomes readable, and the pyramid's old contents are discarded
+	barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[0].image = depthImage;
+	barriers[0].subresourceRange.aspectMask = depthAspect;
+	barriers[0].subresourceRange.levelCount = 1;
+	barriers[0].subresourceRange.layerCount = 1;
+
+	barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[1].image = hizImage;
+	barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barriers[1].subresourceRange.levelCount = levels;
+	barriers[1].subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline);
+
+	for (uint32_t level = 0; level < levels; ++level)
+	{
+		Occlusion_DownsamplePush sizes;
+		VkExtent2D source = level ? hizSizes[level - 1] : depthExtent;
+
+		sizes.sourceSize = glm::ivec2((int32_t)source.width, (int32_t)source.height);
+		sizes.destinationSize = glm::ivec2((int32_t)hizSizes[level].width, (int32_t)hizSizes[level].height);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsampleLayout, 0, 1, &downsampleSets[level], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, downsampleLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), &sizes);
+		vkCmdDispatch(commandBuffer, (hizSizes[level].width + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE, (hizSizes[level].height + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE, 1);
+
+		//the level just written is the next one's source, and the test reads them all
+		VkImageMemoryBarrier levelBarrier = barriers[1];
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.subresourceRange.baseMipLevel = level;
+		levelBarrier.subresourceRange.levelCount = 1;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+	}
+
+	Occlusion_TestPush pyramid;
+
+	pyramid.depthSize = glm::vec2((float)depthExtent.width, (float)depthExtent.height);
+	pyramid.mipCount = levels;
+	pyramid.compactBase = compactBase;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, testPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, testLayout, 0, 1, &testSets[imageIndex], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, testLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pyramid), &pyramid);
+	vkCmdDispatchIndirect(commandBuffer, objectBuffers[imageIndex], 0);
+
+	//the second phase draws from what the test wrote, the host reads visibility once the frame completes
+	VkMemoryBarrier results = {};
+	results.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	results.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	results.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+
+	barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+		0, 1, &results, 0, nullptr, 1, barriers);
+}
\ No newline at end of file
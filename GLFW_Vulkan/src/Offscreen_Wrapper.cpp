@@ -0,0 +1,150 @@
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <array>
+
+#include "Offscreen_Wrapper.h"
+#include "Texture.h"
+#include "Buffers.h"
+#include "simple_logger.h"
+
+Offscreen_Wrapper::Offscreen_Wrapper()
+{
+	logDevice = VK_NULL_HANDLE;
+	physDevice = VK_NULL_HANDLE;
+	colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	extent = {};
+	colorImages = {};
+	colorImagesMemory = {};
+	imageViews = {};
+	frameBuffers = {};
+}
+
+Offscreen_Wrapper::~Offscreen_Wrapper()
+{
+	for (size_t i = 0; i < frameBuffers.size(); ++i)
+	{
+		vkDestroyFramebuffer(logDevice, frameBuffers[i], NULL);
+	}
+
+	for (size_t i = 0; i < colorImages.size(); ++i)
+	{
+		vkDestroyImageView(logDevice, imageViews[i], NULL);
+		vkDestroyImage(logDevice, colorImages[i], NULL);
+		vkFreeMemory(logDevice, colorImagesMemory[i], NULL);
+	}
+}
+
+void Offscreen_Wrapper::OffscreenInit(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t width, uint32_t height, uint32_t imageCount)
+{
+	logDevice = logicalDevice;
+	physDevice = physicalDevice;
+	extent.width = width;
+	extent.height = height;
+
+	colorImages.resize(imageCount);
+	colorImagesMemory.resize(imageCount);
+	imageViews.resize(imageCount);
+
+	for (uint32_t i = 0; i < imageCount; ++i)
+	{
+		Texture_Wrapper::CreateImage(width,
+			height,
+			1,
+			colorFormat,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			colorImages[i],
+			colorImagesMemory[i],
+			logDevice,
+			physDevice);
+
+		imageViews[i] = Texture_Wrapper::CreateImageView(colorImages[i], colorFormat, logDevice, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+
+	slog("created %i offscreen color targets of (%i,%i)", imageCount, width, height);
+}
+
+void Offscreen_Wrapper::CreateFrameBuffers(Pipeline* pipe, VkImageView depthImageView)
+{
+	frameBuffers.resize(imageViews.size());
+
+	for (size_t i = 0; i < imageViews.size(); i++)
+	{
+		std::array<VkImageView, 2> attachments = {
+			imageViews[i],
+			depthImageView
+		};
+
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = pipe->renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
+		framebufferInfo.width = extent.width;
+		framebufferInfo.height = extent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(logDevice, &framebufferInfo, nullptr, &frameBuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen framebuffer!");
+		}
+	}
+}
+
+bool Offscreen_Wrapper::SaveImage(uint32_t index, const char *filename, Command *cmd, VkQueue queue)
+{
+	VkDeviceSize imageSize = extent.width * extent.height * 4;
+	VkBuffer readbackBuffer;
+	VkDeviceMemory readbackBufferMemory;
+	void* data;
+	int written;
+
+	if (index >= colorImages.size())
+	{
+		slog("no offscreen image %i to read back", index);
+		return false;
+	}
+
+	Buffer_Wrapper::CreateBuffer(imageSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		readbackBuffer,
+		readbackBufferMemory,
+		logDevice,
+		queue,
+		physDevice);
+
+	VkCommandBuffer commandBuffer = Commands_Wrapper::CommandBeginSingleTime(cmd, logDevice);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, colorImages[index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+	Commands_Wrapper::CommandEndSingleTime(cmd, commandBuffer, queue, logDevice);
+
+	vkMapMemory(logDevice, readbackBufferMemory, 0, imageSize, 0, &data);
+	written = stbi_write_png(filename, extent.width, extent.height, 4, data, extent.width * 4);
+	vkUnmapMemory(logDevice, readbackBufferMemory);
+
+	vkDestroyBuffer(logDevice, readbackBuffer, nullptr);
+	vkFreeMemory(logDevice, readbackBufferMemory, nullptr);
+
+	if (!written)
+	{
+		slog("failed to write offscreen image to %s", filename);
+		return false;
+	}
+
+	slog("wrote offscreen image to %s", filename);
+	return true;
+}
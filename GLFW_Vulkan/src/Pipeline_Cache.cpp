@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Pipeline_Cache.h"
+#include "simple_logger.h"
+
+const static uint32_t PIPELINE_CACHE_MAGIC = 0x48434350; // "PCCH"
+const static uint32_t PIPELINE_CACHE_VERSION = 1;
+
+Pipeline_Cache::Pipeline_Cache()
+{
+	logicalDevice = VK_NULL_HANDLE;
+	cache = VK_NULL_HANDLE;
+	deviceProperties = {};
+	loadedFromDisk = false;
+	loadedBytes = 0;
+	pipelinesCreated = 0;
+	creationMicroseconds = 0;
+	pipelinesAtLastSave = 0;
+	saveInterval = 0.0f;
+}
+
+Pipeline_Cache::~Pipeline_Cache()
+{
+	if (saveThread.joinable())
+	{
+		saveThread.join();
+	}
+
+	if (cache != VK_NULL_HANDLE)
+	{
+		vkDestroyPipelineCache(logicalDevice, cache, nullptr);
+	}
+}
+
+uint64_t Pipeline_Cache::HashData(const uint8_t *data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+bool Pipeline_Cache::ValidateHeader(const Pipeline_CacheFileHeader &header, const uint8_t *data, size_t size)
+{
+	uint32_t driverHeader[4];
+
+	if (header.magic != PIPELINE_CACHE_MAGIC || header.version != PIPELINE_CACHE_VERSION)
+	{
+		slog("pipeline cache file has an unknown format");
+		return false;
+	}
+
+	if (header.vendorID != deviceProperties.vendorID ||
+		header.deviceID != deviceProperties.deviceID ||
+		header.driverVersion != deviceProperties.driverVersion ||
+		memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		slog("pipeline cache was written by a different device or driver, discarding");
+		return false;
+	}
+
+	if (header.dataSize != size || header.dataHash != HashData(data, size))
+	{
+		slog("pipeline cache data is truncated or corrupt, discarding");
+		return false;
+	}
+
+	//the driver's own header: length, version, vendorID, deviceID, then the cache uuid
+	if (size < sizeof(driverHeader) + VK_UUID_SIZE)
+	{
+		return false;
+	}
+
+	memcpy(driverHeader, data, sizeof(driverHeader));
+
+	if (driverHeader[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		driverHeader[2] != deviceProperties.vendorID ||
+		driverHeader[3] != deviceProperties.deviceID ||
+		memcmp(data + sizeof(driverHeader), deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		slog("pipeline cache driver header does not match this device, discarding");
+		return false;
+	}
+
+	return true;
+}
+
+void Pipeline_Cache::Pipeline_CacheInit(VkPhysicalDevice physDevice, VkDevice device, const char *path, float saveSeconds)
+{
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	std::vector<uint8_t> initialData;
+	Pipeline_CacheFileHeader header = {};
+	FILE *file;
+
+	logicalDevice = device;
+	cachePath = path;
+	saveInterval = saveSeconds;
+	lastSave = std::chrono::steady_clock::now();
+
+	vkGetPhysicalDeviceProperties(physDevice, &deviceProperties);
+
+	file = fopen(path, "rb");
+
+	if (file)
+	{
+		if (fread(&header, sizeof(header), 1, file) == 1 && header.dataSize < (1ULL << 31))
+		{
+			initialData.resize((size_t)header.dataSize);
+
+			if (initialData.empty() || fread(initialData.data(), 1, initialData.size(), file) != initialData.size() || !ValidateHeader(header, initialData.data(), initialData.size()))
+			{
+				initialData.clear();
+			}
+		}
+
+		fclose(file);
+	}
+	else
+	{
+		slog("no pipeline cache at %s, starting cold", path);
+	}
+
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = initialData.size();
+	cacheInfo.pInitialData = initialData.empty() ? NULL : initialData.data();
+
+	if (vkCreatePipelineCache(logicalDevice, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+	{
+		slog("failed to create pipeline cache from disk data, retrying empty");
+
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = NULL;
+		initialData.clear();
+
+		if (vkCreatePipelineCache(logicalDevice, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+		{
+			slog("failed to create pipeline cache!");
+			cache = VK_NULL_HANDLE;
+			return;
+		}
+	}
+
+	loadedFromDisk = !initialData.empty();
+	loadedBytes = initialData.size();
+
+	if (loadedFromDisk)
+	{
+		slog("loaded %i bytes of pipeline cache from %s", (int)loadedBytes, path);
+	}
+}
+
+void Pipeline_Cache::RecordCreation(uint32_t pipelineCount, double milliseconds)
+{
+	pipelinesCreated += pipelineCount;
+	creationMicroseconds += (uint64_t)(milliseconds * 1000.0);
+
+	slog("created %i pipelines in %f ms (%s cache), %i total in %f ms",
+		pipelineCount,
+		milliseconds,
+		loadedFromDisk ? "warm" : "cold",
+		pipelinesCreated.load(),
+		GetCreationMilliseconds());
+}
+
+bool Pipeline_Cache::WriteFileAtomic(const std::string &path, const std::vector<uint8_t> &contents)
+{
+	std::string tempPath = path + ".tmp";
+	FILE *file = fopen(tempPath.c_str(), "wb");
+
+	if (!file)
+	{
+		slog("failed to open %s for writing", tempPath.c_str());
+		return false;
+	}
+
+	if (fwrite(contents.data(), 1, contents.size(), file) != contents.size())
+	{
+		slog("failed to write pipeline cache");
+		fclose(file);
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	fflush(file);
+#ifndef _WIN32
+	fsync(fileno(file));
+#endif
+	fclose(file);
+
+	//the old cache stays intact until the new one is fully on disk
+#ifdef _WIN32
+	if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+	if (rename(tempPath.c_str(), path.c_str()) != 0)
+#endif
+	{
+		slog("failed to replace pipeline cache %s", path.c_str());
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void Pipeline_Cache::WriteSnapshot()
+{
+	Pipeline_CacheFileHeader header = {};
+	std::vector<uint8_t> contents;
+	size_t dataSize = 0;
+
+	if (cache == VK_NULL_HANDLE || vkGetPipelineCacheData(logicalDevice, cache, &dataSize, NULL) != VK_SUCCESS || !dataSize)
+	{
+		return;
+	}
+
+	contents.resize(sizeof(header) + dataSize);
+
+	if (vkGetPipelineCacheData(logicalDevice, cache, &dataSize, contents.data() + sizeof(header)) != VK_SUCCESS)
+	{
+		slog("failed to read pipeline cache data");
+		return;
+	}
+
+	contents.resize(sizeof(header) + dataSize);
+
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = dataSize;
+	header.dataHash = HashData(contents.data() + sizeof(header), dataSize);
+
+	memcpy(contents.data(), &header, sizeof(header));
+
+	if (WriteFileAtomic(cachePath, contents))
+	{
+		slog("saved %i bytes of pipeline cache to %s", (int)dataSize, cachePath.c_str());
+	}
+}
+
+void Pipeline_Cache::Save()
+{
+	if (saveThread.joinable())
+	{
+		saveThread.join();
+	}
+
+	pipelinesAtLastSave = pipelinesCreated.load();
+	lastSave = std::chrono::steady_clock::now();
+
+	WriteSnapshot();
+}
+
+void Pipeline_Cache::Update()
+{
+	if (saveInterval <= 0.0f || pipelinesCreated.load() == pipelinesAtLastSave)
+	{
+		return;
+	}
+
+	if (std::chrono::duration<float>(std::chrono::steady_clock::now() - lastSave).count() < saveInterval)
+	{
+		return;
+	}
+
+	if (saveThread.joinable())
+	{
+		saveThread.join();
+	}
+
+	pipelinesAtLastSave = pipelinesCreated.load();
+	lastSave = std::chrono::steady_clock::now();
+
+	saveThread = std::thread(&Pipeline_Cache::WriteSnapshot, this);
+}
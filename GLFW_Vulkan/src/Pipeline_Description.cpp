@@ -0,0 +1,138 @@
+#include "Pipeline_Description.h"
+
+static void HashBytes(uint64_t &hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t*)data;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+template<typename T>
+static void HashValue(uint64_t &hash, const T &value)
+{
+	HashBytes(hash, &value, sizeof(value));
+}
+
+uint64_t Pipeline_Description::Hash() const
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	HashBytes(hash, vertFile.data(), vertFile.size());
+	HashValue(hash, (uint32_t)vertFile.size());
+	HashBytes(hash, fragFile.data(), fragFile.size());
+	HashValue(hash, (uint32_t)fragFile.size());
+	HashValue(hash, variantKey);
+
+	//hashed field by field, the vulkan structs carry no padding but this one does
+	for (const VkVertexInputBindingDescription &binding : bindings)
+	{
+		HashValue(hash, binding.binding);
+		HashValue(hash, binding.stride);
+		HashValue(hash, binding.inputRate);
+	}
+
+	for (const VkVertexInputAttributeDescription &attribute : attributes)
+	{
+		HashValue(hash, attribute.location);
+		HashValue(hash, attribute.binding);
+		HashValue(hash, attribute.format);
+		HashValue(hash, attribute.offset);
+	}
+
+	HashValue(hash, topology);
+	HashValue(hash, polygonMode);
+	HashValue(hash, cullMode);
+	HashValue(hash, frontFace);
+	HashValue(hash, depthTest);
+	HashValue(hash, depthWrite);
+	HashValue(hash, depthCompare);
+	HashValue(hash, blendEnable);
+	HashValue(hash, srcColorBlend);
+	HashValue(hash, dstColorBlend);
+	HashValue(hash, colorBlendOp);
+	HashValue(hash, srcAlphaBlend);
+	HashValue(hash, dstAlphaBlend);
+	HashValue(hash, alphaBlendOp);
+
+	for (VkDescriptorSetLayout layout : setLayouts)
+	{
+		HashValue(hash, layout);
+	}
+
+	for (const VkPushConstantRange &range : pushConstants)
+	{
+		HashValue(hash, range.stageFlags);
+		HashValue(hash, range.offset);
+		HashValue(hash, range.size);
+	}
+
+	HashValue(hash, renderPass);
+	HashValue(hash, subpass);
+
+	return hash;
+}
+
+bool Pipeline_Description::operator==(const Pipeline_Description &other) const
+{
+	if (vertFile != other.vertFile || fragFile != other.fragFile ||
+		variantKey != other.variantKey ||
+		bindings.size() != other.bindings.size() ||
+		attributes.size() != other.attributes.size() ||
+		setLayouts != other.setLayouts ||
+		pushConstants.size() != other.pushConstants.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < pushConstants.size(); ++i)
+	{
+		if (pushConstants[i].stageFlags != other.pushConstants[i].stageFlags ||
+			pushConstants[i].offset != other.pushConstants[i].offset ||
+			pushConstants[i].size != other.pushConstants[i].size)
+		{
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < bindings.size(); ++i)
+	{
+		if (bindings[i].binding != other.bindings[i].binding ||
+			bindings[i].stride != other.bindings[i].stride ||
+			bindings[i].inputRate != other.bindings[i].inputRate)
+		{
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < attributes.size(); ++i)
+	{
+		if (attributes[i].location != other.attributes[i].location ||
+			attributes[i].binding != other.attributes[i].binding ||
+			attributes[i].format != other.attributes[i].format ||
+			attributes[i].offset != other.attributes[i].offset)
+		{
+			return false;
+		}
+	}
+
+	return topology == other.topology &&
+		polygonMode == other.polygonMode &&
+		cullMode == other.cullMode &&
+		frontFace == other.frontFace &&
+		depthTest == other.depthTest &&
+		depthWrite == other.depthWrite &&
+		depthCompare == other.depthCompare &&
+		blendEnable == other.blendEnable &&
+		srcColorBlend == other.srcColorBlend &&
+		dstColorBlend == other.dstColorBlend &&
+		colorBlendOp == other.colorBlendOp &&
+		srcAlphaBlend == other.srcAlphaBlend &&
+		dstAlphaBlend == other.dstAlphaBlend &&
+		alphaBlendOp == other.alphaBlendOp &&
+		renderPass == other.renderPass &&
+		subpass == other.subpass;
+}
@@ -1,216 +1,1015 @@
+#include <chrono>
 #include <fstream>
+#include <string.h>
 
 #include "Swapchain_Wrapper.h"
 #include "Pipeline_Wrapper.h"
 #include "simple_logger.h"
 #include "Buffers.h"
+#include "Profiler.h"
+
+/**
+ * @brief everything vkCreateGraphicsPipelines points into, kept together so batches can build many at once
+ */
+struct Pipeline_CreateState
+{
+	VkPipelineShaderStageCreateInfo			shaderStages[2];
+	VkPipelineVertexInputStateCreateInfo	vertexInputInfo;
+	VkPipelineInputAssemblyStateCreateInfo	inputAssembly;
+	VkPipelineViewportStateCreateInfo		viewportState;
+	VkPipelineRasterizationStateCreateInfo	rasterizer;
+	VkPipelineMultisampleStateCreateInfo	multisampling;
+	VkPipelineDepthStencilStateCreateInfo	depthStencil;
+	VkPipelineColorBlendAttachmentState		colorBlendAttachment;
+	VkPipelineColorBlendStateCreateInfo		colorBlending;
+	VkPipelineDynamicStateCreateInfo		dynamicState;
+	VkSpecializationMapEntry				specEntries[SHADER_VARIANT_FEATURES];
+	VkBool32								specData[SHADER_VARIANT_FEATURES];
+	VkSpecializationInfo					specInfo;
+	VkGraphicsPipelineCreateInfo			pipelineInfo;
+};
+
+const static uint32_t SPIRV_MAGIC = 0x07230203;
+
+//every pipeline takes these from the command buffer, so a new render extent, line width, depth bias or stencil reference
+//never forces a rebuild, all are core and cost nothing to leave dynamic
+const static VkDynamicState pipelineDynamicStates[] = {
+	VK_DYNAMIC_STATE_VIEWPORT,
+	VK_DYNAMIC_STATE_SCISSOR,
+	VK_DYNAMIC_STATE_LINE_WIDTH,
+	VK_DYNAMIC_STATE_DEPTH_BIAS,
+	VK_DYNAMIC_STATE_STENCIL_REFERENCE
+};
+
+static void FillCreateState(const Pipeline_Description &desc, VkShaderModule vertModule, VkShaderModule fragModule, VkPipelineLayout layout, Pipeline_CreateState &state)
+{
+	state = {};
+
+	//entries for ids a shader does not declare are ignored, so every stage gets the full set
+	for (uint32_t i = 0; i < SHADER_VARIANT_FEATURES; ++i)
+	{
+		state.specEntries[i].constantID = i;
+		state.specEntries[i].offset = i * sizeof(VkBool32);
+		state.specEntries[i].size = sizeof(VkBool32);
+		state.specData[i] = (desc.variantKey >> i) & 1 ? VK_TRUE : VK_FALSE;
+	}
+
+	state.specInfo.mapEntryCount = SHADER_VARIANT_FEATURES;
+	state.specInfo.pMapEntries = state.specEntries;
+	state.specInfo.dataSize = sizeof(state.specData);
+	state.specInfo.pData = state.specData;
+
+	state.shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	state.shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	state.shaderStages[0].module = vertModule;
+	state.shaderStages[0].pName = "main";
+	state.shaderStages[0].pSpecializationInfo = &state.specInfo;
+
+	state.shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	state.shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	state.shaderStages[1].module = fragModule;
+	state.shaderStages[1].pName = "main";
+	state.shaderStages[1].pSpecializationInfo = &state.specInfo;
+
+	state.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	state.vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings.size());
+	state.vertexInputInfo.pVertexBindingDescriptions = desc.bindings.empty() ? NULL : desc.bindings.data();
+	state.vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes.size());
+	state.vertexInputInfo.pVertexAttributeDescriptions = desc.attributes.empty() ? NULL : desc.attributes.data();
+
+	state.inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	state.inputAssembly.topology = desc.topology;
+	state.inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	//the counts still have to be given, the values come from vkCmdSetViewport/vkCmdSetScissor
+	state.viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	state.viewportState.viewportCount = 1;
+	state.viewportState.scissorCount = 1;
+
+	state.rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	state.rasterizer.depthClampEnable = VK_FALSE;
+	state.rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	state.rasterizer.polygonMode = desc.polygonMode;
+	//dynamic, ignored here
+	state.rasterizer.lineWidth = 1.0f;
+	state.rasterizer.cullMode = desc.cullMode;
+	state.rasterizer.frontFace = desc.frontFace;
+	state.rasterizer.depthBiasEnable = VK_FALSE;
+
+	state.multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	state.multisampling.sampleShadingEnable = VK_FALSE;
+	state.multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	state.depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	state.depthStencil.depthTestEnable = desc.depthTest;
+	state.depthStencil.depthWriteEnable = desc.depthWrite;
+	state.depthStencil.depthCompareOp = desc.depthCompare;
+	state.depthStencil.depthBoundsTestEnable = VK_FALSE;
+	state.depthStencil.stencilTestEnable = VK_FALSE;
+
+	state.colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	state.colorBlendAttachment.blendEnable = desc.blendEnable;
+	state.colorBlendAttachment.srcColorBlendFactor = desc.srcColorBlend;
+	state.colorBlendAttachment.dstColorBlendFactor = desc.dstColorBlend;
+	state.colorBlendAttachment.colorBlendOp = desc.colorBlendOp;
+	state.colorBlendAttachment.srcAlphaBlendFactor = desc.srcAlphaBlend;
+	state.colorBlendAttachment.dstAlphaBlendFactor = desc.dstAlphaBlend;
+	state.colorBlendAttachment.alphaBlendOp = desc.alphaBlendOp;
+
+	state.colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	state.colorBlending.logicOpEnable = VK_FALSE;
+	state.colorBlending.logicOp = VK_LOGIC_OP_COPY;
+	state.colorBlending.attachmentCount = 1;
+	state.colorBlending.pAttachments = &state.colorBlendAttachment;
+
+	state.dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	state.dynamicState.dynamicStateCount = sizeof(pipelineDynamicStates) / sizeof(pipelineDynamicStates[0]);
+	state.dynamicState.pDynamicStates = pipelineDynamicStates;
+
+	state.pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	state.pipelineInfo.stageCount = 2;
+	state.pipelineInfo.pStages = state.shaderStages;
+	state.pipelineInfo.pVertexInputState = &state.vertexInputInfo;
+	state.pipelineInfo.pInputAssemblyState = &state.inputAssembly;
+	state.pipelineInfo.pViewportState = &state.viewportState;
+	state.pipelineInfo.pRasterizationState = &state.rasterizer;
+	state.pipelineInfo.pMultisampleState = &state.multisampling;
+	state.pipelineInfo.pDepthStencilState = &state.depthStencil;
+	state.pipelineInfo.pColorBlendState = &state.colorBlending;
+	state.pipelineInfo.pDynamicState = &state.dynamicState;
+	state.pipelineInfo.layout = layout;
+	state.pipelineInfo.renderPass = desc.renderPass;
+	state.pipelineInfo.subpass = desc.subpass;
+	state.pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+}
 
 Pipeline_Wrapper::Pipeline_Wrapper()
 {
 	shaderWrapper = new Shader_Wrapper();	
 	logicalDevice = VK_NULL_HANDLE;
+	renderPass = VK_NULL_HANDLE;
+	loadRenderPass = VK_NULL_HANDLE;
+	graphicsPipelineIndex = PIPELINE_HANDLE_INVALID;
+	pipelineCache = NULL;
+	shaderArchive = NULL;
+	lookupHits = 0;
+	pipelineBuilds = 0;
+	pipelineRebuilds = 0;
+	jobSystem = NULL;
+	stopCompiling = false;
+	compilesPending = 0;
+	compiledSinceUpdate = false;
+	currentFrame = 0;
+	indexedArraySize = 0;
 }
 
 
-void Pipeline_Wrapper::Pipeline_WrapperInit(uint32_t maxPipelines)
+void Pipeline_Wrapper::Pipeline_WrapperInit(VkDevice device, VkPhysicalDevice physDevice, VkFormat format, Job_System *jobs, VkImageLayout finalLayout)
+{
+	logicalDevice = device;
+	jobSystem = jobs;
+
+	RenderPassSetup(format, physDevice, device, finalLayout);
+}
+
+Pipeline_Wrapper::~Pipeline_Wrapper()
 {
-	if (maxPipelines == 0)
 	{
-		slog("cannot initialize zero pipelines");
-		return;
+		std::lock_guard<std::mutex> lock(compileMutex);
+		stopCompiling = true;
+		compileQueue.clear();
+	}
+
+	//jobs for the dropped compiles find the queue empty and return
+	if (jobSystem)
+	{
+		jobSystem->Wait(&compilesRunning);
+	}
+
+	for (size_t i = 0; i < pipelineList.size(); ++i)
+	{
+		if (pipelineList[i].inUse)
+		{
+			pipelineList[i].inUse = false;
+
+			if (pipelineList[i].graphicsPipeline != VK_NULL_HANDLE)
+			{
+				vkDestroyPipeline(logicalDevice, pipelineList[i].graphicsPipeline, NULL);
+			}
+
+			if (pipelineList[i].rebuiltPipeline != VK_NULL_HANDLE)
+			{
+				vkDestroyPipeline(logicalDevice, pipelineList[i].rebuiltPipeline, NULL);
+			}
+		}
+	}
+
+	for (Pipeline_Retired &retired : retiredObjects)
+	{
+		if (retired.pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(logicalDevice, retired.pipeline, NULL);
+		}
+
+		if (retired.module != VK_NULL_HANDLE)
+		{
+			vkDestroyShaderModule(logicalDevice, retired.module, NULL);
+		}
+	}
+
+	for (auto &layout : layoutCache)
+	{
+		vkDestroyPipelineLayout(logicalDevice, layout.second, NULL);
 	}
 
-	maxPipes = maxPipelines;
+	for (auto &setLayout : setLayoutCache)
+	{
+		vkDestroyDescriptorSetLayout(logicalDevice, setLayout.second, NULL);
+	}
 
-	graphicsPipelineIndex = 0;
+	for (auto &shader : shaderModules)
+	{
+		vkDestroyShaderModule(logicalDevice, shader.second.module, NULL);
+	}
+
+	if (renderPass != VK_NULL_HANDLE)
+	{
+		vkDestroyRenderPass(logicalDevice, renderPass, NULL);
+	}
 
-	pipelineList.resize(maxPipes);
+	if (loadRenderPass != VK_NULL_HANDLE)
+	{
+		vkDestroyRenderPass(logicalDevice, loadRenderPass, NULL);
+	}
 }
 
-Pipeline_Wrapper::~Pipeline_Wrapper()
+Pipeline_Description Pipeline_Wrapper::DefaultDescription(const char *vertFile, const char *fragFile)
+{
+	Pipeline_Description desc;
+	auto attrDesc = GetAttributeDescriptions();
+
+	desc.vertFile = vertFile;
+	desc.fragFile = fragFile;
+	desc.bindings.push_back(GetBindingDescription());
+	desc.attributes.assign(attrDesc.begin(), attrDesc.end());
+	desc.renderPass = renderPass;
+
+	if (!ReflectDescription(desc))
+	{
+		throw std::runtime_error("shader interfaces of " + desc.vertFile + " and " + desc.fragFile + " do not match!");
+	}
+
+	return desc;
+}
+
+void Pipeline_Wrapper::PipelineLoad(const char *vertFile, const char *fragFile)
+{
+	graphicsPipelineIndex = RequestPipeline(DefaultDescription(vertFile, fragFile));
+}
+
+void Pipeline_Wrapper::ReflectSetLayouts(const Shader_Reflection &reflection, std::vector<VkDescriptorSetLayout> &setLayouts)
 {
-	if (pipelineList.size())
-	{	
-		for (int i = 0; i < pipelineList.size(); ++i)
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+	std::vector<std::vector<VkDescriptorBindingFlagsEXT>> setFlags;
+
+	for (const Shader_Binding &binding : reflection.bindings)
+	{
+		VkDescriptorSetLayoutBinding layoutBinding = {};
+		VkDescriptorBindingFlagsEXT flags = 0;
+
+		layoutBinding.binding = binding.binding;
+		layoutBinding.descriptorType = binding.type;
+		//runtime sized arrays get a single descriptor until the layout is built for indexing
+		layoutBinding.descriptorCount = binding.count ? binding.count : 1;
+		layoutBinding.stageFlags = binding.stages;
+
+		//only the slots a draw actually indexes have to be valid, and they may be written while the set is bound
+		if (!binding.count && indexedArraySize)
 		{
-			if (pipelineList[i].inUse)
-			{
-				pipelineList[i].inUse = false;
+			layoutBinding.descriptorCount = indexedArraySize;
+			flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+		}
 
-				vkDestroyRenderPass(pipelineList[i].device, pipelineList[i].renderPass, NULL);
-				
-				vkDestroyPipeline(logicalDevice, pipelineList[i].graphicsPipeline, NULL);
+		if (sets.size() <= binding.set)
+		{
+			sets.resize(binding.set + 1);
+			setFlags.resize(binding.set + 1);
+		}
+		sets[binding.set].push_back(layoutBinding);
+		setFlags[binding.set].push_back(flags);
+	}
+
+	//set numbers are kept as declared so bindings grouped by update frequency stay in their own sets
+	setLayouts.clear();
+
+	for (size_t set = 0; set < sets.size(); ++set)
+	{
+		bool indexed = false;
 
-				vkDestroyPipelineLayout(logicalDevice, pipelineList[i].pipelineLayout, NULL);
+		for (VkDescriptorBindingFlagsEXT flags : setFlags[set])
+		{
+			indexed = indexed || flags;
+		}
+
+		setLayouts.push_back(indexed ? GetSetLayout(sets[set], setFlags[set]) : GetSetLayout(sets[set]));
+	}
+}
+
+bool Pipeline_Wrapper::ReflectDescription(Pipeline_Description &description)
+{
+	Shader_Reflection reflection = GetShaderReflection(description.vertFile);
+
+	if (!Shader_Wrapper::MergeReflection(reflection, GetShaderReflection(description.fragFile)))
+	{
+		return false;
+	}
+
+	ReflectSetLayouts(reflection, description.setLayouts);
+
+	description.pushConstants = reflection.pushConstants;
+
+	for (const Shader_VertexInput &input : reflection.vertexInputs)
+	{
+		bool found = false;
+
+		for (const VkVertexInputAttributeDescription &attribute : description.attributes)
+		{
+			if (attribute.location == input.location)
+			{
+				found = true;
+
+				if (input.format != VK_FORMAT_UNDEFINED && attribute.format != input.format)
+				{
+					slog("%s: vertex input %i format %i does not match attribute format %i", description.vertFile.c_str(), input.location, input.format, attribute.format);
+				}
+				break;
 			}
 		}
+
+		if (!found)
+		{
+			slog("%s: vertex input %i has no matching attribute", description.vertFile.c_str(), input.location);
+		}
 	}
+
+	return true;
 }
 
-void Pipeline_Wrapper::PipelineLoad(VkDevice device, char*  vertFile, char* fragFile, VkFormat format, VkPhysicalDevice physDevice, VkExtent2D extents, VkDescriptorSetLayout descriptorSetLayout)
+VkPipeline Pipeline_Wrapper::CreateComputePipeline(const std::string &compFile, VkPipelineLayout &layout, std::vector<VkDescriptorSetLayout> &setLayouts)
 {
-	auto bindDesc = GetBindingDescription();
-	auto attrDesc = GetAttributeDescriptions();
-	
-	Pipeline *pipe = NewPipe();
-
-	std::vector<char> vertShaderCode = ReadShaderFile("shaders/vert.spv");
-	std::vector<char> fragShaderCode = ReadShaderFile("shaders/frag.spv");
-
-	VkShaderModule vertShaderModule = shaderWrapper->CreateShaderModule(vertShaderCode, device );
-	VkShaderModule fragShaderModule = shaderWrapper->CreateShaderModule(fragShaderCode, device );
-
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertShaderModule;
-	vertShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragShaderModule;
-	fragShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindDesc;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attrDesc.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attrDesc.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)extents.width;
-	viewport.height = (float)extents.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = {};
-	scissor.offset = { 0, 0 };
-	scissor.extent = extents;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-	depthStencil.depthBoundsTestEnable = VK_FALSE;
-	depthStencil.stencilTestEnable = VK_FALSE;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.logicOp = VK_LOGIC_OP_COPY;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-	colorBlending.blendConstants[0] = 0.0f;
-	colorBlending.blendConstants[1] = 0.0f;
-	colorBlending.blendConstants[2] = 0.0f;
-	colorBlending.blendConstants[3] = 0.0f;
+	Shader_Reflection reflection = GetShaderReflection(compFile);
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	ReflectSetLayouts(reflection, setLayouts);
+	layout = GetLayout(setLayouts, reflection.pushConstants);
+
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = GetShaderModule(compFile);
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = layout;
+
+	auto createStart = std::chrono::steady_clock::now();
+
+	if (vkCreateComputePipelines(logicalDevice, pipelineCache ? pipelineCache->GetCache() : VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		slog("failed to create compute pipeline for %s", compFile.c_str());
+		return VK_NULL_HANDLE;
+	}
+
+	if (pipelineCache)
+	{
+		pipelineCache->RecordCreation(1, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - createStart).count());
+	}
+
+	++pipelineBuilds;
+
+	return pipeline;
+}
+
+VkDescriptorSetLayout Pipeline_Wrapper::GetSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings, const std::vector<VkDescriptorBindingFlagsEXT> &bindingFlags)
+{
+	std::vector<uint32_t> key;
+	bool updateAfterBind = false;
+
+	for (size_t i = 0; i < bindings.size(); ++i)
+	{
+		key.push_back(bindings[i].binding);
+		key.push_back(bindings[i].descriptorType);
+		key.push_back(bindings[i].descriptorCount);
+		key.push_back(bindings[i].stageFlags);
+		key.push_back(i < bindingFlags.size() ? bindingFlags[i] : 0);
+
+		updateAfterBind = updateAfterBind || (i < bindingFlags.size() && (bindingFlags[i] & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT));
+	}
+
+	auto found = setLayoutCache.find(key);
+
+	if (found != setLayoutCache.end())
+	{
+		return found->second;
+	}
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.empty() ? NULL : bindings.data();
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+
+	if (!bindingFlags.empty())
+	{
+		flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		flagsInfo.pBindingFlags = bindingFlags.data();
+
+		layoutInfo.pNext = &flagsInfo;
+	}
+
+	//sets of this layout have to come from a pool created with the matching update after bind flag
+	if (updateAfterBind)
+	{
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	}
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+
+	setLayoutCache[key] = setLayout;
+
+	return setLayout;
+}
+
+PipelineHandle Pipeline_Wrapper::FindPipeline(const Pipeline_Description &description, uint64_t hash)
+{
+	auto found = pipelineLookup.find(hash);
+
+	if (found == pipelineLookup.end())
+	{
+		return PIPELINE_HANDLE_INVALID;
+	}
+
+	//a hash collision only costs a compare, it never hands back the wrong pipeline
+	for (PipelineHandle handle : found->second)
+	{
+		if (pipelineList[handle].description == description)
+		{
+			return handle;
+		}
+	}
+
+	return PIPELINE_HANDLE_INVALID;
+}
+
+VkShaderModule Pipeline_Wrapper::GetShaderModule(const std::string &filename)
+{
+	std::lock_guard<std::mutex> lock(moduleMutex);
 
+	return LoadShader(filename).module;
+}
+
+bool Pipeline_Wrapper::HasShader(const std::string &filename)
+{
+	size_t codeSize;
+
+	{
+		std::lock_guard<std::mutex> lock(moduleMutex);
+
+		if (shaderModules.count(filename))
+		{
+			return true;
+		}
+	}
+
+	if (shaderArchive && shaderArchive->GetCode(filename, &codeSize))
+	{
+		return true;
+	}
+
+	std::ifstream file(filename, std::ios::binary);
+
+	return file.is_open();
+}
+
+Shader_Reflection Pipeline_Wrapper::GetShaderReflection(const std::string &filename)
+{
+	std::lock_guard<std::mutex> lock(moduleMutex);
+
+	return LoadShader(filename).reflection;
+}
+
+Pipeline_Shader& Pipeline_Wrapper::LoadShader(const std::string &filename)
+{
+	auto found = shaderModules.find(filename);
+
+	if (found != shaderModules.end())
+	{
+		return found->second;
+	}
+
+	Pipeline_Shader shader;
+	std::vector<char> looseCode;
+	const uint32_t *code = NULL;
+	size_t codeSize = 0;
+	bool reflected = false;
+
+	//a hot reloaded shader is newer than the archive built at startup
+	if (shaderArchive && !looseShaders.count(filename))
+	{
+		code = shaderArchive->GetCode(filename, &codeSize);
+		reflected = code && shaderArchive->GetReflection(filename, shader.reflection);
+	}
+
+	if (!code)
+	{
+		looseCode = Shader_Wrapper::ReadShaderFile(filename);
+
+		if (looseCode.empty())
+		{
+			throw std::runtime_error("failed to open shader file " + filename);
+		}
+
+		code = reinterpret_cast<const uint32_t*>(looseCode.data());
+		codeSize = looseCode.size();
+	}
+
+	//a half written file from a hot reload must not reach the driver
+	if (codeSize < sizeof(uint32_t) || codeSize % 4 != 0 || code[0] != SPIRV_MAGIC)
+	{
+		throw std::runtime_error("invalid SPIR-V in " + filename);
+	}
+
+	if (!reflected && !Shader_Wrapper::Reflect(code, codeSize / 4, shader.reflection))
+	{
+		throw std::runtime_error("failed to reflect " + filename);
+	}
+
+	shader.module = shaderWrapper->CreateShaderModule(code, codeSize, logicalDevice);
+
+	if (shader.module == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("failed to create shader module for " + filename);
+	}
+
+	return shaderModules[filename] = shader;
+}
+
+VkPipelineLayout Pipeline_Wrapper::GetLayout(const std::vector<VkDescriptorSetLayout> &setLayouts, const std::vector<VkPushConstantRange> &pushConstants)
+{
+	std::vector<uint64_t> key;
+
+	for (VkDescriptorSetLayout setLayout : setLayouts)
+	{
+		key.push_back((uint64_t)setLayout);
+	}
+
+	for (const VkPushConstantRange &range : pushConstants)
+	{
+		key.push_back(range.stageFlags);
+		key.push_back(((uint64_t)range.offset << 32) | range.size);
+	}
+
+	auto found = layoutCache.find(key);
+
+	if (found != layoutCache.end())
+	{
+		return found->second;
+	}
+
+	VkPipelineLayout layout = VK_NULL_HANDLE;
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-
-	RenderPassSetup(format, physDevice, device);
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = setLayouts.empty() ? NULL : setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+	pipelineLayoutInfo.pPushConstantRanges = pushConstants.empty() ? NULL : pushConstants.data();
 
-	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineList[graphicsPipelineIndex].pipelineLayout) != VK_SUCCESS) 
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) 
 	{
 		throw std::runtime_error("failed to create pipeline layout!");
 	}
 
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.layout = pipelineList[graphicsPipelineIndex].pipelineLayout;
-	pipelineInfo.renderPass = pipelineList[graphicsPipelineIndex].renderPass;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	layoutCache[key] = layout;
+
+	return layout;
+}
+
+PipelineHandle Pipeline_Wrapper::AcquirePipeline(const Pipeline_Description &description)
+{
+	std::vector<Pipeline_Description> descriptions(1, description);
+	std::vector<PipelineHandle> handles;
+
+	AcquirePipelines(descriptions, handles);
+
+	return handles[0];
+}
+
+Pipeline* Pipeline_Wrapper::RegisterPipeline(const Pipeline_Description &description, PipelineHandle *handle)
+{
+	Pipeline_Description desc = description;
+
+	if (desc.renderPass == VK_NULL_HANDLE)
+	{
+		desc.renderPass = renderPass;
+	}
+
+	uint64_t hash = desc.Hash();
+
+	*handle = FindPipeline(desc, hash);
+
+	if (*handle != PIPELINE_HANDLE_INVALID)
+	{
+		++lookupHits;
+		return NULL;
+	}
+
+	VkPipelineLayout layout = GetLayout(desc.setLayouts, desc.pushConstants);
+
+	//registered before creation so duplicates requested meanwhile resolve to it
+	*handle = (PipelineHandle)pipelineList.size();
+	pipelineList.emplace_back();
+	pipelineLookup[hash].push_back(*handle);
+
+	Pipeline &pipe = pipelineList.back();
+	pipe.hash = hash;
+	pipe.description = desc;
+	pipe.renderPass = desc.renderPass;
+	pipe.pipelineLayout = layout;
+	pipe.device = logicalDevice;
+	pipe.inUse = true;
+
+	return &pipe;
+}
+
+void Pipeline_Wrapper::AcquirePipelines(const std::vector<Pipeline_Description> &descriptions, std::vector<PipelineHandle> &handles)
+{
+	std::vector<Pipeline*> created;
+
+	handles.resize(descriptions.size());
+
+	for (size_t i = 0; i < descriptions.size(); ++i)
+	{
+		Pipeline *pipe = RegisterPipeline(descriptions[i], &handles[i]);
+
+		if (pipe)
+		{
+			created.push_back(pipe);
+		}
+	}
+
+	if (!created.empty())
+	{
+		std::vector<Pipeline_CreateState> states(created.size());
+		std::vector<VkGraphicsPipelineCreateInfo> createInfos(created.size());
+		std::vector<VkPipeline> results(created.size(), VK_NULL_HANDLE);
+
+		for (size_t i = 0; i < created.size(); ++i)
+		{
+			FillCreateState(created[i]->description,
+				GetShaderModule(created[i]->description.vertFile),
+				GetShaderModule(created[i]->description.fragFile),
+				created[i]->pipelineLayout,
+				states[i]);
+
+			createInfos[i] = states[i].pipelineInfo;
+		}
+
+		auto createStart = std::chrono::steady_clock::now();
+
+		if (vkCreateGraphicsPipelines(logicalDevice, pipelineCache ? pipelineCache->GetCache() : VK_NULL_HANDLE, static_cast<uint32_t>(createInfos.size()), createInfos.data(), nullptr, results.data()) != VK_SUCCESS) 
+		{
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+
+		if (pipelineCache)
+		{
+			pipelineCache->RecordCreation(static_cast<uint32_t>(created.size()), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - createStart).count());
+		}
+
+		pipelineBuilds += static_cast<uint32_t>(created.size());
+
+		for (size_t i = 0; i < created.size(); ++i)
+		{
+			created[i]->graphicsPipeline = results[i];
+			created[i]->status = PS_Ready;
+		}
+	}
+
+	//anything already queued as a job is waited for so the caller always gets a usable pipeline
+	for (PipelineHandle handle : handles)
+	{
+		if (!WaitForPipeline(handle))
+		{
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+	}
+}
+
+PipelineHandle Pipeline_Wrapper::RequestVariant(PipelineHandle base, uint32_t variantKey)
+{
+	if (base >= pipelineList.size())
+	{
+		return PIPELINE_HANDLE_INVALID;
+	}
+
+	Pipeline_Description desc = pipelineList[base].description;
+
+	if (desc.variantKey == variantKey)
+	{
+		return base;
+	}
+
+	desc.variantKey = variantKey;
+
+	return RequestPipeline(desc);
+}
+
+PipelineHandle Pipeline_Wrapper::RequestPipeline(const Pipeline_Description &description)
+{
+	PipelineHandle handle;
+	Pipeline *pipe = RegisterPipeline(description, &handle);
+
+	if (pipe)
+	{
+		QueueCompile(pipe, false);
+	}
+
+	return handle;
+}
+
+void Pipeline_Wrapper::QueueCompile(Pipeline *pipe, bool rebuild)
+{
+	Pipeline_CompileJob job;
+
+	job.pipe = pipe;
+	job.rebuild = rebuild;
+
+	{
+		std::lock_guard<std::mutex> lock(compileMutex);
+		compileQueue.push_back(job);
+		++compilesPending;
+	}
+
+	jobSystem->Run(&Pipeline_Wrapper::CompileJob, this, &compilesRunning);
+}
+
+bool Pipeline_Wrapper::IsPipelineReady(PipelineHandle handle)
+{
+	return handle < pipelineList.size() && pipelineList[handle].status.load() == PS_Ready;
+}
+
+bool Pipeline_Wrapper::WaitForPipeline(PipelineHandle handle)
+{
+	if (handle >= pipelineList.size())
+	{
+		return false;
+	}
+
+	Pipeline *pipe = &pipelineList[handle];
+
+	if (pipe->status.load() == PS_Pending)
+	{
+		std::unique_lock<std::mutex> lock(compileMutex);
+		compileDone.wait(lock, [pipe]{ return pipe->status.load() != PS_Pending; });
+	}
+
+	return pipe->status.load() == PS_Ready;
+}
+
+Pipeline* Pipeline_Wrapper::ResolvePipeline(PipelineHandle handle, PipelineHandle fallback)
+{
+	if (IsPipelineReady(handle))
+	{
+		return &pipelineList[handle];
+	}
+
+	if (IsPipelineReady(fallback))
+	{
+		return &pipelineList[fallback];
+	}
+
+	return NULL;
+}
+
+uint32_t Pipeline_Wrapper::GetPendingCompiles()
+{
+	std::lock_guard<std::mutex> lock(compileMutex);
+	return compilesPending;
+}
+
+void Pipeline_Wrapper::CompileJob(void *data, uint32_t begin, uint32_t end)
+{
+	((Pipeline_Wrapper*)data)->CompileNext();
+}
+
+void Pipeline_Wrapper::CompileNext()
+{
+	Pipeline_CompileJob job;
+
+	{
+		std::lock_guard<std::mutex> lock(compileMutex);
+
+		if (stopCompiling || compileQueue.empty())
+		{
+			return;
+		}
+
+		job = compileQueue.front();
+		compileQueue.pop_front();
+	}
 
-	pipe->device = device;
-	pipe->fragModule = fragShaderModule;
-	pipe->fragShader = fragShaderCode.data();
-	pipe->fragSize = fragShaderCode.size();
-	pipe->inUse = true;
-	pipe->vertModule = vertShaderModule;
-	pipe->vertShader = vertShaderCode.data();
-	pipe->vertSize = vertShaderCode.size();
+	CompilePipeline(job.pipe, job.rebuild);
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipe->graphicsPipeline) != VK_SUCCESS) 
 	{
-		throw std::runtime_error("failed to create graphics pipeline!");
+		std::lock_guard<std::mutex> lock(compileMutex);
+		--compilesPending;
 	}
 
-	vkDestroyShaderModule(device, fragShaderModule, nullptr);
-	vkDestroyShaderModule(device, vertShaderModule, nullptr);
+	compileDone.notify_all();
 }
 
+void Pipeline_Wrapper::CompilePipeline(Pipeline *pipe, bool rebuild)
+{
+	Pipeline_CreateState state;
+	VkPipeline result = VK_NULL_HANDLE;
+	uint32_t status = PS_Failed;
+
+	PROFILE_ZONE("CompilePipeline");
+
+	try
+	{
+		FillCreateState(pipe->description,
+			GetShaderModule(pipe->description.vertFile),
+			GetShaderModule(pipe->description.fragFile),
+			pipe->pipelineLayout,
+			state);
+
+		auto createStart = std::chrono::steady_clock::now();
+
+		//the pipeline cache is internally synchronized, every compile job shares it
+		if (vkCreateGraphicsPipelines(logicalDevice, pipelineCache ? pipelineCache->GetCache() : VK_NULL_HANDLE, 1, &state.pipelineInfo, nullptr, &result) == VK_SUCCESS)
+		{
+			status = PS_Ready;
+			++pipelineBuilds;
 
-Pipeline* Pipeline_Wrapper::NewPipe()
+			if (pipelineCache)
+			{
+				pipelineCache->RecordCreation(1, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - createStart).count());
+			}
+		}
+		else
+		{
+			slog("failed to compile pipeline %s / %s", pipe->description.vertFile.c_str(), pipe->description.fragFile.c_str());
+		}
+	}
+	catch (const std::exception &e)
+	{
+		slog("failed to compile pipeline: %s", e.what());
+	}
+
+	//published under the lock so WaitForPipeline cannot miss the wakeup
+	std::lock_guard<std::mutex> lock(compileMutex);
+
+	if (!rebuild)
+	{
+		pipe->graphicsPipeline = result;
+		pipe->status = status;
+		compiledSinceUpdate = true;
+		return;
+	}
+
+	//a failed rebuild keeps the running pipeline, so a broken shader edit never takes the frame down
+	if (result == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	//superseded by a newer edit before it was ever swapped in, so the gpu never saw it
+	if (pipe->rebuiltPipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(logicalDevice, pipe->rebuiltPipeline, NULL);
+	}
+
+	pipe->rebuiltPipeline = result;
+	completedRebuilds.push_back(pipe);
+}
+
+void Pipeline_Wrapper::ReloadShader(const std::string &filename)
 {
-	for (int i = 0; i < maxPipes; ++i)
+	uint32_t dependents = 0;
+
 	{
-		if (pipelineList[i].inUse || i != graphicsPipelineIndex)
+		std::lock_guard<std::mutex> lock(moduleMutex);
+		auto found = shaderModules.find(filename);
+
+		looseShaders.insert(filename);
+
+		if (found == shaderModules.end())
+		{
+			return;
+		}
+
+		//a compile job may still be building with the old module, so it is retired rather than destroyed
+		Pipeline_Retired retired = { VK_NULL_HANDLE, found->second.module, currentFrame };
+		retiredObjects.push_back(retired);
+		shaderModules.erase(found);
+	}
+
+	for (Pipeline &pipe : pipelineList)
+	{
+		if (!pipe.inUse || (pipe.description.vertFile != filename && pipe.description.fragFile != filename))
 		{
 			continue;
 		}
 
-		pipelineList[i].inUse = true;
+		if (pipe.status.load() == PS_Ready)
+		{
+			QueueCompile(&pipe, true);
+			++dependents;
+		}
+		else if (pipe.status.load() == PS_Failed)
+		{
+			//a fixed shader gets a second chance at its first compile
+			pipe.status = PS_Pending;
+			QueueCompile(&pipe, false);
+			++dependents;
+		}
+	}
+
+	slog("reloading %s, rebuilding %i pipelines", filename.c_str(), dependents);
+}
+
+bool Pipeline_Wrapper::UpdateReloads(uint64_t frame, uint32_t framesInFlight)
+{
+	std::vector<Pipeline*> rebuilt;
+	bool changed = compiledSinceUpdate.exchange(false);
 
-		graphicsPipelineIndex = i;
+	currentFrame = frame;
 
-		return &pipelineList[i];
+	{
+		std::lock_guard<std::mutex> lock(compileMutex);
+		rebuilt.swap(completedRebuilds);
 	}
 
-	slog("no free pipelines");
-	return NULL;
+	for (Pipeline *pipe : rebuilt)
+	{
+		VkPipeline replacement;
+
+		{
+			std::lock_guard<std::mutex> lock(compileMutex);
+			replacement = pipe->rebuiltPipeline;
+			pipe->rebuiltPipeline = VK_NULL_HANDLE;
+		}
+
+		//the same pipeline can be listed twice when two edits landed close together
+		if (replacement == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		Pipeline_Retired retired = { pipe->graphicsPipeline, VK_NULL_HANDLE, frame };
+		retiredObjects.push_back(retired);
+
+		pipe->graphicsPipeline = replacement;
+		++pipelineRebuilds;
+		changed = true;
+	}
+
+	bool compiling = GetPendingCompiles() != 0;
+
+	for (size_t i = 0; i < retiredObjects.size();)
+	{
+		Pipeline_Retired &retired = retiredObjects[i];
+
+		if (frame < retired.frame + framesInFlight || (retired.module != VK_NULL_HANDLE && compiling))
+		{
+			++i;
+			continue;
+		}
+
+		if (retired.pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(logicalDevice, retired.pipeline, NULL);
+		}
+
+		if (retired.module != VK_NULL_HANDLE)
+		{
+			vkDestroyShaderModule(logicalDevice, retired.module, NULL);
+		}
+
+		retiredObjects[i] = retiredObjects.back();
+		retiredObjects.pop_back();
+	}
+
+	return changed;
 }
 
-void Pipeline_Wrapper::RenderPassSetup(VkFormat format, VkPhysicalDevice physDevice, VkDevice lDevice)
+void Pipeline_Wrapper::RenderPassSetup(VkFormat format, VkPhysicalDevice physDevice, VkDevice lDevice, VkImageLayout finalLayout)
 {
 	VkAttachmentDescription colorAttachment = {};
 	colorAttachment.format = format;
@@ -220,13 +1019,14 @@ void Pipeline_Wrapper::RenderPassSetup(VkFormat format, VkPhysicalDevice physDev
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = finalLayout;
 
 	VkAttachmentDescription depthAttachment = {};
 	depthAttachment.format = FindDepthFormat(physDevice);
 	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	//kept for the occlusion pass, which builds its depth pyramid from it and draws on top of it
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -249,10 +1049,11 @@ void Pipeline_Wrapper::RenderPassSetup(VkFormat format, VkPhysicalDevice physDev
 	VkSubpassDependency dependency = {};
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	//every frame in flight shares one depth image, the clear waits on the previous frame's pyramid reads and second pass writes
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
 
@@ -265,11 +1066,27 @@ void Pipeline_Wrapper::RenderPassSetup(VkFormat format, VkPhysicalDevice physDev
 	renderPassInfo.dependencyCount = 1;
 	renderPassInfo.pDependencies = &dependency;
 
-	if (vkCreateRenderPass(lDevice, &renderPassInfo, NULL, &pipelineList[graphicsPipelineIndex].renderPass) != VK_SUCCESS)
+	if (vkCreateRenderPass(lDevice, &renderPassInfo, NULL, &renderPass) != VK_SUCCESS)
 	{
 		slog("failed to create render pass!");
 		return;
 	}
+
+	//the same attachments picked up where the first pass left them, compatible with its pipelines and framebuffers
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[0].initialLayout = finalLayout;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	if (vkCreateRenderPass(lDevice, &renderPassInfo, NULL, &loadRenderPass) != VK_SUCCESS)
+	{
+		slog("failed to create load render pass!");
+	}
 }
 
 VkFormat Pipeline_Wrapper::FindSupportedFormat(VkFormat * candidates, uint32_t candidateCount, VkImageTiling tiling, VkFormatFeatureFlags features, VkPhysicalDevice physDevice)
@@ -303,24 +1120,4 @@ VkFormat Pipeline_Wrapper::FindDepthFormat(VkPhysicalDevice physDevice)
 		VK_IMAGE_TILING_OPTIMAL,
 		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT,
 		physDevice);
-}
-
-std::vector<char> Pipeline_Wrapper::ReadShaderFile(const std::string& filename)
-{
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open()) 
-	{
-		throw std::runtime_error("failed to open file!");
-	}
-
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
-
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-
-	file.close();
-
-	return buffer;
 }
\ No newline at end of file
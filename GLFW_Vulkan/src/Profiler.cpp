@@ -0,0 +1,237 @@
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+#include "Profiler.h"
+#include "simple_logger.h"
+
+const static uint32_t PROFILER_RING_SIZE = 1 << 16;
+
+const static uint32_t BENCHMARK_ZONES = 1 << 22;
+const static double BENCHMARK_ZONE_TARGET_NS = 20.0;
+
+struct Profile_ThreadBuffer
+{
+	uint32_t					threadId;
+	std::atomic<uint64_t>		head;
+	uint64_t					tail;
+	Profile_Event				events[PROFILER_RING_SIZE];
+};
+
+std::atomic<bool> Profiler::capturing(false);
+
+static std::mutex							bufferMutex;
+static std::vector<Profile_ThreadBuffer*>	threadBuffers;
+static thread_local Profile_ThreadBuffer	*localBuffer = NULL;
+
+static uint32_t								framesRemaining = 0;
+static std::string							captureFile;
+static uint64_t								captureStartTicks = 0;
+static uint64_t								frameStartTicks = 0;
+static std::chrono::steady_clock::time_point	captureStartTime;
+
+//writes the last finished capture, joined before the rings are reused
+static std::thread							captureWriter;
+
+static Profile_ThreadBuffer* GetThreadBuffer()
+{
+	if (!localBuffer)
+	{
+		localBuffer = new Profile_ThreadBuffer();
+		localBuffer->head.store(0);
+		localBuffer->tail = 0;
+
+		std::lock_guard<std::mutex> lock(bufferMutex);
+		localBuffer->threadId = (uint32_t)threadBuffers.size();
+		threadBuffers.push_back(localBuffer);
+	}
+
+	return localBuffer;
+}
+
+void Profiler::Record(const char *name, uint64_t start, uint64_t end)
+{
+	Profile_ThreadBuffer *buffer = GetThreadBuffer();
+	uint64_t index = buffer->head.load(std::memory_order_relaxed);
+	Profile_Event &e = buffer->events[index & (PROFILER_RING_SIZE - 1)];
+
+	e.name = name;
+	e.start = start;
+	e.end = end;
+
+	buffer->head.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::BeginCapture(uint32_t frameCount, const char *outputFile)
+{
+	if (!frameCount || IsCapturing())
+	{
+		return;
+	}
+
+	if (captureWriter.joinable())
+	{
+		captureWriter.join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(bufferMutex);
+
+		for (Profile_ThreadBuffer *buffer : threadBuffers)
+		{
+			buffer->tail = buffer->head.load(std::memory_order_acquire);
+		}
+	}
+
+	captureFile = outputFile ? outputFile : "profile_capture.json";
+	framesRemaining = frameCount;
+	captureStartTime = std::chrono::steady_clock::now();
+	captureStartTicks = ReadTicks();
+	frameStartTicks = captureStartTicks;
+
+	capturing.store(true, std::memory_order_relaxed);
+
+	slog("profiler capturing %i frames", frameCount);
+}
+
+static void WriteJsonString(FILE *file, const char *str)
+{
+	fputc('"', file);
+	for (; *str; ++str)
+	{
+		if (*str == '"' || *str == '\\')
+		{
+			fputc('\\', file);
+		}
+		fputc(*str, file);
+	}
+	fputc('"', file);
+}
+
+static void WriteCapture(uint64_t endTicks, std::chrono::steady_clock::time_point endTime)
+{
+	double elapsedUs = std::chrono::duration<double, std::micro>(endTime - captureStartTime).count();
+	double ticksPerUs = elapsedUs > 0.0 ? (double)(endTicks - captureStartTicks) / elapsedUs : 1.0;
+	FILE *file = fopen(captureFile.c_str(), "w");
+	bool first = true;
+	size_t eventCount = 0;
+
+	if (!file)
+	{
+		slog("failed to open profiler capture file %s", captureFile.c_str());
+		return;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	std::lock_guard<std::mutex> lock(bufferMutex);
+
+	for (Profile_ThreadBuffer *buffer : threadBuffers)
+	{
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t tail = buffer->tail;
+
+		if (head - tail > PROFILER_RING_SIZE)
+		{
+			slog("profiler ring for thread %i overflowed, dropping %i zones", buffer->threadId, (int)(head - tail - PROFILER_RING_SIZE));
+			tail = head - PROFILER_RING_SIZE;
+		}
+
+		for (uint64_t i = tail; i < head; ++i)
+		{
+			const Profile_Event &e = buffer->events[i & (PROFILER_RING_SIZE - 1)];
+
+			if (e.start < captureStartTicks || e.start > endTicks)
+			{
+				continue;
+			}
+
+			fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+			WriteJsonString(file, e.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->threadId,
+				(double)(e.start - captureStartTicks) / ticksPerUs,
+				(double)(e.end - e.start) / ticksPerUs);
+
+			first = false;
+			++eventCount;
+		}
+
+		buffer->tail = head;
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	slog("profiler wrote %i zones to %s", (int)eventCount, captureFile.c_str());
+}
+
+static void EndCapture(uint64_t endTicks)
+{
+	Profiler::capturing.store(false, std::memory_order_relaxed);
+
+	//zones stop recording with the flag, so the writer has the rings to itself until the next capture joins it
+	captureWriter = std::thread(WriteCapture, endTicks, std::chrono::steady_clock::now());
+}
+
+void Profiler::FrameMark()
+{
+	uint64_t now = ReadTicks();
+
+	if (IsCapturing())
+	{
+		Record("Frame", frameStartTicks, now);
+		frameStartTicks = now;
+
+		if (--framesRemaining == 0)
+		{
+			EndCapture(now);
+		}
+	}
+}
+
+void Profiler::Flush()
+{
+	if (IsCapturing())
+	{
+		slog("profiler capture ended %i frames early", framesRemaining);
+		EndCapture(ReadTicks());
+	}
+
+	if (captureWriter.joinable())
+	{
+		captureWriter.join();
+	}
+}
+
+static double TimeZones(uint32_t count)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Profile_Zone zone("BenchmarkZone");
+	}
+
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+bool Profiler::Benchmark()
+{
+	Flush();
+
+	double idleNs = TimeZones(BENCHMARK_ZONES);
+
+	capturing.store(true, std::memory_order_relaxed);
+
+	double captureNs = TimeZones(BENCHMARK_ZONES);
+
+	capturing.store(false, std::memory_order_relaxed);
+
+	slog("profiler zone: %.1f ns idle, %.1f ns capturing over %u zones, target %.1f ns", idleNs, captureNs, BENCHMARK_ZONES, BENCHMARK_ZONE_TARGET_NS);
+
+	return captureNs <= BENCHMARK_ZONE_TARGET_NS;
+}
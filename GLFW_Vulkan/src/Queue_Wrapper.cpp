@@ -22,7 +22,7 @@ Queue_Wrapper::Queue_Wrapper()
 
 VkDeviceQueueCreateInfo* Queue_Wrapper::Queue_WrapperInit(VkPhysicalDevice* device, VkSurfaceKHR surface)
 {
-	VkBool32 supported;
+	VkBool32 supported = VK_FALSE;
 
 	graphicsQueueFamily = -1;
 	presentQueueFamily = -1; 
@@ -56,7 +56,10 @@ VkDeviceQueueCreateInfo* Queue_Wrapper::Queue_WrapperInit(VkPhysicalDevice* devi
 			localQueueFamilyProps[i].minImageTransferGranularity.height,
 			localQueueFamilyProps[i].minImageTransferGranularity.depth);
 
-		vkGetPhysicalDeviceSurfaceSupportKHR(*device, i, surface, &supported);
+		if (surface != VK_NULL_HANDLE)
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(*device, i, surface, &supported);
+		}
 
 		if (localQueueFamilyProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
 		{
@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Shader_Archive.h"
+#include "simple_logger.h"
+
+const static uint32_t SHADER_ARCHIVE_MAGIC = 0x4B504853; // "SHPK"
+const static uint32_t SHADER_ARCHIVE_VERSION = 1;
+
+const static uint32_t SPIRV_MAGIC = 0x07230203;
+
+Shader_Archive::Shader_Archive()
+{
+	data = NULL;
+	size = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#endif
+}
+
+Shader_Archive::~Shader_Archive()
+{
+	Unmap();
+}
+
+void Shader_Archive::Unmap()
+{
+#ifdef _WIN32
+	if (data)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle)
+	{
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+	}
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	if (data)
+	{
+		munmap((void*)data, size);
+	}
+#endif
+	data = NULL;
+	size = 0;
+}
+
+bool Shader_Archive::Shader_ArchiveInit(const char *filename)
+{
+	Unmap();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Unmap();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mappingHandle)
+	{
+		data = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	if (!data)
+	{
+		slog("failed to map shader archive %s", filename);
+		Unmap();
+		return false;
+	}
+
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileInfo;
+
+	if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void *mapping = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	//the mapping holds its own reference to the file
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		slog("failed to map shader archive %s", filename);
+		return false;
+	}
+
+	data = (const uint8_t*)mapping;
+	size = (size_t)fileInfo.st_size;
+#endif
+
+	if (!Validate())
+	{
+		slog("shader archive %s is malformed, ignoring it", filename);
+		Unmap();
+		return false;
+	}
+
+	//the archive takes priority over loose files, so one left behind by a shader rebuild would hide the new code
+	std::string staleName;
+
+	if (FindStaleEntry(filename, staleName))
+	{
+		slog("shader archive %s is older than %s, loading loose shaders until it is repacked", filename, staleName.c_str());
+		Unmap();
+		return false;
+	}
+
+	slog("mapped shader archive %s, %i shaders in %i bytes", filename, GetEntryCount(), (uint32_t)size);
+
+	return true;
+}
+
+bool Shader_Archive::Validate() const
+{
+	const Shader_ArchiveHeader *header = (const Shader_ArchiveHeader*)data;
+
+	if (size < sizeof(Shader_ArchiveHeader) || header->magic != SHADER_ARCHIVE_MAGIC || header->version != SHADER_ARCHIVE_VERSION || header->fileSize != size)
+	{
+		return false;
+	}
+
+	if (header->entryCount > (size - sizeof(Shader_ArchiveHeader)) / sizeof(Shader_ArchiveEntry))
+	{
+		return false;
+	}
+
+	const Shader_ArchiveEntry *entries = (const Shader_ArchiveEntry*)(data + sizeof(Shader_ArchiveHeader));
+
+	//checked once here so lookups can trust every offset
+	for (uint32_t i = 0; i < header->entryCount; ++i)
+	{
+		const Shader_ArchiveEntry &entry = entries[i];
+
+		if (i > 0 && entries[i - 1].nameHash > entry.nameHash)
+		{
+			return false;
+		}
+
+		if ((uint64_t)entry.nameOffset + entry.nameLength > size ||
+			(uint64_t)entry.codeOffset + entry.codeSize > size ||
+			(uint64_t)entry.reflectionOffset + entry.reflectionSize > size)
+		{
+			return false;
+		}
+
+		if (entry.codeOffset % 4 || entry.codeSize % 4 || entry.codeSize < 4 || entry.reflectionOffset % 4 || entry.reflectionSize % 4)
+		{
+			return false;
+		}
+
+		if (*(const uint32_t*)(data + entry.codeOffset) != SPIRV_MAGIC)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool GetWriteTime(const char *filename, uint64_t &writeTime)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &attributes))
+	{
+		return false;
+	}
+
+	writeTime = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat fileInfo;
+
+	if (stat(filename, &fileInfo) != 0)
+	{
+		return false;
+	}
+
+	writeTime = (uint64_t)fileInfo.st_mtime;
+#endif
+
+	return true;
+}
+
+bool Shader_Archive::FindStaleEntry(const char *archiveFile, std::string &staleName) const
+{
+	uint64_t archiveTime;
+
+	if (!GetWriteTime(archiveFile, archiveTime))
+	{
+		return false;
+	}
+
+	const Shader_ArchiveEntry *entries = (const Shader_ArchiveEntry*)(data + sizeof(Shader_ArchiveHeader));
+
+	//entries are stored under the path they were packed from, a shipped build without loose files is never stale
+	for (uint32_t i = 0; i < GetEntryCount(); ++i)
+	{
+		std::string name((const char*)data + entries[i].nameOffset, entries[i].nameLength);
+		uint64_t looseTime;
+
+		if (GetWriteTime(name.c_str(), looseTime) && looseTime > archiveTime)
+		{
+			staleName = name;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint32_t Shader_Archive::GetEntryCount() const
+{
+	return data ? ((const Shader_ArchiveHeader*)data)->entryCount : 0;
+}
+
+uint64_t Shader_Archive::HashName(const std::string &name)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (char c : name)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+const Shader_ArchiveEntry* Shader_Archive::FindEntry(const std::string &name) const
+{
+	if (!data)
+	{
+		return NULL;
+	}
+
+	const Shader_ArchiveEntry *entries = (const Shader_ArchiveEntry*)(data + sizeof(Shader_ArchiveHeader));
+	const Shader_ArchiveEntry *end = entries + GetEntryCount();
+	uint64_t hash = HashName(name);
+
+	const Shader_ArchiveEntry *entry = std::lower_bound(entries, end, hash,
+		[](const Shader_ArchiveEntry &e, uint64_t h) { return e.nameHash < h; });
+
+	//the stored name settles hash collisions
+	for (; entry != end && entry->nameHash == hash; ++entry)
+	{
+		if (entry->nameLength == name.size() && memcmp(data + entry->nameOffset, name.data(), name.size()) == 0)
+		{
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+const uint32_t* Shader_Archive::GetCode(const std::string &name, size_t *codeSize) const
+{
+	const Shader_ArchiveEntry *entry = FindEntry(name);
+
+	if (!entry)
+	{
+		return NULL;
+	}
+
+	if (codeSize)*codeSize = entry->codeSize;
+
+	return (const uint32_t*)(data + entry->codeOffset);
+}
+
+static void WriteReflection(const Shader_Reflection &reflection, std::vector<uint32_t> &words)
+{
+	words.push_back(reflection.stages);
+
+	words.push_back((uint32_t)reflection.bindings.size());
+	for (const Shader_Binding &binding : reflection.bindings)
+	{
+		words.push_back(binding.set);
+		words.push_back(binding.binding);
+		words.push_back((uint32_t)binding.type);
+		words.push_back(binding.count);
+		words.push_back(binding.stages);
+	}
+
+	words.push_back((uint32_t)reflection.pushConstants.size());
+	for (const VkPushConstantRange &range : reflection.pushConstants)
+	{
+		words.push_back(range.stageFlags);
+		words.push_back(range.offset);
+		words.push_back(range.size);
+	}
+
+	words.push_back((uint32_t)reflection.vertexInputs.size());
+	for (const Shader_VertexInput &input : reflection.vertexInputs)
+	{
+		words.push_back(input.location);
+		words.push_back((uint32_t)input.format);
+	}
+}
+
+bool Shader_Archive::GetReflection(const std::string &name, Shader_Reflection &reflection) const
+{
+	const Shader_ArchiveEntry *entry = FindEntry(name);
+
+	if (!entry || !entry->reflectionSize)
+	{
+		return false;
+	}
+
+	const uint32_t *words = (const uint32_t*)(data + entry->reflectionOffset);
+	size_t wordCount = entry->reflectionSize / 4;
+	size_t cursor = 0;
+
+	//every count is checked against what is left so a bad entry falls back to reflecting the code
+	auto take = [&](size_t count) -> const uint32_t*
+	{
+		if (cursor + count > wordCount)
+		{
+			return NULL;
+		}
+		cursor += count;
+		return words + cursor - count;
+	};
+
+	Shader_Reflection result;
+	const uint32_t *word = take(2);
+
+	if (!word)
+	{
+		return false;
+	}
+
+	result.stages = word[0];
+
+	for (uint32_t i = 0, count = word[1]; i < count; ++i)
+	{
+		if (!(word = take(5)))
+		{
+			return false;
+		}
+		result.bindings.push_back({ word[0], word[1], (VkDescriptorType)word[2], word[3], word[4] });
+	}
+
+	if (!(word = take(1)))
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0, count = word[0]; i < count; ++i)
+	{
+		if (!(word = take(3)))
+		{
+			return false;
+		}
+		result.pushConstants.push_back({ word[0], word[1], word[2] });
+	}
+
+	if (!(word = take(1)))
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0, count = word[0]; i < count; ++i)
+	{
+		if (!(word = take(2)))
+		{
+			return false;
+		}
+		result.vertexInputs.push_back({ word[0], (VkFormat)word[1] });
+	}
+
+	reflection = result;
+
+	return true;
+}
+
+bool Shader_Archive::Pack(const char *archiveFile, const std::vector<std::string> &shaderFiles, bool withReflection)
+{
+	struct PackedShader
+	{
+		std::string				name;
+		std::vector<char>		code;
+		std::vector<uint32_t>	reflection;
+	};
+
+	std::vector<PackedShader> shaders;
+
+	for (const std::string &file : shaderFiles)
+	{
+		PackedShader shader;
+		shader.name = file;
+		shader.code = Shader_Wrapper::ReadShaderFile(file);
+
+		Shader_Reflection reflection;
+		const uint32_t *code = (const uint32_t*)shader.code.data();
+		size_t wordCount = shader.code.size() / 4;
+
+		if (shader.code.size() % 4 || !Shader_Wrapper::Reflect(code, wordCount, reflection))
+		{
+			slog("%s is not valid SPIR-V, archive not written", file.c_str());
+			return false;
+		}
+
+		if (withReflection)
+		{
+			WriteReflection(reflection, shader.reflection);
+		}
+
+		shaders.push_back(shader);
+	}
+
+	std::sort(shaders.begin(), shaders.end(), [](const PackedShader &a, const PackedShader &b) { return HashName(a.name) < HashName(b.name); });
+
+	for (size_t i = 1; i < shaders.size(); ++i)
+	{
+		if (shaders[i].name == shaders[i - 1].name)
+		{
+			slog("%s was given twice, archive not written", shaders[i].name.c_str());
+			return false;
+		}
+	}
+
+	Shader_ArchiveHeader header = {};
+	std::vector<Shader_ArchiveEntry> entries(shaders.size());
+	std::vector<uint8_t> blobs;
+	uint32_t blobStart = (uint32_t)(sizeof(Shader_ArchiveHeader) + entries.size() * sizeof(Shader_ArchiveEntry));
+
+	auto append = [&](const void *bytes, size_t count) -> uint32_t
+	{
+		uint32_t offset = blobStart + (uint32_t)blobs.size();
+		blobs.insert(blobs.end(), (const uint8_t*)bytes, (const uint8_t*)bytes + count);
+		//keeps the next blob word aligned for vkCreateShaderModule
+		blobs.resize((blobs.size() + 3) & ~(size_t)3, 0);
+		return offset;
+	};
+
+	for (size_t i = 0; i < shaders.size(); ++i)
+	{
+		Shader_ArchiveEntry &entry = entries[i];
+
+		entry.nameHash = HashName(shaders[i].name);
+		entry.nameLength = (uint32_t)shaders[i].name.size();
+		entry.nameOffset = append(shaders[i].name.data(), shaders[i].name.size());
+		entry.codeSize = (uint32_t)shaders[i].code.size();
+		entry.codeOffset = append(shaders[i].code.data(), shaders[i].code.size());
+		entry.reflectionSize = (uint32_t)(shaders[i].reflection.size() * 4);
+		entry.reflectionOffset = entry.reflectionSize ? append(shaders[i].reflection.data(), entry.reflectionSize) : 0;
+	}
+
+	header.magic = SHADER_ARCHIVE_MAGIC;
+	header.version = SHADER_ARCHIVE_VERSION;
+	header.entryCount = (uint32_t)entries.size();
+	header.fileSize = blobStart + (uint32_t)blobs.size();
+
+	FILE *file = fopen(archiveFile, "wb");
+
+	if (!file)
+	{
+		slog("failed to open %s for writing", archiveFile);
+		return false;
+	}
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+	written = written && (entries.empty() || fwrite(entries.data(), sizeof(Shader_ArchiveEntry), entries.size(), file) == entries.size());
+	written = written && (blobs.empty() || fwrite(blobs.data(), blobs.size(), 1, file) == 1);
+	written = fclose(file) == 0 && written;
+
+	if (!written)
+	{
+		slog("failed to write shader archive %s", archiveFile);
+		return false;
+	}
+
+	slog("packed %i shaders into %s, %i bytes", header.entryCount, archiveFile, header.fileSize);
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+
+#include "Shader_Watcher.h"
+#include "simple_logger.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+static bool IsSpirvFile(const char *name)
+{
+	size_t length = strlen(name);
+
+	return length > 4 && strcmp(name + length - 4, ".spv") == 0;
+}
+
+Shader_Watcher::Shader_Watcher()
+{
+	running = false;
+#ifdef __linux__
+	inotifyFd = -1;
+	watchFd = -1;
+#endif
+}
+
+Shader_Watcher::~Shader_Watcher()
+{
+	running = false;
+
+	if (watchThread.joinable())
+	{
+		watchThread.join();
+	}
+
+#ifdef __linux__
+	if (inotifyFd >= 0)
+	{
+		if (watchFd >= 0)
+		{
+			inotify_rm_watch(inotifyFd, watchFd);
+		}
+		close(inotifyFd);
+	}
+#endif
+}
+
+bool Shader_Watcher::Shader_WatcherInit(const char *shaderDirectory)
+{
+	directory = shaderDirectory;
+
+#ifdef __linux__
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (inotifyFd < 0)
+	{
+		slog("failed to initialize inotify, shader hot reload disabled");
+		return false;
+	}
+
+	//close-write catches compilers writing in place, moved-to catches editors that write a temp file and rename
+	watchFd = inotify_add_watch(inotifyFd, shaderDirectory, IN_CLOSE_WRITE | IN_MOVED_TO);
+
+	if (watchFd < 0)
+	{
+		slog("failed to watch shader directory %s", shaderDirectory);
+		return false;
+	}
+#elif defined(_WIN32)
+	ScanDirectory(false);
+#else
+	slog("shader hot reload is not supported on this platform");
+	return false;
+#endif
+
+	running = true;
+	watchThread = std::thread(&Shader_Watcher::WatchLoop, this);
+
+	slog("watching %s for shader changes", shaderDirectory);
+
+	return true;
+}
+
+void Shader_Watcher::AddChange(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(changeMutex);
+	changedFiles.insert(directory + "/" + name);
+}
+
+void Shader_Watcher::PollChanges(std::vector<std::string> &files)
+{
+	std::lock_guard<std::mutex> lock(changeMutex);
+
+	files.insert(files.end(), changedFiles.begin(), changedFiles.end());
+	changedFiles.clear();
+}
+
+#ifdef __linux__
+void Shader_Watcher::WatchLoop()
+{
+	//aligned for the inotify_event structs read into it
+	alignas(struct inotify_event) char buffer[4096];
+	struct pollfd pollInfo = {};
+
+	pollInfo.fd = inotifyFd;
+	pollInfo.events = POLLIN;
+
+	while (running)
+	{
+		//short timeout so the destructor never waits long for the join
+		if (poll(&pollInfo, 1, 100) <= 0)
+		{
+			continue;
+		}
+
+		ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const struct inotify_event *event = (const struct inotify_event*)(buffer + offset);
+
+			if (event->len && IsSpirvFile(event->name))
+			{
+				AddChange(event->name);
+			}
+
+			offset += sizeof(struct inotify_event) + event->len;
+		}
+	}
+}
+#elif defined(_WIN32)
+void Shader_Watcher::ScanDirectory(bool report)
+{
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA((directory + "/*.spv").c_str(), &findData);
+
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	do
+	{
+		uint64_t writeTime = ((uint64_t)findData.ftLastWriteTime.dwHighDateTime << 32) | findData.ftLastWriteTime.dwLowDateTime;
+		uint64_t size = ((uint64_t)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+		auto known = watchedFiles.find(findData.cFileName);
+
+		if (known == watchedFiles.end() || known->second.writeTime != writeTime || known->second.size != size)
+		{
+			//the compiler may still be writing it, wait for a scan that finds it unchanged
+			Shader_WatchedFile &file = watchedFiles[findData.cFileName];
+
+			file.writeTime = writeTime;
+			file.size = size;
+			file.pending = report;
+		}
+		else if (known->second.pending)
+		{
+			known->second.pending = false;
+
+			if (IsSpirvFile(findData.cFileName))
+			{
+				AddChange(findData.cFileName);
+			}
+		}
+	} while (FindNextFileA(find, &findData));
+
+	FindClose(find);
+}
+
+void Shader_Watcher::WatchLoop()
+{
+	while (running)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+		ScanDirectory(true);
+	}
+}
+#else
+void Shader_Watcher::WatchLoop()
+{
+}
+#endif
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 
 #include "Shader_Wrapper.h"
@@ -18,48 +19,35 @@ Shader_Wrapper::~Shader_Wrapper()
 
 }
 
-char* Shader_Wrapper::LoadShaderData(const char* filename, size_t *rsize)
+std::vector<char> Shader_Wrapper::ReadShaderFile(const std::string &filename)
 {
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
-	char* buffer = {};
-	FILE *file;
-	size_t size;
-	file = fopen(filename, "rb");
-	if (!file)
+	if (!file.is_open())
 	{
-		slog("failed to open shader file %s", filename);
-		return NULL;
+		slog("failed to open shader file %s", filename.c_str());
+		return std::vector<char>();
 	}
-	fseek(file, 0, SEEK_END);
-	size = ftell(file);
-	if (!size)
-	{
-		slog("file %s contained no data", filename);
-		fclose(file);
-		return NULL;
-	}
-	rewind(file);
-	buffer = new char[size];
-	if (!buffer)
-	{
-		slog("failed to allocate memory for shader file %s", filename);
-		fclose(file);
-		return NULL;
-	}
-	fread(buffer, size, 1, file);
-	fclose(file);
-	if (rsize)*rsize = size;
+
+	size_t fileSize = (size_t)file.tellg();
+	std::vector<char> buffer(fileSize);
+
+	file.seekg(0);
+	file.read(buffer.data(), fileSize);
+
+	file.close();
+
 	return buffer;
 }
 
-VkShaderModule Shader_Wrapper::CreateShaderModule(const std::vector<char>& shader, VkDevice device)
+VkShaderModule Shader_Wrapper::CreateShaderModule(const uint32_t *code, size_t codeSize, VkDevice device)
 {
 	VkShaderModule module = {};
 	VkShaderModuleCreateInfo createInfo = {};
 
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = shader.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(shader.data());
+	createInfo.codeSize = codeSize;
+	createInfo.pCode = code;
 
 	if (vkCreateShaderModule(device, &createInfo, NULL, &module) != VK_SUCCESS)
 	{
@@ -67,3 +55,495 @@ VkShaderModule Shader_Wrapper::CreateShaderModule(const std::vector<char>& shade
 	}
 	return module;
 }
+
+//the subset of the SPIR-V grammar needed to find a module's resource interface
+enum
+{
+	SPV_OpEntryPoint = 15,
+	SPV_OpTypeInt = 21,
+	SPV_OpTypeFloat = 22,
+	SPV_OpTypeVector = 23,
+	SPV_OpTypeMatrix = 24,
+	SPV_OpTypeImage = 25,
+	SPV_OpTypeSampler = 26,
+	SPV_OpTypeSampledImage = 27,
+	SPV_OpTypeArray = 28,
+	SPV_OpTypeRuntimeArray = 29,
+	SPV_OpTypeStruct = 30,
+	SPV_OpTypePointer = 32,
+	SPV_OpConstant = 43,
+	SPV_OpVariable = 59,
+	SPV_OpDecorate = 71,
+	SPV_OpMemberDecorate = 72,
+
+	SPV_DecorationBlock = 2,
+	SPV_DecorationBufferBlock = 3,
+	SPV_DecorationArrayStride = 6,
+	SPV_DecorationMatrixStride = 7,
+	SPV_DecorationBuiltIn = 11,
+	SPV_DecorationLocation = 30,
+	SPV_DecorationBinding = 33,
+	SPV_DecorationDescriptorSet = 34,
+	SPV_DecorationOffset = 35,
+
+	SPV_StorageUniformConstant = 0,
+	SPV_StorageInput = 1,
+	SPV_StorageUniform = 2,
+	SPV_StoragePushConstant = 9,
+	SPV_StorageStorageBuffer = 12,
+
+	SPV_DimBuffer = 5,
+	SPV_DimSubpassData = 6
+};
+
+const static uint32_t SPIRV_MAGIC = 0x07230203;
+
+/**
+ * @brief what the reflection pass remembers about one result id
+ */
+struct Spirv_Id
+{
+	uint32_t				opcode;
+	uint32_t				typeId;			// pointee, element, component or column type
+	uint32_t				storageClass;
+	uint32_t				width;			// int/float bits, vector/matrix count, array length id
+	uint32_t				sign;
+	uint32_t				dim;
+	uint32_t				sampled;
+	uint32_t				constant;
+	uint32_t				set;
+	uint32_t				binding;
+	uint32_t				location;
+	uint32_t				arrayStride;
+	bool					hasBinding;
+	bool					hasLocation;
+	bool					builtIn;
+	bool					block;
+	bool					bufferBlock;
+	std::vector<uint32_t>	members;
+	std::vector<uint32_t>	memberOffsets;
+	std::vector<uint32_t>	memberMatrixStrides;
+};
+
+/**
+ * @brief checks an instruction the reflection pass reads has every operand it reads, and that the ids it keeps are below the bound
+ */
+static bool SpirvOperandsValid(const uint32_t *op, uint32_t opcode, uint32_t length, uint32_t bound)
+{
+	switch (opcode)
+	{
+	case SPV_OpEntryPoint:
+	case SPV_OpTypeSampler:
+		return length >= 2;
+	case SPV_OpTypeFloat:
+		return length >= 3;
+	case SPV_OpTypeRuntimeArray:
+	case SPV_OpTypeSampledImage:
+		return length >= 3 && op[2] < bound;
+	case SPV_OpTypeInt:
+		return length >= 4;
+	case SPV_OpTypeVector:
+	case SPV_OpTypeMatrix:
+		return length >= 4 && op[2] < bound;
+	case SPV_OpTypeArray:
+		return length >= 4 && op[2] < bound && op[3] < bound;
+	case SPV_OpTypeImage:
+		return length >= 9 && op[2] < bound;
+	case SPV_OpTypeStruct:
+		for (uint32_t i = 2; i < length; ++i)
+		{
+			if (op[i] >= bound)
+			{
+				return false;
+			}
+		}
+		return length >= 2;
+	case SPV_OpTypePointer:
+		return length >= 4 && op[3] < bound;
+	case SPV_OpConstant:
+	case SPV_OpVariable:
+		return length >= 4 && op[1] < bound;
+	case SPV_OpDecorate:
+		//decorations the pass reads a literal of carry it in op[3]
+		return length >= 3 && (length >= 4 || (op[2] != SPV_DecorationArrayStride && op[2] != SPV_DecorationLocation &&
+			op[2] != SPV_DecorationBinding && op[2] != SPV_DecorationDescriptorSet));
+	case SPV_OpMemberDecorate:
+		return length >= 4 && (length >= 5 || (op[3] != SPV_DecorationOffset && op[3] != SPV_DecorationMatrixStride));
+	}
+
+	return true;
+}
+
+static uint32_t SpirvTypeSize(const std::vector<Spirv_Id> &ids, uint32_t typeId, uint32_t matrixStride)
+{
+	const Spirv_Id &type = ids[typeId];
+	uint32_t size = 0;
+
+	switch (type.opcode)
+	{
+	case SPV_OpTypeInt:
+	case SPV_OpTypeFloat:
+		return type.width / 8;
+	case SPV_OpTypeVector:
+		return type.width * SpirvTypeSize(ids, type.typeId, 0);
+	case SPV_OpTypeMatrix:
+		return type.width * (matrixStride ? matrixStride : SpirvTypeSize(ids, type.typeId, 0));
+	case SPV_OpTypeArray:
+		return ids[type.width].constant * (type.arrayStride ? type.arrayStride : SpirvTypeSize(ids, type.typeId, matrixStride));
+	case SPV_OpTypeStruct:
+		for (size_t i = 0; i < type.members.size(); ++i)
+		{
+			uint32_t offset = i < type.memberOffsets.size() ? type.memberOffsets[i] : 0;
+			uint32_t stride = i < type.memberMatrixStrides.size() ? type.memberMatrixStrides[i] : 0;
+
+			size = std::max(size, offset + SpirvTypeSize(ids, type.members[i], stride));
+		}
+		return size;
+	default:
+		return 0;
+	}
+}
+
+static VkFormat SpirvVertexFormat(const std::vector<Spirv_Id> &ids, uint32_t typeId)
+{
+	const static VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+	const static VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+	const static VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+	uint32_t count = 1;
+	const Spirv_Id *component = &ids[typeId];
+
+	if (component->opcode == SPV_OpTypeVector)
+	{
+		count = component->width;
+		component = &ids[component->typeId];
+	}
+
+	if (count < 1 || count > 4 || component->width != 32)
+	{
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	if (component->opcode == SPV_OpTypeFloat)
+	{
+		return floatFormats[count - 1];
+	}
+
+	if (component->opcode == SPV_OpTypeInt)
+	{
+		return component->sign ? intFormats[count - 1] : uintFormats[count - 1];
+	}
+
+	return VK_FORMAT_UNDEFINED;
+}
+
+static bool SpirvDescriptorType(const std::vector<Spirv_Id> &ids, const Spirv_Id &variable, VkDescriptorType &descriptorType, uint32_t &count)
+{
+	uint32_t typeId = ids[variable.typeId].typeId;
+
+	count = 1;
+
+	while (ids[typeId].opcode == SPV_OpTypeArray || ids[typeId].opcode == SPV_OpTypeRuntimeArray)
+	{
+		count = ids[typeId].opcode == SPV_OpTypeArray ? count * ids[ids[typeId].width].constant : 0;
+		typeId = ids[typeId].typeId;
+	}
+
+	const Spirv_Id &type = ids[typeId];
+
+	if (variable.storageClass == SPV_StorageStorageBuffer)
+	{
+		descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		return true;
+	}
+
+	if (variable.storageClass == SPV_StorageUniform)
+	{
+		descriptorType = type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		return true;
+	}
+
+	switch (type.opcode)
+	{
+	case SPV_OpTypeSampledImage:
+		descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		return true;
+	case SPV_OpTypeSampler:
+		descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		return true;
+	case SPV_OpTypeImage:
+		if (type.dim == SPV_DimSubpassData)
+		{
+			descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		}
+		else if (type.dim == SPV_DimBuffer)
+		{
+			descriptorType = type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+		}
+		else
+		{
+			descriptorType = type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool Shader_Wrapper::Reflect(const uint32_t *code, size_t wordCount, Shader_Reflection &reflection)
+{
+	const static VkShaderStageFlagBits executionStages[] = {
+		VK_SHADER_STAGE_VERTEX_BIT,
+		VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+		VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+		VK_SHADER_STAGE_GEOMETRY_BIT,
+		VK_SHADER_STAGE_FRAGMENT_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT
+	};
+	std::vector<Spirv_Id> ids;
+	std::vector<uint32_t> variables;
+	size_t word = 5;
+
+	reflection = Shader_Reflection();
+
+	if (wordCount < 5 || code[0] != SPIRV_MAGIC)
+	{
+		return false;
+	}
+
+	ids.resize(code[3]);
+
+	while (word < wordCount)
+	{
+		const uint32_t *op = code + word;
+		uint32_t length = op[0] >> 16;
+		uint32_t opcode = op[0] & 0xFFFF;
+
+		if (length == 0 || word + length > wordCount)
+		{
+			slog("truncated SPIR-V instruction");
+			return false;
+		}
+
+		//every opcode handled below keeps its result id in op[1], except constants and variables which use op[2]
+		uint32_t result = (opcode == SPV_OpConstant || opcode == SPV_OpVariable) ? (length > 2 ? op[2] : 0) : (length > 1 ? op[1] : 0);
+
+		if (result >= ids.size() && opcode != SPV_OpEntryPoint)
+		{
+			word += length;
+			continue;
+		}
+
+		if (!SpirvOperandsValid(op, opcode, length, (uint32_t)ids.size()))
+		{
+			slog("malformed SPIR-V instruction, opcode %u with %u words", opcode, length);
+			return false;
+		}
+
+		switch (opcode)
+		{
+		case SPV_OpEntryPoint:
+			if (op[1] < sizeof(executionStages) / sizeof(executionStages[0]))
+			{
+				reflection.stages |= executionStages[op[1]];
+			}
+			break;
+		case SPV_OpTypeInt:
+			ids[result].opcode = opcode;
+			ids[result].width = op[2];
+			ids[result].sign = op[3];
+			break;
+		case SPV_OpTypeFloat:
+			ids[result].opcode = opcode;
+			ids[result].width = op[2];
+			break;
+		case SPV_OpTypeVector:
+		case SPV_OpTypeMatrix:
+		case SPV_OpTypeArray:
+			ids[result].opcode = opcode;
+			ids[result].typeId = op[2];
+			ids[result].width = op[3];
+			break;
+		case SPV_OpTypeRuntimeArray:
+		case SPV_OpTypeSampledImage:
+			ids[result].opcode = opcode;
+			ids[result].typeId = op[2];
+			break;
+		case SPV_OpTypeImage:
+			ids[result].opcode = opcode;
+			ids[result].typeId = op[2];
+			ids[result].dim = op[3];
+			ids[result].sampled = op[7];
+			break;
+		case SPV_OpTypeSampler:
+			ids[result].opcode = opcode;
+			break;
+		case SPV_OpTypeStruct:
+			ids[result].opcode = opcode;
+			ids[result].members.assign(op + 2, op + length);
+			break;
+		case SPV_OpTypePointer:
+			ids[result].opcode = opcode;
+			ids[result].storageClass = op[2];
+			ids[result].typeId = op[3];
+			break;
+		case SPV_OpConstant:
+			ids[result].opcode = opcode;
+			ids[result].typeId = op[1];
+			ids[result].constant = op[3];
+			break;
+		case SPV_OpVariable:
+			ids[result].opcode = opcode;
+			ids[result].typeId = op[1];
+			ids[result].storageClass = op[3];
+			variables.push_back(result);
+			break;
+		case SPV_OpDecorate:
+			switch (op[2])
+			{
+			case SPV_DecorationBlock: ids[result].block = true; break;
+			case SPV_DecorationBufferBlock: ids[result].bufferBlock = true; break;
+			case SPV_DecorationBuiltIn: ids[result].builtIn = true; break;
+			case SPV_DecorationArrayStride: ids[result].arrayStride = op[3]; break;
+			case SPV_DecorationLocation: ids[result].location = op[3]; ids[result].hasLocation = true; break;
+			case SPV_DecorationBinding: ids[result].binding = op[3]; ids[result].hasBinding = true; break;
+			case SPV_DecorationDescriptorSet: ids[result].set = op[3]; break;
+			}
+			break;
+		case SPV_OpMemberDecorate:
+			if (op[3] == SPV_DecorationOffset || op[3] == SPV_DecorationMatrixStride)
+			{
+				std::vector<uint32_t> &values = op[3] == SPV_DecorationOffset ? ids[result].memberOffsets : ids[result].memberMatrixStrides;
+
+				if (values.size() <= op[2])
+				{
+					values.resize(op[2] + 1, 0);
+				}
+				values[op[2]] = op[4];
+			}
+			else if (op[3] == SPV_DecorationBuiltIn)
+			{
+				//gl_PerVertex members are builtins, the block itself is then never a user input
+				ids[result].builtIn = true;
+			}
+			break;
+		}
+
+		word += length;
+	}
+
+	for (uint32_t id : variables)
+	{
+		const Spirv_Id &variable = ids[id];
+		const Spirv_Id &pointee = ids[ids[variable.typeId].typeId];
+
+		if (variable.storageClass == SPV_StorageInput)
+		{
+			if ((reflection.stages & VK_SHADER_STAGE_VERTEX_BIT) && variable.hasLocation && !variable.builtIn && !pointee.builtIn)
+			{
+				Shader_VertexInput input;
+				input.location = variable.location;
+				input.format = SpirvVertexFormat(ids, ids[variable.typeId].typeId);
+				reflection.vertexInputs.push_back(input);
+			}
+		}
+		else if (variable.storageClass == SPV_StoragePushConstant)
+		{
+			VkPushConstantRange range = {};
+			uint32_t start = pointee.memberOffsets.empty() ? 0 : *std::min_element(pointee.memberOffsets.begin(), pointee.memberOffsets.end());
+
+			range.stageFlags = reflection.stages;
+			range.offset = start;
+			range.size = SpirvTypeSize(ids, ids[variable.typeId].typeId, 0) - start;
+			reflection.pushConstants.push_back(range);
+		}
+		else if (variable.storageClass == SPV_StorageUniformConstant || variable.storageClass == SPV_StorageUniform || variable.storageClass == SPV_StorageStorageBuffer)
+		{
+			Shader_Binding binding;
+
+			if (!variable.hasBinding || !SpirvDescriptorType(ids, variable, binding.type, binding.count))
+			{
+				continue;
+			}
+
+			binding.set = variable.set;
+			binding.binding = variable.binding;
+			binding.stages = reflection.stages;
+			reflection.bindings.push_back(binding);
+		}
+	}
+
+	std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const Shader_Binding &a, const Shader_Binding &b)
+	{
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+
+	std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [](const Shader_VertexInput &a, const Shader_VertexInput &b)
+	{
+		return a.location < b.location;
+	});
+
+	return true;
+}
+
+bool Shader_Wrapper::MergeReflection(Shader_Reflection &into, const Shader_Reflection &from)
+{
+	into.stages |= from.stages;
+
+	for (const Shader_Binding &binding : from.bindings)
+	{
+		bool merged = false;
+
+		for (Shader_Binding &existing : into.bindings)
+		{
+			if (existing.set != binding.set || existing.binding != binding.binding)
+			{
+				continue;
+			}
+
+			if (existing.type != binding.type)
+			{
+				slog("set %i binding %i is declared with different descriptor types across stages", binding.set, binding.binding);
+				return false;
+			}
+
+			existing.stages |= binding.stages;
+			existing.count = (existing.count == 0 || binding.count == 0) ? 0 : std::max(existing.count, binding.count);
+			merged = true;
+			break;
+		}
+
+		if (!merged)
+		{
+			into.bindings.push_back(binding);
+		}
+	}
+
+	std::sort(into.bindings.begin(), into.bindings.end(), [](const Shader_Binding &a, const Shader_Binding &b)
+	{
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+
+	//one range visible to every stage that uses push constants keeps the layout simple and valid
+	for (const VkPushConstantRange &range : from.pushConstants)
+	{
+		if (into.pushConstants.empty())
+		{
+			into.pushConstants.push_back(range);
+			continue;
+		}
+
+		VkPushConstantRange &existing = into.pushConstants[0];
+		uint32_t end = std::max(existing.offset + existing.size, range.offset + range.size);
+
+		existing.offset = std::min(existing.offset, range.offset);
+		existing.size = end - existing.offset;
+		existing.stageFlags |= range.stageFlags;
+	}
+
+	if (!from.vertexInputs.empty())
+	{
+		into.vertexInputs = from.vertexInputs;
+	}
+
+	return true;
+}
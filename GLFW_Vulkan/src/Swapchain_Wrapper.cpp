@@ -14,6 +14,9 @@ Swapchain_Wrapper::Swapchain_Wrapper()
 	chosenFormat = 0;
 	chosenPresentMode = 0;
 	swapchainImageCount = 0;
+
+	swapchain = VK_NULL_HANDLE;
+	logDevice = VK_NULL_HANDLE;
 }
 
 Swapchain_Wrapper::~Swapchain_Wrapper()
@@ -281,10 +284,7 @@ void Swapchain_Wrapper::CleanupSwapChain(VkCommandPool pool, std::vector<VkComma
 
 	vkFreeCommandBuffers(logDevice, pool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
 
-	vkDestroyPipeline(logDevice, pipeWrapper->GetCurrentPipe().graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(logDevice, pipeWrapper->GetPipelineLayout(), nullptr);
-	vkDestroyRenderPass(logDevice, pipeWrapper->GetCurrentPipe().renderPass, nullptr);
-
+	//pipelines, layouts and the render pass belong to the pipeline registry
 
 	for (size_t i = 0; i < imageViews.size(); i++) {
 		vkDestroyImageView(logDevice, imageViews[i], nullptr);
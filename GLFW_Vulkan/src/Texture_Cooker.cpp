@@ -0,0 +1,516 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <stb_image.h>
+
+#include "Texture_Cooker.h"
+#include "Texture_Ktx2.h"
+#include "Texture_Palette.h"
+#include "simple_logger.h"
+
+//BC7 4 bit index interpolation weights out of 64
+const static int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/**
+ * @brief fits a line through the block's colours along their principal axis, low and high are its extremes
+ */
+static void FitLine(const uint8_t texels[16][4], int channels, float low[4], float high[4])
+{
+	float mean[4] = {};
+	float minimum[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+	float maximum[4] = {};
+
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < channels; ++c)
+		{
+			mean[c] += texels[i][c] / 16.0f;
+			minimum[c] = std::min(minimum[c], (float)texels[i][c]);
+			maximum[c] = std::max(maximum[c], (float)texels[i][c]);
+		}
+	}
+
+	float covariance[4][4] = {};
+
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int a = 0; a < channels; ++a)
+		{
+			for (int b = 0; b < channels; ++b)
+			{
+				covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+			}
+		}
+	}
+
+	//power iteration from the bounding box diagonal converges on the principal axis in a few steps
+	float axis[4] = {};
+
+	for (int c = 0; c < channels; ++c)
+	{
+		axis[c] = maximum[c] - minimum[c];
+	}
+
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+
+		for (int a = 0; a < channels; ++a)
+		{
+			for (int b = 0; b < channels; ++b)
+			{
+				next[a] += covariance[a][b] * axis[b];
+			}
+			length += next[a] * next[a];
+		}
+
+		if (length < 1e-6f)
+		{
+			break;
+		}
+
+		length = sqrtf(length);
+
+		for (int c = 0; c < channels; ++c)
+		{
+			axis[c] = next[c] / length;
+		}
+	}
+
+	float axisLength = 0.0f;
+
+	for (int c = 0; c < channels; ++c)
+	{
+		axisLength += axis[c] * axis[c];
+	}
+
+	//a flat block has no axis, both ends sit on the mean
+	float tMin = 0.0f;
+	float tMax = 0.0f;
+
+	if (axisLength > 1e-6f)
+	{
+		axisLength = sqrtf(axisLength);
+
+		for (int c = 0; c < channels; ++c)
+		{
+			axis[c] /= axisLength;
+		}
+
+		tMin = 1e9f;
+		tMax = -1e9f;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0.0f;
+
+			for (int c = 0; c < channels; ++c)
+			{
+				t += (texels[i][c] - mean[c]) * axis[c];
+			}
+
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+	}
+
+	for (int c = 0; c < channels; ++c)
+	{
+		low[c] = std::min(std::max(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+		high[c] = std::min(std::max(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+	}
+}
+
+static int ColorDistance(const int a[4], const uint8_t b[4], int channels)
+{
+	int distance = 0;
+
+	for (int c = 0; c < channels; ++c)
+	{
+		distance += (a[c] - b[c]) * (a[c] - b[c]);
+	}
+
+	return distance;
+}
+
+static uint16_t PackRGB565(const float color[4])
+{
+	uint16_t r = (uint16_t)(color[0] * 31.0f / 255.0f + 0.5f);
+	uint16_t g = (uint16_t)(color[1] * 63.0f / 255.0f + 0.5f);
+	uint16_t b = (uint16_t)(color[2] * 31.0f / 255.0f + 0.5f);
+
+	return (r << 11) | (g << 5) | b;
+}
+
+static void UnpackRGB565(uint16_t packed, int color[4])
+{
+	int r = packed >> 11;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+	color[3] = 255;
+}
+
+void Texture_Cooker::EncodeBC1Block(const uint8_t texels[16][4], uint8_t block[8])
+{
+	float low[4], high[4];
+
+	FitLine(texels, 3, low, high);
+
+	uint16_t color0 = PackRGB565(high);
+	uint16_t color1 = PackRGB565(low);
+	uint32_t indices = 0;
+
+	//color0 > color1 selects the four colour mode
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	if (color0 != color1)
+	{
+		int palette[4][4];
+
+		UnpackRGB565(color0, palette[0]);
+		UnpackRGB565(color1, palette[1]);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 0;
+			int bestDistance = ColorDistance(palette[0], texels[i], 3);
+
+			for (int p = 1; p < 4; ++p)
+			{
+				int distance = ColorDistance(palette[p], texels[i], 3);
+
+				if (distance < bestDistance)
+				{
+					best = p;
+					bestDistance = distance;
+				}
+			}
+
+			indices |= (uint32_t)best << (i * 2);
+		}
+	}
+
+	block[0] = color0 & 0xFF;
+	block[1] = color0 >> 8;
+	block[2] = color1 & 0xFF;
+	block[3] = color1 >> 8;
+	memcpy(block + 4, &indices, sizeof(indices));
+}
+
+/**
+ * @brief appends fields to a block least significant bit first, the order BC7 is laid out in
+ */
+struct Texture_BlockWriter
+{
+	uint8_t		*block;
+	uint32_t	position;
+
+	void Write(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i = 0; i < bits; ++i, ++position)
+		{
+			if ((value >> i) & 1)
+			{
+				block[position >> 3] |= 1 << (position & 7);
+			}
+		}
+	}
+};
+
+void Texture_Cooker::EncodeBC7Block(const uint8_t texels[16][4], uint8_t block[16])
+{
+	float ends[2][4];
+
+	FitLine(texels, 4, ends[0], ends[1]);
+
+	//mode 6 endpoints are 7 bits per channel plus one p-bit shared by the endpoint's channels
+	int quantized[2][4];
+	int pBits[2];
+	int expanded[2][4];
+
+	for (int e = 0; e < 2; ++e)
+	{
+		int bestError = -1;
+
+		for (int p = 0; p < 2; ++p)
+		{
+			int error = 0;
+			int candidate[4];
+
+			for (int c = 0; c < 4; ++c)
+			{
+				candidate[c] = std::min(std::max((int)((ends[e][c] - p) / 2.0f + 0.5f), 0), 127);
+				int value = (candidate[c] << 1) | p;
+				error += (int)((value - ends[e][c]) * (value - ends[e][c]));
+			}
+
+			if (bestError < 0 || error < bestError)
+			{
+				bestError = error;
+				pBits[e] = p;
+				memcpy(quantized[e], candidate, sizeof(candidate));
+			}
+		}
+
+		for (int c = 0; c < 4; ++c)
+		{
+			expanded[e][c] = (quantized[e][c] << 1) | pBits[e];
+		}
+	}
+
+	int palette[16][4];
+
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			palette[i][c] = (expanded[0][c] * (64 - BC7_WEIGHTS4[i]) + expanded[1][c] * BC7_WEIGHTS4[i] + 32) >> 6;
+		}
+	}
+
+	int indices[16];
+
+	for (int i = 0; i < 16; ++i)
+	{
+		int bestDistance = ColorDistance(palette[0], texels[i], 4);
+		indices[i] = 0;
+
+		for (int p = 1; p < 16; ++p)
+		{
+			int distance = ColorDistance(palette[p], texels[i], 4);
+
+			if (distance < bestDistance)
+			{
+				indices[i] = p;
+				bestDistance = distance;
+			}
+		}
+	}
+
+	//the first index is stored without its top bit, so it must be below 8
+	if (indices[0] & 8)
+	{
+		std::swap(quantized[0], quantized[1]);
+		std::swap(pBits[0], pBits[1]);
+
+		for (int i = 0; i < 16; ++i)
+		{
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	memset(block, 0, 16);
+
+	Texture_BlockWriter writer = { block, 0 };
+
+	writer.Write(1 << 6, 7);
+
+	for (int c = 0; c < 4; ++c)
+	{
+		writer.Write(quantized[0][c], 7);
+		writer.Write(quantized[1][c], 7);
+	}
+
+	writer.Write(pBits[0], 1);
+	writer.Write(pBits[1], 1);
+
+	for (int i = 0; i < 16; ++i)
+	{
+		writer.Write(indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+void Texture_Cooker::EncodeImage(const uint8_t *rgba, uint32_t width, uint32_t height, TextureCookFormat format, std::vector<uint8_t> &blocks)
+{
+	uint32_t blockBytes = format == TC_BC1 ? 8 : 16;
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t blocksHigh = (height + 3) / 4;
+
+	blocks.resize((size_t)blocksWide * blocksHigh * blockBytes);
+
+	for (uint32_t by = 0; by < blocksHigh; ++by)
+	{
+		for (uint32_t bx = 0; bx < blocksWide; ++bx)
+		{
+			uint8_t texels[16][4];
+
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				uint32_t x = std::min(bx * 4 + (i & 3), width - 1);
+				uint32_t y = std::min(by * 4 + (i >> 2), height - 1);
+
+				memcpy(texels[i], rgba + ((size_t)y * width + x) * 4, 4);
+			}
+
+			uint8_t *block = blocks.data() + ((size_t)by * blocksWide + bx) * blockBytes;
+
+			if (format == TC_BC1)
+			{
+				EncodeBC1Block(texels, block);
+			}
+			else
+			{
+				EncodeBC7Block(texels, block);
+			}
+		}
+	}
+}
+
+void Texture_Cooker::Downsample(const std::vector<uint8_t> &source, uint32_t width, uint32_t height, std::vector<uint8_t> &destination)
+{
+	uint32_t halfWidth = std::max(width / 2, 1u);
+	uint32_t halfHeight = std::max(height / 2, 1u);
+
+	destination.resize((size_t)halfWidth * halfHeight * 4);
+
+	for (uint32_t y = 0; y < halfHeight; ++y)
+	{
+		uint32_t y0 = std::min(y * 2, height - 1);
+		uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+		for (uint32_t x = 0; x < halfWidth; ++x)
+		{
+			uint32_t x0 = std::min(x * 2, width - 1);
+			uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				uint32_t sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c] +
+					source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+
+				destination[((size_t)y * halfWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+bool Texture_Cooker::Cook(const char *source, const char *destination, TextureCookFormat format)
+{
+	int width, height, channels;
+	stbi_uc *pixels = stbi_load(source, &width, &height, &channels, STBI_rgb_alpha);
+
+	if (!pixels)
+	{
+		slog("failed to decode %s", source);
+		return false;
+	}
+
+	std::vector<uint8_t> level(pixels, pixels + (size_t)width * height * 4);
+	std::vector<std::vector<uint8_t>> levelBlocks;
+	uint32_t levelWidth = (uint32_t)width;
+	uint32_t levelHeight = (uint32_t)height;
+
+	stbi_image_free(pixels);
+
+	while (true)
+	{
+		levelBlocks.push_back(std::vector<uint8_t>());
+		EncodeImage(level.data(), levelWidth, levelHeight, format, levelBlocks.back());
+
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+
+		std::vector<uint8_t> next;
+		Downsample(level, levelWidth, levelHeight, next);
+		level.swap(next);
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+
+	VkFormat vkFormat = format == TC_BC1 ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+
+	if (!Texture_Ktx2::Write(destination, vkFormat, (uint32_t)width, (uint32_t)height, levelBlocks))
+	{
+		return false;
+	}
+
+	size_t cookedBytes = 0;
+
+	for (const std::vector<uint8_t> &blocks : levelBlocks)
+	{
+		cookedBytes += blocks.size();
+	}
+
+	slog("cooked %s to %s: %ix%i, %i levels, %i bytes against %i as RGBA8 without mips", source, destination, width, height,
+		(uint32_t)levelBlocks.size(), (uint32_t)cookedBytes, width * height * 4);
+
+	return true;
+}
+
+bool Texture_Cooker::CookPaletted(const char *source, const char *palettePath, const char *destination)
+{
+	Texture_Palette palette;
+
+	if (!palette.Texture_PaletteInit(palettePath))
+	{
+		return false;
+	}
+
+	int width, height, channels;
+	stbi_uc *pixels = stbi_load(source, &width, &height, &channels, STBI_rgb_alpha);
+
+	if (!pixels)
+	{
+		slog("failed to decode %s", source);
+		return false;
+	}
+
+	//indices can't be averaged, so the file holds a single level and the loader does not generate a chain
+	std::vector<std::vector<uint8_t>> levels(1, std::vector<uint8_t>((size_t)width * height));
+	uint32_t inexact = 0;
+
+	for (size_t i = 0; i < levels[0].size(); ++i)
+	{
+		const stbi_uc *texel = &pixels[i * 4];
+
+		if (texel[3] < 128)
+		{
+			levels[0][i] = PALETTE_TRANSPARENT_INDEX;
+			continue;
+		}
+
+		uint8_t index = palette.NearestIndex(texel[0], texel[1], texel[2]);
+		const uint8_t *color = palette.GetColor(index);
+
+		//art drawn in the palette maps exactly, anything else is quantized to the closest entry
+		if (color[0] != texel[0] || color[1] != texel[1] || color[2] != texel[2])
+		{
+			++inexact;
+		}
+
+		levels[0][i] = index;
+	}
+
+	stbi_image_free(pixels);
+
+	if (inexact)
+	{
+		slog("%s: %u texels are not palette colours and were quantized", source, inexact);
+	}
+
+	if (!Texture_Ktx2::Write(destination, VK_FORMAT_R8_UINT, (uint32_t)width, (uint32_t)height, levels))
+	{
+		return false;
+	}
+
+	slog("cooked %s to %s: %ix%i palette indices, %i bytes against %i as RGBA8", source, destination, width, height,
+		width * height, width * height * 4);
+
+	return true;
+}
\ No newline at end of file
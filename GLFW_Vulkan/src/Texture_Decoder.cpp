@@ -0,0 +1,474 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <stb_image.h>
+
+#include "Texture_Decoder.h"
+#include "simple_logger.h"
+#include "Profiler.h"
+
+//staging regions start on this alignment, which covers the texel size copy alignment
+const static uint64_t DECODE_STAGING_ALIGNMENT = 16;
+
+//region the current decode job's image should be decoded into
+static thread_local uint8_t *decodeTarget = NULL;
+static thread_local size_t decodeTargetSize = 0;
+static thread_local size_t decodeImageSize = 0;
+static thread_local bool decodeTargetClaimed = false;
+
+void* Texture_DecodeMalloc(size_t size)
+{
+	//only the output buffer is sized like the image, if an intermediate happens to match the copy after decode still covers it
+	if (decodeTarget && !decodeTargetClaimed && size >= decodeImageSize && size <= decodeTargetSize)
+	{
+		decodeTargetClaimed = true;
+		return decodeTarget;
+	}
+
+	return malloc(size);
+}
+
+void* Texture_DecodeRealloc(void *pointer, size_t size)
+{
+	if (pointer && pointer == decodeTarget)
+	{
+		//a staging region can't grow, the buffer moves to the heap instead
+		void *moved = malloc(size);
+
+		if (moved)
+		{
+			memcpy(moved, pointer, std::min(size, decodeTargetSize));
+		}
+
+		decodeTargetClaimed = false;
+
+		return moved;
+	}
+
+	return realloc(pointer, size);
+}
+
+void Texture_DecodeFree(void *pointer)
+{
+	if (pointer && pointer == decodeTarget)
+	{
+		decodeTargetClaimed = false;
+		return;
+	}
+
+	free(pointer);
+}
+
+static uint64_t AlignStaging(uint64_t size)
+{
+	return (size + DECODE_STAGING_ALIGNMENT - 1) & ~(DECODE_STAGING_ALIGNMENT - 1);
+}
+
+Texture_Decoder::Texture_Decoder()
+{
+	jobSystem = NULL;
+	stopDecoding = false;
+	nextId = 0;
+	pending = 0;
+	prefetchBytes = 0;
+	prefetchLimit = 0;
+	stagingMemory = NULL;
+	stagingSize = 0;
+	decodeCount = 0;
+	stagedInPlace = 0;
+	bytesRead = 0;
+}
+
+Texture_Decoder::~Texture_Decoder()
+{
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+		stopDecoding = true;
+	}
+
+	readReady.notify_all();
+	stagingFreed.notify_all();
+
+	if (ioThread.joinable())
+	{
+		ioThread.join();
+	}
+
+	//queued jobs still run, they find the decoder stopping and return without touching the staging memory
+	if (jobSystem)
+	{
+		jobSystem->Wait(&decodesRunning);
+	}
+}
+
+void Texture_Decoder::Texture_DecoderInit(void *staging, uint64_t size, Job_System *jobs, uint64_t prefetchSize)
+{
+	stagingMemory = (uint8_t*)staging;
+	stagingSize = size & ~(DECODE_STAGING_ALIGNMENT - 1);
+	prefetchLimit = prefetchSize;
+	jobSystem = jobs;
+
+	stagingFree.clear();
+	stagingFree[0] = stagingSize;
+
+	ioThread = std::thread(&Texture_Decoder::ReadWorker, this);
+}
+
+uint32_t Texture_Decoder::Submit(const std::string &path)
+{
+	Texture_DecodeJob job;
+	uint32_t id;
+
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+
+		id = nextId++;
+		job.id = id;
+		job.path = path;
+
+		reads.push_back(std::move(job));
+		++pending;
+	}
+
+	readReady.notify_one();
+
+	return id;
+}
+
+bool Texture_Decoder::WaitResult(Texture_DecodeResult &result)
+{
+	std::unique_lock<std::mutex> lock(decodeMutex);
+	resultReady.wait(lock, [this]{ return !results.empty() || pending == 0; });
+
+	if (results.empty())
+	{
+		return false;
+	}
+
+	result = results.front();
+	results.pop_front();
+	--pending;
+
+	return true;
+}
+
+bool Texture_Decoder::TryResult(Texture_DecodeResult &result)
+{
+	std::lock_guard<std::mutex> lock(decodeMutex);
+
+	if (results.empty())
+	{
+		return false;
+	}
+
+	result = results.front();
+	results.pop_front();
+	--pending;
+
+	return true;
+}
+
+void Texture_Decoder::ReleaseStaging(const Texture_DecodeResult &result)
+{
+	if (!result.succeeded || result.pixels)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+		FreeStaging(result.offset, result.size);
+	}
+
+	stagingFreed.notify_all();
+}
+
+bool Texture_Decoder::AllocateStaging(uint64_t size, uint64_t &offset)
+{
+	std::unique_lock<std::mutex> lock(decodeMutex);
+
+	while (!stopDecoding)
+	{
+		for (auto range = stagingFree.begin(); range != stagingFree.end(); ++range)
+		{
+			if (range->second < size)
+			{
+				continue;
+			}
+
+			offset = range->first;
+
+			if (range->second > size)
+			{
+				stagingFree[range->first + size] = range->second - size;
+			}
+
+			stagingFree.erase(range);
+
+			return true;
+		}
+
+		//every other region belongs to an image being decoded or uploaded, each is released once it is done
+		stagingFreed.wait(lock);
+	}
+
+	return false;
+}
+
+void Texture_Decoder::FreeStaging(uint64_t offset, uint64_t size)
+{
+	auto range = stagingFree.insert(std::make_pair(offset, size)).first;
+	auto next = std::next(range);
+
+	if (next != stagingFree.end() && range->first + range->second == next->first)
+	{
+		range->second += next->second;
+		stagingFree.erase(next);
+	}
+
+	if (range != stagingFree.begin())
+	{
+		auto previous = std::prev(range);
+
+		if (previous->first + previous->second == range->first)
+		{
+			previous->second += range->second;
+			stagingFree.erase(range);
+		}
+	}
+}
+
+void Texture_Decoder::ReadWorker()
+{
+	while (true)
+	{
+		Texture_DecodeJob job;
+
+		{
+			//reads ahead until the decodes fall prefetchLimit behind, an idle pool always gets its next file
+			std::unique_lock<std::mutex> lock(decodeMutex);
+			readReady.wait(lock, [this]{ return stopDecoding || (!reads.empty() && (prefetchBytes < prefetchLimit || jobs.empty())); });
+
+			if (stopDecoding)
+			{
+				return;
+			}
+
+			job = std::move(reads.front());
+			reads.pop_front();
+		}
+
+		{
+			PROFILE_ZONE("ReadTextureFile");
+
+			FILE *file = fopen(job.path.c_str(), "rb");
+
+			if (file)
+			{
+				fseek(file, 0, SEEK_END);
+				long fileSize = ftell(file);
+				rewind(file);
+
+				job.bytes.resize(fileSize > 0 ? (size_t)fileSize : 0);
+
+				if (fread(job.bytes.data(), 1, job.bytes.size(), file) != job.bytes.size())
+				{
+					job.bytes.clear();
+				}
+
+				fclose(file);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(decodeMutex);
+
+			prefetchBytes += job.bytes.size();
+			bytesRead += job.bytes.size();
+			jobs.push_back(std::move(job));
+		}
+
+		jobSystem->Run(&Texture_Decoder::DecodeJob, this, &decodesRunning);
+	}
+}
+
+void Texture_Decoder::DecodeJob(void *data, uint32_t begin, uint32_t end)
+{
+	((Texture_Decoder*)data)->DecodeNext();
+}
+
+void Texture_Decoder::DecodeNext()
+{
+	Texture_DecodeJob job;
+
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+
+		if (stopDecoding || jobs.empty())
+		{
+			return;
+		}
+
+		job = std::move(jobs.front());
+		jobs.pop_front();
+	}
+
+	PROFILE_ZONE("DecodeTexture");
+
+	Texture_DecodeResult result = {};
+	int width, height, channels;
+
+	result.id = job.id;
+	result.path = job.path;
+
+	//the header alone sizes the staging region before any texels are decoded
+	if (!job.bytes.empty() && stbi_info_from_memory(job.bytes.data(), (int)job.bytes.size(), &width, &height, &channels))
+	{
+		result.width = (uint32_t)width;
+		result.height = (uint32_t)height;
+
+		uint64_t imageSize = (uint64_t)width * height * 4;
+
+		//some stb_image loaders allocate their output a byte longer than the texels
+		uint64_t regionSize = AlignStaging(imageSize + 1);
+
+		if (regionSize <= stagingSize)
+		{
+			if (!AllocateStaging(regionSize, result.offset))
+			{
+				return;
+			}
+
+			result.size = regionSize;
+
+			decodeTarget = stagingMemory + result.offset;
+			decodeTargetSize = (size_t)regionSize;
+			decodeImageSize = (size_t)imageSize;
+			decodeTargetClaimed = false;
+
+			stbi_uc *pixels = stbi_load_from_memory(job.bytes.data(), (int)job.bytes.size(), &width, &height, &channels, STBI_rgb_alpha);
+
+			result.succeeded = pixels != NULL;
+
+			if (pixels && pixels != decodeTarget)
+			{
+				memcpy(decodeTarget, pixels, (size_t)imageSize);
+				stbi_image_free(pixels);
+			}
+			else if (pixels)
+			{
+				std::lock_guard<std::mutex> lock(decodeMutex);
+				++stagedInPlace;
+			}
+
+			decodeTarget = NULL;
+
+			if (!result.succeeded)
+			{
+				std::lock_guard<std::mutex> lock(decodeMutex);
+				FreeStaging(result.offset, result.size);
+			}
+		}
+		else
+		{
+			//larger than the whole staging memory, the caller stages it on its own
+			result.pixels = stbi_load_from_memory(job.bytes.data(), (int)job.bytes.size(), &width, &height, &channels, STBI_rgb_alpha);
+			result.succeeded = result.pixels != NULL;
+		}
+	}
+
+	if (!result.succeeded)
+	{
+		slog("failed to decode texture image %s", job.path.c_str());
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+
+		prefetchBytes -= job.bytes.size();
+		++decodeCount;
+		results.push_back(result);
+	}
+
+	if (!result.succeeded)
+	{
+		stagingFreed.notify_all();
+	}
+
+	readReady.notify_one();
+	resultReady.notify_all();
+}
+
+uint32_t Texture_Decoder::GetDecodeCount()
+{
+	std::lock_guard<std::mutex> lock(decodeMutex);
+
+	return decodeCount;
+}
+
+uint32_t Texture_Decoder::GetStagedInPlace()
+{
+	std::lock_guard<std::mutex> lock(decodeMutex);
+
+	return stagedInPlace;
+}
+
+uint64_t Texture_Decoder::GetBytesRead()
+{
+	std::lock_guard<std::mutex> lock(decodeMutex);
+
+	return bytesRead;
+}
+
+bool Texture_Decoder::Benchmark(const std::vector<std::string> &paths, uint64_t stagingBytes)
+{
+	std::vector<uint8_t> staging((size_t)stagingBytes);
+	uint32_t workerCounts[2] = { 1, 0 };
+	double singleMs = 0.0;
+	bool succeeded = true;
+
+	for (uint32_t workers : workerCounts)
+	{
+		Job_System jobSystem;
+		Texture_Decoder decoder;
+		Texture_DecodeResult result;
+		uint64_t texels = 0;
+
+		jobSystem.Job_SystemInit(workers);
+		decoder.Texture_DecoderInit(staging.data(), staging.size(), &jobSystem);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (const std::string &path : paths)
+		{
+			decoder.Submit(path);
+		}
+
+		while (decoder.WaitResult(result))
+		{
+			succeeded = succeeded && result.succeeded;
+			texels += (uint64_t)result.width * result.height;
+
+			if (result.pixels)
+			{
+				stbi_image_free(result.pixels);
+			}
+
+			decoder.ReleaseStaging(result);
+		}
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (workers == 1)
+		{
+			singleMs = ms;
+		}
+
+		slog("decoded %u images, %.1f megatexels, with %u workers in %.2f ms, %.2fx single worker, %u staged in place",
+			(uint32_t)paths.size(), texels / 1000000.0, decoder.GetWorkerCount(), ms, ms > 0.0 ? singleMs / ms : 0.0, decoder.GetStagedInPlace());
+	}
+
+	return succeeded;
+}
\ No newline at end of file
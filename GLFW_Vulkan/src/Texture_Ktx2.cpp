@@ -0,0 +1,279 @@
+#include <string.h>
+#include <algorithm>
+
+#include "Texture_Ktx2.h"
+#include "simple_logger.h"
+
+const static uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+//data format descriptor values, see the Khronos Data Format specification
+const static uint32_t KHR_DF_MODEL_RGBSDA = 1;
+const static uint32_t KHR_DF_MODEL_BC1A = 128;
+const static uint32_t KHR_DF_MODEL_BC3 = 130;
+const static uint32_t KHR_DF_MODEL_BC5 = 132;
+const static uint32_t KHR_DF_MODEL_BC7 = 134;
+const static uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+const static uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+const static uint32_t KHR_DF_TRANSFER_SRGB = 2;
+
+Texture_Ktx2::Texture_Ktx2()
+{
+	file = NULL;
+	header = {};
+}
+
+Texture_Ktx2::~Texture_Ktx2()
+{
+	if (file)
+	{
+		fclose(file);
+	}
+}
+
+uint32_t Texture_Ktx2::BlockBytes(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return 4;
+	case VK_FORMAT_R8_UINT:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+bool Texture_Ktx2::IsBlockCompressed(VkFormat format)
+{
+	return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+bool Texture_Ktx2::IsIntegerFormat(VkFormat format)
+{
+	return format == VK_FORMAT_R8_UINT;
+}
+
+uint64_t Texture_Ktx2::LevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	if (IsBlockCompressed(format))
+	{
+		return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+	}
+
+	return (uint64_t)width * height * BlockBytes(format);
+}
+
+bool Texture_Ktx2::Texture_Ktx2Init(const char *filename)
+{
+	file = fopen(filename, "rb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	uint64_t fileSize = (uint64_t)ftell(file);
+	rewind(file);
+
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+	{
+		slog("%s is not a KTX2 file", filename);
+		return false;
+	}
+
+	VkFormat format = (VkFormat)header.vkFormat;
+
+	if (!BlockBytes(format))
+	{
+		slog("%s uses unsupported format %i", filename, header.vkFormat);
+		return false;
+	}
+
+	if (header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || !header.pixelWidth || !header.pixelHeight)
+	{
+		slog("%s is not a 2D texture without supercompression", filename);
+		return false;
+	}
+
+	//0 asks the loader to generate mips, the single stored level is used as is
+	levels.resize(std::max(header.levelCount, 1u));
+
+	if (fread(levels.data(), sizeof(Texture_Ktx2Level), levels.size(), file) != levels.size())
+	{
+		slog("%s has a truncated level index", filename);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < levels.size(); ++i)
+	{
+		uint32_t width = std::max(header.pixelWidth >> i, 1u);
+		uint32_t height = std::max(header.pixelHeight >> i, 1u);
+
+		if (levels[i].byteOffset + levels[i].byteLength > fileSize || levels[i].byteLength != LevelSize(format, width, height))
+		{
+			slog("%s level %i does not match its dimensions", filename, i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Texture_Ktx2::ReadLevel(uint32_t level, void *destination)
+{
+	if (!file || level >= levels.size())
+	{
+		return false;
+	}
+
+	if (fseek(file, (long)levels[level].byteOffset, SEEK_SET) != 0)
+	{
+		return false;
+	}
+
+	return fread(destination, (size_t)levels[level].byteLength, 1, file) == 1;
+}
+
+bool Texture_Ktx2::Write(const char *filename, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>> &levelData)
+{
+	uint32_t blockBytes = BlockBytes(format);
+	bool compressed = IsBlockCompressed(format);
+	bool srgb = format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_R8G8B8A8_SRGB;
+
+	if (!blockBytes || levelData.empty())
+	{
+		return false;
+	}
+
+	uint32_t colorModel = KHR_DF_MODEL_RGBSDA;
+
+	if (format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK && compressed)
+	{
+		colorModel = KHR_DF_MODEL_BC1A;
+	}
+	else if (format == VK_FORMAT_BC3_UNORM_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK)
+	{
+		colorModel = KHR_DF_MODEL_BC3;
+	}
+	else if (format == VK_FORMAT_BC5_UNORM_BLOCK)
+	{
+		colorModel = KHR_DF_MODEL_BC5;
+	}
+	else if (format == VK_FORMAT_BC7_UNORM_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK)
+	{
+		colorModel = KHR_DF_MODEL_BC7;
+	}
+	else if (compressed)
+	{
+		return false;
+	}
+
+	//basic descriptor block, one sample covering the whole block for BCn or one per channel for uncompressed formats
+	std::vector<uint32_t> dfd;
+	uint32_t sampleCount = compressed ? 1 : blockBytes;
+
+	dfd.push_back(4 + 24 + 16 * sampleCount);
+	dfd.push_back(0);
+	dfd.push_back(2 | ((24 + 16 * sampleCount) << 16));
+	dfd.push_back(colorModel | (KHR_DF_PRIMARIES_BT709 << 8) | ((srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+	dfd.push_back(compressed ? (3 | (3 << 8)) : 0);
+	dfd.push_back(blockBytes);
+	dfd.push_back(0);
+
+	for (uint32_t sample = 0; sample < sampleCount; ++sample)
+	{
+		uint32_t bitOffset = compressed ? 0 : sample * 8;
+		uint32_t bitLength = compressed ? blockBytes * 8 : 8;
+		//RGBSDA channel ids are R 0, G 1, B 2 and A 15, BCn colour channels are 0
+		uint32_t channel = compressed ? 0 : (sample == 3 ? 15 : sample);
+
+		dfd.push_back(bitOffset | ((bitLength - 1) << 16) | (channel << 24));
+		dfd.push_back(0);
+		dfd.push_back(0);
+		//unnormalized integers map 1 to 1.0 rather than 255
+		dfd.push_back(compressed ? 0xFFFFFFFF : (IsIntegerFormat(format) ? 1 : 255));
+	}
+
+	Texture_Ktx2Header fileHeader = {};
+	std::vector<Texture_Ktx2Level> index(levelData.size());
+
+	memcpy(fileHeader.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	fileHeader.vkFormat = (uint32_t)format;
+	fileHeader.typeSize = 1;
+	fileHeader.pixelWidth = width;
+	fileHeader.pixelHeight = height;
+	fileHeader.pixelDepth = 0;
+	fileHeader.layerCount = 0;
+	fileHeader.faceCount = 1;
+	fileHeader.levelCount = (uint32_t)levelData.size();
+	fileHeader.supercompressionScheme = 0;
+	fileHeader.dfdByteOffset = (uint32_t)(sizeof(Texture_Ktx2Header) + index.size() * sizeof(Texture_Ktx2Level));
+	fileHeader.dfdByteLength = (uint32_t)(dfd.size() * sizeof(uint32_t));
+
+	//levels are stored smallest first, each aligned to the block size
+	uint64_t alignment = std::max(blockBytes, 4u);
+	uint64_t offset = fileHeader.dfdByteOffset + fileHeader.dfdByteLength;
+
+	for (size_t i = levelData.size(); i-- > 0;)
+	{
+		uint32_t levelWidth = std::max(width >> i, 1u);
+		uint32_t levelHeight = std::max(height >> i, 1u);
+
+		if (levelData[i].size() != LevelSize(format, levelWidth, levelHeight))
+		{
+			slog("level %i holds %i bytes, expected %i", (uint32_t)i, (uint32_t)levelData[i].size(), (uint32_t)LevelSize(format, levelWidth, levelHeight));
+			return false;
+		}
+
+		offset = (offset + alignment - 1) / alignment * alignment;
+		index[i].byteOffset = offset;
+		index[i].byteLength = levelData[i].size();
+		index[i].uncompressedByteLength = levelData[i].size();
+		offset += levelData[i].size();
+	}
+
+	FILE *out = fopen(filename, "wb");
+
+	if (!out)
+	{
+		slog("failed to open %s for writing", filename);
+		return false;
+	}
+
+	bool written = fwrite(&fileHeader, sizeof(fileHeader), 1, out) == 1;
+	written = written && fwrite(index.data(), sizeof(Texture_Ktx2Level), index.size(), out) == index.size();
+	written = written && fwrite(dfd.data(), sizeof(uint32_t), dfd.size(), out) == dfd.size();
+
+	const uint8_t padding[16] = {};
+
+	for (size_t i = levelData.size(); written && i-- > 0;)
+	{
+		long position = ftell(out);
+
+		written = fwrite(padding, 1, (size_t)(index[i].byteOffset - position), out) == (size_t)(index[i].byteOffset - position);
+		written = written && fwrite(levelData[i].data(), levelData[i].size(), 1, out) == 1;
+	}
+
+	written = fclose(out) == 0 && written;
+
+	if (!written)
+	{
+		slog("failed to write %s", filename);
+	}
+
+	return written;
+}
\ No newline at end of file
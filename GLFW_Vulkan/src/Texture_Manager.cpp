@@ -0,0 +1,656 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Texture_Manager.h"
+#include "Texture_Ktx2.h"
+#include "simple_logger.h"
+#include "Profiler.h"
+
+//streamed levels uploaded per frame, the rest wait for the next frame so a burst of reads can't stall one frame
+const static VkDeviceSize TEXTURE_STREAM_BYTES_PER_FRAME = 8 << 20;
+
+Texture_Manager::Texture_Manager()
+{
+	loader = NULL;
+	logicalDevice = VK_NULL_HANDLE;
+	defaultSampler = VK_NULL_HANDLE;
+	defaultSamplerInfo = {};
+	streamer = NULL;
+	textureTable = NULL;
+	streamTail = 0;
+	texturesChanged = false;
+	budget = 0;
+	residentBytes = 0;
+	residentCount = 0;
+	currentFrame = 0;
+	framesInFlight = 0;
+	overBudgetLogged = false;
+	lookupHits = 0;
+	loads = 0;
+	evictions = 0;
+	levelsStreamed = 0;
+	mipsDropped = 0;
+}
+
+Texture_Manager::~Texture_Manager()
+{
+	//joins the reader first so nothing is written into pendingUploads while the pool is torn down
+	if (streamer)
+	{
+		streamer->~Texture_Streamer();
+	}
+
+	for (Texture_Retired &retired : retiredTextures)
+	{
+		loader->DestroyTexture(retired.texture);
+	}
+
+	for (TextureHandle handle = 0; handle < textureList.size(); ++handle)
+	{
+		if (textureList[handle].inUse)
+		{
+			DestroyTexture(handle);
+		}
+	}
+
+	for (auto &entry : samplerCache)
+	{
+		vkDestroySampler(logicalDevice, entry.second, nullptr);
+	}
+}
+
+void Texture_Manager::Texture_ManagerInit(VkDevice device, Texture_Wrapper *textureLoader, VkDeviceSize budgetBytes, uint32_t streamTailSize)
+{
+	logicalDevice = device;
+	loader = textureLoader;
+	budget = budgetBytes;
+	streamTail = streamTailSize;
+
+	if (streamTail)
+	{
+		streamer = new Texture_Streamer();
+		streamer->Texture_StreamerInit();
+	}
+
+	if (!budget)
+	{
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(loader->GetPhysicalDevice(), &memoryProperties);
+
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+		{
+			if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			{
+				budget = std::max(budget, memoryProperties.memoryHeaps[i].size / 2);
+			}
+		}
+	}
+
+	defaultSamplerInfo = loader->DefaultSamplerInfo();
+	defaultSampler = GetSampler(defaultSamplerInfo);
+
+	slog("texture budget %llu MB", (unsigned long long)(budget >> 20));
+}
+
+uint64_t Texture_Manager::HashPath(const std::string &path)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (char c : path)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+TextureHandle Texture_Manager::FindTexture(const std::string &path, uint64_t hash)
+{
+	auto found = textureLookup.find(hash);
+
+	if (found == textureLookup.end())
+	{
+		return TEXTURE_HANDLE_INVALID;
+	}
+
+	for (TextureHandle handle : found->second)
+	{
+		if (textureList[handle].path == path)
+		{
+			return handle;
+		}
+	}
+
+	return TEXTURE_HANDLE_INVALID;
+}
+
+TextureHandle Texture_Manager::AcquireTexture(const char *path)
+{
+	std::string key = path;
+	uint64_t hash = HashPath(key);
+	TextureHandle handle = FindTexture(key, hash);
+
+	if (handle != TEXTURE_HANDLE_INVALID)
+	{
+		Texture_Resource &resource = textureList[handle];
+
+		++resource.refCount;
+		resource.lastUsedFrame = currentFrame;
+		++lookupHits;
+
+		return handle;
+	}
+
+	PROFILE_ZONE("AcquireTexture");
+
+	Texture texture = {};
+
+	if (!loader->LoadTexture(path, texture, streamTail))
+	{
+		return TEXTURE_HANDLE_INVALID;
+	}
+
+	handle = AddResource(key, hash, texture);
+	++loads;
+
+	EvictToBudget();
+
+	return handle;
+}
+
+void Texture_Manager::AcquireTextures(const std::vector<std::string> &paths, std::vector<TextureHandle> &handles)
+{
+	PROFILE_ZONE("AcquireTextures");
+
+	std::vector<std::string> missing;
+	std::vector<size_t> missingIndex;
+	std::unordered_map<std::string, size_t> batchLookup;
+
+	handles.assign(paths.size(), TEXTURE_HANDLE_INVALID);
+
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		TextureHandle handle = FindTexture(paths[i], HashPath(paths[i]));
+
+		if (handle != TEXTURE_HANDLE_INVALID)
+		{
+			Texture_Resource &resource = textureList[handle];
+
+			++resource.refCount;
+			resource.lastUsedFrame = currentFrame;
+			++lookupHits;
+
+			handles[i] = handle;
+			continue;
+		}
+
+		//a path listed twice is loaded once, the repeat takes a reference below
+		if (batchLookup.find(paths[i]) == batchLookup.end())
+		{
+			batchLookup[paths[i]] = missing.size();
+			missing.push_back(paths[i]);
+		}
+
+		missingIndex.push_back(i);
+	}
+
+	if (missing.empty())
+	{
+		return;
+	}
+
+	std::vector<Texture> textures;
+	std::vector<bool> loaded;
+	std::vector<TextureHandle> loadedHandles(missing.size(), TEXTURE_HANDLE_INVALID);
+
+	loader->LoadTextures(missing, textures, loaded, streamTail);
+
+	for (size_t i = 0; i < missing.size(); ++i)
+	{
+		if (loaded[i])
+		{
+			loadedHandles[i] = AddResource(missing[i], HashPath(missing[i]), textures[i]);
+			++loads;
+		}
+	}
+
+	std::vector<bool> referenced(missing.size(), false);
+
+	for (size_t i : missingIndex)
+	{
+		size_t load = batchLookup[paths[i]];
+
+		handles[i] = loadedHandles[load];
+
+		//the first occurrence holds the reference AddResource took, every repeat takes its own
+		if (handles[i] != TEXTURE_HANDLE_INVALID && referenced[load])
+		{
+			AddReference(handles[i]);
+		}
+
+		referenced[load] = true;
+	}
+
+	EvictToBudget();
+}
+
+TextureHandle Texture_Manager::RegisterTexture(const char *name, const Texture &texture)
+{
+	std::string key = name;
+	uint64_t hash = HashPath(key);
+
+	if (FindTexture(key, hash) != TEXTURE_HANDLE_INVALID)
+	{
+		slog("texture %s is already registered", name);
+		return TEXTURE_HANDLE_INVALID;
+	}
+
+	TextureHandle handle = AddResource(key, hash, texture);
+
+	EvictToBudget();
+
+	return handle;
+}
+
+TextureHandle Texture_Manager::AddResource(const std::string &key, uint64_t hash, const Texture &texture)
+{
+	TextureHandle handle;
+
+	if (!freeList.empty())
+	{
+		handle = freeList.back();
+		freeList.pop_back();
+	}
+	else
+	{
+		handle = (TextureHandle)textureList.size();
+		textureList.emplace_back();
+	}
+
+	Texture_Resource &resource = textureList[handle];
+
+	resource.inUse = true;
+	resource.texture = texture;
+	resource.sampler = ResidencySampler(texture);
+	resource.path = key;
+	resource.hash = hash;
+	resource.refCount = 1;
+	resource.generation++;
+	resource.requestedLevel = texture.residentLevel;
+	resource.readPending = false;
+	resource.lastUsedFrame = currentFrame;
+	resource.tableSlot = textureTable ? textureTable->AllocateSlot() : TEXTURE_SLOT_INVALID;
+
+	WriteTableSlot(resource);
+
+	textureLookup[hash].push_back(handle);
+
+	residentBytes += texture.bytes;
+	++residentCount;
+
+	return handle;
+}
+
+void Texture_Manager::AddReference(TextureHandle handle)
+{
+	Texture_Resource *resource = GetTexture(handle);
+
+	if (resource)
+	{
+		++resource->refCount;
+	}
+}
+
+void Texture_Manager::ReleaseTexture(TextureHandle handle)
+{
+	Texture_Resource *resource = GetTexture(handle);
+
+	if (!resource || !resource->refCount)
+	{
+		slog("released texture %u which holds no references", handle);
+		return;
+	}
+
+	--resource->refCount;
+
+	//command buffers recorded this frame may still sample it
+	resource->lastUsedFrame = currentFrame;
+}
+
+void Texture_Manager::TouchTexture(TextureHandle handle)
+{
+	Texture_Resource *resource = GetTexture(handle);
+
+	if (resource)
+	{
+		resource->lastUsedFrame = currentFrame;
+	}
+}
+
+void Texture_Manager::RequestLevel(TextureHandle handle, uint32_t level)
+{
+	Texture_Resource *resource = GetTexture(handle);
+
+	if (resource)
+	{
+		resource->requestedLevel = std::min(level, resource->texture.fileLevels - 1);
+		resource->lastUsedFrame = currentFrame;
+	}
+}
+
+uint32_t Texture_Manager::LevelForCoverage(uint32_t textureSize, float screenPixels)
+{
+	if (screenPixels < 1.0f)
+	{
+		screenPixels = 1.0f;
+	}
+
+	float level = log2f(textureSize / screenPixels);
+
+	return level > 0.0f ? (uint32_t)level : 0;
+}
+
+VkSampler Texture_Manager::ResidencySampler(const Texture &texture)
+{
+	//integer images can't be filtered, indices are looked up point sampled like the software renderer did
+	if (Texture_Ktx2::IsIntegerFormat(texture.format))
+	{
+		VkSamplerCreateInfo samplerInfo = defaultSamplerInfo;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.anisotropyEnable = VK_FALSE;
+		samplerInfo.maxAnisotropy = 1.0f;
+		samplerInfo.minLod = (float)(texture.residentLevel - texture.baseLevel);
+
+		return GetSampler(samplerInfo);
+	}
+
+	if (texture.residentLevel == texture.baseLevel)
+	{
+		return defaultSampler;
+	}
+
+	//levels above the resident one hold nothing yet, minLod is relative to the image's own first level
+	VkSamplerCreateInfo samplerInfo = defaultSamplerInfo;
+	samplerInfo.minLod = (float)(texture.residentLevel - texture.baseLevel);
+
+	return GetSampler(samplerInfo);
+}
+
+Texture_Resource* Texture_Manager::GetTexture(TextureHandle handle)
+{
+	if (handle >= textureList.size() || !textureList[handle].inUse)
+	{
+		return NULL;
+	}
+
+	return &textureList[handle];
+}
+
+VkSampler Texture_Manager::GetSampler(const VkSamplerCreateInfo &samplerInfo)
+{
+	float floats[4] = { samplerInfo.mipLodBias, samplerInfo.maxAnisotropy, samplerInfo.minLod, samplerInfo.maxLod };
+	uint32_t floatBits[4];
+
+	memcpy(floatBits, floats, sizeof(floats));
+
+	std::vector<uint32_t> key = {
+		samplerInfo.flags,
+		(uint32_t)samplerInfo.magFilter,
+		(uint32_t)samplerInfo.minFilter,
+		(uint32_t)samplerInfo.mipmapMode,
+		(uint32_t)samplerInfo.addressModeU,
+		(uint32_t)samplerInfo.addressModeV,
+		(uint32_t)samplerInfo.addressModeW,
+		floatBits[0],
+		samplerInfo.anisotropyEnable,
+		floatBits[1],
+		samplerInfo.compareEnable,
+		(uint32_t)samplerInfo.compareOp,
+		floatBits[2],
+		floatBits[3],
+		(uint32_t)samplerInfo.borderColor,
+		samplerInfo.unnormalizedCoordinates
+	};
+
+	auto found = samplerCache.find(key);
+
+	if (found != samplerCache.end())
+	{
+		return found->second;
+	}
+
+	VkSampler sampler;
+
+	if (vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create texture sampler!");
+	}
+
+	samplerCache[key] = sampler;
+
+	return sampler;
+}
+
+void Texture_Manager::DestroyTexture(TextureHandle handle)
+{
+	Texture_Resource &resource = textureList[handle];
+	std::vector<TextureHandle> &bucket = textureLookup[resource.hash];
+
+	bucket.erase(std::remove(bucket.begin(), bucket.end(), handle), bucket.end());
+
+	if (bucket.empty())
+	{
+		textureLookup.erase(resource.hash);
+	}
+
+	if (textureTable && resource.tableSlot != TEXTURE_SLOT_INVALID)
+	{
+		textureTable->FreeSlot(resource.tableSlot);
+		resource.tableSlot = TEXTURE_SLOT_INVALID;
+	}
+
+	loader->DestroyTexture(resource.texture);
+
+	residentBytes -= resource.texture.bytes;
+	--residentCount;
+
+	resource.inUse = false;
+	resource.path.clear();
+	resource.refCount = 0;
+
+	freeList.push_back(handle);
+}
+
+void Texture_Manager::WriteTableSlot(const Texture_Resource &resource)
+{
+	if (textureTable && resource.tableSlot != TEXTURE_SLOT_INVALID)
+	{
+		textureTable->WriteSlot(resource.tableSlot, resource.texture.textureImageView, resource.sampler);
+	}
+}
+
+void Texture_Manager::ResizeResource(Texture_Resource &resource, uint32_t baseLevel)
+{
+	Texture resized;
+
+	loader->ResizeTexture(resource.texture, baseLevel, resized);
+
+	Texture_Retired retired = { resource.texture, currentFrame };
+	retiredTextures.push_back(retired);
+
+	residentBytes = residentBytes - resource.texture.bytes + resized.bytes;
+
+	resource.texture = resized;
+	resource.sampler = ResidencySampler(resized);
+	texturesChanged = true;
+
+	WriteTableSlot(resource);
+}
+
+void Texture_Manager::UpdateStreaming()
+{
+	PROFILE_ZONE("UpdateStreaming");
+
+	streamer->Collect(pendingUploads);
+
+	VkDeviceSize uploaded = 0;
+	size_t consumed = 0;
+
+	for (; consumed < pendingUploads.size() && uploaded < TEXTURE_STREAM_BYTES_PER_FRAME; ++consumed)
+	{
+		Texture_StreamResult &result = pendingUploads[consumed];
+		Texture_Resource *resource = GetTexture(result.handle);
+
+		if (!resource || resource->generation != result.generation)
+		{
+			continue;
+		}
+
+		Texture &texture = resource->texture;
+
+		resource->readPending = false;
+
+		//a drop since the read was queued can leave the level outside the image
+		if (!result.succeeded || result.level + 1 != texture.residentLevel || result.level < texture.baseLevel)
+		{
+			continue;
+		}
+
+		loader->UploadLevel(texture, result.level, result.data);
+
+		//only now is the level back in SHADER_READ_ONLY_OPTIMAL, so only now may minLod let it be sampled
+		resource->sampler = ResidencySampler(texture);
+		uploaded += result.data.size();
+		++levelsStreamed;
+		texturesChanged = true;
+
+		WriteTableSlot(*resource);
+	}
+
+	pendingUploads.erase(pendingUploads.begin(), pendingUploads.begin() + consumed);
+
+	for (TextureHandle handle = 0; handle < textureList.size(); ++handle)
+	{
+		Texture_Resource &resource = textureList[handle];
+		Texture &texture = resource.texture;
+
+		if (!resource.inUse || texture.streamPath.empty() || resource.readPending || resource.requestedLevel >= texture.residentLevel)
+		{
+			continue;
+		}
+
+		//the image grows one level at a time, and only while the larger chain still fits the budget
+		if (texture.residentLevel == texture.baseLevel)
+		{
+			if (residentBytes - texture.bytes + Texture_Wrapper::ChainBytes(texture, texture.baseLevel - 1) > budget)
+			{
+				continue;
+			}
+
+			ResizeResource(resource, texture.baseLevel - 1);
+		}
+
+		Texture_StreamRequest request = { handle, resource.generation, texture.streamPath, texture.residentLevel - 1 };
+
+		streamer->Request(request);
+		resource.readPending = true;
+	}
+}
+
+void Texture_Manager::EvictToBudget()
+{
+	while (residentBytes > budget)
+	{
+		TextureHandle oldest = TEXTURE_HANDLE_INVALID;
+
+		for (TextureHandle handle = 0; handle < textureList.size(); ++handle)
+		{
+			Texture_Resource &resource = textureList[handle];
+
+			if (!resource.inUse || resource.refCount || currentFrame < resource.lastUsedFrame + framesInFlight)
+			{
+				continue;
+			}
+
+			if (oldest == TEXTURE_HANDLE_INVALID || resource.lastUsedFrame < textureList[oldest].lastUsedFrame)
+			{
+				oldest = handle;
+			}
+		}
+
+		//everything left is in use, so give up the top mip of the largest streamed texture instead
+		if (oldest == TEXTURE_HANDLE_INVALID)
+		{
+			Texture_Resource *largest = NULL;
+
+			for (Texture_Resource &resource : textureList)
+			{
+				if (resource.inUse && !resource.texture.streamPath.empty() && resource.texture.baseLevel + 1 < resource.texture.fileLevels &&
+					(!largest || resource.texture.bytes > largest->texture.bytes))
+				{
+					largest = &resource;
+				}
+			}
+
+			if (largest)
+			{
+				ResizeResource(*largest, largest->texture.baseLevel + 1);
+				++mipsDropped;
+				continue;
+			}
+		}
+
+		if (oldest == TEXTURE_HANDLE_INVALID)
+		{
+			if (!overBudgetLogged)
+			{
+				slog("textures in use take %llu MB, over the %llu MB budget", (unsigned long long)(residentBytes >> 20), (unsigned long long)(budget >> 20));
+				overBudgetLogged = true;
+			}
+
+			return;
+		}
+
+		DestroyTexture(oldest);
+		++evictions;
+	}
+
+	overBudgetLogged = false;
+}
+
+bool Texture_Manager::Update(uint64_t frame, uint32_t inFlight)
+{
+	currentFrame = frame;
+	framesInFlight = inFlight;
+
+	for (size_t i = 0; i < retiredTextures.size();)
+	{
+		if (frame < retiredTextures[i].frame + framesInFlight)
+		{
+			++i;
+			continue;
+		}
+
+		loader->DestroyTexture(retiredTextures[i].texture);
+
+		retiredTextures[i] = retiredTextures.back();
+		retiredTextures.pop_back();
+	}
+
+	if (streamer)
+	{
+		UpdateStreaming();
+	}
+
+	EvictToBudget();
+
+	bool changed = texturesChanged;
+	texturesChanged = false;
+
+	return changed;
+}
\ No newline at end of file
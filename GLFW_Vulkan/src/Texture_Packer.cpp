@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include "Texture_Packer.h"
+#include "simple_logger.h"
+#include "Profiler.h"
+
+//an array group needs at least this many textures of one size, lone textures pack into the atlas instead
+const static uint32_t PACK_MIN_ARRAY_LAYERS = 2;
+
+static bool IsPowerOfTwo(uint32_t value)
+{
+	return value && !(value & (value - 1));
+}
+
+static uint32_t FullMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+	{
+		++levels;
+	}
+
+	return levels;
+}
+
+Texture_Packer::Texture_Packer(uint32_t atlasPageSize, uint32_t paddingTexels)
+{
+	atlasSize = atlasPageSize;
+	padding = std::max(paddingTexels, 1u);
+	packedTexels = 0;
+}
+
+bool Texture_Packer::AddImage(const char *path)
+{
+	int width, height, channels;
+	stbi_uc *pixels = stbi_load(path, &width, &height, &channels, STBI_rgb_alpha);
+
+	if (!pixels)
+	{
+		slog("failed to decode %s for packing", path);
+		return false;
+	}
+
+	AddImage(path, (uint32_t)width, (uint32_t)height, pixels);
+
+	stbi_image_free(pixels);
+
+	return true;
+}
+
+void Texture_Packer::AddImage(const std::string &name, uint32_t width, uint32_t height, const uint8_t *rgba)
+{
+	Texture_PackImage image;
+
+	image.name = name;
+	image.width = width;
+	image.height = height;
+	image.pixels.assign(rgba, rgba + (size_t)width * height * 4);
+
+	images.push_back(std::move(image));
+}
+
+bool Texture_Packer::SkylineInsert(std::vector<Texture_SkylineSegment> &skyline, uint32_t pageSize, uint32_t width, uint32_t height, uint32_t &x, uint32_t &y)
+{
+	size_t bestIndex = skyline.size();
+	uint32_t bestX = 0;
+	uint32_t bestY = pageSize;
+
+	for (size_t i = 0; i < skyline.size(); ++i)
+	{
+		uint32_t left = skyline[i].x;
+
+		if (left + width > pageSize)
+		{
+			break;
+		}
+
+		//the rectangle rests on the highest segment it spans
+		uint32_t top = 0;
+		uint32_t covered = 0;
+
+		for (size_t j = i; covered < width; ++j)
+		{
+			top = std::max(top, skyline[j].y);
+			covered += skyline[j].width;
+		}
+
+		if (top + height <= pageSize && (top < bestY || (top == bestY && left < bestX)))
+		{
+			bestIndex = i;
+			bestX = left;
+			bestY = top;
+		}
+	}
+
+	if (bestIndex == skyline.size())
+	{
+		return false;
+	}
+
+	Texture_SkylineSegment placed = { bestX, bestY + height, width };
+	uint32_t right = bestX + width;
+
+	skyline.insert(skyline.begin() + bestIndex, placed);
+
+	//segments now under the rectangle are cut back to where it ends
+	for (size_t i = bestIndex + 1; i < skyline.size() && skyline[i].x < right;)
+	{
+		uint32_t overlap = right - skyline[i].x;
+
+		if (overlap >= skyline[i].width)
+		{
+			skyline.erase(skyline.begin() + i);
+			continue;
+		}
+
+		skyline[i].x += overlap;
+		skyline[i].width -= overlap;
+		break;
+	}
+
+	for (size_t i = 0; i + 1 < skyline.size();)
+	{
+		if (skyline[i].y == skyline[i + 1].y)
+		{
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+			continue;
+		}
+
+		++i;
+	}
+
+	x = bestX;
+	y = bestY;
+
+	return true;
+}
+
+void Texture_Packer::BlitPadded(const Texture_PackImage &image, std::vector<uint8_t> &page, uint32_t x, uint32_t y)
+{
+	int32_t pad = (int32_t)padding;
+
+	for (int32_t row = -pad; row < (int32_t)image.height + pad; ++row)
+	{
+		uint32_t sourceRow = (uint32_t)std::min(std::max(row, 0), (int32_t)image.height - 1);
+
+		for (int32_t column = -pad; column < (int32_t)image.width + pad; ++column)
+		{
+			uint32_t sourceColumn = (uint32_t)std::min(std::max(column, 0), (int32_t)image.width - 1);
+			size_t destination = ((size_t)(y + pad + row) * atlasSize + (x + pad + column)) * 4;
+
+			memcpy(&page[destination], &image.pixels[((size_t)sourceRow * image.width + sourceColumn) * 4], 4);
+		}
+	}
+}
+
+void Texture_Packer::Pack()
+{
+	PROFILE_ZONE("PackTextures");
+
+	groups.clear();
+	remap.clear();
+	packedTexels = 0;
+
+	std::map<std::pair<uint32_t, uint32_t>, std::vector<size_t>> sizes;
+
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		if (IsPowerOfTwo(images[i].width) && IsPowerOfTwo(images[i].height))
+		{
+			sizes[std::make_pair(images[i].width, images[i].height)].push_back(i);
+		}
+	}
+
+	std::vector<bool> grouped(images.size(), false);
+
+	for (auto &size : sizes)
+	{
+		if (size.second.size() < PACK_MIN_ARRAY_LAYERS)
+		{
+			continue;
+		}
+
+		Texture_PackGroup group;
+
+		group.atlas = false;
+		group.width = size.first.first;
+		group.height = size.first.second;
+		group.mipLevels = FullMipCount(group.width, group.height);
+
+		for (size_t index : size.second)
+		{
+			Texture_PackRegion region = { (uint32_t)groups.size(), (uint32_t)group.layers.size(), glm::vec2(0.0f), glm::vec2(1.0f) };
+
+			remap[images[index].name] = region;
+			group.layers.push_back(images[index].pixels);
+			grouped[index] = true;
+		}
+
+		groups.push_back(std::move(group));
+	}
+
+	//tallest first keeps the skyline flat, which is what bottom left placement packs best
+	std::vector<size_t> atlasImages;
+
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		if (grouped[i])
+		{
+			continue;
+		}
+
+		//too big for a page, bound on its own instead
+		if (images[i].width + 2 * padding > atlasSize || images[i].height + 2 * padding > atlasSize)
+		{
+			Texture_PackGroup group;
+			Texture_PackRegion region = { (uint32_t)groups.size(), 0, glm::vec2(0.0f), glm::vec2(1.0f) };
+
+			group.atlas = false;
+			group.width = images[i].width;
+			group.height = images[i].height;
+			group.mipLevels = FullMipCount(group.width, group.height);
+			group.layers.push_back(images[i].pixels);
+
+			remap[images[i].name] = region;
+			groups.push_back(std::move(group));
+			continue;
+		}
+
+		atlasImages.push_back(i);
+	}
+
+	if (atlasImages.empty())
+	{
+		return;
+	}
+
+	std::sort(atlasImages.begin(), atlasImages.end(), [this](size_t a, size_t b)
+	{
+		return images[a].height != images[b].height ? images[a].height > images[b].height : images[a].width > images[b].width;
+	});
+
+	Texture_PackGroup atlas;
+	std::vector<std::vector<Texture_SkylineSegment>> skylines;
+	uint32_t atlasGroup = (uint32_t)groups.size();
+
+	//entries start on padding aligned texels, so a level's texel never straddles two entries until it is wider than the gutter
+	atlas.atlas = true;
+	atlas.width = atlasSize;
+	atlas.height = atlasSize;
+	atlas.mipLevels = std::min(FullMipCount(atlasSize, atlasSize), FullMipCount(padding, padding));
+
+	for (size_t index : atlasImages)
+	{
+		const Texture_PackImage &image = images[index];
+		uint32_t paddedWidth = (image.width + 2 * padding + padding - 1) / padding * padding;
+		uint32_t paddedHeight = (image.height + 2 * padding + padding - 1) / padding * padding;
+		uint32_t x, y;
+		uint32_t page = 0;
+
+		while (page < skylines.size() && !SkylineInsert(skylines[page], atlasSize, std::min(paddedWidth, atlasSize), std::min(paddedHeight, atlasSize), x, y))
+		{
+			++page;
+		}
+
+		if (page == skylines.size())
+		{
+			Texture_SkylineSegment floor = { 0, 0, atlasSize };
+
+			skylines.push_back(std::vector<Texture_SkylineSegment>(1, floor));
+			atlas.layers.push_back(std::vector<uint8_t>((size_t)atlasSize * atlasSize * 4, 0));
+
+			SkylineInsert(skylines[page], atlasSize, std::min(paddedWidth, atlasSize), std::min(paddedHeight, atlasSize), x, y);
+		}
+
+		BlitPadded(image, atlas.layers[page], x, y);
+
+		Texture_PackRegion region;
+
+		region.group = atlasGroup;
+		region.layer = page;
+		region.uvOffset = glm::vec2((x + padding) / (float)atlasSize, (y + padding) / (float)atlasSize);
+		region.uvScale = glm::vec2(image.width / (float)atlasSize, image.height / (float)atlasSize);
+
+		remap[image.name] = region;
+		packedTexels += image.width * image.height;
+	}
+
+	groups.push_back(std::move(atlas));
+
+	slog("packed %u textures into %u groups, %u atlas pages at %.1f%% occupancy", (uint32_t)images.size(), (uint32_t)groups.size(),
+		(uint32_t)groups.back().layers.size(), GetAtlasOccupancy() * 100.0f);
+}
+
+float Texture_Packer::GetAtlasOccupancy()
+{
+	if (groups.empty() || !groups.back().atlas)
+	{
+		return 0.0f;
+	}
+
+	return packedTexels / ((float)groups.back().layers.size() * atlasSize * atlasSize);
+}
+
+bool Texture_Packer::WriteDebugOutput(const char *prefix)
+{
+	char filename[512];
+
+	for (size_t group = 0; group < groups.size(); ++group)
+	{
+		for (size_t layer = 0; layer < groups[group].layers.size(); ++layer)
+		{
+			snprintf(filename, sizeof(filename), "%s_%u_%u.png", prefix, (uint32_t)group, (uint32_t)layer);
+
+			if (!stbi_write_png(filename, groups[group].width, groups[group].height, 4, groups[group].layers[layer].data(), groups[group].width * 4))
+			{
+				slog("failed to write %s", filename);
+				return false;
+			}
+		}
+	}
+
+	snprintf(filename, sizeof(filename), "%s.txt", prefix);
+
+	FILE *file = fopen(filename, "w");
+
+	if (!file)
+	{
+		slog("failed to write %s", filename);
+		return false;
+	}
+
+	fprintf(file, "#name group layer u_offset v_offset u_scale v_scale\n");
+
+	for (const Texture_PackImage &image : images)
+	{
+		const Texture_PackRegion &region = remap[image.name];
+
+		fprintf(file, "%s %u %u %f %f %f %f\n", image.name.c_str(), region.group, region.layer, region.uvOffset.x, region.uvOffset.y, region.uvScale.x, region.uvScale.y);
+	}
+
+	fclose(file);
+
+	return true;
+}
\ No newline at end of file
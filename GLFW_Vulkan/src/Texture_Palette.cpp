@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include "Texture_Palette.h"
+#include "simple_logger.h"
+
+const static uint32_t PALETTE_BYTES = 256 * 3;
+const static uint32_t COLORMAP_BYTES = 256;
+
+static bool ReadWholeFile(const char *path, std::vector<uint8_t> &bytes)
+{
+	FILE *file = fopen(path, "rb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+	rewind(file);
+
+	bytes.resize(fileSize > 0 ? (size_t)fileSize : 0);
+
+	bool read = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+
+	fclose(file);
+
+	return read;
+}
+
+Texture_Palette::Texture_Palette()
+{
+	paletteCount = 0;
+	colormapCount = 0;
+}
+
+bool Texture_Palette::Texture_PaletteInit(const char *palettePath, const char *colormapPath)
+{
+	if (!ReadWholeFile(palettePath, palettes) || palettes.empty() || palettes.size() % PALETTE_BYTES != 0)
+	{
+		slog("%s is not a set of 256 colour palettes", palettePath);
+		return false;
+	}
+
+	if (colormapPath)
+	{
+		if (!ReadWholeFile(colormapPath, colormaps) || colormaps.empty() || colormaps.size() % COLORMAP_BYTES != 0)
+		{
+			slog("%s is not a set of colormaps", colormapPath);
+			return false;
+		}
+	}
+	else
+	{
+		colormaps.resize(COLORMAP_BYTES);
+
+		for (uint32_t i = 0; i < COLORMAP_BYTES; ++i)
+		{
+			colormaps[i] = (uint8_t)i;
+		}
+	}
+
+	paletteCount = (uint32_t)(palettes.size() / PALETTE_BYTES);
+	colormapCount = (uint32_t)(colormaps.size() / COLORMAP_BYTES);
+
+	return true;
+}
+
+uint8_t Texture_Palette::NearestIndex(uint8_t r, uint8_t g, uint8_t b)
+{
+	uint32_t best = 0;
+	int32_t bestDistance = INT32_MAX;
+
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		if (i == PALETTE_TRANSPARENT_INDEX)
+		{
+			continue;
+		}
+
+		int32_t dr = (int32_t)palettes[i * 3] - r;
+		int32_t dg = (int32_t)palettes[i * 3 + 1] - g;
+		int32_t db = (int32_t)palettes[i * 3 + 2] - b;
+		int32_t distance = dr * dr + dg * dg + db * db;
+
+		if (distance < bestDistance)
+		{
+			best = i;
+			bestDistance = distance;
+
+			if (distance == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	return (uint8_t)best;
+}
+
+void Texture_Palette::BuildLookup(std::vector<std::vector<uint8_t>> &layers)
+{
+	layers.assign(paletteCount, std::vector<uint8_t>((size_t)256 * colormapCount * 4));
+
+	for (uint32_t palette = 0; palette < paletteCount; ++palette)
+	{
+		const uint8_t *colors = &palettes[palette * PALETTE_BYTES];
+		uint8_t *layer = layers[palette].data();
+
+		for (uint32_t colormap = 0; colormap < colormapCount; ++colormap)
+		{
+			for (uint32_t index = 0; index < 256; ++index)
+			{
+				uint8_t mapped = colormaps[colormap * COLORMAP_BYTES + index];
+				uint8_t *texel = &layer[((size_t)colormap * 256 + index) * 4];
+
+				texel[0] = colors[mapped * 3];
+				texel[1] = colors[mapped * 3 + 1];
+				texel[2] = colors[mapped * 3 + 2];
+				texel[3] = index == PALETTE_TRANSPARENT_INDEX ? 0 : 255;
+			}
+		}
+	}
+}
+
+uint32_t Texture_Palette::EffectPalette(uint32_t damageCount, uint32_t bonusCount, bool radiationSuit)
+{
+	if (damageCount)
+	{
+		return PALETTE_START_RED + std::min((damageCount + 7) >> 3, (uint32_t)PALETTE_RED_COUNT - 1);
+	}
+
+	if (bonusCount)
+	{
+		return PALETTE_START_BONUS + std::min((bonusCount + 7) >> 3, (uint32_t)PALETTE_BONUS_COUNT - 1);
+	}
+
+	return radiationSuit ? PALETTE_RADIATION : 0;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "Texture_Streamer.h"
+#include "Texture_Ktx2.h"
+#include "simple_logger.h"
+#include "Profiler.h"
+
+Texture_Streamer::Texture_Streamer()
+{
+	stopStreaming = false;
+	bytesRead = 0;
+}
+
+Texture_Streamer::~Texture_Streamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+		stopStreaming = true;
+	}
+
+	requestReady.notify_all();
+
+	if (worker.joinable())
+	{
+		worker.join();
+	}
+}
+
+void Texture_Streamer::Texture_StreamerInit()
+{
+	worker = std::thread(&Texture_Streamer::StreamWorker, this);
+}
+
+void Texture_Streamer::Request(const Texture_StreamRequest &request)
+{
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+		requests.push_back(request);
+	}
+
+	requestReady.notify_one();
+}
+
+void Texture_Streamer::Collect(std::vector<Texture_StreamResult> &finished)
+{
+	std::lock_guard<std::mutex> lock(streamMutex);
+
+	for (Texture_StreamResult &result : results)
+	{
+		finished.push_back(std::move(result));
+	}
+
+	results.clear();
+}
+
+uint64_t Texture_Streamer::GetBytesRead()
+{
+	std::lock_guard<std::mutex> lock(streamMutex);
+
+	return bytesRead;
+}
+
+void Texture_Streamer::StreamWorker()
+{
+	while (true)
+	{
+		Texture_StreamRequest request;
+
+		{
+			std::unique_lock<std::mutex> lock(streamMutex);
+			requestReady.wait(lock, [this]{ return stopStreaming || !requests.empty(); });
+
+			if (stopStreaming)
+			{
+				return;
+			}
+
+			request = requests.front();
+			requests.pop_front();
+		}
+
+		PROFILE_ZONE("StreamLevel");
+
+		Texture_StreamResult result;
+		Texture_Ktx2 ktx;
+
+		result.handle = request.handle;
+		result.generation = request.generation;
+		result.level = request.level;
+		result.succeeded = ktx.Texture_Ktx2Init(request.path.c_str()) && request.level < ktx.GetLevelCount();
+
+		if (result.succeeded)
+		{
+			result.data.resize((size_t)ktx.GetLevelSize(request.level));
+			result.succeeded = ktx.ReadLevel(request.level, result.data.data());
+		}
+
+		if (!result.succeeded)
+		{
+			slog("failed to stream level %u of %s", request.level, request.path.c_str());
+		}
+
+		std::lock_guard<std::mutex> lock(streamMutex);
+		bytesRead += result.data.size();
+		results.push_back(std::move(result));
+	}
+}
\ No newline at end of file
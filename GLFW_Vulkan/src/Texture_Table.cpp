@@ -0,0 +1,181 @@
+#include <stdexcept>
+
+#include "Texture_Table.h"
+#include "simple_logger.h"
+#include "Profiler.h"
+
+Texture_Table::Texture_Table()
+{
+	logicalDevice = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	capacity = 0;
+	usedSlots = 0;
+	currentFrame = 0;
+	descriptorWrites = 0;
+}
+
+Texture_Table::~Texture_Table()
+{
+	//sets are freed with their pool
+	if (descriptorPool != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+	}
+}
+
+void Texture_Table::Texture_TableInit(VkDevice device, VkDescriptorSetLayout layout, uint32_t tableCapacity, uint32_t setCount)
+{
+	logicalDevice = device;
+	setLayout = layout;
+	capacity = tableCapacity;
+
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = capacity * setCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = setCount;
+
+	if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create texture table descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(setCount, setLayout);
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	descriptorSets.resize(setCount);
+
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate texture table descriptor sets!");
+	}
+
+	slots.assign(capacity, VkDescriptorImageInfo());
+	dirtySlots.assign(setCount, std::vector<uint32_t>());
+
+	//handed out lowest first so a small scene keeps its indices packed at the front
+	freeSlots.clear();
+	for (uint32_t slot = capacity; slot > 0; --slot)
+	{
+		freeSlots.push_back(slot - 1);
+	}
+
+	slog("texture table: %u slots, %u sets", capacity, setCount);
+}
+
+uint32_t Texture_Table::AllocateSlot()
+{
+	if (freeSlots.empty())
+	{
+		slog("texture table is full, %u slots in use", usedSlots);
+		return TEXTURE_SLOT_INVALID;
+	}
+
+	uint32_t slot = freeSlots.back();
+	freeSlots.pop_back();
+	++usedSlots;
+
+	return slot;
+}
+
+void Texture_Table::WriteSlot(uint32_t slot, VkImageView imageView, VkSampler sampler)
+{
+	if (slot >= capacity)
+	{
+		return;
+	}
+
+	slots[slot].imageView = imageView;
+	slots[slot].sampler = sampler;
+	slots[slot].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	for (std::vector<uint32_t> &dirty : dirtySlots)
+	{
+		dirty.push_back(slot);
+	}
+}
+
+void Texture_Table::FreeSlot(uint32_t slot)
+{
+	if (slot >= capacity)
+	{
+		return;
+	}
+
+	Texture_RetiredSlot retired = { slot, currentFrame };
+
+	//a write still waiting for a flush must not reach the sets, its view is about to be destroyed
+	slots[slot].imageView = VK_NULL_HANDLE;
+	slots[slot].sampler = VK_NULL_HANDLE;
+
+	retiredSlots.push_back(retired);
+	--usedSlots;
+}
+
+void Texture_Table::Flush(uint32_t setIndex)
+{
+	if (setIndex >= dirtySlots.size() || dirtySlots[setIndex].empty())
+	{
+		return;
+	}
+
+	PROFILE_ZONE("FlushTextureTable");
+
+	std::vector<VkWriteDescriptorSet> writes;
+
+	writes.reserve(dirtySlots[setIndex].size());
+
+	for (uint32_t slot : dirtySlots[setIndex])
+	{
+		//freed slots keep their stale descriptor, partially bound arrays allow that while nothing indexes them
+		if (slots[slot].imageView == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSets[setIndex];
+		write.dstBinding = 0;
+		write.dstArrayElement = slot;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo = &slots[slot];
+
+		writes.push_back(write);
+	}
+
+	//update after bind lets the sets stay bound in recorded command buffers while they are written
+	vkUpdateDescriptorSets(logicalDevice, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+
+	descriptorWrites += (uint32_t)writes.size();
+	dirtySlots[setIndex].clear();
+}
+
+void Texture_Table::Update(uint64_t frame, uint32_t framesInFlight)
+{
+	currentFrame = frame;
+
+	for (size_t i = 0; i < retiredSlots.size();)
+	{
+		if (frame >= retiredSlots[i].frame + framesInFlight)
+		{
+			freeSlots.push_back(retiredSlots[i].slot);
+			retiredSlots[i] = retiredSlots.back();
+			retiredSlots.pop_back();
+			continue;
+		}
+
+		++i;
+	}
+}
\ No newline at end of file
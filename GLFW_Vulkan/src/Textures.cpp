@@ -1,18 +1,72 @@
+#include "Texture_Decoder.h"
+
+//decode workers place their output straight into staging memory through these
+#define STBI_MALLOC(size) Texture_DecodeMalloc(size)
+#define STBI_REALLOC(pointer, size) Texture_DecodeRealloc(pointer, size)
+#define STBI_FREE(pointer) Texture_DecodeFree(pointer)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#include <stdio.h>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <unordered_map>
 
 #include "Texture.h"
+#include "Texture_Ktx2.h"
 #include "simple_logger.h"
+#include "Profiler.h"
 #include "Buffers.h"
 
+//decoded images wait here for their upload, anything larger is staged on its own
+const static VkDeviceSize TEXTURE_STAGING_SIZE = 128 * 1024 * 1024;
+
+static std::string CookedPath(const std::string &path)
+{
+	std::string cookedPath = path;
+	size_t extension = cookedPath.find_last_of('.');
+
+	if (extension != std::string::npos && cookedPath.find_first_of("/\\", extension) == std::string::npos)
+	{
+		cookedPath.erase(extension);
+	}
+
+	return cookedPath + ".ktx2";
+}
+
+static bool FileExists(const std::string &path)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	fclose(file);
+
+	return true;
+}
+
 Texture_Wrapper::~Texture_Wrapper()
 {
-	vkDestroySampler(logicalDevice, textureSampler, nullptr);
+	//decode jobs may still be writing into the mapped staging memory until they finish
+	if (decoder)
+	{
+		decoder->~Texture_Decoder();
+	}
 
-	vkDestroyImageView(logicalDevice, textureImageView, nullptr);
+	if (uploadFence != VK_NULL_HANDLE)
+	{
+		vkDestroyFence(logicalDevice, uploadFence, nullptr);
+	}
 
-	vkDestroyImage(logicalDevice, textureImage, nullptr);
-	vkFreeMemory(logicalDevice, textureImageMemory, nullptr);
+	if (decodeStaging != VK_NULL_HANDLE)
+	{
+		vkUnmapMemory(logicalDevice, decodeStagingMemory);
+		vkDestroyBuffer(logicalDevice, decodeStaging, nullptr);
+		vkFreeMemory(logicalDevice, decodeStagingMemory, nullptr);
+	}
 }
 
 Texture_Wrapper::Texture_Wrapper()
@@ -20,33 +74,354 @@ Texture_Wrapper::Texture_Wrapper()
 	physicalDevice = VK_NULL_HANDLE;
 	logicalDevice = VK_NULL_HANDLE;
 	graphicsQueue = VK_NULL_HANDLE;
+	anisotropyEnabled = true;
+	decoder = NULL;
+	decodeStaging = VK_NULL_HANDLE;
+	decodeStagingMemory = VK_NULL_HANDLE;
+	decodeStagingMapped = NULL;
+	uploadFence = VK_NULL_HANDLE;
 }
 
-void Texture_Wrapper::Texture_WrapperInit(VkPhysicalDevice physDevice, VkDevice logDevice, VkQueue gQueue, Command *cmd)
+void Texture_Wrapper::Texture_WrapperInit(VkPhysicalDevice physDevice, VkDevice logDevice, VkQueue gQueue, Command *cmd, Job_System *jobs, bool anisotropy)
 {
 	physicalDevice = physDevice;
 	logicalDevice = logDevice;
 	graphicsQueue = gQueue;
 	graphicsCommand = cmd;
+	anisotropyEnabled = anisotropy;
+
+	//mapped for the wrapper's lifetime, decode jobs write into it while the main thread copies other regions out
+	Buffer_Wrapper::CreateBuffer(TEXTURE_STAGING_SIZE,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		decodeStaging,
+		decodeStagingMemory,
+		logicalDevice,
+		graphicsQueue,
+		physicalDevice);
+
+	if (vkMapMemory(logicalDevice, decodeStagingMemory, 0, TEXTURE_STAGING_SIZE, 0, &decodeStagingMapped) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to map texture staging memory!");
+	}
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateFence(logicalDevice, &fenceInfo, nullptr, &uploadFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create texture upload fence!");
+	}
+
+	decoder = new Texture_Decoder();
+	decoder->Texture_DecoderInit(decodeStagingMapped, TEXTURE_STAGING_SIZE, jobs);
+
+	slog("texture decoder: %u workers, %llu MB staging", decoder->GetWorkerCount(), (unsigned long long)(TEXTURE_STAGING_SIZE >> 20));
+}
+
+bool Texture_Wrapper::LoadTexture(const char *path, Texture &texture, uint32_t streamTail)
+{
+	PROFILE_ZONE("LoadTexture");
+
+	std::string cookedPath = CookedPath(path);
+
+	//cooked textures carry their own mip chain, the source is only decoded when there is none or the device can't sample it
+	if (LoadKtx2Texture(cookedPath.c_str(), texture, streamTail))
+	{
+		return true;
+	}
+
+	return cookedPath != path && LoadImageTexture(path, texture);
+}
+
+VkFormat Texture_Wrapper::CookedFormat(const char *path)
+{
+	std::string cookedPath = CookedPath(path);
+	Texture_Ktx2 ktx;
+
+	if (!FileExists(cookedPath) || !ktx.Texture_Ktx2Init(cookedPath.c_str()))
+	{
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	return ktx.GetFormat();
+}
+
+void Texture_Wrapper::LoadTextures(const std::vector<std::string> &paths, std::vector<Texture> &textures, std::vector<bool> &loaded, uint32_t streamTail)
+{
+	PROFILE_ZONE("LoadTextures");
+
+	std::unordered_map<uint32_t, size_t> decodes;
+	std::vector<size_t> cooked;
+
+	textures.assign(paths.size(), Texture());
+	loaded.assign(paths.size(), false);
+
+	//sources without a cooked file are queued first so they decode while the cooked ones load below
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		std::string cookedPath = CookedPath(paths[i]);
+
+		if (cookedPath != paths[i] && !FileExists(cookedPath))
+		{
+			decodes[decoder->Submit(paths[i])] = i;
+			continue;
+		}
+
+		cooked.push_back(i);
+	}
+
+	for (size_t i : cooked)
+	{
+		std::string cookedPath = CookedPath(paths[i]);
+
+		if (LoadKtx2Texture(cookedPath.c_str(), textures[i], streamTail))
+		{
+			loaded[i] = true;
+		}
+		else if (cookedPath != paths[i])
+		{
+			decodes[decoder->Submit(paths[i])] = i;
+		}
+	}
+
+	//uploads are recorded on this thread as images finish, in whatever order the decode jobs complete them
+	Texture_UploadBatch batch;
+	Texture_DecodeResult result;
+
+	while (true)
+	{
+		//nothing finished yet, the batch is submitted rather than holding staging the decodes may be waiting on
+		if (!decoder->TryResult(result))
+		{
+			FlushUploadBatch(batch);
+
+			if (!decoder->WaitResult(result))
+			{
+				break;
+			}
+		}
+
+		size_t i = decodes[result.id];
+
+		loaded[i] = CreateDecodedTexture(result, textures[i], batch);
+
+		if (batch.bytes >= TEXTURE_STAGING_SIZE / 2)
+		{
+			FlushUploadBatch(batch);
+		}
+	}
+}
+
+void Texture_Wrapper::DestroyTexture(Texture &texture)
+{
+	vkDestroyImageView(logicalDevice, texture.textureImageView, nullptr);
+
+	vkDestroyImage(logicalDevice, texture.textureImage, nullptr);
+	vkFreeMemory(logicalDevice, texture.textureImageMemory, nullptr);
+
+	texture.textureImageView = VK_NULL_HANDLE;
+	texture.textureImage = VK_NULL_HANDLE;
+	texture.textureImageMemory = VK_NULL_HANDLE;
+}
+
+bool Texture_Wrapper::LoadImageTexture(const char *path, Texture &texture)
+{
+	Texture_DecodeResult result;
+
+	decoder->Submit(path);
+
+	if (!decoder->WaitResult(result))
+	{
+		return false;
+	}
+
+	Texture_UploadBatch batch;
+	bool created = CreateDecodedTexture(result, texture, batch);
+
+	FlushUploadBatch(batch);
+
+	return created;
 }
 
-void Texture_Wrapper::CreateTextureImage()
+void Texture_Wrapper::FlushUploadBatch(Texture_UploadBatch &batch)
 {
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load("textures/chalet.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
+	if (batch.commandBuffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	PROFILE_ZONE("FlushUploadBatch");
+
+	VkSubmitInfo submitInfo = {};
+
+	vkEndCommandBuffer(batch.commandBuffer);
+
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+	vkQueueSubmit(graphicsQueue, 1, &submitInfo, uploadFence);
+	vkWaitForFences(logicalDevice, 1, &uploadFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	vkResetFences(logicalDevice, 1, &uploadFence);
+
+	vkFreeCommandBuffers(logicalDevice, graphicsCommand->commandPool, 1, &batch.commandBuffer);
+
+	for (const Texture_DecodeResult &result : batch.staged)
+	{
+		decoder->ReleaseStaging(result);
+	}
+
+	for (size_t i = 0; i < batch.buffers.size(); ++i)
+	{
+		vkDestroyBuffer(logicalDevice, batch.buffers[i], nullptr);
+		vkFreeMemory(logicalDevice, batch.memories[i], nullptr);
+	}
+
+	batch = Texture_UploadBatch();
+}
+
+bool Texture_Wrapper::CreateDecodedTexture(const Texture_DecodeResult &result, Texture &texture, Texture_UploadBatch &batch)
+{
+	if (!result.succeeded)
+	{
+		slog("failed to load texture image %s", result.path.c_str());
+		return false;
+	}
+
+	PROFILE_ZONE("CreateDecodedTexture");
+
+	int texWidth = (int)result.width;
+	int texHeight = (int)result.height;
+	VkDeviceSize imageSize = (VkDeviceSize)texWidth * texHeight * 4;
+	VkImage textureImage;
+	VkDeviceMemory textureImageMemory;
+
+	VkBuffer sourceBuffer = decodeStaging;
+	VkDeviceSize sourceOffset = result.offset;
+	VkBuffer imageStagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory imageStagingMemory = VK_NULL_HANDLE;
+
+	//only images too large for the shared staging memory come back in their own allocation
+	if (result.pixels)
+	{
+		Buffer_Wrapper::CreateBuffer(imageSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			imageStagingBuffer,
+			imageStagingMemory,
+			logicalDevice,
+			graphicsQueue,
+			physicalDevice);
+
+		void* data;
+		vkMapMemory(logicalDevice, imageStagingMemory, 0, imageSize, 0, &data);
+		memcpy(data, result.pixels, static_cast<size_t>(imageSize));
+		vkUnmapMemory(logicalDevice, imageStagingMemory);
+
+		stbi_image_free(result.pixels);
+
+		sourceBuffer = imageStagingBuffer;
+		sourceOffset = 0;
 
-	if (!pixels) 
+		batch.buffers.push_back(imageStagingBuffer);
+		batch.memories.push_back(imageStagingMemory);
+	}
+	else
 	{
-		slog("failed to load texture image!");
+		batch.staged.push_back(result);
 	}
 
+	uint32_t mipLevels = MipLevelCount(texWidth, texHeight);
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+
+	//the chain is built with linear blits, without them the texture keeps its single level
+	VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures)
+	{
+		slog("texture format does not support linear blits, mipmaps disabled");
+		mipLevels = 1;
+	}
+
+	VkDeviceSize textureBytes = 0;
+	for (uint32_t level = 0; level < mipLevels; ++level)
+	{
+		textureBytes += (VkDeviceSize)std::max(texWidth >> level, 1) * std::max(texHeight >> level, 1) * 4;
+	}
+
+	CreateImage(texWidth,
+		texHeight, 
+		mipLevels,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+		textureImage,
+		textureImageMemory,
+		logicalDevice,
+		physicalDevice);
+
+	if (batch.commandBuffer == VK_NULL_HANDLE)
+	{
+		batch.commandBuffer = Commands_Wrapper::CommandBeginSingleTime(graphicsCommand, logicalDevice);
+	}
+
+	RecordLayoutTransition(batch.commandBuffer,
+		textureImage, 
+		VK_FORMAT_R8G8B8A8_UNORM, 
+		VK_IMAGE_LAYOUT_UNDEFINED, 
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+		mipLevels);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = sourceOffset;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { result.width, result.height, 1 };
+
+	vkCmdCopyBufferToImage(batch.commandBuffer, sourceBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	//leaves every level in SHADER_READ_ONLY_OPTIMAL
+	RecordMipmaps(batch.commandBuffer, textureImage, texWidth, texHeight, mipLevels);
+
+	batch.bytes += imageSize;
+
+	texture.textureImage = textureImage;
+	texture.textureImageMemory = textureImageMemory;
+	texture.textureImageView = CreateImageView(textureImage, VK_FORMAT_R8G8B8A8_UNORM, logicalDevice, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+	texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+	texture.width = (uint32_t)texWidth;
+	texture.height = (uint32_t)texHeight;
+	texture.mipLevels = mipLevels;
+	texture.layers = 1;
+	texture.bytes = textureBytes;
+	texture.streamPath.clear();
+	texture.fileLevels = mipLevels;
+	texture.baseLevel = 0;
+	texture.residentLevel = 0;
+
+	return true;
+}
+
+void Texture_Wrapper::CreateArrayTexture(uint32_t width, uint32_t height, uint32_t mipLevels, const std::vector<std::vector<uint8_t>> &layers, Texture &texture)
+{
+	PROFILE_ZONE("CreateArrayTexture");
+
+	VkDeviceSize layerSize = (VkDeviceSize)width * height * 4;
+	VkDeviceSize imageSize = layerSize * layers.size();
+	uint32_t layerCount = (uint32_t)layers.size();
+
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
 	Buffer_Wrapper::CreateBuffer(imageSize,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, 
+		stagingBuffer,
 		stagingBufferMemory,
 		logicalDevice,
 		graphicsQueue,
@@ -54,51 +429,420 @@ void Texture_Wrapper::CreateTextureImage()
 
 	void* data;
 	vkMapMemory(logicalDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
+
+	std::vector<VkBufferImageCopy> regions(layerCount);
+
+	for (uint32_t layer = 0; layer < layerCount; ++layer)
+	{
+		memcpy((uint8_t*)data + layerSize * layer, layers[layer].data(), (size_t)layerSize);
+
+		regions[layer] = {};
+		regions[layer].bufferOffset = layerSize * layer;
+		regions[layer].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[layer].imageSubresource.mipLevel = 0;
+		regions[layer].imageSubresource.baseArrayLayer = layer;
+		regions[layer].imageSubresource.layerCount = 1;
+		regions[layer].imageExtent = { width, height, 1 };
+	}
+
 	vkUnmapMemory(logicalDevice, stagingBufferMemory);
 
-	stbi_image_free(pixels);
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
 
-	CreateImage(texWidth,
-		texHeight, 
+	VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures)
+	{
+		mipLevels = 1;
+	}
+
+	VkDeviceSize textureBytes = 0;
+	for (uint32_t level = 0; level < mipLevels; ++level)
+	{
+		textureBytes += (VkDeviceSize)std::max(width >> level, 1u) * std::max(height >> level, 1u) * 4 * layerCount;
+	}
+
+	CreateImage(width,
+		height,
+		mipLevels,
 		VK_FORMAT_R8G8B8A8_UNORM,
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-		textureImage,
-		textureImageMemory,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		texture.textureImage,
+		texture.textureImageMemory,
+		logicalDevice,
+		physicalDevice,
+		layerCount);
+
+	TransitionImageLayout(texture.textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, logicalDevice, graphicsCommand, graphicsQueue, mipLevels, layerCount);
+
+	CopyBufferToImage(stagingBuffer, texture.textureImage, regions, logicalDevice, graphicsCommand, graphicsQueue);
+
+	//every layer's chain is blitted at once, each blit covers all layers
+	GenerateMipmaps(texture.textureImage, width, height, mipLevels, logicalDevice, graphicsCommand, graphicsQueue, layerCount);
+
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+
+	texture.textureImageView = CreateImageView(texture.textureImage, VK_FORMAT_R8G8B8A8_UNORM, logicalDevice, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, VK_IMAGE_VIEW_TYPE_2D_ARRAY, layerCount);
+	texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+	texture.width = width;
+	texture.height = height;
+	texture.mipLevels = mipLevels;
+	texture.layers = layerCount;
+	texture.bytes = textureBytes;
+	texture.streamPath.clear();
+	texture.fileLevels = mipLevels;
+	texture.baseLevel = 0;
+	texture.residentLevel = 0;
+}
+
+bool Texture_Wrapper::LoadKtx2Texture(const char *path, Texture &texture, uint32_t streamTail)
+{
+	PROFILE_ZONE("LoadKtx2Texture");
+
+	Texture_Ktx2 ktx;
+
+	if (!ktx.Texture_Ktx2Init(path))
+	{
+		return false;
+	}
+
+	VkFormat format = ktx.GetFormat();
+	bool compressed = Texture_Ktx2::IsBlockCompressed(format);
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+	//palette indices are fetched texel by texel, only colour formats need linear filtering
+	bool integer = Texture_Ktx2::IsIntegerFormat(format);
+	VkFormatFeatureFlags sampleFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | (integer ? 0 : VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+	if ((formatProperties.optimalTilingFeatures & sampleFeatures) != sampleFeatures)
+	{
+		slog("%s uses format %i which this device cannot sample", path, format);
+		return false;
+	}
+
+	uint32_t width = ktx.GetWidth();
+	uint32_t height = ktx.GetHeight();
+	uint32_t levels = ktx.GetLevelCount();
+
+	//a single uncompressed level can still be blitted down, compressed formats can't be blit destinations
+	bool generateMips = ktx.WantsGeneratedMips() && !compressed && !integer;
+	VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+
+	if (generateMips && (formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures)
+	{
+		generateMips = false;
+	}
+
+	//a streamed chain starts with only the levels no larger than the tail, the rest are read in the background on demand
+	bool streamed = streamTail && !ktx.WantsGeneratedMips() && levels > 1;
+	uint32_t baseLevel = 0;
+
+	while (streamed && baseLevel + 1 < levels && std::max(width >> baseLevel, height >> baseLevel) > streamTail)
+	{
+		++baseLevel;
+	}
+
+	uint32_t imageLevels = generateMips ? MipLevelCount(width, height) : levels - baseLevel;
+
+	//levels are packed at 16 byte offsets, which satisfies both the block size and the texel size copy alignment
+	std::vector<VkBufferImageCopy> regions(levels - baseLevel);
+	VkDeviceSize stagingSize = 0;
+
+	for (uint32_t level = baseLevel; level < levels; ++level)
+	{
+		VkBufferImageCopy &region = regions[level - baseLevel];
+
+		stagingSize = (stagingSize + 15) & ~(VkDeviceSize)15;
+
+		region = {};
+		region.bufferOffset = stagingSize;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level - baseLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+
+		stagingSize += ktx.GetLevelSize(level);
+	}
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	Buffer_Wrapper::CreateBuffer(stagingSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer,
+		stagingBufferMemory,
 		logicalDevice,
+		graphicsQueue,
 		physicalDevice);
 
-	TransitionImageLayout(textureImage, 
-		VK_FORMAT_R8G8B8A8_UNORM, 
-		VK_IMAGE_LAYOUT_UNDEFINED, 
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-		logicalDevice, 
-		graphicsCommand, 
-		graphicsQueue);
+	void* data;
+	bool read = true;
+	vkMapMemory(logicalDevice, stagingBufferMemory, 0, stagingSize, 0, &data);
+	{
+		PROFILE_ZONE("ReadLevels");
+
+		for (uint32_t level = baseLevel; level < levels && read; ++level)
+		{
+			read = ktx.ReadLevel(level, (uint8_t*)data + regions[level - baseLevel].bufferOffset);
+		}
+	}
+	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+
+	if (!read)
+	{
+		slog("failed to read the levels of %s", path);
+		vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+		vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+		return false;
+	}
 
-	CopyBufferToImage(stagingBuffer,
+	VkImage textureImage;
+	VkDeviceMemory textureImageMemory;
+
+	CreateImage(std::max(width >> baseLevel, 1u),
+		std::max(height >> baseLevel, 1u),
+		imageLevels,
+		format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | ((generateMips || streamed) ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0),
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		textureImage,
-		static_cast<uint32_t>(texWidth),
-		static_cast<uint32_t>(texHeight),
+		textureImageMemory,
 		logicalDevice,
-		graphicsCommand,
-		graphicsQueue);
+		physicalDevice);
 
-	TransitionImageLayout(textureImage,
-		VK_FORMAT_R8G8B8A8_UNORM,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	TransitionImageLayout(textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, logicalDevice, graphicsCommand, graphicsQueue, imageLevels);
+
+	CopyBufferToImage(stagingBuffer, textureImage, regions, logicalDevice, graphicsCommand, graphicsQueue);
+
+	if (generateMips)
+	{
+		GenerateMipmaps(textureImage, width, height, imageLevels, logicalDevice, graphicsCommand, graphicsQueue);
+	}
+	else
+	{
+		TransitionImageLayout(textureImage, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, logicalDevice, graphicsCommand, graphicsQueue, imageLevels);
+	}
+
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+
+	texture.textureImage = textureImage;
+	texture.textureImageMemory = textureImageMemory;
+	texture.textureImageView = CreateImageView(textureImage, format, logicalDevice, VK_IMAGE_ASPECT_COLOR_BIT, imageLevels);
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	texture.mipLevels = imageLevels;
+	texture.layers = 1;
+	texture.streamPath = streamed ? path : "";
+	texture.fileLevels = generateMips ? imageLevels : levels;
+	texture.baseLevel = baseLevel;
+	texture.residentLevel = baseLevel;
+	texture.bytes = ChainBytes(texture, baseLevel);
+
+	slog("loaded %s: %ix%i format %i, %i of %i levels, %i bytes", path, width, height, format, imageLevels, texture.fileLevels, (uint32_t)texture.bytes);
+
+	return true;
+}
+
+VkDeviceSize Texture_Wrapper::ChainBytes(const Texture &texture, uint32_t baseLevel)
+{
+	VkDeviceSize bytes = 0;
+
+	for (uint32_t level = baseLevel; level < texture.fileLevels; ++level)
+	{
+		bytes += Texture_Ktx2::LevelSize(texture.format, std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u));
+	}
+
+	return bytes;
+}
+
+void Texture_Wrapper::UploadLevel(Texture &texture, uint32_t level, const std::vector<uint8_t> &data)
+{
+	PROFILE_ZONE("UploadLevel");
+
+	//only the level just past the resident ones, which the current sampler's minLod still excludes, may be written,
+	//the caller raises minLod once this has returned and the level is back in SHADER_READ_ONLY_OPTIMAL
+	if (level + 1 != texture.residentLevel || level < texture.baseLevel)
+	{
+		slog("streamed level %u is not the next one down from resident level %u, upload skipped", level, texture.residentLevel);
+		return;
+	}
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	Buffer_Wrapper::CreateBuffer(data.size(),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer,
+		stagingBufferMemory,
 		logicalDevice,
-		graphicsCommand,
-		graphicsQueue);
+		graphicsQueue,
+		physicalDevice);
+
+	void* mapped;
+	vkMapMemory(logicalDevice, stagingBufferMemory, 0, data.size(), 0, &mapped);
+	memcpy(mapped, data.data(), data.size());
+	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+
+	VkCommandBuffer commandBuffer = Commands_Wrapper::CommandBeginSingleTime(graphicsCommand, logicalDevice);
+
+	//the level is clamped out by minLod, but the frames still in flight bind the whole view as SHADER_READ_ONLY_OPTIMAL,
+	//so the transition waits for their fragment shading to finish before the level leaves that layout
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = texture.textureImage;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = level - texture.baseLevel;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = level - texture.baseLevel;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	//waits for the queue, no frame is submitted while the level is out of SHADER_READ_ONLY_OPTIMAL
+	Commands_Wrapper::CommandEndSingleTime(graphicsCommand, commandBuffer, graphicsQueue, logicalDevice);
 
 	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
 	vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+
+	texture.residentLevel = level;
+}
+
+void Texture_Wrapper::ResizeTexture(const Texture &texture, uint32_t baseLevel, Texture &resized)
+{
+	PROFILE_ZONE("ResizeTexture");
+
+	resized = texture;
+	resized.baseLevel = baseLevel;
+	resized.residentLevel = std::max(texture.residentLevel, baseLevel);
+	resized.mipLevels = texture.fileLevels - baseLevel;
+	resized.bytes = ChainBytes(texture, baseLevel);
+
+	CreateImage(std::max(texture.width >> baseLevel, 1u),
+		std::max(texture.height >> baseLevel, 1u),
+		resized.mipLevels,
+		texture.format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		resized.textureImage,
+		resized.textureImageMemory,
+		logicalDevice,
+		physicalDevice);
+
+	uint32_t firstShared = resized.residentLevel;
+	uint32_t sharedLevels = texture.fileLevels - firstShared;
+
+	VkCommandBuffer commandBuffer = Commands_Wrapper::CommandBeginSingleTime(graphicsCommand, logicalDevice);
+
+	VkImageMemoryBarrier barriers[2] = {};
+
+	for (VkImageMemoryBarrier &barrier : barriers)
+	{
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+	}
+
+	//the whole new image becomes a copy destination, levels not yet resident included so every level can be sampled later
+	barriers[0].image = resized.textureImage;
+	barriers[0].subresourceRange.baseMipLevel = 0;
+	barriers[0].subresourceRange.levelCount = resized.mipLevels;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].srcAccessMask = 0;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	barriers[1].image = texture.textureImage;
+	barriers[1].subresourceRange.baseMipLevel = firstShared - texture.baseLevel;
+	barriers[1].subresourceRange.levelCount = sharedLevels;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	std::vector<VkImageCopy> copies(sharedLevels);
+
+	for (uint32_t i = 0; i < sharedLevels; ++i)
+	{
+		uint32_t level = firstShared + i;
+
+		copies[i] = {};
+		copies[i].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture.baseLevel, 0, 1 };
+		copies[i].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - baseLevel, 0, 1 };
+		copies[i].extent = { std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+	}
+
+	vkCmdCopyImage(commandBuffer, texture.textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, resized.textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, sharedLevels, copies.data());
+
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	Commands_Wrapper::CommandEndSingleTime(graphicsCommand, commandBuffer, graphicsQueue, logicalDevice);
+
+	resized.textureImageView = CreateImageView(resized.textureImage, texture.format, logicalDevice, VK_IMAGE_ASPECT_COLOR_BIT, resized.mipLevels);
 }
 
-void Texture_Wrapper::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice logicalDevice, VkPhysicalDevice physicalDevice)
+uint32_t Texture_Wrapper::MipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+	{
+		++levels;
+	}
+
+	return levels;
+}
+
+void Texture_Wrapper::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, VkDevice logicalDevice, VkPhysicalDevice physicalDevice, uint32_t arrayLayers)
 {
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -106,8 +850,8 @@ void Texture_Wrapper::CreateImage(uint32_t width, uint32_t height, VkFormat form
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = arrayLayers;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -136,10 +880,17 @@ void Texture_Wrapper::CreateImage(uint32_t width, uint32_t height, VkFormat form
 	vkBindImageMemory(logicalDevice, image, imageMemory, 0);
 }
 
-void Texture_Wrapper::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue)
+void Texture_Wrapper::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue, uint32_t mipLevels, uint32_t layerCount)
 {
 	VkCommandBuffer commandBuffer = Commands_Wrapper::CommandBeginSingleTime(graphicsCommand, logicalDevice);
 
+	RecordLayoutTransition(commandBuffer, image, format, oldLayout, newLayout, mipLevels, layerCount);
+
+	Commands_Wrapper::CommandEndSingleTime(graphicsCommand, commandBuffer, graphicsQueue, logicalDevice);
+}
+
+void Texture_Wrapper::RecordLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t layerCount)
+{
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = oldLayout;
@@ -163,9 +914,9 @@ void Texture_Wrapper::TransitionImageLayout(VkImage image, VkFormat format, VkIm
 	}
 
 	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.levelCount = mipLevels;
 	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.layerCount = layerCount;
 
 	VkPipelineStageFlags sourceStage;
 	VkPipelineStageFlags destinationStage;
@@ -207,10 +958,80 @@ void Texture_Wrapper::TransitionImageLayout(VkImage image, VkFormat format, VkIm
 		0, nullptr,
 		1, &barrier
 		);
+}
+
+void Texture_Wrapper::GenerateMipmaps(VkImage image, int32_t width, int32_t height, uint32_t mipLevels, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue, uint32_t layerCount)
+{
+	PROFILE_ZONE("GenerateMipmaps");
+
+	VkCommandBuffer commandBuffer = Commands_Wrapper::CommandBeginSingleTime(graphicsCommand, logicalDevice);
+
+	RecordMipmaps(commandBuffer, image, width, height, mipLevels, layerCount);
 
 	Commands_Wrapper::CommandEndSingleTime(graphicsCommand, commandBuffer, graphicsQueue, logicalDevice);
+}
 
+void Texture_Wrapper::RecordMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t width, int32_t height, uint32_t mipLevels, uint32_t layerCount)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = layerCount;
+	barrier.subresourceRange.levelCount = 1;
 
+	//each level is blitted from the one above it, which has to finish being written and become a blit source first
+	for (uint32_t level = 1; level < mipLevels; ++level)
+	{
+		int32_t levelWidth = std::max(width >> level, 1);
+		int32_t levelHeight = std::max(height >> level, 1);
+
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkImageBlit blit = {};
+		blit.srcOffsets[1] = { std::max(width >> (level - 1), 1), std::max(height >> (level - 1), 1), 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = layerCount;
+		blit.dstOffsets[1] = { levelWidth, levelHeight, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = layerCount;
+
+		vkCmdBlitImage(commandBuffer,
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit,
+			VK_FILTER_LINEAR);
+
+		//the source level is finished once its blit has read it
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	//the smallest level was only ever written
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
 
 void Texture_Wrapper::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue)
@@ -237,18 +1058,27 @@ void Texture_Wrapper::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t
 	Commands_Wrapper::CommandEndSingleTime(graphicsCommand, commandBuffer, graphicsQueue, logicalDevice);
 }
 
-VkImageView Texture_Wrapper::CreateImageView(VkImage image, VkFormat format, VkDevice logDevice, VkImageAspectFlags aspectFlags)
+void Texture_Wrapper::CopyBufferToImage(VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy> &regions, VkDevice logicalDevice, Command *graphicsCommand, VkQueue graphicsQueue)
+{
+	VkCommandBuffer commandBuffer = Commands_Wrapper::CommandBeginSingleTime(graphicsCommand, logicalDevice);
+
+	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+	Commands_Wrapper::CommandEndSingleTime(graphicsCommand, commandBuffer, graphicsQueue, logicalDevice);
+}
+
+VkImageView Texture_Wrapper::CreateImageView(VkImage image, VkFormat format, VkDevice logDevice, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkImageViewType viewType, uint32_t layerCount)
 {
 	VkImageViewCreateInfo viewInfo = {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = image;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.viewType = viewType;
 	viewInfo.format = format;
 	viewInfo.subresourceRange.aspectMask = aspectFlags;
 	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = mipLevels;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = 1;
+	viewInfo.subresourceRange.layerCount = layerCount;
 
 	VkImageView imageView;
 	if (vkCreateImageView(logDevice, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
@@ -259,12 +1089,7 @@ VkImageView Texture_Wrapper::CreateImageView(VkImage image, VkFormat format, VkD
 	return imageView;
 }
 
-void Texture_Wrapper::CreateTextureImageView()
-{
-	textureImageView = CreateImageView(textureImage, VK_FORMAT_R8G8B8A8_UNORM, logicalDevice, VK_IMAGE_ASPECT_COLOR_BIT);
-}
-
-void Texture_Wrapper::CreateTextureSampler()
+VkSamplerCreateInfo Texture_Wrapper::DefaultSamplerInfo()
 {
 	VkSamplerCreateInfo samplerInfo = {};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -273,16 +1098,16 @@ void Texture_Wrapper::CreateTextureSampler()
 	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.anisotropyEnable = VK_TRUE;
-	samplerInfo.maxAnisotropy = 16;
+	samplerInfo.anisotropyEnable = anisotropyEnabled ? VK_TRUE : VK_FALSE;
+	samplerInfo.maxAnisotropy = anisotropyEnabled ? 16.0f : 1.0f;
 	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
 	samplerInfo.unnormalizedCoordinates = VK_FALSE;
 	samplerInfo.compareEnable = VK_FALSE;
 	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
-	if (vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to create texture sampler!");
-	}
+	return samplerInfo;
 }
\ No newline at end of file
@@ -9,10 +9,31 @@
 
 #include "Vulkan_Graphics.h"
 #include "simple_logger.h"
+#include "Profiler.h"
 
 static bool enableValidationLayers;
 
 const static int MAX_FRAMES_IN_FLIGHT = 2;
+const static uint32_t TEXTURE_STREAM_TAIL = 128;
+const static uint32_t TEXTURE_TABLE_SIZE = 4096;
+
+//model matrices per image, entities past this aren't drawn
+const static uint32_t MAX_INSTANCES = 16384;
+
+const static char *BINDLESS_FRAGMENT_SHADER = "shaders/bindless_frag.spv";
+const static char *PALETTED_FRAGMENT_SHADER = "shaders/paletted_frag.spv";
+
+const static char *MODEL_TEXTURE = "textures/chalet.jpg";
+
+//PLAYPAL and COLORMAP lumps, only read when the model's texture was cooked to palette indices
+const static char *PALETTE_FILE = "textures/playpal.lmp";
+const static char *COLORMAP_FILE = "textures/colormap.lmp";
+
+//scales Doom's depth falloff to scene units, the model spans a couple of units where a room spans hundreds of map units
+const static float PALETTE_LIGHT_DIMINISHING = 1.5f;
+const static float PALETTE_DEFAULT_SECTOR_LIGHT = 160.0f;
+
+const static char *PIPELINE_CACHE_FILE = "pipeline_cache.bin";
 
 const static std::vector<const char*> validationLayers = {
 	"VK_LAYER_LUNARG_standard_validation"
@@ -52,29 +73,92 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 
 static std::vector<const char*> instanceExtensionNames = {};
 
-Vulkan_Graphics::Vulkan_Graphics(GLFW_Wrapper *gWrapper, bool enableValidation)
+Vulkan_Graphics::Vulkan_Graphics(GLFW_Wrapper *gWrapper, bool enableValidation, Job_System *jobSystem, const char *levelFile)
+{
+	this->jobSystem = jobSystem;
+	this->levelFile = levelFile;
+	glfwWrapper = gWrapper;
+	headless = false;
+	renderWidth = glfwWrapper->GetWindowWidth();
+	renderHeight = glfwWrapper->GetWindowHeight();
+	enableValidationLayers = enableValidation;
+
+	Init();
+}
+
+Vulkan_Graphics::Vulkan_Graphics(uint32_t width, uint32_t height, bool enableValidation, Job_System *jobSystem, const char *levelFile)
+{
+	this->jobSystem = jobSystem;
+	this->levelFile = levelFile;
+	glfwWrapper = NULL;
+	headless = true;
+	renderWidth = width;
+	renderHeight = height;
+	enableValidationLayers = enableValidation;
+
+	Init();
+}
+
+void Vulkan_Graphics::Init()
 {	
 	vkInstance = VK_NULL_HANDLE;
 	extManager = new Extensions_Manager();
 	queueWrapper = new Queue_Wrapper();
 	swapchainWrapper = new Swapchain_Wrapper();
+	offscreenWrapper = new Offscreen_Wrapper();
 	pipeWrapper = new Pipeline_Wrapper();
+	pipelineCache = new Pipeline_Cache();
+	shaderArchive = new Shader_Archive();
 	cmdWrapper = new Commands_Wrapper();
 	bufferWrapper = new Buffer_Wrapper();
 	textureWrapper = new Texture_Wrapper();
+	textureManager = new Texture_Manager();
+	textureTable = NULL;
 	modelManager = new Model_Manager();
-	glfwWrapper = gWrapper;
-	enableValidationLayers = enableValidation;
 	validationDeviceLayerNames = {};
+	cameraPath = NULL;
+	gameState = NULL;
+	frameIndex = 0;
+	cameraPathFrame = 0;
+	culler = new Frustum_Culler();
+	level = NULL;
+	levelVertexOffset = 0;
+	levelFirstIndex = 0;
+	levelInstance = 0;
+	occlusion = NULL;
+	timestampPool = VK_NULL_HANDLE;
+	timestampPeriod = 0.0f;
+	lastGpuFrameMs = 0.0;
+	gpuFramesResolved = 0;
+	shaderWatcher = NULL;
+	materialPipeline = PIPELINE_HANDLE_INVALID;
+	modelTexture = TEXTURE_HANDLE_INVALID;
+	modelRadius = 1.0f;
+	textureTableSize = 0;
+	indexingFeatures = {};
+	palette = NULL;
+	paletteLookup = TEXTURE_HANDLE_INVALID;
+	paletteIndex = 0;
+	fixedColormap = -1;
+	sectorLight = PALETTE_DEFAULT_SECTOR_LIGHT;
 
 	
 	CreateVulkanInstance();
-	surface = glfwWrapper->CreateGLFWWindowSurface(vkInstance);
+	surface = headless ? VK_NULL_HANDLE : glfwWrapper->CreateGLFWWindowSurface(vkInstance);
 	SetupDebugCallback();
 	PickPhysicalDevice();
+	CheckDescriptorIndexing();
 	CreateLogicalDevice(); 
 	queueWrapper->SetupDeviceQueues(logicalDevice);
-	swapchainWrapper->SwapchainInit(physicalDevice, logicalDevice, surface, glfwWrapper->GetWindowWidth(), glfwWrapper->GetWindowHeight(), queueWrapper, glfwWrapper->GetWindow());
+
+	if (headless)
+	{
+		offscreenWrapper->OffscreenInit(physicalDevice, logicalDevice, renderWidth, renderHeight, MAX_FRAMES_IN_FLIGHT);
+	}
+	else
+	{
+		swapchainWrapper->SwapchainInit(physicalDevice, logicalDevice, surface, renderWidth, renderHeight, queueWrapper, glfwWrapper->GetWindow());
+	}
 	
 	graphicsQueue = queueWrapper->GetGraphicsQueue();
 
@@ -86,48 +170,214 @@ Vulkan_Graphics::Vulkan_Graphics(GLFW_Wrapper *gWrapper, bool enableValidation)
 
 	//following tutorial/DJ but using tutorial as basis for now, will add model stuff later
 
-	bufferWrapper->BufferInit(logicalDevice, physicalDevice, queueWrapper->GetGraphicsQueue(), swapchainWrapper->GetSwapchainImages(), graphicsCommands);
+	bufferWrapper->BufferInit(logicalDevice, physicalDevice, queueWrapper->GetGraphicsQueue(), GetRenderImages(), graphicsCommands);
 
-	bufferWrapper->CreateDescriptorSetLayout();
+	pipeWrapper->Pipeline_WrapperInit(logicalDevice, physicalDevice, GetRenderFormat(), jobSystem, headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
-	pipeWrapper->Pipeline_WrapperInit(4);
+	pipelineCache->Pipeline_CacheInit(physicalDevice, logicalDevice, PIPELINE_CACHE_FILE);
 
-	//pipeWrapper->RenderPassSetup(swapchainWrapper->GetFormat(), physicalDevice, logicalDevice);
+	pipeWrapper->SetPipelineCache(pipelineCache);
 
-	pipeWrapper->PipelineLoad(logicalDevice, "shaders/vert.spv", "shaders/frag.spv", swapchainWrapper->GetFormat(), physicalDevice, swapchainWrapper->GetExtent(), bufferWrapper->GetDescriptorSetLayout());
+	//one open and map for every shader, loose files are the fallback while developing
+	if (shaderArchive->Shader_ArchiveInit(SHADER_ARCHIVE_FILE))
+	{
+		pipeWrapper->SetShaderArchive(shaderArchive);
+	}
+	else
+	{
+		slog("no shader archive at %s, loading loose shader files", SHADER_ARCHIVE_FILE);
+	}
+
+	//8-bit art is drawn through the palette lookup, RGBA sampling shaders can't read index images
+	if (Texture_Wrapper::CookedFormat(MODEL_TEXTURE) == VK_FORMAT_R8_UINT)
+	{
+		palette = new Texture_Palette();
+
+		if (!palette->Texture_PaletteInit(PALETTE_FILE, COLORMAP_FILE) || !pipeWrapper->HasShader(PALETTED_FRAGMENT_SHADER))
+		{
+			throw std::runtime_error("paletted textures need the palette, colormaps and paletted shader!");
+		}
+	}
+
+	//textures are indexed out of one table instead of each binding a set, once the device and the built shaders allow it
+	bool bindless = !palette && textureTableSize && pipeWrapper->HasShader(BINDLESS_FRAGMENT_SHADER);
+
+	if (bindless)
+	{
+		pipeWrapper->EnableDescriptorIndexing(textureTableSize);
+	}
+
+	//compiles on a worker while the depth buffer, textures and model load below
+	pipeWrapper->PipelineLoad("shaders/vert.spv", palette ? PALETTED_FRAGMENT_SHADER : (bindless ? BINDLESS_FRAGMENT_SHADER : "shaders/frag.spv"));
+
+	bufferWrapper->SetDescriptorSetLayout(pipeWrapper->GetCurrentPipe().description.setLayouts[0]);
 
 	//swapchainWrapper->SetupFramebuffers(pipeWrapper->GetPipe());
-	bufferWrapper->CreateDepthResources(swapchainWrapper->GetExtent(), graphicsCommands);
+	bufferWrapper->CreateDepthResources(GetRenderExtent(), graphicsCommands);
 
-	swapchainWrapper->CreateFrameBuffers(&pipeWrapper->GetCurrentPipe(), bufferWrapper->GetDepthImageView());
+	if (headless)
+	{
+		offscreenWrapper->CreateFrameBuffers(&pipeWrapper->GetCurrentPipe(), bufferWrapper->GetDepthImageView());
+	}
+	else
+	{
+		swapchainWrapper->CreateFrameBuffers(&pipeWrapper->GetCurrentPipe(), bufferWrapper->GetDepthImageView());
+	}
 
 	//graphicsCommands = cmdWrapper->GraphicsCommandPoolSetup(swapchainWrapper->GetFrameBuffers().size(), currentPipe, queueWrapper->GetGraphicsQueueFamily());
 	
-	textureWrapper->Texture_WrapperInit(physicalDevice, logicalDevice, graphicsQueue, graphicsCommands);
+	textureWrapper->Texture_WrapperInit(physicalDevice, logicalDevice, graphicsQueue, graphicsCommands, jobSystem, deviceFeatures.samplerAnisotropy == VK_TRUE);
 	
-	textureWrapper->CreateTextureImage();
-	textureWrapper->CreateTextureImageView();
-	textureWrapper->CreateTextureSampler();
+	//cooked textures start drawing with their 128 pixel tail and stream the larger levels in as the camera needs them
+	textureManager->Texture_ManagerInit(logicalDevice, textureWrapper, 0, TEXTURE_STREAM_TAIL);
+
+	if (bindless)
+	{
+		const std::vector<VkDescriptorSetLayout> &setLayouts = pipeWrapper->GetCurrentPipe().description.setLayouts;
+
+		if (setLayouts.size() < 2)
+		{
+			throw std::runtime_error("bindless shaders declare no texture table set!");
+		}
+
+		textureTable = new Texture_Table();
+		textureTable->Texture_TableInit(logicalDevice, setLayouts[1], textureTableSize, (uint32_t)GetRenderImages().size());
+
+		textureManager->SetTextureTable(textureTable);
+	}
+
+	modelTexture = textureManager->AcquireTexture(MODEL_TEXTURE);
+
+	if (modelTexture == TEXTURE_HANDLE_INVALID)
+	{
+		throw std::runtime_error("failed to load texture image!");
+	}
+
+	if (palette)
+	{
+		//every palette and colormap pair resolved up front, a fragment's index needs a single fetch
+		std::vector<std::vector<uint8_t>> lookupLayers;
+		Texture lookup = {};
+
+		palette->BuildLookup(lookupLayers);
+		textureWrapper->CreateArrayTexture(256, palette->GetColormapCount(), 1, lookupLayers, lookup);
+
+		paletteLookup = textureManager->RegisterTexture(PALETTE_FILE, lookup);
+
+		if (paletteLookup == TEXTURE_HANDLE_INVALID)
+		{
+			throw std::runtime_error("failed to create palette lookup!");
+		}
+
+		Texture_Resource *lookupResource = textureManager->GetTexture(paletteLookup);
+
+		bufferWrapper->SetPaletteInfo(lookupResource->texture.textureImageView, lookupResource->sampler);
+
+		slog("paletted textures: %u palettes, %u colormaps", palette->GetPaletteCount(), palette->GetColormapCount());
+	}
 
 	testModel = modelManager->LoadModel("models/chalet.obj");
 
-	bufferWrapper->CreateVertexBuffers(graphicsCommands, testModel->vertices);
-	bufferWrapper->CreateIndexBuffers(graphicsCommands, testModel->indices);
+	modelRadius = 0.0f;
+	for (const Vertex &vertex : testModel->vertices)
+	{
+		modelRadius = std::max(modelRadius, glm::length(vertex.pos));
+	}
+
+	std::vector<Vertex> vertices = testModel->vertices;
+	std::vector<uint32_t> indices = testModel->indices;
+	uint32_t drawCapacity = 1;
+
+	if (levelFile)
+	{
+		level = new Level_Map();
+
+		if (!level->Level_MapInit(levelFile))
+		{
+			throw std::runtime_error("failed to load level!");
+		}
+
+		levelVertexOffset = (uint32_t)vertices.size();
+		levelFirstIndex = (uint32_t)indices.size();
+
+		vertices.insert(vertices.end(), level->GetVertices(), level->GetVertices() + level->GetVertexCount());
+		indices.insert(indices.end(), level->GetIndices(), level->GetIndices() + level->GetIndexCount());
+		drawCapacity += level->GetLeafCount();
+		levelDrawsWritten.assign(GetRenderImages().size(), 0);
+	}
+
+	bufferWrapper->CreateVertexBuffers(graphicsCommands, vertices);
+	bufferWrapper->CreateIndexBuffers(graphicsCommands, indices);
 	bufferWrapper->CreateUniformBuffers();
 
-	bufferWrapper->SetTextureInfo(textureWrapper->GetTextureImageView(), textureWrapper->GetTextureSampler());
+	//leaves take the first visibility ids and instances the rest, the instances that pass the test are compacted past the model's
+	if (bufferWrapper->IsDepthSampled())
+	{
+		uint32_t occlusionIds = (level ? level->GetLeafCount() : 0) + MAX_INSTANCES;
+
+		occlusion = new Occlusion_Culler();
+
+		if (!occlusion->Occlusion_CullerInit(logicalDevice, physicalDevice, pipeWrapper, bufferWrapper->GetDepthImage(), bufferWrapper->GetDepthImageView(), bufferWrapper->FindDepthFormat(),
+			GetRenderExtent(), (uint32_t)GetRenderImages().size(), occlusionIds, occlusionIds, drawCapacity, MAX_INSTANCES))
+		{
+			occlusion->~Occlusion_Culler();
+			occlusion = NULL;
+		}
+	}
+
+	//the level is built in world space, it draws with an identity matrix kept in the slot past the model's instances
+	levelInstance = occlusion ? MAX_INSTANCES * 2 : MAX_INSTANCES;
+	bufferWrapper->CreateInstanceBuffers(level ? levelInstance + 1 : levelInstance, (uint32_t)testModel->indices.size(), drawCapacity);
+
+	if (!textureTable)
+	{
+		Texture_Resource *texture = textureManager->GetTexture(modelTexture);
+
+		bufferWrapper->SetTextureInfo(texture->texture.textureImageView, texture->sampler);
+	}
 
-	bufferWrapper->CreateDescriptorSetLayout();
 	bufferWrapper->CreateDescriptorPool();
 	bufferWrapper->CreateDescriptorSets();
 
-	cmdWrapper->CreateCommandBuffers(graphicsCommands, swapchainWrapper->GetFrameBuffers().size(), swapchainWrapper->GetFrameBuffers(), &pipeWrapper->GetCurrentPipe(), swapchainWrapper->GetExtent(), bufferWrapper->GetVertexBuffer(), bufferWrapper->GetIndexBuffer(), bufferWrapper->GetDescriptorSets(), testModel->indices);
+	if (occlusion)
+	{
+		occlusion->BindFrameBuffers(bufferWrapper->GetUniformBuffers(), bufferWrapper->GetInstanceBuffers());
+	}
+
+	CreateTimestampQueries();
+
+	if (!pipeWrapper->WaitForPipeline(pipeWrapper->GetCurrentHandle()))
+	{
+		throw std::runtime_error("failed to create graphics pipeline!");
+	}
+
+	RecordCommandBuffers();
 
 	CreateSemaphores();
 
 	currentFrame = 0;
 }
 
+VkFormat Vulkan_Graphics::GetRenderFormat()
+{
+	return headless ? offscreenWrapper->GetFormat() : swapchainWrapper->GetFormat();
+}
+
+VkExtent2D Vulkan_Graphics::GetRenderExtent()
+{
+	return headless ? offscreenWrapper->GetExtent() : swapchainWrapper->GetExtent();
+}
+
+std::vector<VkImage> Vulkan_Graphics::GetRenderImages()
+{
+	return headless ? offscreenWrapper->GetImages() : swapchainWrapper->GetSwapchainImages();
+}
+
+std::vector<VkFramebuffer> Vulkan_Graphics::GetRenderFrameBuffers()
+{
+	return headless ? offscreenWrapper->GetFrameBuffers() : swapchainWrapper->GetFrameBuffers();
+}
+
 void Vulkan_Graphics::SetupDebugCallback() 
 {
 	if (!enableValidationLayers)
@@ -163,6 +413,11 @@ Vulkan_Graphics::~Vulkan_Graphics()
 		DestroyDebugUtilsMessengerEXT(vkInstance, callback, nullptr);
 	}
 
+	if (shaderWatcher)
+	{
+		shaderWatcher->~Shader_Watcher();
+	}
+
 	if (cmdWrapper)
 	{
 		cmdWrapper->~Commands_Wrapper();
@@ -173,16 +428,74 @@ Vulkan_Graphics::~Vulkan_Graphics()
 		pipeWrapper->~Pipeline_Wrapper();
 	}
 
+	if (pipelineCache)
+	{
+		pipelineCache->Save();
+		pipelineCache->~Pipeline_Cache();
+	}
+
+	if (shaderArchive)
+	{
+		shaderArchive->~Shader_Archive();
+	}
+
 	if (swapchainWrapper)
 	{
 		swapchainWrapper->~Swapchain_Wrapper();
 	}
 
+	if (offscreenWrapper)
+	{
+		offscreenWrapper->~Offscreen_Wrapper();
+	}
+
 	if (bufferWrapper)
 	{
 		bufferWrapper->~Buffer_Wrapper();
 	}
 
+	if (textureManager)
+	{
+		textureManager->~Texture_Manager();
+	}
+
+	if (palette)
+	{
+		palette->~Texture_Palette();
+	}
+
+	//after the manager, which frees its textures' slots on the way out
+	if (textureTable)
+	{
+		textureTable->~Texture_Table();
+	}
+
+	//the manager destroys its textures through the wrapper
+	if (textureWrapper)
+	{
+		textureWrapper->~Texture_Wrapper();
+	}
+
+	if (culler)
+	{
+		culler->~Frustum_Culler();
+	}
+
+	if (level)
+	{
+		level->~Level_Map();
+	}
+
+	if (occlusion)
+	{
+		occlusion->~Occlusion_Culler();
+	}
+
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(logicalDevice, timestampPool, nullptr);
+	}
+
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		vkDestroySemaphore(logicalDevice, renderFinishedSemaphores[i], nullptr);
@@ -211,7 +524,7 @@ void Vulkan_Graphics::CreateVulkanInstance()
 		return;
 	}
 
-	vkExtensions = extManager->InstanceExtensionsInit(enableValidationLayers);
+	vkExtensions = extManager->InstanceExtensionsInit(enableValidationLayers, !headless);
 
 	vkInstance = VK_NULL_HANDLE;
 
@@ -254,7 +567,10 @@ void Vulkan_Graphics::CreateLogicalDevice()
 
 	extManager->DeviceExtensionsInit(physicalDevice, &deviceExts);
 
-	deviceExts.push_back("VK_KHR_swapchain");
+	if (!headless)
+	{
+		deviceExts.push_back("VK_KHR_swapchain");
+	}
 
 	deviceCreateInfo = GetDeviceInfo(enableValidationLayers);
 
@@ -348,8 +664,66 @@ void Vulkan_Graphics::PickPhysicalDevice()
 }
 
 
+void Vulkan_Graphics::CheckDescriptorIndexing()
+{
+	textureTableSize = 0;
+	indexingFeatures = {};
+
+	auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(vkInstance, "vkGetPhysicalDeviceFeatures2KHR");
+	auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(vkInstance, "vkGetPhysicalDeviceProperties2KHR");
+
+	if (!getFeatures2 || !getProperties2 || !Extensions_Manager::IsDeviceExtensionAvailable(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+	{
+		slog("descriptor indexing unavailable, textures bind a descriptor set each");
+		return;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+	features.pNext = &supported;
+
+	getFeatures2(physicalDevice, &features);
+
+	if (!supported.runtimeDescriptorArray || !supported.descriptorBindingPartiallyBound || !supported.descriptorBindingSampledImageUpdateAfterBind)
+	{
+		slog("descriptor indexing lacks partially bound update after bind sampled images, textures bind a descriptor set each");
+		return;
+	}
+
+	//the table index comes from a push constant, uniform across the draw, so dynamic indexing is all the shader needs
+	if (!deviceFeatures.shaderSampledImageArrayDynamicIndexing)
+	{
+		slog("sampled image arrays can't be dynamically indexed, textures bind a descriptor set each");
+		return;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits = {};
+	limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+	properties.pNext = &limits;
+
+	getProperties2(physicalDevice, &properties);
+
+	//a combined image sampler counts against both the sampler and the sampled image limits
+	textureTableSize = std::min(TEXTURE_TABLE_SIZE, std::min(limits.maxPerStageDescriptorUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSampledImages));
+	textureTableSize = std::min(textureTableSize, std::min(limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxDescriptorSetUpdateAfterBindSampledImages));
+
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+	indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+
+	slog("descriptor indexing: texture table of %u slots", textureTableSize);
+}
+
 bool Vulkan_Graphics::IsDeviceSuitable(VkPhysicalDevice device) {
 	VkPhysicalDeviceProperties deviceProperties;
+	uint32_t queueFamilyCount = 0;
 
 	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 	vkGetPhysicalDeviceProperties(device, &deviceProperties);
@@ -359,8 +733,48 @@ bool Vulkan_Graphics::IsDeviceSuitable(VkPhysicalDevice device) {
 	slog("apiVersion: %i", deviceProperties.apiVersion);
 	slog("driverVersion: %i", deviceProperties.driverVersion);
 	slog("supports Geometry Shader: %i", deviceFeatures.geometryShader);
+	slog("supports Sampler Anisotropy: %i", deviceFeatures.samplerAnisotropy);
+	slog("supports BC Texture Compression: %i", deviceFeatures.textureCompressionBC);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+	bool graphics = false;
+	bool present = headless;
+
+	for (uint32_t i = 0; i < queueFamilyCount; ++i)
+	{
+		if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		{
+			graphics = true;
+		}
+
+		//headless never presents, so only a windowed run needs a family that can present to the surface
+		if (!present)
+		{
+			VkBool32 presentSupport = VK_FALSE;
+
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+			present = presentSupport == VK_TRUE;
+		}
+	}
+
+	if (!headless && !Extensions_Manager::IsDeviceExtensionAvailable(device, VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+	{
+		slog("no swapchain support, skipping device");
+		return false;
+	}
 
-	return deviceFeatures.geometryShader && deviceFeatures.samplerAnisotropy;
+	if (!present)
+	{
+		slog("no queue family presents to the window surface, skipping device");
+	}
+
+	return graphics && present;
 }
 
 VkDeviceCreateInfo Vulkan_Graphics::GetDeviceInfo(bool validation)
@@ -371,10 +785,9 @@ VkDeviceCreateInfo Vulkan_Graphics::GetDeviceInfo(bool validation)
 
 	createInfo.pQueueCreateInfos = queueWrapper->Queue_WrapperInit(&physicalDevice, surface);
 	createInfo.queueCreateInfoCount = queueWrapper->GetWorkQueueCount();
-	
-	deviceFeatures.samplerAnisotropy = VK_TRUE;
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
+	createInfo.pNext = textureTableSize ? &indexingFeatures : NULL;
 
 	if (validation)
 	{		
@@ -432,9 +845,70 @@ void Vulkan_Graphics::CreateSemaphores()
 	}
 }
 
+void Vulkan_Graphics::CreateTimestampQueries()
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	VkQueryPoolCreateInfo queryInfo = {};
+	uint32_t queueFamilyCount = 0;
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	if (queueWrapper->GetGraphicsQueueFamily() >= queueFamilyCount || !queueFamilies[queueWrapper->GetGraphicsQueueFamily()].timestampValidBits)
+	{
+		slog("graphics queue does not support timestamps, gpu frame times unavailable");
+		return;
+	}
+
+	timestampPeriod = deviceProperties.limits.timestampPeriod;
+
+	queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = static_cast<uint32_t>(GetRenderFrameBuffers().size() * 2);
+
+	if (vkCreateQueryPool(logicalDevice, &queryInfo, nullptr, &timestampPool) != VK_SUCCESS)
+	{
+		slog("failed to create timestamp query pool!");
+		timestampPool = VK_NULL_HANDLE;
+	}
+}
+
+void Vulkan_Graphics::ResolveGpuFrameTime(uint32_t imageIndex)
+{
+	uint64_t timestamps[2];
+
+	if (timestampPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	//results belong to the previous submission of this image, headless has waited on its fence but a windowed run
+	//only on the frame slot's, so an unfinished submission returns VK_NOT_READY and that frame goes unmeasured
+	if (vkGetQueryPoolResults(logicalDevice, timestampPool, imageIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+	{
+		lastGpuFrameMs = (double)(timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+		++gpuFramesResolved;
+	}
+}
+
 void Vulkan_Graphics::DrawFrame()
 {
-	vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	PROFILE_ZONE("DrawFrame");
+
+	if (headless)
+	{
+		DrawOffscreenFrame();
+		return;
+	}
+
+	{
+		PROFILE_ZONE("vkWaitForFences");
+		vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
 
 	uint32_t imageIndex;
 	VkSwapchainKHR swapchain = swapchainWrapper->GetSwapchain();
@@ -445,12 +919,22 @@ void Vulkan_Graphics::DrawFrame()
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
-	vkAcquireNextImageKHR(logicalDevice,
-		swapchain,
-		std::numeric_limits<uint32_t>::max(),
-		imageAvailableSemaphores[currentFrame],
-		VK_NULL_HANDLE,
-		&imageIndex);
+	{
+		PROFILE_ZONE("vkAcquireNextImageKHR");
+		vkAcquireNextImageKHR(logicalDevice,
+			swapchain,
+			std::numeric_limits<uint32_t>::max(),
+			imageAvailableSemaphores[currentFrame],
+			VK_NULL_HANDLE,
+			&imageIndex);
+	}
+
+	ResolveGpuFrameTime(imageIndex);
+
+	if (textureTable)
+	{
+		textureTable->Flush(imageIndex);
+	}
 
 	UpdateUniformBuffer(imageIndex);
 
@@ -467,9 +951,12 @@ void Vulkan_Graphics::DrawFrame()
 
 	vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
 
-	if (vkQueueSubmit(queueWrapper->GetGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
 	{
-		slog("failed to submit draw command buffer!");
+		PROFILE_ZONE("vkQueueSubmit");
+		if (vkQueueSubmit(queueWrapper->GetGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+		{
+			slog("failed to submit draw command buffer!");
+		}
 	}
 
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -482,36 +969,417 @@ void Vulkan_Graphics::DrawFrame()
 	presentInfo.pImageIndices = &imageIndex;
 	presentInfo.pResults = NULL; // Optional
 
-	VkResult result = vkQueuePresentKHR(queueWrapper->GetPresentQueue(), &presentInfo);
-
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+	VkResult result;
 	{
-		return;
+		PROFILE_ZONE("vkQueuePresentKHR");
+		result = vkQueuePresentKHR(queueWrapper->GetPresentQueue(), &presentInfo);
 	}
-	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+
+	//the frame was submitted either way, so an out of date or suboptimal swapchain still finishes it
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		slog("failed to acquire swap chain image!");
 	}
 
-	vkQueueWaitIdle(queueWrapper->GetPresentQueue());
+	{
+		PROFILE_ZONE("vkQueueWaitIdle");
+		vkQueueWaitIdle(queueWrapper->GetPresentQueue());
+	}
+
+	EndFrame();
+}
+
+void Vulkan_Graphics::DrawOffscreenFrame()
+{
+	uint32_t imageIndex = currentFrame;
+	VkSubmitInfo submitInfo = {};
 
+	{
+		PROFILE_ZONE("vkWaitForFences");
+		vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+
+	ResolveGpuFrameTime(imageIndex);
+
+	if (textureTable)
+	{
+		textureTable->Flush(imageIndex);
+	}
+
+	UpdateUniformBuffer(imageIndex);
+
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &graphicsCommands->commandBuffers[imageIndex];
+
+	vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
+
+	{
+		PROFILE_ZONE("vkQueueSubmit");
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+		{
+			slog("failed to submit offscreen command buffer!");
+		}
+	}
+
+	EndFrame();
+}
+
+void Vulkan_Graphics::EndFrame()
+{
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+	UpdateShaderReload();
+
+	++frameIndex;
+	++cameraPathFrame;
+
+	pipelineCache->Update();
+
+	UpdateTextures();
+}
+
+void Vulkan_Graphics::RecordCommandBuffers()
+{
+	//the buffers are recorded once and resubmitted, so none may be in flight while they are replaced
+	if (!inFlightFences.empty())
+	{
+		vkWaitForFences(logicalDevice, (uint32_t)inFlightFences.size(), inFlightFences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+
+	Pipeline *pipe = pipeWrapper->ResolvePipeline(materialPipeline, pipeWrapper->GetCurrentHandle());
+
+	if (!pipe)
+	{
+		pipe = &pipeWrapper->GetCurrentPipe();
+	}
+
+	//without multiDrawIndirect every indirect draw is its own call
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	uint32_t drawCount = bufferWrapper->GetMaxDraws();
+	uint32_t drawsPerCall = deviceFeatures.multiDrawIndirect ? std::max(1u, std::min(drawCount, deviceProperties.limits.maxDrawIndirectCount)) : 1;
+
+	if (textureTable)
+	{
+		cmdWrapper->CreateCommandBuffers(graphicsCommands, GetRenderFrameBuffers().size(), GetRenderFrameBuffers(), pipe, GetRenderExtent(), bufferWrapper->GetVertexBuffer(), bufferWrapper->GetIndexBuffer(), bufferWrapper->GetDescriptorSets(), bufferWrapper->GetIndirectBuffers(), drawCount, drawsPerCall, timestampPool, textureTable->GetDescriptorSets(), textureManager->GetTexture(modelTexture)->tableSlot, occlusion);
+		return;
+	}
+
+	cmdWrapper->CreateCommandBuffers(graphicsCommands, GetRenderFrameBuffers().size(), GetRenderFrameBuffers(), pipe, GetRenderExtent(), bufferWrapper->GetVertexBuffer(), bufferWrapper->GetIndexBuffer(), bufferWrapper->GetDescriptorSets(), bufferWrapper->GetIndirectBuffers(), drawCount, drawsPerCall, timestampPool, std::vector<VkDescriptorSet>(), 0, occlusion);
+}
+
+void Vulkan_Graphics::UpdateShaderReload()
+{
+	std::vector<std::string> changed;
+
+	if (shaderWatcher)
+	{
+		shaderWatcher->PollChanges(changed);
+
+		for (const std::string &file : changed)
+		{
+			pipeWrapper->ReloadShader(file);
+		}
+	}
+
+	if (pipeWrapper->UpdateReloads(frameIndex, MAX_FRAMES_IN_FLIGHT))
+	{
+		PROFILE_ZONE("RecordCommandBuffers");
+		RecordCommandBuffers();
+	}
+}
+
+void Vulkan_Graphics::UpdateTextures()
+{
+	if (textureTable)
+	{
+		textureTable->Update(frameIndex, MAX_FRAMES_IN_FLIGHT);
+	}
+
+	bool changed = textureManager->Update(frameIndex, MAX_FRAMES_IN_FLIGHT);
+
+	//table slots are rewritten in place and flushed per image before it is submitted, nothing waits or records again
+	if (!changed || textureTable)
+	{
+		return;
+	}
+
+	PROFILE_ZONE("UpdateTextureDescriptors");
+
+	//sets bound by recorded command buffers can't be written while those buffers may execute
+	vkWaitForFences(logicalDevice, (uint32_t)inFlightFences.size(), inFlightFences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+	Texture_Resource *texture = textureManager->GetTexture(modelTexture);
+
+	bufferWrapper->SetTextureInfo(texture->texture.textureImageView, texture->sampler);
+	bufferWrapper->UpdateTextureDescriptors();
+
+	RecordCommandBuffers();
+}
+
+void Vulkan_Graphics::SetMaterialVariant(uint32_t variantKey)
+{
+	PipelineHandle variant = pipeWrapper->RequestVariant(pipeWrapper->GetCurrentHandle(), variantKey);
+
+	if (variant == materialPipeline)
+	{
+		return;
+	}
+
+	materialPipeline = variant;
+
+	//a variant seen before is already compiled and can be bound now, a new one is picked up by UpdateShaderReload once ready
+	if (pipeWrapper->IsPipelineReady(materialPipeline))
+	{
+		RecordCommandBuffers();
+	}
+}
+
+void Vulkan_Graphics::SetPaletteEffect(uint32_t effectPalette)
+{
+	//lumps with fewer palettes than Doom's fall back to the normal one
+	paletteIndex = (palette && effectPalette < palette->GetPaletteCount()) ? (int32_t)effectPalette : 0;
+}
+
+void Vulkan_Graphics::SetFixedColormap(int32_t colormap)
+{
+	fixedColormap = (palette && colormap >= 0 && (uint32_t)colormap < palette->GetColormapCount()) ? colormap : -1;
+}
+
+bool Vulkan_Graphics::EnableShaderHotReload(const char *shaderDirectory)
+{
+	if (!shaderWatcher)
+	{
+		shaderWatcher = new Shader_Watcher();
+	}
+
+	return shaderWatcher->Shader_WatcherInit(shaderDirectory);
+}
+
+bool Vulkan_Graphics::SaveFrame(const char *filename)
+{
+	if (!headless)
+	{
+		slog("frame readback is only available in headless mode");
+		return false;
+	}
+
+	//the render image is still in its undefined initial layout until a frame has been drawn into it
+	if (!frameIndex)
+	{
+		slog("no frame has been drawn, nothing to read back");
+		return false;
+	}
+
+	vkDeviceWaitIdle(logicalDevice);
+
+	return offscreenWrapper->SaveImage((uint32_t)((currentFrame + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT), filename, &stagingCommand, graphicsQueue);
+}
+
+void Vulkan_Graphics::UpdateLevelDraws(uint32_t imageIndex, const glm::vec3 &eye, const glm::mat4 &viewProj)
+{
+	VkDrawIndexedIndirectCommand *draws = bufferWrapper->GetIndirectCommand(imageIndex) + 1;
+	uint32_t &written = levelDrawsWritten[imageIndex];
+
+	uint32_t drawn = 0;
+
+	bufferWrapper->GetInstanceData(imageIndex)[levelInstance] = glm::mat4(1.0f);
+
+	level->CollectVisible(eye, &viewProj, visibleLeaves);
+
+	//leaves go out nearest first so the early depth test rejects what nearer walls cover
+	for (uint32_t i = 0; i < (uint32_t)visibleLeaves.size(); ++i)
+	{
+		const Level_Leaf &leaf = level->GetLeaf(visibleLeaves[i]);
+		VkDrawIndexedIndirectCommand draw = {};
+
+		draw.indexCount = leaf.indexCount;
+		draw.instanceCount = 1;
+		draw.firstIndex = levelFirstIndex + leaf.firstIndex;
+		draw.vertexOffset = (int32_t)levelVertexOffset;
+		draw.firstInstance = levelInstance;
+
+		//a leaf hidden last time waits for the second pass, one that was seen is drawn now and tested to find out if it still is
+		if (occlusion)
+		{
+			if (!occlusion->WasVisible(imageIndex, visibleLeaves[i]) && occlusion->AddDeferredDraw(imageIndex, visibleLeaves[i], leaf.boundsMin, leaf.boundsMax, draw))
+			{
+				continue;
+			}
+
+			occlusion->AddDrawn(imageIndex, visibleLeaves[i], leaf.boundsMin, leaf.boundsMax);
+		}
+
+		draws[drawn++] = draw;
+	}
+
+	//the draws still holding last use's leaves are emptied, the rest were never filled
+	for (uint32_t i = drawn; i < written; ++i)
+	{
+		draws[i].instanceCount = 0;
+	}
+
+	written = drawn;
+}
+
+void Vulkan_Graphics::AddModelInstance(uint32_t imageIndex, uint32_t id, const glm::mat4 &model, const glm::vec3 &center, float radius, uint32_t &instanceCount, uint32_t &deferredCount)
+{
+	glm::mat4 *instances = bufferWrapper->GetInstanceData(imageIndex);
+	glm::vec3 boundsMin = center - glm::vec3(radius);
+	glm::vec3 boundsMax = center + glm::vec3(radius);
+
+	if (!occlusion)
+	{
+		instances[instanceCount++] = model;
+		return;
+	}
+
+	//parked instances fill the buffer from the top down, the test copies the ones it passes past the model's instances
+	if (!occlusion->WasVisible(imageIndex, id))
+	{
+		uint32_t slot = MAX_INSTANCES - 1 - deferredCount;
+
+		if (occlusion->AddDeferredInstance(imageIndex, id, boundsMin, boundsMax, slot))
+		{
+			instances[slot] = model;
+			++deferredCount;
+			return;
+		}
+	}
+
+	occlusion->AddDrawn(imageIndex, id, boundsMin, boundsMax);
+	instances[instanceCount++] = model;
 }
 
 void Vulkan_Graphics::UpdateUniformBuffer(uint32_t imageIndex)
 {
+	PROFILE_ZONE("UpdateUniformBuffer");
+
 	static auto startTime = std::chrono::high_resolution_clock::now();
 
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+	glm::vec3 eye = glm::vec3(2.0f, 2.0f, 2.0f);
+	glm::vec3 target = glm::vec3(0.0f, 0.0f, 0.0f);
+	float modelAngle;
+
+	if (cameraPath)
+	{
+		cameraPath->Evaluate(cameraPathFrame, eye, target, modelAngle);
+	}
+	else if (gameState)
+	{
+		modelAngle = gameState->modelAngle;
+	}
+	else
+	{
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+
+		modelAngle = time * 90.0f;
+	}
 
+	//in a level the camera stands at the player start and turns on the spot as the model spins
+	float nearPlane = 0.1f;
+	float farPlane = 10.0f;
+
+	if (level)
+	{
+		if (!cameraPath)
+		{
+			float yaw = glm::radians(level->GetStartAngle() + modelAngle);
+
+			eye = level->GetStartEye();
+			target = eye + glm::vec3(cosf(yaw), sinf(yaw), 0.0f);
+		}
+
+		nearPlane = 1.0f;
+		farPlane = std::max(farPlane, level->GetExtent());
+	}
 
 	UniformBufferObject ubo = {};
-	ubo.model = glm::rotate(glm::mat4(1.0f), (time * glm::radians(90.0f)), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), swapchainWrapper->GetExtent().width / (float)swapchainWrapper->GetExtent().height, 0.1f, 10.0f);
+	ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(modelAngle), glm::vec3(0.0f, 0.0f, 1.0f));
+	ubo.view = glm::lookAt(eye, target, glm::vec3(0.0f, 0.0f, 1.0f));
+	ubo.proj = glm::perspective(glm::radians(45.0f), GetRenderExtent().width / (float)GetRenderExtent().height, nearPlane, farPlane);
 	ubo.proj[1][1] *= -1;
 
+	//every entity in view carrying the model becomes one instance, without entities the model is drawn once at the origin
+	uint32_t instanceCount = 0;
+	uint32_t deferredCount = 0;
+	uint32_t instanceIds = level ? level->GetLeafCount() : 0;
+
+	if (occlusion)
+	{
+		occlusion->BeginFrame(imageIndex, *bufferWrapper->GetIndirectCommand(imageIndex));
+	}
+
+	if (gameState && !gameState->instances.empty() && !cameraPath)
+	{
+		const std::vector<Game_Instance> &gameInstances = gameState->instances;
+
+		//the model's bounding sphere is centred on its origin, so rotation leaves it alone and scale scales it
+		culler->Resize((uint32_t)gameInstances.size());
+
+		for (uint32_t i = 0; i < (uint32_t)gameInstances.size(); ++i)
+		{
+			culler->SetSphere(i, gameInstances[i].position, gameInstances[i].scale * modelRadius);
+		}
+
+		culler->SetFrustum(ubo.proj * ubo.view);
+
+		uint32_t visibleCount = culler->Cull(jobSystem);
+		const uint32_t *visible = culler->GetVisible();
+
+		for (uint32_t i = 0; i < visibleCount; ++i)
+		{
+			const Game_Instance &instance = gameInstances[visible[i]];
+
+			if (instance.mesh != MESH_MODEL)
+			{
+				continue;
+			}
+
+			if (instanceCount + deferredCount == MAX_INSTANCES)
+			{
+				break;
+			}
+
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), instance.position);
+			model = glm::rotate(model, glm::radians(instance.yaw), glm::vec3(0.0f, 0.0f, 1.0f));
+			model = glm::scale(model, glm::vec3(instance.scale));
+
+			AddModelInstance(imageIndex, instanceIds + visible[i], model, instance.position, instance.scale * modelRadius, instanceCount, deferredCount);
+		}
+	}
+	else
+	{
+		AddModelInstance(imageIndex, instanceIds, ubo.model, glm::vec3(0.0f), modelRadius, instanceCount, deferredCount);
+	}
+
+	bufferWrapper->GetIndirectCommand(imageIndex)->instanceCount = instanceCount;
+
+	if (level)
+	{
+		UpdateLevelDraws(imageIndex, eye, ubo.proj * ubo.view);
+	}
+
+	if (occlusion)
+	{
+		occlusion->EndFrame(imageIndex);
+	}
+
+	ubo.paletteIndex = paletteIndex;
+	ubo.fixedColormap = fixedColormap;
+	ubo.sectorLight = sectorLight;
+	ubo.lightDiminishing = PALETTE_LIGHT_DIMINISHING;
+
+	//the model's bounding sphere projected to pixels picks the texture level it needs on screen
+	Texture_Resource *texture = textureManager->GetTexture(modelTexture);
+	float distance = std::max(glm::length(eye), modelRadius);
+	float screenPixels = modelRadius / (distance * tanf(glm::radians(45.0f) * 0.5f)) * GetRenderExtent().height;
+
+	textureManager->RequestLevel(modelTexture, Texture_Manager::LevelForCoverage(std::max(texture->texture.width, texture->texture.height), screenPixels));
+
 	void* data;
 	vkMapMemory(logicalDevice, bufferWrapper->GetUniformBuffersMemory()[imageIndex], 0, sizeof(ubo), 0, &data);
 	memcpy(data, &ubo, sizeof(ubo));
@@ -1,33 +1,481 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
 #include <vulkan/vulkan.h>
 
 #include "GLFW_Wrapper.h"
 #include "Vulkan_Graphics.h"
 #include "simple_logger.h"
+#include "Profiler.h"
+#include "Benchmark.h"
+#include "Shader_Archive.h"
+#include "Texture_Cooker.h"
+#include "Texture_Packer.h"
+#include "Texture_Decoder.h"
+#include "Job_System.h"
+#include "Game_Loop.h"
+#include "Entity_Manager.h"
+#include "Frustum_Culler.h"
+#include "Level_Compiler.h"
 
 using namespace std;
 
-int main(int agrc, char *argv[])
+const static uint32_t PROFILE_HOTKEY_FRAMES = 120;
+const static uint32_t ENTITY_BENCHMARK_COUNT = 100000;
+const static uint32_t CULL_BENCHMARK_COUNT = 100000;
+const static uint32_t LEVEL_BENCHMARK_ROOMS = 16;
+
+//-selftest sizes, small enough to run on every build
+const static uint32_t SELFTEST_ENTITY_COUNT = 10000;
+const static uint32_t SELFTEST_CULL_COUNT = 10000;
+const static uint32_t SELFTEST_JOB_THREADS = 4;
+const static uint32_t SELFTEST_LEVEL_ROOMS = 4;
+
+//lays count copies of the model out in a square over the single model's footprint, each spinning at its own rate
+static void SpawnActors(Entity_Manager &entities, uint32_t count, float modelRadius)
+{
+	uint32_t side = (uint32_t)ceilf(sqrtf((float)count));
+	float spacing = 2.0f * modelRadius / side;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Entity_Id actor = entities.Create(ENTITY_MASK(EC_TRANSFORM) | ENTITY_MASK(EC_VELOCITY) | ENTITY_MASK(EC_MESH));
+		Transform_Component *transform = entities.Get<Transform_Component>(actor);
+
+		transform->position = glm::vec3(-modelRadius + spacing * (i % side + 0.5f), -modelRadius + spacing * (i / side + 0.5f), 0.0f);
+		transform->scale = 1.0f / side;
+
+		entities.Get<Velocity_Component>(actor)->angular = 45.0f + (i * 37) % 90;
+		entities.Get<Mesh_Component>(actor)->mesh = MESH_MODEL;
+	}
+
+	slog("spawned %u actors", count);
+}
+
+static int RunHeadless(uint32_t width, uint32_t height, uint32_t frameCount, const char *readbackFile, const char *levelFile)
+{
+	Job_System jobSystem;
+	jobSystem.Job_SystemInit();
+
+	Vulkan_Graphics vGraphics = Vulkan_Graphics(width, height, false, &jobSystem, levelFile);
+	std::vector<double> frameTimes(frameCount);
+	double totalMs = 0.0;
+
+	auto runStart = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		auto frameStart = std::chrono::steady_clock::now();
+
+		vGraphics.DrawFrame();
+
+		PROFILE_FRAME();
+
+		frameTimes[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+		totalMs += frameTimes[i];
+	}
+
+	vkDeviceWaitIdle(vGraphics.GetLogicalDevice());
+
+	double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+
+	if (frameCount)
+	{
+		std::sort(frameTimes.begin(), frameTimes.end());
+
+		slog("headless run: %i frames at %ix%i", frameCount, width, height);
+		slog("cpu frame time ms: min %f avg %f median %f max %f", frameTimes.front(), totalMs / frameCount, frameTimes[frameCount / 2], frameTimes.back());
+		slog("wall time %f ms, %f frames per second", wallMs, frameCount * 1000.0 / wallMs);
+	}
+
+	if (readbackFile && !vGraphics.SaveFrame(readbackFile))
+	{
+		return 1;
+	}
+
+	vkDeviceWaitIdle(vGraphics.GetLogicalDevice());
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
 {
+	uint32_t profileFrames = 0;
+	const char *profileFile = "profile_capture.json";
+	bool profileKeyDown = false;
+	bool headless = false;
+	uint32_t headlessFrames = 300;
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	const char *readbackFile = NULL;
+	bool benchmark = false;
+	bool hotReload = false;
+	int variantKey = -1;
+	uint32_t tickRate = GAME_DEFAULT_TICK_RATE;
+	uint32_t actorCount = 0;
+	const char *levelFile = NULL;
+	Benchmark_Config benchConfig;
+
+	//offline tool mode, packs the listed SPIR-V files and exits without creating a device
+	if (argc > 2 && strcmp(argv[1], "-packshaders") == 0)
+	{
+		init_logger("logFile.txt");
+
+		std::vector<std::string> shaderFiles(argv + 3, argv + argc);
+
+		int result = Shader_Archive::Pack(argv[2], shaderFiles) ? 0 : 1;
+
+		slog_sync();
 
-	GLFW_Wrapper *glfwWrapper = new GLFW_Wrapper("Doomlike", 1280, 720, false);
-	Vulkan_Graphics vGraphics = Vulkan_Graphics(glfwWrapper, true);
+		return result;
+	}
+
+	if (argc > 3 && strcmp(argv[1], "-cooktexture") == 0)
+	{
+		init_logger("logFile.txt");
+
+		TextureCookFormat format = (argc > 4 && strcmp(argv[4], "bc1") == 0) ? TC_BC1 : TC_BC7;
+
+		int result = Texture_Cooker::Cook(argv[2], argv[3], format) ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//times decoding the listed images on one worker against the whole pool, no device is created
+	if (argc > 2 && strcmp(argv[1], "-decodetextures") == 0)
+	{
+		init_logger("logFile.txt");
+
+		std::vector<std::string> images(argv + 2, argv + argc);
+
+		int result = Texture_Decoder::Benchmark(images) ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//cost of a profiler zone with and without a capture running
+	if (argc > 1 && strcmp(argv[1], "-benchprofiler") == 0)
+	{
+		init_logger("logFile.txt");
+
+		int result = Profiler::Benchmark() ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//spawn and steal cost per job and parallel for scaling, up to 32 threads unless given
+	if (argc > 1 && strcmp(argv[1], "-benchjobs") == 0)
+	{
+		init_logger("logFile.txt");
+
+		int result = Job_System::Benchmark(argc > 2 ? (uint32_t)atoi(argv[2]) : 0) ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//integrates transforms over archetype arrays against an array of actor structs, 100k entities unless given
+	if (argc > 1 && strcmp(argv[1], "-benchentities") == 0)
+	{
+		init_logger("logFile.txt");
+
+		int result = Entity_Manager::Benchmark(argc > 2 ? (uint32_t)atoi(argv[2]) : ENTITY_BENCHMARK_COUNT) ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//culls bounding spheres on the scalar, SSE and AVX2 paths and checks they agree, 100k spheres unless given
+	if (argc > 1 && strcmp(argv[1], "-benchcull") == 0)
+	{
+		init_logger("logFile.txt");
+
+		int result = Frustum_Culler::Benchmark(argc > 2 ? (uint32_t)atoi(argv[2]) : CULL_BENCHMARK_COUNT) ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//builds the BSP and PVS of a text map into a level file
+	if (argc > 3 && strcmp(argv[1], "-compilelevel") == 0)
+	{
+		init_logger("logFile.txt");
+
+		int result = Level_Compiler::CompileFile(argv[2], argv[3]) ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//compiles a square grid of rooms, 16 a side unless given, and checks the PVS against sight lines across it
+	if (argc > 1 && strcmp(argv[1], "-benchlevel") == 0)
+	{
+		init_logger("logFile.txt");
+
+		int result = Level_Compiler::Benchmark(argc > 2 ? (uint32_t)atoi(argv[2]) : LEVEL_BENCHMARK_ROOMS) ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//the checks of every benchmark above at small sizes, exits non-zero if any of them fails so a build can gate on it
+	if (argc > 1 && strcmp(argv[1], "-selftest") == 0)
+	{
+		init_logger("logFile.txt");
+
+		bool passed = Frustum_Culler::Benchmark(SELFTEST_CULL_COUNT);
+
+		passed = Job_System::Benchmark(SELFTEST_JOB_THREADS) && passed;
+		passed = Entity_Manager::Benchmark(SELFTEST_ENTITY_COUNT) && passed;
+		passed = Level_Compiler::Benchmark(SELFTEST_LEVEL_ROOMS) && passed;
+
+		slog("self test %s", passed ? "passed" : "failed");
+
+		slog_sync();
+
+		return passed ? 0 : 1;
+	}
+
+	//maps an image drawn in the palette to 8-bit indices, for the paletted shading path
+	if (argc > 4 && strcmp(argv[1], "-cookpaletted") == 0)
+	{
+		init_logger("logFile.txt");
+
+		int result = Texture_Cooker::CookPaletted(argv[2], argv[3], argv[4]) ? 0 : 1;
+
+		slog_sync();
+
+		return result;
+	}
+
+	//packs every image into array layers and atlas pages and writes them out for inspection
+	if (argc > 3 && strcmp(argv[1], "-packtextures") == 0)
+	{
+		init_logger("logFile.txt");
+
+		Texture_Packer packer;
+		int result = 0;
+
+		for (int i = 3; i < argc; ++i)
+		{
+			if (!packer.AddImage(argv[i]))
+			{
+				result = 1;
+			}
+		}
+
+		packer.Pack();
+
+		if (!packer.WriteDebugOutput(argv[2]))
+		{
+			result = 1;
+		}
+
+		slog_sync();
+
+		return result;
+	}
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc)
+		{
+			profileFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-profileout") == 0 && i + 1 < argc)
+		{
+			profileFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-headless") == 0)
+		{
+			headless = true;
+		}
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+		{
+			headlessFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-benchmark") == 0 && i + 1 < argc)
+		{
+			benchmark = true;
+			benchConfig.measuredFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc)
+		{
+			benchConfig.warmupFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-benchpath") == 0 && i + 1 < argc)
+		{
+			benchConfig.pathFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-benchout") == 0 && i + 1 < argc)
+		{
+			benchConfig.outputFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-readback") == 0 && i + 1 < argc)
+		{
+			readbackFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-variant") == 0 && i + 1 < argc)
+		{
+			variantKey = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-tickrate") == 0 && i + 1 < argc)
+		{
+			tickRate = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-actors") == 0 && i + 1 < argc)
+		{
+			actorCount = (uint32_t)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-level") == 0 && i + 1 < argc)
+		{
+			levelFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-hotreload") == 0)
+		{
+			hotReload = true;
+		}
+		else if (strcmp(argv[i], "-size") == 0 && i + 2 < argc)
+		{
+			width = (uint32_t)atoi(argv[++i]);
+			height = (uint32_t)atoi(argv[++i]);
+		}
+	}
+
+	if (benchmark && headless)
+	{
+		init_logger("logFile.txt");
+
+		Profiler::BeginCapture(profileFrames, profileFile);
+
+		Job_System jobSystem;
+		jobSystem.Job_SystemInit();
+
+		Vulkan_Graphics vGraphics = Vulkan_Graphics(width, height, false, &jobSystem, levelFile);
+		Benchmark_Runner runner = Benchmark_Runner(&vGraphics, NULL, benchConfig);
+
+		int result = runner.Run();
+
+		Profiler::Flush();
+
+		slog_sync();
+
+		return result;
+	}
+
+	if (headless)
+	{
+		init_logger("logFile.txt");
+
+		if (readbackFile && !headlessFrames)
+		{
+			slog("-readback needs at least one frame, -frames 0 draws none");
+			slog_sync();
+			return 1;
+		}
+
+		Profiler::BeginCapture(profileFrames, profileFile);
+
+		int result = RunHeadless(width, height, headlessFrames, readbackFile, levelFile);
+
+		Profiler::Flush();
+
+		slog_sync();
+
+		return result;
+	}
+
+	//open before the window and device so model loading, texture decoding and pipeline compiles land in the first frame
+	Profiler::BeginCapture(profileFrames, profileFile);
+
+	//the window thread is the job system's main thread, GLFW calls from jobs go through RunOnMainThread
+	Job_System jobSystem;
+	jobSystem.Job_SystemInit();
+
+	GLFW_Wrapper *glfwWrapper = new GLFW_Wrapper("Doomlike", width, height, false);
+	Vulkan_Graphics vGraphics = Vulkan_Graphics(glfwWrapper, true, &jobSystem, levelFile);
 
 	init_logger("logFile.txt");
 
+	Entity_Manager entities;
+	SpawnActors(entities, actorCount, vGraphics.GetModelRadius());
+
+	Game_Loop gameLoop;
+	gameLoop.Game_LoopInit(&jobSystem, actorCount ? &entities : NULL, tickRate);
+
+	if (hotReload)
+	{
+		vGraphics.EnableShaderHotReload("shaders");
+	}
+
+	if (variantKey >= 0)
+	{
+		vGraphics.SetMaterialVariant((uint32_t)variantKey);
+	}
+
+	if (benchmark)
+	{
+		Benchmark_Runner runner = Benchmark_Runner(&vGraphics, glfwWrapper, benchConfig);
+
+		int result = runner.Run();
+
+		Profiler::Flush();
+
+		slog_sync();
+
+		vkDeviceWaitIdle(vGraphics.GetLogicalDevice());
+
+		return result;
+	}
+
 	while (!glfwWindowShouldClose(glfwWrapper->GetWindow()))
 	{
 		glfwPollEvents();
 
+		if (glfwGetKey(glfwWrapper->GetWindow(), GLFW_KEY_F12) == GLFW_PRESS)
+		{
+			if (!profileKeyDown)
+			{
+				Profiler::BeginCapture(profileFrames ? profileFrames : PROFILE_HOTKEY_FRAMES, profileFile);
+			}
+			profileKeyDown = true;
+		}
+		else
+		{
+			profileKeyDown = false;
+		}
+
+		jobSystem.RunMainThreadJobs();
+
+		vGraphics.SetGameState(gameLoop.Advance());
 		vGraphics.DrawFrame();
+
+		PROFILE_FRAME();
 	}
 
 	slog("Ending program...");
 
+	Profiler::Flush();
+
 	slog_sync();
 
 	vkDeviceWaitIdle(vGraphics.GetLogicalDevice());
 
 	return 0;
-}
\ No newline at end of file
+}